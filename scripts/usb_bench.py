@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+
+############################### usb_bench.py ###############################
+"""
+USB CDC benchmark for HydraBus (USB1 or USB2 console).
+
+Start HydraBus with latest HydraFW, close any console opened on the port
+to test then launch this script with the port name.
+It uses the following HydraFW commands:
+debug test-tx       => device to host throughput (pattern is checked)
+debug test-loopback => round-trip latency and throughput per packet size
+debug test-rx       => host to device throughput (stopped with UBTN + Key)
+
+Examples
+usb_bench.py COM3
+usb_bench.py /dev/ttyACM0 --tx-time 10
+usb_bench.py /dev/ttyACM1 --sizes 1 64 512 4096 --count 200
+usb_bench.py /dev/ttyACM0 --rx
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+LOOPBACK_SIZES = [1, 16, 64, 256, 512, 1024, 4096]
+
+
+def open_port(port):
+    try:
+        return serial.Serial(port, 115200, timeout=2)
+    except serial.SerialException as e:
+        print("Couldn't open serial port %s: %s" % (port, e))
+        sys.exit(1)
+
+
+def start_cmd(ser, cmd):
+    """ Send a console command and wait for its "started" line """
+    ser.reset_input_buffer()
+    ser.write(b"\r")
+    time.sleep(0.1)
+    ser.reset_input_buffer()
+    ser.write(cmd.encode("ascii") + b"\r")
+    line = b""
+    deadline = time.time() + 3
+    while time.time() < deadline:
+        line += ser.read(1)
+        if line.endswith(b"\r\n"):
+            if b"started" in line:
+                return
+            line = b""
+    print("No answer to '%s'" % cmd)
+    sys.exit(1)
+
+
+def wait_end(ser, pattern, timeout=5):
+    """ Read until the end line of the test, return it """
+    data = b""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        data += ser.read(max(1, ser.in_waiting))
+        idx = data.find(pattern)
+        if idx >= 0 and data.endswith(b"\r\n") and data.rfind(b"\r\n") > idx:
+            return data[idx:].strip().decode("ascii", "replace")
+    return None
+
+
+def percentile(values, p):
+    values = sorted(values)
+    idx = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[idx]
+
+
+def bench_tx(ser, duration):
+    start_cmd(ser, "debug test-tx")
+
+    nb_bytes = 0
+    nb_errors = 0
+    expected = None
+    start = time.perf_counter()
+    while time.perf_counter() - start < duration:
+        data = ser.read(max(1, ser.in_waiting))
+        if not data:
+            continue
+        if expected is None:
+            expected = data[0]
+        for b in data:
+            if b != expected:
+                nb_errors += 1
+                expected = b
+            expected = (expected + 1) & 0xFF
+        nb_bytes += len(data)
+    elapsed = time.perf_counter() - start
+
+    ser.write(b"\x00")
+    end = wait_end(ser, b"Test debug-tx end")
+
+    print("TX(device->host): %d bytes in %.3fs => %.3f MB/s, pattern errors: %d" %
+          (nb_bytes, elapsed, nb_bytes / elapsed / 1e6, nb_errors))
+    if end:
+        print("  device: %s" % end)
+
+
+def bench_loopback(ser, sizes, count):
+    start_cmd(ser, "debug test-loopback")
+
+    print("Loopback %d packets per size" % count)
+    print("%6s %10s %10s %10s %10s %10s %8s" %
+          ("size", "p50(us)", "p90(us)", "p99(us)", "max(us)", "MB/s", "errors"))
+    for size in sizes:
+        payload = bytes(i & 0xFF for i in range(size))
+        rtts = []
+        nb_errors = 0
+        total_start = time.perf_counter()
+        for _ in range(count):
+            t0 = time.perf_counter()
+            ser.write(payload)
+            answer = ser.read(size)
+            rtts.append((time.perf_counter() - t0) * 1e6)
+            if answer != payload:
+                nb_errors += 1
+        total = time.perf_counter() - total_start
+        print("%6d %10.0f %10.0f %10.0f %10.0f %10.3f %8d" %
+              (size, percentile(rtts, 50), percentile(rtts, 90),
+               percentile(rtts, 99), max(rtts),
+               (2 * size * count) / total / 1e6, nb_errors))
+
+    # Device stops after 2s without data
+    end = wait_end(ser, b"Test debug-loopback end", timeout=5)
+    if end:
+        print("  device: %s" % end)
+
+
+def bench_rx(ser, size, duration):
+    start_cmd(ser, "debug test-rx")
+
+    payload = bytes(i & 0xFF for i in range(size))
+    nb_bytes = 0
+    start = time.perf_counter()
+    while time.perf_counter() - start < duration:
+        ser.write(payload)
+        nb_bytes += size
+    ser.flush()
+    elapsed = time.perf_counter() - start
+
+    print("RX(host->device): %d bytes in %.3fs => %.3f MB/s" %
+          (nb_bytes, elapsed, nb_bytes / elapsed / 1e6))
+    print("  press UBTN then send a key to stop debug test-rx")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HydraBus USB CDC benchmark")
+    parser.add_argument("port", help="Serial port (COM3, /dev/ttyACM0...)")
+    parser.add_argument("--tx-time", type=float, default=5,
+                        help="debug test-tx duration in s (0 to skip)")
+    parser.add_argument("--sizes", type=int, nargs="+", default=LOOPBACK_SIZES,
+                        help="debug test-loopback packet sizes (max 4096)")
+    parser.add_argument("--count", type=int, default=500,
+                        help="debug test-loopback packets per size (0 to skip)")
+    parser.add_argument("--rx", action="store_true",
+                        help="Run debug test-rx at the end (needs UBTN to stop)")
+    parser.add_argument("--rx-size", type=int, default=4096)
+    parser.add_argument("--rx-time", type=float, default=5)
+    args = parser.parse_args()
+
+    ser = open_port(args.port)
+    if args.tx_time > 0:
+        bench_tx(ser, args.tx_time)
+    if args.count > 0:
+        bench_loopback(ser, [s for s in args.sizes if 0 < s <= 4096], args.count)
+    if args.rx:
+        bench_rx(ser, args.rx_size, args.rx_time)
+    ser.close()
+
+
+if __name__ == "__main__":
+    main()
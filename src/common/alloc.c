@@ -40,6 +40,7 @@ void pool_init(void)
 	ram_pool.pool_size = POOL_BLOCK_NUMBER;
 	ram_pool.block_size = POOL_BLOCK_SIZE;
 	ram_pool.blocks_used = 0;
+	ram_pool.blocks_used_max = 0;
 	ram_pool.pool = pool_buf;
 	
 	for(i=0; i<sizeof(ram_pool.blocks); i++) {
@@ -87,6 +88,9 @@ void * pool_alloc_blocks(uint8_t num_blocks)
 					ram_pool.blocks[i+j] = num_blocks;
 				}
 				ram_pool.blocks_used += num_blocks;
+				if(ram_pool.blocks_used > ram_pool.blocks_used_max) {
+					ram_pool.blocks_used_max = ram_pool.blocks_used;
+				}
 				return ram_pool.pool+(ram_pool.block_size * i);
 			}
 		}
@@ -145,6 +149,16 @@ uint8_t pool_stats_used()
 	return ram_pool.blocks_used;
 }
 
+uint8_t pool_stats_used_max()
+{
+	return ram_pool.blocks_used_max;
+}
+
+void pool_stats_clear_max()
+{
+	ram_pool.blocks_used_max = ram_pool.blocks_used;
+}
+
 uint8_t * pool_stats_blocks()
 {
 	return ram_pool.blocks;
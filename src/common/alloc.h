@@ -29,6 +29,7 @@ typedef struct pool {
 	uint32_t block_size;	// Block size in bytes
 	uint8_t pool_size;	// Total number of blocks
 	uint8_t blocks_used;	// Number of used blocks
+	uint8_t blocks_used_max;	// High-water mark of used blocks
 	uint8_t blocks[POOL_BLOCK_NUMBER];	// Blocks status
 }pool_t;
 
@@ -42,6 +43,8 @@ void pool_free(void * ptr);
 
 uint8_t pool_stats_free(void);
 uint8_t pool_stats_used(void);
+uint8_t pool_stats_used_max(void);
+void pool_stats_clear_max(void);
 uint8_t * pool_stats_blocks(void);
 
 #endif /* _ALLOC_H_ */
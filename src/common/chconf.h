@@ -587,7 +587,8 @@
  * @details User fields added to the end of the @p thread_t structure.
  */
 #define CH_CFG_THREAD_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  /* Add threads custom fields here.*/                                      \
+  uint64_t perf_cycles; /* CPU cycles, see perf.c */
 
 /**
  * @brief   Threads initialization hook.
@@ -598,6 +599,7 @@
  */
 #define CH_CFG_THREAD_INIT_HOOK(tp) {                                       \
   /* Add threads initialization code here.*/                                \
+  (tp)->perf_cycles = 0;                                                    \
 }
 
 /**
@@ -614,6 +616,7 @@
  */
 #define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
   /* Context switch code here.*/                                            \
+  perf_context_switch(otp);                                                 \
 }
 
 /**
@@ -621,6 +624,7 @@
  */
 #define CH_CFG_IRQ_PROLOGUE_HOOK() {                                        \
   /* IRQ prologue code here.*/                                              \
+  perf_irq_enter();                                                         \
 }
 
 /**
@@ -628,6 +632,7 @@
  */
 #define CH_CFG_IRQ_EPILOGUE_HOOK() {                                        \
   /* IRQ epilogue code here.*/                                              \
+  perf_irq_exit();                                                          \
 }
 
 /**
@@ -691,6 +696,14 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+/* Performance counters hooks (see perf.c) */
+#if !defined(_FROM_ASM_)
+struct ch_thread;
+void perf_context_switch(struct ch_thread *otp);
+void perf_irq_enter(void);
+void perf_irq_exit(void);
+#endif
+
 #endif  /* CHCONF_H */
 
 /** @} */
@@ -29,6 +29,8 @@
 #include "bsp_gpio.h"
 #include "microsd.h"
 #include "hydrabus_sd.h"
+#include "hexdump.h"
+#include "usb_tx.h"
 
 #define HYDRAFW_VERSION "HydraFW (HydraBus) " HYDRAFW_GIT_TAG " " HYDRAFW_CHECKIN_DATE
 #define TEST_WA_SIZE    THD_WORKING_AREA_SIZE(256)
@@ -36,8 +38,12 @@
 /* Generic large buffer.*/
 uint8_t fbuff[2048] __attribute__ ((section(".ram4")));
 
+/* Unique per build, common.o is rebuilt with hydrafw_version.hdr (see Makefile) */
+const char hydrafw_build_id[] = HYDRAFW_GIT_TAG " " __DATE__ " " __TIME__;
+
 extern uint32_t debug_flags;
 extern char log_dest[];
+extern t_token_dict tl_dict[];
 
 void stream_write(t_hydra_console *con, const char *data, const uint32_t size)
 {
@@ -47,6 +53,7 @@ void stream_write(t_hydra_console *con, const char *data, const uint32_t size)
 		return;
 
 	chnWrite(chp, (uint8_t *)data, size);
+	usb_tx_perf(con, size);
 
 	if (con->log_file.obj.fs)
 		file_append(&(con->log_file), (uint8_t *)data, size);
@@ -73,34 +80,179 @@ void cprint(t_hydra_console *con, const char *data, const uint32_t size)
 	stream_write(con, data, size);
 }
 
-void print_hex(t_hydra_console *con, uint8_t* data, uint8_t size)
+/* Lines are formatted in a buffer written with one cprint() when full */
+#define PRINT_HEX_BUF_SIZE (512)
+
+void print_hex(t_hydra_console *con, uint8_t* data, uint32_t size)
+{
+	char buf[PRINT_HEX_BUF_SIZE];
+	uint32_t idx, i, n;
+
+	idx = 0;
+	for (i = 0; i < size; i += n) {
+		n = size - i;
+		if (n > HEXDUMP_LINE_BYTES)
+			n = HEXDUMP_LINE_BYTES;
+
+		if ((idx + HEXDUMP_LINE_MAX) > sizeof(buf)) {
+			cprint(con, buf, idx);
+			idx = 0;
+		}
+		idx += hexdump_line(&buf[idx], &data[i], n);
+	}
+	if (idx > 0)
+		cprint(con, buf, idx);
+}
+
+/* Same as print_hex() with address of first byte of each line */
+void print_hex_addr(t_hydra_console *con, uint32_t addr, uint8_t* data, uint32_t size)
 {
-	uint8_t ascii[17];
-	uint8_t i, j;
-	ascii[16] = '\0';
-	for (i = 0; i < size; ++i) {
-		cprintf(con, "%02X ", data[i]);
-		if (data[i] >= 0x20 && data[i] <= 0x7f) {
-			ascii[i % 16] = data[i];
+	char buf[PRINT_HEX_BUF_SIZE];
+	uint32_t idx, i, n;
+
+	idx = 0;
+	for (i = 0; i < size; i += n) {
+		n = size - i;
+		if (n > HEXDUMP_LINE_BYTES)
+			n = HEXDUMP_LINE_BYTES;
+
+		if ((idx + 10 + HEXDUMP_LINE_MAX) > sizeof(buf)) {
+			cprint(con, buf, idx);
+			idx = 0;
+		}
+		hexdump_u8(&buf[idx], (addr + i) >> 24, hexdump_digits_upper);
+		hexdump_u8(&buf[idx + 2], (addr + i) >> 16, hexdump_digits_upper);
+		hexdump_u8(&buf[idx + 4], (addr + i) >> 8, hexdump_digits_upper);
+		hexdump_u8(&buf[idx + 6], addr + i, hexdump_digits_upper);
+		buf[idx + 8] = ':';
+		buf[idx + 9] = ' ';
+		idx += 10;
+		idx += hexdump_line(&buf[idx], &data[i], n);
+	}
+	if (idx > 0)
+		cprint(con, buf, idx);
+}
+
+/* Print prefix then " XX" for each byte and "\r\n" */
+void print_hex_bytes(t_hydra_console *con, const char *prefix, const uint8_t* data, uint32_t size)
+{
+	char buf[PRINT_HEX_BUF_SIZE];
+	uint32_t idx, n;
+
+	idx = strlen(prefix);
+	if (idx > (sizeof(buf) - 3))
+		idx = sizeof(buf) - 3;
+	memcpy(buf, prefix, idx);
+
+	while (size > 0) {
+		n = (sizeof(buf) - 3 - idx) / 3;
+		if (n == 0) {
+			cprint(con, buf, idx);
+			idx = 0;
+			continue;
+		}
+		if (n > size)
+			n = size;
+		idx += hexdump_bytes(&buf[idx], data, n);
+		data += n;
+		size -= n;
+	}
+	buf[idx++] = '\r';
+	buf[idx++] = '\n';
+	cprint(con, buf, idx);
+}
+
+/*
+ * Read size bytes from start with io->chunk to filename, or print them as an
+ * addressed hexdump if filename is NULL. Stop on error or UBTN.
+ */
+bool range_read_to_file(t_hydra_console *con, const t_range_io *io,
+			uint32_t start, uint32_t size, const char *filename)
+{
+	uint32_t done, nb;
+	bool ok;
+	FIL fp;
+
+	if (filename != NULL) {
+		if (!file_open(&fp, filename, 'w') || f_truncate(&fp) != FR_OK) {
+			cprintf(con, "Failed to open file %s\r\n", filename);
+			return FALSE;
+		}
+	}
+
+	ok = (io->begin == NULL) || io->begin(con, io->ctx, start, size);
+	for (done = 0; ok && done < size; done += nb) {
+		if (hydrabus_ubtn()) {
+			cprintf(con, "Aborted by UBTN\r\n");
+			ok = FALSE;
+			break;
+		}
+		nb = size - done;
+		if (nb > io->chunk_size)
+			nb = io->chunk_size;
+
+		if (!io->chunk(con, io->ctx, start + done, io->buf, nb)) {
+			ok = FALSE;
+			break;
+		}
+		if (filename != NULL) {
+			ok = file_append(&fp, io->buf, nb);
+			if (!ok)
+				cprintf(con, "Failed to write file %s\r\n", filename);
 		} else {
-			ascii[i % 16] = '.';
+			print_hex_addr(con, start + done, io->buf, nb);
 		}
-		if ((i+1) % 8 == 0 || i+1 == size) {
-			cprintf(con, " ");
-			if ((i+1) % 16 == 0) {
-				cprintf(con, "|  %s \r\n", ascii);
-			} else if (i+1 == size) {
-				ascii[(i+1) % 16] = '\0';
-				if ((i+1) % 16 <= 8) {
-					cprintf(con, " ");
-				}
-				for (j = (i+1) % 16; j < 16; ++j) {
-					cprintf(con, "   ");
-				}
-				cprintf(con, "|  %s \r\n", ascii);
-			}
+	}
+
+	if (filename != NULL) {
+		if (!file_close(&fp) && ok) {
+			cprintf(con, "Failed to write file %s\r\n", filename);
+			ok = FALSE;
+		}
+	}
+
+	return ok;
+}
+
+/*
+ * Write *size bytes from filename at start with io->chunk, *size is set to
+ * the file size if it is 0 or above. Stop on error or UBTN.
+ */
+bool range_write_from_file(t_hydra_console *con, const t_range_io *io,
+			   uint32_t start, uint32_t *size, const char *filename)
+{
+	uint32_t done, nb;
+	bool ok;
+	FIL fp;
+
+	if (!file_open(&fp, filename, 'r')) {
+		cprintf(con, "Failed to open file %s\r\n", filename);
+		return FALSE;
+	}
+	if (*size == 0 || *size > f_size(&fp))
+		*size = f_size(&fp);
+
+	ok = (io->begin == NULL) || io->begin(con, io->ctx, start, *size);
+	for (done = 0; ok && done < *size; done += nb) {
+		if (hydrabus_ubtn()) {
+			cprintf(con, "Aborted by UBTN\r\n");
+			ok = FALSE;
+			break;
+		}
+		nb = *size - done;
+		if (nb > io->chunk_size)
+			nb = io->chunk_size;
+
+		if (file_read(&fp, io->buf, nb) != nb) {
+			cprintf(con, "Failed to read file %s\r\n", filename);
+			ok = FALSE;
+			break;
 		}
+		ok = io->chunk(con, io->ctx, start + done, io->buf, nb);
 	}
+	file_close(&fp);
+
+	return ok;
 }
 
 void cprintf(t_hydra_console *con, const char *fmt, ...)
@@ -249,8 +401,75 @@ static void cmd_show_debug(t_hydra_console *con)
 		cprintf(con, "Debugging is disabled.\r\n");
 }
 
+/* Cycles to ms or % (in tenth) of elapsed cycles */
+#define PERF_CYCLES_MS(c) ((uint32_t)((c) / (STM32_HCLK / 1000)))
+#define PERF_PERMILLE(c, elapsed) ((uint32_t)(((c) * 1000) / (elapsed)))
+
+static void cmd_show_perf(t_hydra_console *con, bool clear)
+{
+	const t_perf_mode_slot *slot;
+	const t_perf_mode *cnt;
+	t_perf_isr isr;
+	thread_t *tp;
+	uint64_t elapsed, cycles;
+	uint32_t permille;
+	int i;
+
+	elapsed = perf_elapsed_cycles();
+	if (elapsed == 0)
+		elapsed = 1;
+	cprintf(con, "Elapsed: %lums\r\n\r\n", PERF_CYCLES_MS(elapsed));
+
+	cprintf(con, "mode          bytes in  bytes out   commands     errors   overruns\r\n");
+	for (i = 0; (slot = perf_mode_slot(i)) != NULL; i++) {
+		cnt = &slot->cnt;
+		cprintf(con, "%-10s %11lu %10lu %10lu %10lu %10lu\r\n",
+			tl_dict[slot->token].tokenstr, cnt->bytes_in,
+			cnt->bytes_out, cnt->commands, cnt->errors,
+			cnt->overruns);
+	}
+	cprint(con, "\r\n", 2);
+
+	cprintf(con, "thread              time(ms)   cpu\r\n");
+	tp = chRegFirstThread();
+	do {
+		cycles = tp->perf_cycles;
+		permille = PERF_PERMILLE(cycles, elapsed);
+		cprintf(con, "%-16s %11lu %3lu.%lu%%\r\n",
+			tp->name == NULL ? "" : tp->name, PERF_CYCLES_MS(cycles),
+			permille / 10, permille % 10);
+		tp = chRegNextThread(tp);
+	} while (tp != NULL);
+	cprint(con, "\r\n", 2);
+
+	perf_isr_get(&isr);
+	permille = PERF_PERMILLE(isr.cycles, elapsed);
+	cprintf(con, "ISR: %lu calls, %lums, cpu %lu.%lu%%\r\n",
+		isr.count, PERF_CYCLES_MS(isr.cycles),
+		permille / 10, permille % 10);
+	cprintf(con, "ISR longest: %lu cycles (%luus)\r\n", isr.cycles_max,
+		isr.cycles_max / (STM32_HCLK / 1000000));
+	cprintf(con, "USB tx: %lu bytes, queue high-water: %lu/%lu buffers\r\n",
+		con->perf.usb_tx_bytes, con->perf.usb_tx_hwm,
+		(uint32_t)con->sdu->obqueue.bn);
+	cprintf(con, "pool high-water: %u/%u blocks\r\n",
+		pool_stats_used_max(), POOL_BLOCK_NUMBER);
+
+	if (clear) {
+		perf_clear(con);
+		cprintf(con, "Counters cleared\r\n");
+	}
+}
+
 int cmd_show(t_hydra_console *con, t_tokenline_parsed *p)
 {
+	if (p->tokens[1] == T_PERF) {
+		if (p->tokens[2] != 0 && p->tokens[2] != T_CLEAR)
+			return FALSE;
+		cmd_show_perf(con, p->tokens[2] == T_CLEAR);
+		return TRUE;
+	}
+
 	if (p->tokens[1] == 0 || p->tokens[2] != 0)
 		return FALSE;
 
@@ -447,6 +666,107 @@ int cmd_debug_test_rx(t_hydra_console *con, t_tokenline_parsed *p)
 	return TRUE;
 }
 
+#define TEST_USB_BUF_SIZE (0x1000) /* Multiple of 256 to keep pattern continuous */
+#define TEST_USB_WRITE_TIMEOUT TIME_MS2I(1000)
+#define TEST_USB_LOOPBACK_IDLE TIME_MS2I(2000)
+
+static void test_usb_print_stats(t_hydra_console *con, const char *name,
+				 uint32_t nb_bytes, uint32_t nb_packets,
+				 systime_t start)
+{
+	uint32_t elapsed_ms;
+
+	elapsed_ms = TIME_I2MS(chVTTimeElapsedSinceX(start));
+	cprintf(con, "\r\nTest %s end: %d bytes %d packets in %dms", name,
+		nb_bytes, nb_packets, elapsed_ms);
+	if (elapsed_ms > 0)
+		cprintf(con, " (%d KB/s)", (uint32_t)(((uint64_t)nb_bytes * 1000) / (elapsed_ms * 1024)));
+	cprintf(con, "\r\n");
+}
+
+/*
+ * Debug tx speed: send pattern (byte n of stream is n & 0xFF) as fast as
+ * possible until UBTN is pressed, a byte is received or host stops reading.
+ */
+int cmd_debug_test_tx(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	(void)p;
+	uint8_t *outbuf;
+	uint8_t dummy;
+	uint32_t nb_bytes, nb_packets, nb_write;
+	systime_t start;
+	int i;
+
+	outbuf = pool_alloc_bytes(TEST_USB_BUF_SIZE);
+	if (outbuf == NULL) {
+		cprintf(con, "Error, unable to get buffer space.\r\n");
+		return FALSE;
+	}
+	for (i = 0; i < TEST_USB_BUF_SIZE; i++)
+		outbuf[i] = i & 0xFF;
+
+	cprintf(con, "Test debug-tx started, stop it with UBTN or Key\r\n");
+	nb_bytes = 0;
+	nb_packets = 0;
+	start = chVTGetSystemTimeX();
+	while (!hydrabus_ubtn()) {
+		if (chnReadTimeout(con->sdu, &dummy, 1, TIME_IMMEDIATE) > 0)
+			break;
+
+		nb_write = chnWriteTimeout(con->sdu, outbuf, TEST_USB_BUF_SIZE,
+					   TEST_USB_WRITE_TIMEOUT);
+		nb_bytes += nb_write;
+		if (nb_write != TEST_USB_BUF_SIZE)
+			break;
+		nb_packets++;
+	}
+	pool_free(outbuf);
+
+	test_usb_print_stats(con, "debug-tx", nb_bytes, nb_packets, start);
+	return TRUE;
+}
+
+/*
+ * Debug loopback: echo all data received (each read is sent back as soon
+ * as possible so host can measure round-trip time) until UBTN is pressed
+ * or no data is received during 2s.
+ */
+int cmd_debug_test_loopback(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	(void)p;
+	uint8_t *buf;
+	uint32_t nb_bytes, nb_packets, nb_read;
+	systime_t start;
+
+	buf = pool_alloc_bytes(TEST_USB_BUF_SIZE);
+	if (buf == NULL) {
+		cprintf(con, "Error, unable to get buffer space.\r\n");
+		return FALSE;
+	}
+
+	cprintf(con, "Test debug-loopback started, stop it with UBTN or 2s without data\r\n");
+	nb_bytes = 0;
+	nb_packets = 0;
+	start = chVTGetSystemTimeX();
+	while (!hydrabus_ubtn()) {
+		/* Wait first byte then get all bytes already received */
+		nb_read = chnReadTimeout(con->sdu, buf, 1, TEST_USB_LOOPBACK_IDLE);
+		if (nb_read == 0)
+			break;
+		nb_read += chnReadTimeout(con->sdu, &buf[1], TEST_USB_BUF_SIZE - 1,
+					  TIME_IMMEDIATE);
+
+		if (chnWriteTimeout(con->sdu, buf, nb_read, TEST_USB_WRITE_TIMEOUT) != nb_read)
+			break;
+		nb_bytes += nb_read;
+		nb_packets++;
+	}
+	pool_free(buf);
+
+	test_usb_print_stats(con, "debug-loopback", nb_bytes, nb_packets, start);
+	return TRUE;
+}
+
 uint8_t hexchartonibble(char hex)
 {
 	if (hex >= '0' && hex <= '9') return hex - '0';
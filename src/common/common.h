@@ -29,6 +29,9 @@
 #include "mode_config.h"
 #include "ff.h"
 #include "alloc.h"
+#include "periodic_sched.h"
+#include "perf.h"
+#include "hot_path.h"
 
 #define ARRAY_SIZE(x) (sizeof((x))/sizeof((x)[0]))
 
@@ -62,6 +65,9 @@ void DelayMs(uint32_t delay_ms);
 /* Generic large buffer.*/
 extern uint8_t fbuff[2048] __attribute__ ((section(".ram4")));
 
+/* Firmware git tag and build date/time */
+extern const char hydrafw_build_id[];
+
 #define NB_SBUFFER  (65536)
 #define G_SBUF_SDC_BURST_SIZE (NB_SBUFFER/MMCSD_BLOCK_SIZE) /* how many sectors reads at once */
 
@@ -85,6 +91,7 @@ extern SerialUSBDriver SDU2;
 #define PROMPT "> "
 
 struct t_mode_config;
+struct t_script;
 typedef struct hydra_console {
 	char *thread_name;
 	thread_t *thread;
@@ -96,6 +103,11 @@ typedef struct hydra_console {
 	t_mode_config *mode;
 	int console_mode;
 	FIL log_file;
+	mutex_t mutex; /* Held while console processes input */
+	thread_t *periodic_thread; /* Mode periodic service (see hydrabus_periodic.c) */
+	t_periodic_sched periodic;
+	struct t_script *script; /* Script being run (see script.c) */
+	t_perf_console perf;
 } t_hydra_console;
 
 enum console_modes {
@@ -119,6 +131,8 @@ int mode_exit(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_show(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_debug_timing(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_debug_test_rx(t_hydra_console *con, t_tokenline_parsed *p);
+int cmd_debug_test_tx(t_hydra_console *con, t_tokenline_parsed *p);
+int cmd_debug_test_loopback(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_adc(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_pwm(t_hydra_console *con, t_tokenline_parsed *p);
@@ -127,10 +141,31 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_sump(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_rng(t_hydra_console *con, t_tokenline_parsed *p);
 
+/*
+ * Memory range transfer by chunks of chunk_size bytes in buf, see
+ * range_read_to_file() and range_write_from_file().
+ */
+typedef struct {
+	/* Optional, called with the final size before the first chunk */
+	bool (*begin)(t_hydra_console *con, void *ctx, uint32_t start, uint32_t size);
+	/* Read or write nb bytes at addr, print the error and return FALSE on failure */
+	bool (*chunk)(t_hydra_console *con, void *ctx, uint32_t addr, uint8_t *buf, uint32_t nb);
+	void *ctx;
+	uint8_t *buf;
+	uint32_t chunk_size;
+} t_range_io;
+
+bool range_read_to_file(t_hydra_console *con, const t_range_io *io,
+			uint32_t start, uint32_t size, const char *filename);
+bool range_write_from_file(t_hydra_console *con, const t_range_io *io,
+			   uint32_t start, uint32_t *size, const char *filename);
+
 void token_dump(t_hydra_console *con, t_tokenline_parsed *p);
 void cprint(t_hydra_console *con, const char *data, const uint32_t size);
 void cprintf(t_hydra_console *con, const char *fmt, ...);
-void print_hex(t_hydra_console *con, uint8_t* data, uint8_t size);
+void print_hex(t_hydra_console *con, uint8_t* data, uint32_t size);
+void print_hex_addr(t_hydra_console *con, uint32_t addr, uint8_t* data, uint32_t size);
+void print_hex_bytes(t_hydra_console *con, const char *prefix, const uint8_t* data, uint32_t size);
 uint8_t parse_escaped_string(char * input, uint8_t * output);
 uint8_t hexchartonibble(char hex);
 uint8_t hex2byte(char * hex);
@@ -2,8 +2,13 @@
 COMMONSRC = common/common.c \
             common/exec.c \
             common/microsd.c \
+            common/file_fmt_pcapng.c \
+            common/hexdump.c \
+            common/periodic_sched.c \
+            common/perf.c \
             common/usb1cfg.c \
             common/usb2cfg.c \
+            common/usb_tx.c \
             common/script.c \
             common/alloc.c
 
@@ -62,6 +62,7 @@ int mode_exit(t_hydra_console *con, t_tokenline_parsed *p)
 	(void)p;
 
 	con->console_mode = MODE_TOP;
+	con->perf.mode = NULL;
 	tl_set_prompt(con->tl, PROMPT);
 	ret = tl_mode_pop(con->tl);
 
@@ -118,6 +119,12 @@ static int cmd_debug(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_DEBUG_TEST_RX:
 			cmd_debug_test_rx(con, p);
 			break;
+		case T_DEBUG_TEST_TX:
+			cmd_debug_test_tx(con, p);
+			break;
+		case T_DEBUG_TEST_LOOPBACK:
+			cmd_debug_test_loopback(con, p);
+			break;
 		case T_ON:
 		case T_OFF:
 			action = p->tokens[t];
@@ -0,0 +1,364 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h> /* snprintf */
+#include <string.h> /* memcpy */
+
+#include "file_fmt_pcapng.h"
+
+/*
+ * pcapng writer (https://github.com/pcapng/pcapng)
+ * Blocks are built in a RAM block buffer in native (little endian) byte
+ * order and written in file by pcapng_flush(), either explicitly by the
+ * caller or automatically when the buffer is full (auto_flush).
+ * File layout: Section Header Block, Interface Description Block(s), then
+ * one Enhanced Packet Block per packet.
+ */
+
+#define PCAPNG_BT_SHB (0x0A0D0D0A)
+#define PCAPNG_BT_IDB (0x00000001)
+#define PCAPNG_BT_EPB (0x00000006)
+#define PCAPNG_BYTE_ORDER_MAGIC (0x1A2B3C4D)
+
+#define PCAPNG_OPT_ENDOFOPT (0)
+#define PCAPNG_OPT_COMMENT (1)
+#define PCAPNG_OPT_SHB_USERAPPL (4)
+#define PCAPNG_OPT_IF_NAME (2)
+#define PCAPNG_OPT_IF_TSRESOL (9)
+#define PCAPNG_OPT_EPB_FLAGS (2)
+
+#define PCAPNG_BLOCK_HDR_SIZE (8) /* Block Type + Block Total Length */
+#define PCAPNG_BLOCK_TRAILER_SIZE (4) /* Block Total Length */
+#define PCAPNG_OPT_HDR_SIZE (4) /* Option Code + Option Length */
+#define PCAPNG_COMMENT_MAX (7 + 2 * PCAPNG_PARITY_MAX + 10)
+
+#define PCAPNG_USERAPPL "HydraFW"
+
+#define PAD32(x) (((x) + 3) & ~3)
+
+static void pcapng_put_u16(t_pcapng *pcap, uint16_t val)
+{
+	memcpy(&pcap->buf[pcap->buf_idx], &val, sizeof(uint16_t));
+	pcap->buf_idx += sizeof(uint16_t);
+}
+
+static void pcapng_put_u32(t_pcapng *pcap, uint32_t val)
+{
+	memcpy(&pcap->buf[pcap->buf_idx], &val, sizeof(uint32_t));
+	pcap->buf_idx += sizeof(uint32_t);
+}
+
+static void pcapng_put_bytes(t_pcapng *pcap, const uint8_t *data, uint32_t len)
+{
+	memcpy(&pcap->buf[pcap->buf_idx], data, len);
+	pcap->buf_idx += len;
+}
+
+/* Pad to 32bits a field of len bytes */
+static void pcapng_put_pad(t_pcapng *pcap, uint32_t len)
+{
+	for (; len & 3; len++)
+		pcap->buf[pcap->buf_idx++] = 0;
+}
+
+static void pcapng_put_option(t_pcapng *pcap, uint16_t code,
+			      const uint8_t *data, uint32_t len)
+{
+	pcapng_put_u16(pcap, code);
+	pcapng_put_u16(pcap, len);
+	pcapng_put_bytes(pcap, data, len);
+	pcapng_put_pad(pcap, len);
+}
+
+/* Build opt_comment text of parity and RSSI, return its length */
+static uint32_t pcapng_opts_comment(const t_pcapng_pkt_opts *opts, char *comment)
+{
+	static const char hex[] = "0123456789abcdef";
+	uint32_t i, n, len;
+	int rssi;
+
+	n = 0;
+	if (opts->parity != NULL) {
+		memcpy(comment, "parity=", 7);
+		n = 7;
+		len = MIN(opts->parity_len, PCAPNG_PARITY_MAX);
+		for (i = 0; i < len; i++) {
+			comment[n++] = hex[opts->parity[i] >> 4];
+			comment[n++] = hex[opts->parity[i] & 0x0f];
+		}
+	}
+	if (opts->rssi_valid) {
+		if (n > 0)
+			comment[n++] = ' ';
+		memcpy(&comment[n], "rssi=", 5);
+		n += 5;
+		rssi = opts->rssi;
+		if (rssi < 0) {
+			comment[n++] = '-';
+			rssi = -rssi;
+		}
+		if (rssi >= 100)
+			comment[n++] = '0' + rssi / 100;
+		if (rssi >= 10)
+			comment[n++] = '0' + (rssi / 10) % 10;
+		comment[n++] = '0' + rssi % 10;
+	}
+	return n;
+}
+
+/* Return TRUE if block_len bytes are available in block buffer */
+static bool pcapng_reserve(t_pcapng *pcap, uint32_t block_len)
+{
+	if (pcap->error)
+		return FALSE;
+
+	if ((pcap->buf_idx + block_len) > pcap->buf_size) {
+		if (!pcap->auto_flush || pcapng_flush(pcap) < 0)
+			return FALSE;
+	}
+
+	return (pcap->buf_idx + block_len) <= pcap->buf_size;
+}
+
+/*
+ * Write the Section Header Block in an already opened (empty) file.
+ * ts_freq is the frequency (Hz) of timestamps given to pcapng_write_packet()
+ */
+int pcapng_init(t_pcapng *pcap, FIL *file, uint8_t *buf, uint32_t buf_size,
+		uint32_t ts_freq)
+{
+	uint32_t block_len;
+
+	memset(pcap, 0, sizeof(t_pcapng));
+	pcap->file = file;
+	pcap->buf = buf;
+	pcap->buf_size = buf_size;
+	pcap->ts_freq = ts_freq;
+	pcap->auto_flush = TRUE;
+
+	block_len = PCAPNG_BLOCK_HDR_SIZE + 16 +
+		    PCAPNG_OPT_HDR_SIZE + PAD32(sizeof(PCAPNG_USERAPPL) - 1) +
+		    PCAPNG_OPT_HDR_SIZE + PCAPNG_BLOCK_TRAILER_SIZE;
+	if (!pcapng_reserve(pcap, block_len)) {
+		pcap->error = TRUE;
+		return -3;
+	}
+
+	pcapng_put_u32(pcap, PCAPNG_BT_SHB);
+	pcapng_put_u32(pcap, block_len);
+	pcapng_put_u32(pcap, PCAPNG_BYTE_ORDER_MAGIC);
+	pcapng_put_u16(pcap, 1); /* Major version */
+	pcapng_put_u16(pcap, 0); /* Minor version */
+	pcapng_put_u32(pcap, 0xFFFFFFFF); /* Section length not specified */
+	pcapng_put_u32(pcap, 0xFFFFFFFF);
+	pcapng_put_option(pcap, PCAPNG_OPT_SHB_USERAPPL,
+			  (const uint8_t *)PCAPNG_USERAPPL,
+			  sizeof(PCAPNG_USERAPPL) - 1);
+	pcapng_put_u32(pcap, PCAPNG_OPT_ENDOFOPT);
+	pcapng_put_u32(pcap, block_len);
+
+	return 0;
+}
+
+/*
+ * Create file "0:<prefix><N>.pcapng" and write the Section Header Block.
+ * ts_freq is the frequency (Hz) of timestamps given to pcapng_write_packet()
+ */
+int pcapng_create(t_pcapng *pcap, FIL *file, const char *prefix,
+		  uint8_t *buf, uint32_t buf_size, uint32_t ts_freq)
+{
+	filename_t filename;
+	uint32_t i;
+	FRESULT err;
+	int ret;
+
+	memset(pcap, 0, sizeof(t_pcapng));
+	if (!is_fs_ready()) {
+		if (mount() != 0)
+			return -1;
+	}
+
+	err = FR_EXIST;
+	for (i = 0; i < 999; i++) {
+		snprintf(filename.filename, FILENAME_SIZE,
+			 "0:%s%ld.pcapng", prefix, i);
+		err = f_open(file, filename.filename,
+			     FA_WRITE | FA_CREATE_NEW);
+		if (err == FR_OK)
+			break;
+	}
+	if (err != FR_OK) {
+		pcap->error = TRUE;
+		return -2;
+	}
+
+	ret = pcapng_init(pcap, file, buf, buf_size, ts_freq);
+	pcap->filename = filename;
+	if (ret < 0)
+		f_close(file);
+	return ret;
+}
+
+/* Write an Interface Description Block, return the interface id (or < 0 on error) */
+int pcapng_add_interface(t_pcapng *pcap, uint16_t linktype,
+			 uint32_t snaplen, const char *name)
+{
+	uint32_t block_len;
+	uint32_t name_len;
+	uint8_t tsresol = PCAPNG_TSRESOL_NS;
+
+	name_len = (name != NULL) ? strlen(name) : 0;
+	block_len = PCAPNG_BLOCK_HDR_SIZE + 8 +
+		    PCAPNG_OPT_HDR_SIZE + PAD32(sizeof(tsresol)) +
+		    PCAPNG_OPT_HDR_SIZE + PCAPNG_BLOCK_TRAILER_SIZE;
+	if (name_len > 0)
+		block_len += PCAPNG_OPT_HDR_SIZE + PAD32(name_len);
+
+	if (!pcapng_reserve(pcap, block_len))
+		return -1;
+
+	pcapng_put_u32(pcap, PCAPNG_BT_IDB);
+	pcapng_put_u32(pcap, block_len);
+	pcapng_put_u16(pcap, linktype);
+	pcapng_put_u16(pcap, 0); /* Reserved */
+	pcapng_put_u32(pcap, snaplen);
+	if (name_len > 0)
+		pcapng_put_option(pcap, PCAPNG_OPT_IF_NAME,
+				  (const uint8_t *)name, name_len);
+	pcapng_put_option(pcap, PCAPNG_OPT_IF_TSRESOL, &tsresol, sizeof(tsresol));
+	pcapng_put_u32(pcap, PCAPNG_OPT_ENDOFOPT);
+	pcapng_put_u32(pcap, block_len);
+
+	return pcap->nb_interfaces++;
+}
+
+/*
+ * Write an Enhanced Packet Block with hdr (link type pseudo header, can be
+ * NULL) followed by data.
+ * timestamp is in ts_freq units (64bits so it does not wrap).
+ * Return 0 if OK or < 0 if the packet is dropped.
+ */
+HOT_FUNC
+int pcapng_write_packet(t_pcapng *pcap, uint32_t interface_id,
+			uint64_t timestamp,
+			const uint8_t *hdr, uint32_t hdr_len,
+			const uint8_t *data, uint32_t len,
+			const t_pcapng_pkt_opts *opts)
+{
+	char comment[PCAPNG_COMMENT_MAX];
+	uint32_t comment_len;
+	uint32_t block_len;
+	uint32_t opts_len;
+	uint32_t flags;
+	uint64_t ts_ns;
+
+	opts_len = 0;
+	flags = 0;
+	comment_len = 0;
+	if (opts != NULL) {
+		flags = opts->direction | opts->flags_errors;
+		if (flags != 0)
+			opts_len += PCAPNG_OPT_HDR_SIZE + sizeof(uint32_t);
+		comment_len = pcapng_opts_comment(opts, comment);
+		if (comment_len > 0)
+			opts_len += PCAPNG_OPT_HDR_SIZE + PAD32(comment_len);
+		if (opts_len > 0)
+			opts_len += PCAPNG_OPT_HDR_SIZE;
+	}
+	block_len = PCAPNG_BLOCK_HDR_SIZE + 20 + PAD32(hdr_len + len) +
+		    opts_len + PCAPNG_BLOCK_TRAILER_SIZE;
+
+	if (!pcapng_reserve(pcap, block_len)) {
+		pcap->nb_dropped++;
+		return -1;
+	}
+
+	/* Split to avoid 64bits overflow of timestamp * 10^9 */
+	ts_ns = (timestamp / pcap->ts_freq) * 1000000000ULL +
+		((timestamp % pcap->ts_freq) * 1000000000ULL) / pcap->ts_freq;
+
+	pcapng_put_u32(pcap, PCAPNG_BT_EPB);
+	pcapng_put_u32(pcap, block_len);
+	pcapng_put_u32(pcap, interface_id);
+	pcapng_put_u32(pcap, (uint32_t)(ts_ns >> 32));
+	pcapng_put_u32(pcap, (uint32_t)ts_ns);
+	pcapng_put_u32(pcap, hdr_len + len); /* Captured length */
+	pcapng_put_u32(pcap, hdr_len + len); /* Original length */
+	if (hdr_len > 0)
+		pcapng_put_bytes(pcap, hdr, hdr_len);
+	pcapng_put_bytes(pcap, data, len);
+	pcapng_put_pad(pcap, hdr_len + len);
+
+	if (opts_len > 0) {
+		if (flags != 0)
+			pcapng_put_option(pcap, PCAPNG_OPT_EPB_FLAGS,
+					  (const uint8_t *)&flags, sizeof(uint32_t));
+		if (comment_len > 0)
+			pcapng_put_option(pcap, PCAPNG_OPT_COMMENT,
+					  (const uint8_t *)comment, comment_len);
+		pcapng_put_u32(pcap, PCAPNG_OPT_ENDOFOPT);
+	}
+	pcapng_put_u32(pcap, block_len);
+
+	pcap->nb_packets++;
+	return 0;
+}
+
+/* Write block buffer in file, shall be called with kernel unlocked */
+int pcapng_flush(t_pcapng *pcap)
+{
+	FRESULT err;
+	UINT bytes_written;
+
+	if (pcap->error)
+		return -1;
+
+	if (pcap->buf_idx == 0)
+		return 0;
+
+	err = f_write(pcap->file, pcap->buf, pcap->buf_idx, &bytes_written);
+	if ((err != FR_OK) || (bytes_written != pcap->buf_idx)) {
+		pcap->error = TRUE;
+		return -1;
+	}
+	pcap->nb_bytes += bytes_written;
+	pcap->buf_idx = 0;
+
+	/* Keep the file readable if capture is not closed properly */
+	if (f_sync(pcap->file) != FR_OK) {
+		pcap->error = TRUE;
+		return -1;
+	}
+
+	return 0;
+}
+
+int pcapng_close(t_pcapng *pcap)
+{
+	int ret;
+
+	ret = pcapng_flush(pcap);
+	if (pcap->file == NULL)
+		return -1;
+
+	if (f_close(pcap->file) != FR_OK)
+		ret = -1;
+
+	pcap->file = NULL;
+	return ret;
+}
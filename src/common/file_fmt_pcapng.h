@@ -0,0 +1,101 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FILE_FMT_PCAPNG_H_
+#define _FILE_FMT_PCAPNG_H_
+
+#include "ch.h"
+#include "ff.h"
+#include "microsd.h"
+
+/* Link types (see http://www.tcpdump.org/linktypes.html) */
+#define PCAPNG_LINKTYPE_USER0 (147) /* Raw bytes (SPI, UART...) */
+#define PCAPNG_LINKTYPE_I2C_LINUX (209) /* 4 bytes pseudo header + I2C message */
+#define PCAPNG_LINKTYPE_CAN_SOCKETCAN (227) /* SocketCAN frame */
+#define PCAPNG_LINKTYPE_ISO_14443 (264) /* 4 bytes pseudo header + ISO14443 frame */
+
+/* ISO_14443 link type pseudo header */
+#define PCAPNG_ISO14443_HDR_SIZE (4)
+#define PCAPNG_ISO14443_EVT_PICC_TO_PCD (0xFF)
+#define PCAPNG_ISO14443_EVT_PCD_TO_PICC (0xFE)
+
+/* Packet direction (epb_flags) */
+#define PCAPNG_DIR_UNKNOWN (0)
+#define PCAPNG_DIR_INBOUND (1)
+#define PCAPNG_DIR_OUTBOUND (2)
+
+/* Link-layer dependent errors (epb_flags) */
+#define PCAPNG_FLAG_ERR_CRC (0x01000000)
+#define PCAPNG_FLAG_ERR_TOO_SHORT (0x04000000)
+#define PCAPNG_FLAG_ERR_SYMBOL (0x80000000)
+
+/*
+ * There is no registered Private Enterprise Number for custom options, so
+ * parity and RSSI are written in the standard opt_comment option as text:
+ * "parity=<hex bytes> rssi=<value>"
+ * Parity bytes are packed, bit (i & 7) of byte (i / 8) for data byte i.
+ */
+#define PCAPNG_PARITY_MAX (32) /* Parity bytes written (256 data bytes) */
+
+#define PCAPNG_TSRESOL_NS (9) /* Timestamps written in ns */
+
+typedef struct {
+	uint8_t direction; /* PCAPNG_DIR_xxx */
+	uint32_t flags_errors; /* PCAPNG_FLAG_ERR_xxx */
+	const uint8_t *parity; /* NULL if not available */
+	uint32_t parity_len; /* Size of parity in bytes */
+	bool rssi_valid;
+	int8_t rssi;
+} t_pcapng_pkt_opts;
+
+typedef struct {
+	FIL *file;
+	filename_t filename;
+	uint8_t *buf; /* Block buffer */
+	uint32_t buf_size;
+	uint32_t buf_idx;
+	uint32_t ts_freq; /* Timestamp clock frequency in Hz */
+	uint32_t nb_interfaces;
+	uint32_t nb_packets;
+	uint32_t nb_dropped; /* Packets not written (buffer full or write error) */
+	uint32_t nb_bytes; /* Bytes written in file */
+	bool auto_flush; /* Flush buffer in file when full (not usable with kernel locked) */
+	bool error;
+} t_pcapng;
+
+int pcapng_init(t_pcapng *pcap, FIL *file, uint8_t *buf, uint32_t buf_size,
+		uint32_t ts_freq);
+int pcapng_create(t_pcapng *pcap, FIL *file, const char *prefix,
+		  uint8_t *buf, uint32_t buf_size, uint32_t ts_freq);
+int pcapng_add_interface(t_pcapng *pcap, uint16_t linktype,
+			 uint32_t snaplen, const char *name);
+int pcapng_write_packet(t_pcapng *pcap, uint32_t interface_id,
+			uint64_t timestamp,
+			const uint8_t *hdr, uint32_t hdr_len,
+			const uint8_t *data, uint32_t len,
+			const t_pcapng_pkt_opts *opts);
+int pcapng_flush(t_pcapng *pcap);
+int pcapng_close(t_pcapng *pcap);
+
+/* Return the number of bytes waiting in block buffer */
+static inline uint32_t pcapng_buffer_level(t_pcapng *pcap)
+{
+	return pcap->buf_idx;
+}
+
+#endif /* _FILE_FMT_PCAPNG_H_ */
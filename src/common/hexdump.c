@@ -0,0 +1,82 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hexdump.h"
+
+const char hexdump_digits_upper[16] = "0123456789ABCDEF";
+const char hexdump_digits_lower[16] = "0123456789abcdef";
+
+/* Printable characters (0x20 to 0x7F) are kept, others are replaced by '.' */
+#define HEXDUMP_ASCII(c) ((((c) >= 0x20) && ((c) <= 0x7F)) ? (char)(c) : '.')
+
+/*
+ * Format one hexdump line of size bytes (1 to HEXDUMP_LINE_BYTES), the hex
+ * part is padded so the ASCII part is aligned for the last (short) line.
+ * out shall be at least HEXDUMP_LINE_MAX bytes, it is not NUL terminated.
+ * Return the number of chars written.
+ */
+uint32_t hexdump_line(char *out, const uint8_t *data, uint32_t size)
+{
+	char *p;
+	uint32_t i;
+
+	if (size > HEXDUMP_LINE_BYTES)
+		size = HEXDUMP_LINE_BYTES;
+
+	p = out;
+	for (i = 0; i < size; i++) {
+		p = hexdump_u8(p, data[i], hexdump_digits_upper);
+		*p++ = ' ';
+		if (i == 7)
+			*p++ = ' ';
+	}
+	memset(p, ' ', &out[HEXDUMP_LINE_HEX_SIZE] - p);
+	p = &out[HEXDUMP_LINE_HEX_SIZE];
+
+	*p++ = '|';
+	*p++ = ' ';
+	*p++ = ' ';
+	for (i = 0; i < size; i++)
+		*p++ = HEXDUMP_ASCII(data[i]);
+	*p++ = ' ';
+	*p++ = '\r';
+	*p++ = '\n';
+
+	return p - out;
+}
+
+/*
+ * Format " XX" for each byte, out shall be at least (size * 3) + 1 bytes.
+ * Return the number of chars written (without final NUL).
+ */
+uint32_t hexdump_bytes(char *out, const uint8_t *data, uint32_t size)
+{
+	char *p;
+	uint32_t i;
+
+	p = out;
+	for (i = 0; i < size; i++) {
+		*p++ = ' ';
+		p = hexdump_u8(p, data[i], hexdump_digits_upper);
+	}
+	*p = 0;
+
+	return p - out;
+}
@@ -0,0 +1,48 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HEXDUMP_H_
+#define _HEXDUMP_H_
+
+#include <stdint.h>
+
+/*
+ * Console hex formatters, they only write in a char buffer (no ChibiOS
+ * dependency) so whole lines are sent with one cprint().
+ */
+
+#define HEXDUMP_LINE_BYTES (16)
+/* "XX XX XX XX XX XX XX XX  XX XX XX XX XX XX XX XX  |  0123456789ABCDEF \r\n" */
+#define HEXDUMP_LINE_HEX_SIZE (HEXDUMP_LINE_BYTES * 3 + 2)
+#define HEXDUMP_LINE_MAX (HEXDUMP_LINE_HEX_SIZE + 3 + HEXDUMP_LINE_BYTES + 3)
+
+extern const char hexdump_digits_upper[16];
+extern const char hexdump_digits_lower[16];
+
+/* Write 2 hex digits, return pointer after them */
+static inline char *hexdump_u8(char *out, uint8_t val, const char *digits)
+{
+	out[0] = digits[val >> 4];
+	out[1] = digits[val & 0x0F];
+	return out + 2;
+}
+
+uint32_t hexdump_line(char *out, const uint8_t *data, uint32_t size);
+uint32_t hexdump_bytes(char *out, const uint8_t *data, uint32_t size);
+
+#endif /* _HEXDUMP_H_ */
@@ -0,0 +1,38 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HOT_PATH_H_
+#define _HOT_PATH_H_
+
+/*
+ * Hot paths (capture, bit-bang, sniffer and protocol loops).
+ * With HYDRAFW_PERF=1 (see Makefile) HOT_FUNC functions are built with -O3
+ * and run from SRAM (.ramtext, no flash wait states) and HOT_DATA buffers
+ * are in CCM RAM (.ram4, not initialized at boot).
+ * CCM RAM is not reachable by DMA, do not use HOT_DATA for SD, USB or
+ * peripheral DMA buffers.
+ */
+#ifdef HYDRAFW_PERF
+#define HOT_FUNC __attribute__ ((optimize("-O3"), section(".ramtext")))
+#define HOT_DATA __attribute__ ((section(".ram4")))
+#else
+#define HOT_FUNC
+#define HOT_DATA
+#endif
+
+#endif /* _HOT_PATH_H_ */
@@ -29,6 +29,7 @@
 
 #include "microsd.h"
 #include "common.h"
+#include "bsp.h"
 
 #include "script.h"
 
@@ -321,6 +322,11 @@ void fillbuffer(uint8_t pattern, uint8_t *b)
 		b[i] = pattern;
 }
 
+#define PERFRUN_SECONDS 1
+#define SD_PERF_BUF_SIZE	(16384)
+#define SD_PERF_FILE_SIZE	(1024 * 1024)
+#define SD_PERF_FILENAME	"0:sdperf.tmp"
+
 #define PRINT_PERF_VAL_DIGITS	(100)
 static void print_mbs(t_hydra_console *con, uint32_t val_perf_kibs)
 {
@@ -368,7 +374,6 @@ static int sd_perf_run(t_hydra_console *con, int seconds, int sectors, int offse
 	return TRUE;
 }
 
-#define PERFRUN_SECONDS 1
 int sd_perf(t_hydra_console *con, int offset)
 {
 	uint32_t nb_sectors;
@@ -392,6 +397,289 @@ int sd_perf(t_hydra_console *con, int offset)
 	return ret;
 }
 
+/*
+ * Latency histogram in us, SD_PERF_HIST_SUB linear sub-buckets per power of 2
+ * (resolution better than 25%), max/min/average are exact.
+ */
+#define SD_PERF_HIST_SUB_SHIFT	(2)
+#define SD_PERF_HIST_SUB	(1 << SD_PERF_HIST_SUB_SHIFT)
+#define SD_PERF_HIST_OCTAVES	(22) /* Up to 2^23us (8s) */
+#define SD_PERF_HIST_SIZE	(SD_PERF_HIST_OCTAVES * SD_PERF_HIST_SUB)
+#define SD_PERF_CYCLES_PER_US	(STM32_HCLK / 1000000)
+
+typedef struct {
+	uint32_t nb;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint64_t total_bytes;
+	uint32_t bucket[SD_PERF_HIST_SIZE];
+} sd_perf_hist_t;
+
+static sd_perf_hist_t sd_perf_hist;
+
+static void sd_perf_hist_init(sd_perf_hist_t *hist)
+{
+	memset(hist, 0, sizeof(sd_perf_hist_t));
+	hist->min_cycles = 0xFFFFFFFF;
+}
+
+static uint32_t sd_perf_hist_index(uint32_t us)
+{
+	uint32_t octave;
+	uint32_t idx;
+
+	if (us < SD_PERF_HIST_SUB)
+		return us;
+
+	octave = 31 - __builtin_clz(us);
+	idx = ((octave - SD_PERF_HIST_SUB_SHIFT + 1) << SD_PERF_HIST_SUB_SHIFT) +
+	      ((us >> (octave - SD_PERF_HIST_SUB_SHIFT)) & (SD_PERF_HIST_SUB - 1));
+	if (idx >= SD_PERF_HIST_SIZE)
+		idx = SD_PERF_HIST_SIZE - 1;
+
+	return idx;
+}
+
+/* Return the highest latency in us of bucket idx */
+static uint32_t sd_perf_hist_upper(uint32_t idx)
+{
+	uint32_t octave;
+	uint32_t sub;
+
+	if (idx < SD_PERF_HIST_SUB)
+		return idx;
+
+	octave = (idx >> SD_PERF_HIST_SUB_SHIFT) + SD_PERF_HIST_SUB_SHIFT - 1;
+	sub = idx & (SD_PERF_HIST_SUB - 1);
+
+	return ((SD_PERF_HIST_SUB + sub + 1) << (octave - SD_PERF_HIST_SUB_SHIFT)) - 1;
+}
+
+static void sd_perf_hist_add(sd_perf_hist_t *hist, uint32_t cycles, uint32_t bytes)
+{
+	hist->nb++;
+	hist->total_cycles += cycles;
+	hist->total_bytes += bytes;
+	if (cycles < hist->min_cycles)
+		hist->min_cycles = cycles;
+	if (cycles > hist->max_cycles)
+		hist->max_cycles = cycles;
+	hist->bucket[sd_perf_hist_index(cycles / SD_PERF_CYCLES_PER_US)]++;
+}
+
+/* Throughput computed on operations time only */
+static void sd_perf_hist_print(t_hydra_console *con, sd_perf_hist_t *hist)
+{
+	uint32_t i, sum, p99_nb, p99_us, max_us, octave_nb;
+
+	if (hist->nb == 0) {
+		cprintf(con, "no operation\r\n");
+		return;
+	}
+
+	max_us = hist->max_cycles / SD_PERF_CYCLES_PER_US;
+	p99_nb = hist->nb - (hist->nb / 100);
+	sum = 0;
+	p99_us = max_us;
+	for (i = 0; i < SD_PERF_HIST_SIZE; i++) {
+		sum += hist->bucket[i];
+		if (sum >= p99_nb) {
+			p99_us = sd_perf_hist_upper(i);
+			break;
+		}
+	}
+	if (p99_us > max_us)
+		p99_us = max_us;
+
+	print_mbs(con, (uint32_t)((hist->total_bytes * STM32_HCLK) / hist->total_cycles));
+	cprintf(con, " MB/s, %d ops, latency min %dus avg %dus p99 %dus max %dus\r\n",
+		hist->nb, hist->min_cycles / SD_PERF_CYCLES_PER_US,
+		(uint32_t)(hist->total_cycles / hist->nb / SD_PERF_CYCLES_PER_US),
+		p99_us, max_us);
+
+	/* One line per power of 2 */
+	for (i = 0; i < SD_PERF_HIST_SIZE; i += SD_PERF_HIST_SUB) {
+		octave_nb = hist->bucket[i] + hist->bucket[i + 1] +
+			    hist->bucket[i + 2] + hist->bucket[i + 3];
+		if (octave_nb == 0)
+			continue;
+		cprintf(con, "  %7dus-%7dus: %d\r\n",
+			(i == 0) ? 0 : sd_perf_hist_upper(i - 1) + 1,
+			sd_perf_hist_upper(i + SD_PERF_HIST_SUB - 1), octave_nb);
+	}
+}
+
+/*
+ * Raw write: each area is read then written back with the same data so the
+ * card content is kept, only blkWrite() is timed.
+ */
+static int sd_perf_write_run(t_hydra_console *con, uint8_t *buf, int seconds,
+			     uint32_t sectors, bool random)
+{
+	uint32_t nb_blocks, blk, rnd, start_cycles;
+	systime_t start, end;
+
+	nb_blocks = SDCD1.capacity; /* In blocks */
+	/* Sequential test is performed in the middle of the flash area */
+	blk = nb_blocks / 2;
+	rnd = 0x12345678;
+
+	sd_perf_hist_init(&sd_perf_hist);
+	start = chVTGetSystemTime();
+	end = start + TIME_MS2I(seconds * 1000);
+	do {
+		if (random) {
+			/* xorshift32 */
+			rnd ^= rnd << 13;
+			rnd ^= rnd >> 17;
+			rnd ^= rnd << 5;
+			blk = (rnd % (nb_blocks / sectors)) * sectors;
+		} else if ((blk + sectors) > nb_blocks) {
+			blk = nb_blocks / 2;
+		}
+
+		if (blkRead(&SDCD1, blk, buf, sectors)) {
+			cprintf(con, "SD read failed.\r\n");
+			return FALSE;
+		}
+		start_cycles = bsp_get_cyclecounter();
+		if (blkWrite(&SDCD1, blk, buf, sectors)) {
+			cprintf(con, "SD write failed.\r\n");
+			return FALSE;
+		}
+		sd_perf_hist_add(&sd_perf_hist, bsp_get_cyclecounter() - start_cycles,
+				 sectors * MMCSD_BLOCK_SIZE);
+		blk += sectors;
+
+		if (hydrabus_ubtn())
+			return FALSE;
+	} while (chVTIsSystemTimeWithin(start, end));
+
+	sd_perf_hist_print(con, &sd_perf_hist);
+	return TRUE;
+}
+
+/* Sequential and random raw writes */
+int sd_perf_write(t_hydra_console *con)
+{
+	static const uint32_t sectors[] = { 1, 8, SD_PERF_BUF_SIZE / MMCSD_BLOCK_SIZE };
+	uint8_t *buf;
+	uint32_t i;
+	int ret;
+
+	buf = pool_alloc_bytes(SD_PERF_BUF_SIZE);
+	if (buf == 0)
+		return FALSE;
+
+	ret = TRUE;
+	for (i = 0; (i < 2 * ARRAY_SIZE(sectors)) && ret; i++) {
+		cprintf(con, "%s writes %5d bytes: ",
+			(i < ARRAY_SIZE(sectors)) ? "Sequential" : "Random    ",
+			sectors[i % ARRAY_SIZE(sectors)] * MMCSD_BLOCK_SIZE);
+		ret = sd_perf_write_run(con, buf, PERFRUN_SECONDS,
+					sectors[i % ARRAY_SIZE(sectors)],
+					i >= ARRAY_SIZE(sectors));
+	}
+
+	pool_free(buf);
+	return ret;
+}
+
+/*
+ * Write SD_PERF_FILE_SIZE bytes with f_write() of chunk bytes in a new file,
+ * if prealloc is TRUE the file is first expanded to its final size (clusters
+ * allocation is not timed) so f_write() does not update the FAT.
+ */
+static int sd_perf_file_run(t_hydra_console *con, FIL *fil, uint8_t *buf,
+			    uint32_t chunk, bool prealloc)
+{
+	uint32_t written, start_cycles, nb_bytes;
+	FRESULT err;
+
+	err = f_open(fil, SD_PERF_FILENAME, FA_WRITE | FA_CREATE_ALWAYS);
+	if (err != FR_OK) {
+		cprintf(con, "Failed to create file: error %d.\r\n", err);
+		return FALSE;
+	}
+
+	if (prealloc) {
+		err = f_lseek(fil, SD_PERF_FILE_SIZE);
+		if ((err != FR_OK) || (f_tell(fil) != SD_PERF_FILE_SIZE)) {
+			cprintf(con, "Failed to allocate file: error %d.\r\n", err);
+			f_close(fil);
+			return FALSE;
+		}
+		err = f_lseek(fil, 0);
+	}
+
+	sd_perf_hist_init(&sd_perf_hist);
+	for (nb_bytes = 0; (nb_bytes < SD_PERF_FILE_SIZE) && (err == FR_OK); nb_bytes += chunk) {
+		start_cycles = bsp_get_cyclecounter();
+		err = f_write(fil, buf, chunk, (void *)&written);
+		sd_perf_hist_add(&sd_perf_hist, bsp_get_cyclecounter() - start_cycles, chunk);
+		if ((err == FR_OK) && (written != chunk))
+			err = FR_DENIED; /* Disk full */
+
+		if (hydrabus_ubtn())
+			break;
+	}
+
+	if (err != FR_OK) {
+		cprintf(con, "Write failed: error %d.\r\n", err);
+		f_close(fil);
+		return FALSE;
+	}
+
+	start_cycles = bsp_get_cyclecounter();
+	err = f_close(fil);
+	if (err != FR_OK) {
+		cprintf(con, "Close failed: error %d.\r\n", err);
+		return FALSE;
+	}
+
+	sd_perf_hist_print(con, &sd_perf_hist);
+	cprintf(con, "  f_close: %dus\r\n",
+		(bsp_get_cyclecounter() - start_cycles) / SD_PERF_CYCLES_PER_US);
+
+	return (nb_bytes >= SD_PERF_FILE_SIZE);
+}
+
+/* FatFs f_write() with different chunk sizes, growing and pre-allocated file */
+int sd_perf_file(t_hydra_console *con)
+{
+	static const uint32_t chunks[] = { 512, 4096, SD_PERF_BUF_SIZE };
+	/* FIL is too big for thread stack */
+	static FIL fil;
+	uint8_t *buf;
+	uint32_t i;
+	int ret;
+
+	if (!fs_ready && (mount() != 0)) {
+		cprintf(con, "Mount failed.\r\n");
+		return FALSE;
+	}
+
+	buf = pool_alloc_bytes(SD_PERF_BUF_SIZE);
+	if (buf == 0)
+		return FALSE;
+	for (i = 0; i < SD_PERF_BUF_SIZE; i++)
+		buf[i] = i;
+
+	cprintf(con, "f_write %dKiB file:\r\n", SD_PERF_FILE_SIZE / 1024);
+	ret = TRUE;
+	for (i = 0; (i < 2 * ARRAY_SIZE(chunks)) && ret; i++) {
+		cprintf(con, "%5d bytes chunks %s: ", chunks[i % ARRAY_SIZE(chunks)],
+			(i < ARRAY_SIZE(chunks)) ? "growing     " : "preallocated");
+		ret = sd_perf_file_run(con, &fil, buf, chunks[i % ARRAY_SIZE(chunks)],
+				       i >= ARRAY_SIZE(chunks));
+	}
+	f_unlink(SD_PERF_FILENAME);
+
+	pool_free(buf);
+	return ret;
+}
+
 /* Return 0 if OK else < 0 error code */
 /* return 0 if success else <0 for error */
 int mount(void)
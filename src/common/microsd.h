@@ -33,6 +33,8 @@ typedef struct {
 bool is_fs_ready(void);
 bool is_file_present(char * filename);
 int sd_perf(t_hydra_console *con, int offset);
+int sd_perf_write(t_hydra_console *con);
+int sd_perf_file(t_hydra_console *con);
 void fillbuffer(uint8_t pattern, uint8_t *b);
 bool badblocks(uint32_t start, uint32_t end, uint32_t blockatonce, uint8_t pattern);
 
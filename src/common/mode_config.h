@@ -88,6 +88,7 @@ typedef struct {
 	uint32_t dev_speed;
 	uint8_t ack_pending : 1;
 	uint8_t dev_mode;
+	uint8_t dev_backend;
 } i2c_config_t;
 
 typedef struct {
@@ -125,12 +126,21 @@ typedef struct {
 	mode_dev_gpio_pull_t dev_gpio_pull;
 	uint8_t dev_bit_lsb_msb;
 	uint8_t dev_numbits;
+	/* NAND geometry, page_size is 0 if unknown */
+	uint32_t page_size;
+	uint32_t oob_size;
+	uint32_t pages_per_block;
+	uint32_t nb_blocks;
+	uint8_t col_cycles;
+	uint8_t row_cycles;
 } flash_config_t;
 
 typedef struct {
 	mode_dev_gpio_mode_t dev_gpio_mode;
 	mode_dev_gpio_pull_t dev_gpio_pull;
 	uint8_t dev_bit_lsb_msb;
+	uint8_t dev_backend;
+	uint8_t dev_speed;
 } onewire_config_t;
 
 typedef struct {
@@ -201,10 +211,24 @@ typedef struct {
 	uint32_t cmd; /* command defined in hydrabus_mode_cmd() */
 } mode_config_command_t;
 
+/*
+ * Macros compiled by hydrabus_macro.c, 2KB per console in CCM (.ram4) with
+ * the rest of t_mode_config, cleared by the console thread at startup.
+ */
+#define MODE_CONFIG_MACRO_NB (8) /* Macro 1 to 8 */
+#define MODE_CONFIG_MACRO_SIZE (252) /* Max bytecode size of a macro */
+
+typedef struct {
+	uint16_t mode; /* console_mode (mode token) of the macro, 0 if not defined */
+	uint16_t size; /* Bytecode size */
+	uint8_t code[MODE_CONFIG_MACRO_SIZE];
+} mode_config_macro_t;
+
 typedef struct t_mode_config {
 	mode_config_proto_t proto;
 	const struct mode_exec_t *exec;
 	mode_config_command_t cmd;
+	mode_config_macro_t macro[MODE_CONFIG_MACRO_NB];
 } t_mode_config;
 
 #endif /* _MODE_CONFIG_H_ */
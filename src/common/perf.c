@@ -0,0 +1,142 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "bsp.h"
+#include "perf.h"
+
+static t_perf_mode_slot perf_modes[PERF_MODES_NB];
+
+static uint64_t perf_clear_stamp;
+static uint64_t perf_switch_stamp;
+
+static uint32_t perf_irq_nest;
+static uint32_t perf_irq_stamp;
+static t_perf_isr perf_isr;
+
+/*
+ * Return counters of mode token, a slot is allocated on first use.
+ * All modes share the last slot when the table is full.
+ */
+t_perf_mode *perf_mode_get(int token)
+{
+	int i;
+
+	chSysLock();
+	for (i = 0; i < PERF_MODES_NB - 1; i++) {
+		if (perf_modes[i].token == token)
+			break;
+		if (perf_modes[i].token == 0)
+			break;
+	}
+	if (perf_modes[i].token == 0)
+		perf_modes[i].token = token;
+	chSysUnlock();
+
+	return &perf_modes[i].cnt;
+}
+
+/* Return slot at index if it is used, NULL otherwise */
+const t_perf_mode_slot *perf_mode_slot(int index)
+{
+	if (index < 0 || index >= PERF_MODES_NB)
+		return NULL;
+	if (perf_modes[index].token == 0)
+		return NULL;
+	return &perf_modes[index];
+}
+
+void perf_isr_get(t_perf_isr *isr)
+{
+	chSysLock();
+	*isr = perf_isr;
+	chSysUnlock();
+}
+
+/* Cycles since boot or last perf_clear() */
+uint64_t perf_elapsed_cycles(void)
+{
+	return bsp_get_cyclecounter64() - perf_clear_stamp;
+}
+
+/* Clear global counters and counters of this console */
+void perf_clear(t_hydra_console *con)
+{
+	thread_t *tp;
+	int i;
+
+	for (i = 0; i < PERF_MODES_NB; i++)
+		memset(&perf_modes[i].cnt, 0, sizeof(t_perf_mode));
+
+	tp = chRegFirstThread();
+	do {
+		chSysLock();
+		tp->perf_cycles = 0;
+		chSysUnlock();
+		tp = chRegNextThread(tp);
+	} while (tp != NULL);
+
+	chSysLock();
+	memset(&perf_isr, 0, sizeof(perf_isr));
+	chSysUnlock();
+
+	con->perf.usb_tx_bytes = 0;
+	con->perf.usb_tx_hwm = 0;
+	pool_stats_clear_max();
+
+	perf_clear_stamp = bsp_get_cyclecounter64();
+}
+
+/*
+ * Called by CH_CFG_CONTEXT_SWITCH_HOOK() with kernel locked, the 64-bit cycle
+ * counter is refreshed at each switch.
+ */
+void perf_context_switch(thread_t *otp)
+{
+	uint64_t now;
+
+	now = bsp_get_cyclecounter64I();
+	otp->perf_cycles += now - perf_switch_stamp;
+	perf_switch_stamp = now;
+}
+
+/*
+ * Called by CH_CFG_IRQ_PROLOGUE_HOOK()/CH_CFG_IRQ_EPILOGUE_HOOK(), only the
+ * outermost ISR is timed so nested ISRs are included in its duration.
+ */
+void perf_irq_enter(void)
+{
+	if (perf_irq_nest++ == 0)
+		perf_irq_stamp = bsp_get_cyclecounter();
+}
+
+void perf_irq_exit(void)
+{
+	uint32_t cycles;
+
+	if (--perf_irq_nest != 0)
+		return;
+
+	cycles = bsp_get_cyclecounter() - perf_irq_stamp;
+	perf_isr.count++;
+	perf_isr.cycles += cycles;
+	if (cycles > perf_isr.cycles_max)
+		perf_isr.cycles_max = cycles;
+}
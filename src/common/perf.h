@@ -0,0 +1,71 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdint.h>
+
+/*
+ * Runtime performance counters (see "show perf" and BBIO_PERF).
+ * Durations are in DWT cycles (STM32_HCLK), they are always enabled and only
+ * cost a few cycles per update.
+ * Thread CPU time is accumulated at each context switch (see common/chconf.h),
+ * ISR time is included in the time of the interrupted thread.
+ */
+
+#define PERF_MODES_NB (16)
+
+struct hydra_console;
+
+typedef struct {
+	uint32_t bytes_in; /* Bytes read from the bus */
+	uint32_t bytes_out; /* Bytes written to the bus */
+	uint32_t commands; /* Command lines executed in mode */
+	uint32_t errors; /* Read/write errors returned by mode */
+	uint32_t overruns; /* Periodic service calls longer than budget */
+} t_perf_mode;
+
+typedef struct {
+	int token; /* Mode token, 0 if slot is free */
+	t_perf_mode cnt;
+} t_perf_mode_slot;
+
+/* Per console counters (in t_hydra_console) */
+typedef struct {
+	t_perf_mode *mode; /* Counters of current mode, NULL outside modes */
+	uint32_t usb_tx_bytes; /* Bytes sent to USB output queue */
+	uint32_t usb_tx_hwm; /* Max USB output buffers filled */
+} t_perf_console;
+
+typedef struct {
+	uint32_t count; /* Outermost ISRs */
+	uint32_t cycles_max; /* Longest outermost ISR (including nested ones) */
+	uint64_t cycles; /* Total time spent in ISRs */
+} t_perf_isr;
+
+#define PERF_MODE_ADD(con, field, n) \
+	do { if ((con)->perf.mode) (con)->perf.mode->field += (n); } while (0)
+
+t_perf_mode *perf_mode_get(int token);
+const t_perf_mode_slot *perf_mode_slot(int index);
+void perf_isr_get(t_perf_isr *isr);
+uint64_t perf_elapsed_cycles(void);
+void perf_clear(struct hydra_console *con);
+
+#endif /* _PERF_H_ */
@@ -0,0 +1,75 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "periodic_sched.h"
+
+/* First call is due now */
+void periodic_sched_init(t_periodic_sched *s, uint32_t period_us,
+			 uint32_t budget_us, uint32_t now_us)
+{
+	s->period_us = period_us;
+	s->budget_us = budget_us;
+	s->deadline_us = now_us;
+	s->nb_calls = 0;
+	s->nb_overruns = 0;
+	s->nb_missed = 0;
+	s->max_us = 0;
+	s->total_us = 0;
+}
+
+/* Return time to wait before next call (0 if it is due) */
+uint32_t periodic_sched_delay(const t_periodic_sched *s, uint32_t now_us)
+{
+	int32_t diff;
+
+	diff = (int32_t)(s->deadline_us - now_us);
+	return (diff > 0) ? (uint32_t)diff : 0;
+}
+
+/*
+ * Account a call and set next deadline.
+ * If the call ended one or more periods after next deadline, these periods
+ * are skipped (counted in nb_missed) so calls do not burst to catch up.
+ */
+void periodic_sched_done(t_periodic_sched *s, uint32_t start_us, uint32_t end_us)
+{
+	uint32_t duration, late, nb_missed;
+
+	duration = end_us - start_us;
+	s->nb_calls++;
+	s->total_us += duration;
+	if (duration > s->max_us)
+		s->max_us = duration;
+	if (duration > s->budget_us)
+		s->nb_overruns++;
+
+	s->deadline_us += s->period_us;
+	if ((int32_t)(end_us - s->deadline_us) >= (int32_t)s->period_us) {
+		late = end_us - s->deadline_us;
+		nb_missed = late / s->period_us;
+		s->deadline_us += nb_missed * s->period_us;
+		s->nb_missed += nb_missed;
+	}
+}
+
+uint32_t periodic_sched_avg_us(const t_periodic_sched *s)
+{
+	if (s->nb_calls == 0)
+		return 0;
+	return (uint32_t)(s->total_us / s->nb_calls);
+}
@@ -0,0 +1,48 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PERIODIC_SCHED_H_
+#define _PERIODIC_SCHED_H_
+
+#include <stdint.h>
+
+/*
+ * Deadline and budget accounting of a periodic service.
+ * Times are in us on a free running uint32_t counter (wrap is handled).
+ * It does not depend on ChibiOS or on the hardware so it can be built on
+ * a host.
+ */
+
+typedef struct {
+	uint32_t period_us;
+	uint32_t budget_us; /* Max duration of a call */
+	uint32_t deadline_us; /* Start time of next call */
+	uint32_t nb_calls;
+	uint32_t nb_overruns; /* Calls longer than budget_us */
+	uint32_t nb_missed; /* Periods skipped because a call ended too late */
+	uint32_t max_us; /* Longest call */
+	uint64_t total_us; /* Sum of calls duration */
+} t_periodic_sched;
+
+void periodic_sched_init(t_periodic_sched *s, uint32_t period_us,
+			 uint32_t budget_us, uint32_t now_us);
+uint32_t periodic_sched_delay(const t_periodic_sched *s, uint32_t now_us);
+void periodic_sched_done(t_periodic_sched *s, uint32_t start_us, uint32_t end_us);
+uint32_t periodic_sched_avg_us(const t_periodic_sched *s);
+
+#endif /* _PERIODIC_SCHED_H_ */
@@ -16,38 +16,897 @@
  * limitations under the License.
  */
 
+#include <stdio.h> /* snprintf */
+#include <stdlib.h>
+#include <string.h>
+
 #include "ff.h"
 #include "microsd.h"
+#include "common.h"
+#include "tokenline.h"
+#include "alloc.h"
+#include "script.h"
 
-int execute_script(t_hydra_console *con, char *filename)
+#define SCRIPT_STMT_CMD (1)
+#define SCRIPT_STMT_SET (2)
+#define SCRIPT_STMT_ADD (3)
+#define SCRIPT_STMT_LOOP (4)
+#define SCRIPT_STMT_END (5)
+
+/* Command statement state */
+#define SCRIPT_CMD_NEW (0) /* Not tokenized yet */
+#define SCRIPT_CMD_PARSED (1) /* Parsed tokens in code */
+#define SCRIPT_CMD_PATCHED (2) /* Parsed tokens in code, variables patched in buf */
+#define SCRIPT_CMD_DYNAMIC (3) /* Tokenized at each run */
+#define SCRIPT_CMD_ERROR (4) /* Syntax error */
+
+/* script_load_source() result */
+#define SCRIPT_LOAD_OK (0)
+#define SCRIPT_LOAD_ERROR (1)
+#define SCRIPT_LOAD_FULL (2) /* Statement table or heap full */
+
+#define SCRIPT_VAR_NONE (0xFF)
+#define SCRIPT_HEAP_NONE (0xFFFF)
+
+extern t_token_dict tl_dict[];
+
+typedef struct {
+	uint8_t type; /* SCRIPT_STMT_xxx */
+	uint8_t state; /* SCRIPT_CMD_xxx */
+	uint8_t var; /* Variable set by SET/ADD/LOOP */
+	uint8_t arg_var; /* Operand variable, SCRIPT_VAR_NONE to use arg */
+	uint16_t line;
+	uint16_t jump; /* LOOP: index of END, END: index of LOOP */
+	uint16_t text; /* CMD: heap offset of source text */
+	uint16_t code; /* CMD: heap offset of parsed tokens */
+	uint16_t mode; /* CMD: console_mode the tokens were parsed in */
+	uint16_t pad;
+	uint32_t arg;
+} t_script_stmt;
+
+/* Parsed tokens in heap: header, tokens[nb_tokens], buf[buf_len], patches */
+typedef struct {
+	uint8_t nb_tokens;
+	uint8_t nb_patches;
+	uint16_t buf_len;
+} t_script_code;
+
+typedef struct {
+	uint8_t var;
+	uint8_t pad;
+	uint16_t offset; /* uint32_t value offset in buf */
+} t_script_patch;
+
+typedef struct {
+	char magic[4]; /* SCRIPT_CACHE_MAGIC */
+	uint8_t version;
+	uint8_t nb_vars;
+	uint16_t nb_stmts;
+	uint32_t build_hash; /* Firmware build (hydrafw_build_id) */
+	uint32_t dict_hash; /* Firmware tokens */
+	uint32_t parsed_size; /* sizeof(t_tokenline_parsed) */
+	uint32_t src_size;
+	uint16_t src_date;
+	uint16_t src_time;
+	uint32_t heap_size;
+	char vars[SCRIPT_VARS_MAX][SCRIPT_VAR_NAME_SIZE];
+} t_script_hdr;
+
+typedef struct t_script {
+	t_script_hdr hdr;
+	t_script_stmt stmt[SCRIPT_STMTS_MAX];
+	uint8_t heap[SCRIPT_HEAP_SIZE];
+	/* Run time */
+	const char *filename;
+	uint32_t vars[SCRIPT_VARS_MAX];
+	bool dirty; /* Cache file to update */
+	bool captured;
+	t_tokenline_parsed parsed;
+	char line[SCRIPT_LINE_MAX];
+	uint8_t occ_var[SCRIPT_PATCH_MAX]; /* Variable of each $var in line */
+	uint32_t nb_occ;
+} t_script;
+
+typedef struct {
+	uint16_t stmt;
+	uint32_t count;
+	uint32_t counter;
+} t_script_loop;
+
+static uint32_t script_dict_hash(void)
+{
+	const char *str;
+	uint32_t hash, i;
+
+	/* FNV-1a */
+	hash = 2166136261UL;
+	for (i = 1; tl_dict[i].token; i++) {
+		hash = (hash ^ tl_dict[i].token) * 16777619UL;
+		for (str = tl_dict[i].tokenstr; *str; str++)
+			hash = (hash ^ *str) * 16777619UL;
+	}
+
+	return hash;
+}
+
+static uint32_t script_build_hash(void)
+{
+	const char *str;
+	uint32_t hash;
+
+	/* FNV-1a */
+	hash = 2166136261UL;
+	for (str = hydrafw_build_id; *str; str++)
+		hash = (hash ^ *str) * 16777619UL;
+
+	return hash;
+}
+
+static uint32_t script_heap_alloc(t_script *s, uint32_t size)
+{
+	uint32_t offset;
+
+	offset = (s->hdr.heap_size + 3) & ~3;
+	if ((offset + size) > SCRIPT_HEAP_SIZE)
+		return SCRIPT_HEAP_NONE;
+	s->hdr.heap_size = offset + size;
+
+	return offset;
+}
+
+static int script_var_find(t_script *s, const char *name, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < s->hdr.nb_vars; i++) {
+		if (strlen(s->hdr.vars[i]) == len &&
+		    strncmp(s->hdr.vars[i], name, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static int script_var_add(t_script *s, const char *name)
+{
+	int i;
+
+	i = script_var_find(s, name, strlen(name));
+	if (i >= 0)
+		return i;
+	if (s->hdr.nb_vars >= SCRIPT_VARS_MAX ||
+	    strlen(name) >= SCRIPT_VAR_NAME_SIZE)
+		return -1;
+	strcpy(s->hdr.vars[s->hdr.nb_vars], name);
+
+	return s->hdr.nb_vars++;
+}
+
+static uint32_t script_var_len(const char *str)
+{
+	uint32_t len;
+
+	for (len = 0; str[len] == '_' || (str[len] >= '0' && str[len] <= '9') ||
+	     (str[len] >= 'a' && str[len] <= 'z') ||
+	     (str[len] >= 'A' && str[len] <= 'Z'); len++);
+
+	return len;
+}
+
+/* Operand of a directive: number or $var */
+static bool script_operand(t_script *s, t_script_stmt *stmt, const char *str)
 {
+	char *end;
+	int var;
+
+	if (str == NULL)
+		return FALSE;
+
+	if (str[0] == '$') {
+		var = script_var_find(s, str + 1, strlen(str + 1));
+		if (var < 0)
+			return FALSE;
+		stmt->arg_var = var;
+		return TRUE;
+	}
+	stmt->arg = strtol(str, &end, 0);
+
+	return (*end == 0);
+}
+
+static uint32_t script_operand_value(t_script *s, t_script_stmt *stmt)
+{
+	if (stmt->arg_var != SCRIPT_VAR_NONE)
+		return s->vars[stmt->arg_var];
+
+	return stmt->arg;
+}
+
+/* Return NULL if successful, else the error message */
+static const char *script_load_directive(t_script *s, t_script_stmt *stmt,
+					 char *line, uint16_t *loops, uint32_t *depth)
+{
+	char *directive, *arg1, *arg2, *save;
+	int var;
+
+	directive = strtok_r(line, " \t", &save);
+	arg1 = strtok_r(NULL, " \t", &save);
+	arg2 = strtok_r(NULL, " \t", &save);
+
+	if (!strcmp(directive, ".set") || !strcmp(directive, ".add")) {
+		stmt->type = !strcmp(directive, ".set") ? SCRIPT_STMT_SET : SCRIPT_STMT_ADD;
+		if (arg1 == NULL || script_var_len(arg1) != strlen(arg1))
+			return "variable name expected";
+		if (!script_operand(s, stmt, arg2))
+			return "invalid value";
+		var = script_var_add(s, arg1);
+		if (var < 0)
+			return "too many variables";
+		stmt->var = var;
+	} else if (!strcmp(directive, ".loop")) {
+		stmt->type = SCRIPT_STMT_LOOP;
+		if (!script_operand(s, stmt, arg1))
+			return "invalid count";
+		if (arg2 != NULL) {
+			if (script_var_len(arg2) != strlen(arg2))
+				return "invalid variable name";
+			var = script_var_add(s, arg2);
+			if (var < 0)
+				return "too many variables";
+			stmt->var = var;
+		}
+		if (*depth >= SCRIPT_LOOP_DEPTH)
+			return "too many nested loops";
+		loops[(*depth)++] = s->hdr.nb_stmts;
+	} else if (!strcmp(directive, ".end")) {
+		stmt->type = SCRIPT_STMT_END;
+		if (*depth == 0)
+			return ".end without .loop";
+		stmt->jump = loops[--(*depth)];
+		s->stmt[stmt->jump].jump = s->hdr.nb_stmts;
+	} else {
+		return "unknown directive";
+	}
+
+	return NULL;
+}
+
+/* Return FALSE if a $var of a command is not set in the script */
+static bool script_check_vars(t_script *s, const char *text)
+{
+	uint32_t len;
+
+	while ((text = strchr(text, '$')) != NULL) {
+		text++;
+		len = script_var_len(text);
+		if (script_var_find(s, text, len) < 0)
+			return FALSE;
+		text += len;
+	}
+
+	return TRUE;
+}
+
+/* Read script file in statement table, return SCRIPT_LOAD_xxx */
+static int script_load_source(t_hydra_console *con, t_script *s, FIL *fp)
+{
+	uint16_t loops[SCRIPT_LOOP_DEPTH];
+	t_script_stmt *stmt;
+	const char *err;
+	char *line;
+	uint32_t depth, len, nb_line, offset, i;
+
+	depth = 0;
+	nb_line = 0;
+	err = NULL;
+	while (err == NULL && file_readline(fp, (uint8_t *)s->line, SCRIPT_LINE_MAX)) {
+		nb_line++;
+		line = s->line;
+		while (*line == ' ' || *line == '\t')
+			line++;
+		len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n' ||
+				   line[len - 1] == ' ' || line[len - 1] == '\t'))
+			line[--len] = 0;
+		if (len == 0 || line[0] == '#')
+			continue;
+
+		if (s->hdr.nb_stmts >= SCRIPT_STMTS_MAX)
+			return SCRIPT_LOAD_FULL;
+		stmt = &s->stmt[s->hdr.nb_stmts];
+		memset(stmt, 0, sizeof(t_script_stmt));
+		stmt->line = nb_line;
+		stmt->var = SCRIPT_VAR_NONE;
+		stmt->arg_var = SCRIPT_VAR_NONE;
+		stmt->text = SCRIPT_HEAP_NONE;
+		stmt->code = SCRIPT_HEAP_NONE;
+
+		if (line[0] == '.') {
+			err = script_load_directive(s, stmt, line, loops, &depth);
+		} else {
+			stmt->type = SCRIPT_STMT_CMD;
+			stmt->state = SCRIPT_CMD_NEW;
+			offset = script_heap_alloc(s, len + 1);
+			if (offset == SCRIPT_HEAP_NONE)
+				return SCRIPT_LOAD_FULL;
+			memcpy(&s->heap[offset], line, len + 1);
+			stmt->text = offset;
+		}
+		s->hdr.nb_stmts++;
+	}
+
+	if (err == NULL && depth > 0) {
+		nb_line = s->stmt[loops[depth - 1]].line;
+		err = ".loop without .end";
+	}
+	for (i = 0; err == NULL && i < s->hdr.nb_stmts; i++) {
+		if (s->stmt[i].type == SCRIPT_STMT_CMD &&
+		    !script_check_vars(s, (const char *)&s->heap[s->stmt[i].text])) {
+			nb_line = s->stmt[i].line;
+			err = "unknown variable";
+		}
+	}
+	if (err != NULL) {
+		cprintf(con, "%s:%lu: %s\r\n", s->filename, nb_line, err);
+		return SCRIPT_LOAD_ERROR;
+	}
+
+	return SCRIPT_LOAD_OK;
+}
+
+static void script_cache_name(t_script *s, char *name)
+{
+	snprintf(name, FILENAME_SIZE, "%s%s", s->filename, SCRIPT_CACHE_EXT);
+}
+
+/* Check parsed tokens stored at heap offset, as script_code_load() uses them */
+static bool script_code_check(t_script *s, uint32_t offset)
+{
+	t_script_code code;
+	t_script_patch patch;
+	uint32_t end, max, arg, i;
+	int token;
+
+	if ((offset + sizeof(t_script_code)) > s->hdr.heap_size)
+		return FALSE;
+	memcpy(&code, &s->heap[offset], sizeof(t_script_code));
+	max = sizeof(s->parsed.tokens) / sizeof(s->parsed.tokens[0]);
+	if (code.nb_tokens == 0 || code.nb_tokens > max ||
+	    code.buf_len > sizeof(s->parsed.buf))
+		return FALSE;
+	end = offset + sizeof(t_script_code) + (code.nb_tokens * sizeof(int)) +
+	      ((code.buf_len + 3) & ~3) + (code.nb_patches * sizeof(t_script_patch));
+	if (end > s->hdr.heap_size)
+		return FALSE;
+
+	/* Tokens end with 0, argument offsets are in buf */
+	offset += sizeof(t_script_code);
+	for (i = 0; i < code.nb_tokens; i++) {
+		memcpy(&token, &s->heap[offset + (i * sizeof(int))], sizeof(int));
+		if (token == 0)
+			break;
+		if (token != T_ARG_UINT && token != T_ARG_FLOAT &&
+		    token != T_ARG_FREQ && token != T_ARG_TOKEN_SUFFIX_INT &&
+		    token != T_ARG_STRING)
+			continue;
+		if (++i >= code.nb_tokens)
+			return FALSE;
+		memcpy(&arg, &s->heap[offset + (i * sizeof(int))], sizeof(int));
+		if (token == T_ARG_STRING) {
+			if (arg >= code.buf_len ||
+			    memchr(&s->heap[offset + (code.nb_tokens * sizeof(int)) + arg],
+				   0, code.buf_len - arg) == NULL)
+				return FALSE;
+		} else if ((arg + sizeof(uint32_t)) > code.buf_len) {
+			return FALSE;
+		}
+	}
+	if (i != (uint32_t)(code.nb_tokens - 1))
+		return FALSE;
+
+	offset += (code.nb_tokens * sizeof(int)) + ((code.buf_len + 3) & ~3);
+	for (i = 0; i < code.nb_patches; i++) {
+		memcpy(&patch, &s->heap[offset], sizeof(t_script_patch));
+		if (patch.var >= s->hdr.nb_vars ||
+		    (patch.offset + sizeof(uint32_t)) > code.buf_len)
+			return FALSE;
+		offset += sizeof(t_script_patch);
+	}
+
+	return TRUE;
+}
+
+static bool script_cache_load(t_script *s, t_script_hdr *src)
+{
+	char name[FILENAME_SIZE];
+	t_script_stmt *stmt;
+	uint32_t i, size;
+	bool ok;
 	FIL fp;
+
+	script_cache_name(s, name);
+	if (!file_open(&fp, name, 'r'))
+		return FALSE;
+
+	ok = (file_read(&fp, (uint8_t *)&s->hdr, sizeof(t_script_hdr)) == sizeof(t_script_hdr)) &&
+	     (memcmp(s->hdr.magic, SCRIPT_CACHE_MAGIC, 4) == 0) &&
+	     (s->hdr.version == SCRIPT_CACHE_VERSION) &&
+	     (s->hdr.build_hash == src->build_hash) &&
+	     (s->hdr.dict_hash == src->dict_hash) &&
+	     (s->hdr.parsed_size == src->parsed_size) &&
+	     (s->hdr.src_size == src->src_size) &&
+	     (s->hdr.src_date == src->src_date) &&
+	     (s->hdr.src_time == src->src_time) &&
+	     (s->hdr.nb_stmts <= SCRIPT_STMTS_MAX) &&
+	     (s->hdr.nb_vars <= SCRIPT_VARS_MAX) &&
+	     (s->hdr.heap_size <= SCRIPT_HEAP_SIZE);
+	if (ok) {
+		size = s->hdr.nb_stmts * sizeof(t_script_stmt);
+		ok = (file_read(&fp, (uint8_t *)s->stmt, size) == size) &&
+		     (file_read(&fp, s->heap, s->hdr.heap_size) == s->hdr.heap_size);
+	}
+	file_close(&fp);
+
+	for (i = 0; ok && i < s->hdr.nb_stmts; i++) {
+		stmt = &s->stmt[i];
+		if (stmt->type == SCRIPT_STMT_CMD)
+			ok = (stmt->text < s->hdr.heap_size) &&
+			     (memchr(&s->heap[stmt->text], 0,
+				     s->hdr.heap_size - stmt->text) != NULL) &&
+			     (stmt->state <= SCRIPT_CMD_ERROR) &&
+			     ((stmt->state != SCRIPT_CMD_PARSED &&
+			       stmt->state != SCRIPT_CMD_PATCHED) ||
+			      script_code_check(s, stmt->code));
+		else if (stmt->type == SCRIPT_STMT_SET || stmt->type == SCRIPT_STMT_ADD)
+			ok = (stmt->var != SCRIPT_VAR_NONE);
+		else if (stmt->type == SCRIPT_STMT_LOOP || stmt->type == SCRIPT_STMT_END)
+			ok = (stmt->jump < s->hdr.nb_stmts);
+		if (stmt->var != SCRIPT_VAR_NONE && stmt->var >= s->hdr.nb_vars)
+			ok = FALSE;
+		if (stmt->arg_var != SCRIPT_VAR_NONE && stmt->arg_var >= s->hdr.nb_vars)
+			ok = FALSE;
+	}
+	if (!ok)
+		memcpy(&s->hdr, src, sizeof(t_script_hdr));
+
+	return ok;
+}
+
+static void script_cache_save(t_hydra_console *con, t_script *s)
+{
+	char name[FILENAME_SIZE];
+	bool ok;
+	FIL fp;
+
+	script_cache_name(s, name);
+	if (!file_open(&fp, name, 'w') || f_truncate(&fp) != FR_OK) {
+		cprintf(con, "Failed to open file %s\r\n", name);
+		return;
+	}
+
+	ok = file_append(&fp, (uint8_t *)&s->hdr, sizeof(t_script_hdr)) &&
+	     file_append(&fp, (uint8_t *)s->stmt, s->hdr.nb_stmts * sizeof(t_script_stmt)) &&
+	     file_append(&fp, s->heap, s->hdr.heap_size);
+	if (!file_close(&fp) || !ok)
+		cprintf(con, "Failed to write file %s\r\n", name);
+}
+
+/*
+ * Copy command text in s->line, each $var is replaced by its value or, if
+ * probe >= 0, by a fixed width number: 0 or occurrence index + 1 if probe is
+ * not 0.
+ */
+static bool script_expand(t_script *s, const char *text, int probe)
+{
+	uint32_t i, len, var_len, value;
+	int var;
+
+	i = 0;
+	s->nb_occ = 0;
+	while (*text) {
+		if (*text != '$') {
+			if (i >= (SCRIPT_LINE_MAX - 1))
+				return FALSE;
+			s->line[i++] = *text++;
+			continue;
+		}
+		text++;
+		var_len = script_var_len(text);
+		var = script_var_find(s, text, var_len);
+		if (var < 0 || s->nb_occ >= SCRIPT_PATCH_MAX)
+			return FALSE;
+		text += var_len;
+		s->occ_var[s->nb_occ++] = var;
+
+		if (probe < 0) {
+			value = s->vars[var];
+			len = snprintf(&s->line[i], SCRIPT_LINE_MAX - i, "%lu", value);
+		} else {
+			value = probe ? s->nb_occ : 0;
+			len = snprintf(&s->line[i], SCRIPT_LINE_MAX - i, "0x%08lX", value);
+		}
+		i += len;
+		if (i >= SCRIPT_LINE_MAX)
+			return FALSE;
+	}
+	s->line[i] = 0;
+
+	return TRUE;
+}
+
+static void script_capture(void *user, t_tokenline_parsed *p)
+{
+	t_hydra_console *con = user;
+
+	memcpy(&con->script->parsed, p, sizeof(t_tokenline_parsed));
+	con->script->captured = TRUE;
+}
+
+/* Tokenize s->line in s->parsed without executing it */
+static bool script_tokenize(t_hydra_console *con, t_script *s)
+{
+	uint32_t i;
+
+	s->captured = FALSE;
+	tl_set_callback(con->tl, script_capture);
+	for (i = 0; s->line[i]; i++)
+		tl_input(con->tl, s->line[i]);
+	tl_input(con->tl, '\n');
+	tl_set_callback(con->tl, execute);
+
+	return s->captured;
+}
+
+/* Number of tokens (with final 0) and size of buf used by arguments */
+static bool script_parsed_size(t_tokenline_parsed *p, uint32_t *nb_tokens,
+			       uint32_t *buf_len)
+{
+	uint32_t i, end, max;
+
+	max = sizeof(p->tokens) / sizeof(p->tokens[0]);
+	*buf_len = 0;
+	for (i = 0; i < max && p->tokens[i]; i++) {
+		switch (p->tokens[i]) {
+		case T_ARG_UINT:
+		case T_ARG_FLOAT:
+		case T_ARG_FREQ:
+		case T_ARG_TOKEN_SUFFIX_INT:
+			i++;
+			end = p->tokens[i] + sizeof(uint32_t);
+			break;
+		case T_ARG_STRING:
+			i++;
+			end = p->tokens[i] + strlen(p->buf + p->tokens[i]) + 1;
+			break;
+		default:
+			continue;
+		}
+		if (end > *buf_len)
+			*buf_len = end;
+	}
+	*nb_tokens = i + 1;
+
+	return (i < max) && (*nb_tokens <= 0xFF) && (*buf_len <= sizeof(p->buf));
+}
+
+/*
+ * Find the uint32_t arguments set by each $var: the line is tokenized with
+ * all variables at 0 then with variable occurrence i at i + 1. Return the
+ * number of patches or -1 if a variable is not a whole uint argument.
+ */
+static int script_find_patches(t_hydra_console *con, t_script *s,
+			       const char *text, t_script_patch *patches)
+{
+	t_tokenline_parsed *zero;
+	uint32_t i, nb_tokens, buf_len, nb_tokens_zero, buf_len_zero, value;
+	int nb_patches;
+
+	zero = pool_alloc_bytes(sizeof(t_tokenline_parsed));
+	if (zero == NULL)
+		return -1;
+
+	nb_patches = -1;
+	if (!script_expand(s, text, 0) || !script_tokenize(con, s) ||
+	    !script_parsed_size(&s->parsed, &nb_tokens_zero, &buf_len_zero))
+		goto end;
+	memcpy(zero, &s->parsed, sizeof(t_tokenline_parsed));
+	if (!script_expand(s, text, 1) || !script_tokenize(con, s) ||
+	    !script_parsed_size(&s->parsed, &nb_tokens, &buf_len) ||
+	    nb_tokens != nb_tokens_zero || buf_len != buf_len_zero ||
+	    memcmp(zero->tokens, s->parsed.tokens, nb_tokens * sizeof(int)))
+		goto end;
+
+	nb_patches = 0;
+	for (i = 0; i < nb_tokens - 1; i++) {
+		if (s->parsed.tokens[i] != T_ARG_UINT &&
+		    s->parsed.tokens[i] != T_ARG_TOKEN_SUFFIX_INT) {
+			if (s->parsed.tokens[i] == T_ARG_FLOAT ||
+			    s->parsed.tokens[i] == T_ARG_FREQ ||
+			    s->parsed.tokens[i] == T_ARG_STRING)
+				i++;
+			continue;
+		}
+		i++;
+		memcpy(&value, s->parsed.buf + s->parsed.tokens[i], sizeof(uint32_t));
+		if (value == 0)
+			continue;
+		if (value > s->nb_occ) {
+			nb_patches = -1;
+			goto end;
+		}
+		patches[nb_patches].var = s->occ_var[value - 1];
+		patches[nb_patches].pad = 0;
+		patches[nb_patches].offset = s->parsed.tokens[i];
+		nb_patches++;
+		/* Other bytes of buf shall not depend on variables */
+		memset(s->parsed.buf + s->parsed.tokens[i], 0, sizeof(uint32_t));
+	}
+	if (nb_patches != (int)s->nb_occ || memcmp(zero->buf, s->parsed.buf, buf_len))
+		nb_patches = -1;
+
+end:
+	pool_free(zero);
+	return nb_patches;
+}
+
+/* Store s->parsed in heap, return FALSE if heap is full */
+static bool script_code_store(t_script *s, t_script_stmt *stmt,
+			      t_script_patch *patches, uint32_t nb_patches)
+{
+	t_script_code code;
+	uint32_t nb_tokens, buf_len, offset, i;
+
+	if (!script_parsed_size(&s->parsed, &nb_tokens, &buf_len))
+		return FALSE;
+
+	offset = script_heap_alloc(s, sizeof(t_script_code) + (nb_tokens * sizeof(int)) +
+				   ((buf_len + 3) & ~3) + (nb_patches * sizeof(t_script_patch)));
+	if (offset == SCRIPT_HEAP_NONE)
+		return FALSE;
+
+	code.nb_tokens = nb_tokens;
+	code.nb_patches = nb_patches;
+	code.buf_len = buf_len;
+	stmt->code = offset;
+	memcpy(&s->heap[offset], &code, sizeof(t_script_code));
+	offset += sizeof(t_script_code);
+	memcpy(&s->heap[offset], s->parsed.tokens, nb_tokens * sizeof(int));
+	offset += nb_tokens * sizeof(int);
+	memcpy(&s->heap[offset], s->parsed.buf, buf_len);
+	offset += (buf_len + 3) & ~3;
+	for (i = 0; i < nb_patches; i++) {
+		memcpy(&s->heap[offset], &patches[i], sizeof(t_script_patch));
+		offset += sizeof(t_script_patch);
+	}
+
+	return TRUE;
+}
+
+/* Rebuild s->parsed from heap with current variable values */
+static void script_code_load(t_script *s, t_script_stmt *stmt)
+{
+	t_script_code code;
+	t_script_patch patch;
+	uint32_t offset, i;
+
+	offset = stmt->code;
+	memcpy(&code, &s->heap[offset], sizeof(t_script_code));
+	offset += sizeof(t_script_code);
+	memcpy(s->parsed.tokens, &s->heap[offset], code.nb_tokens * sizeof(int));
+	offset += code.nb_tokens * sizeof(int);
+	memcpy(s->parsed.buf, &s->heap[offset], code.buf_len);
+	offset += (code.buf_len + 3) & ~3;
+	for (i = 0; i < code.nb_patches; i++) {
+		memcpy(&patch, &s->heap[offset], sizeof(t_script_patch));
+		memcpy(s->parsed.buf + patch.offset, &s->vars[patch.var], sizeof(uint32_t));
+		offset += sizeof(t_script_patch);
+	}
+}
+
+/* First run of a command: tokenize it and keep parsed tokens if possible */
+static void script_cmd_compile(t_hydra_console *con, t_script *s, t_script_stmt *stmt)
+{
+	t_script_patch patches[SCRIPT_PATCH_MAX];
+	const char *text;
+	int nb_patches;
+
+	text = (const char *)&s->heap[stmt->text];
+	s->dirty = TRUE;
+	stmt->mode = con->console_mode;
+	if (strchr(text, '$') == NULL) {
+		nb_patches = 0;
+		if (!script_expand(s, text, -1) || !script_tokenize(con, s)) {
+			stmt->state = SCRIPT_CMD_ERROR;
+			return;
+		}
+	} else {
+		nb_patches = script_find_patches(con, s, text, patches);
+		if (nb_patches < 0) {
+			stmt->state = SCRIPT_CMD_DYNAMIC;
+			return;
+		}
+	}
+
+	if (!script_code_store(s, stmt, patches, nb_patches)) {
+		stmt->state = SCRIPT_CMD_DYNAMIC;
+		return;
+	}
+	stmt->state = nb_patches ? SCRIPT_CMD_PATCHED : SCRIPT_CMD_PARSED;
+}
+
+static void script_cmd(t_hydra_console *con, t_script *s, t_script_stmt *stmt)
+{
+	uint8_t state;
+
+	if (stmt->state == SCRIPT_CMD_NEW)
+		script_cmd_compile(con, s, stmt);
+
+	/* Tokens depend on the mode, tokenize again if it is not the same */
+	state = stmt->state;
+	if (stmt->mode != con->console_mode)
+		state = SCRIPT_CMD_DYNAMIC;
+
+	switch (state) {
+	case SCRIPT_CMD_PARSED:
+	case SCRIPT_CMD_PATCHED:
+		script_code_load(s, stmt);
+		execute(con, &s->parsed);
+		break;
+	case SCRIPT_CMD_DYNAMIC:
+		if (script_expand(s, (const char *)&s->heap[stmt->text], -1) &&
+		    script_tokenize(con, s)) {
+			execute(con, &s->parsed);
+			break;
+		}
+		/* fall through */
+	default:
+		cprintf(con, "%s:%d: syntax error\r\n", s->filename, stmt->line);
+		break;
+	}
+}
+
+static void script_run(t_hydra_console *con, t_script *s)
+{
+	t_script_loop loops[SCRIPT_LOOP_DEPTH];
+	t_script_stmt *stmt;
+	uint32_t pc, depth, count;
+
+	depth = 0;
+	pc = 0;
+	while (pc < s->hdr.nb_stmts) {
+		stmt = &s->stmt[pc];
+		switch (stmt->type) {
+		case SCRIPT_STMT_CMD:
+			script_cmd(con, s, stmt);
+			break;
+		case SCRIPT_STMT_SET:
+			s->vars[stmt->var] = script_operand_value(s, stmt);
+			break;
+		case SCRIPT_STMT_ADD:
+			s->vars[stmt->var] += script_operand_value(s, stmt);
+			break;
+		case SCRIPT_STMT_LOOP:
+			count = script_operand_value(s, stmt);
+			if (count == 0 || depth >= SCRIPT_LOOP_DEPTH) {
+				pc = stmt->jump;
+				break;
+			}
+			loops[depth].stmt = pc;
+			loops[depth].count = count;
+			loops[depth].counter = 0;
+			depth++;
+			if (stmt->var != SCRIPT_VAR_NONE)
+				s->vars[stmt->var] = 0;
+			break;
+		case SCRIPT_STMT_END:
+			if (depth == 0)
+				break;
+			if (hydrabus_ubtn()) {
+				cprintf(con, "%s:%d: aborted\r\n", s->filename, stmt->line);
+				return;
+			}
+			if (++loops[depth - 1].counter < loops[depth - 1].count) {
+				pc = loops[depth - 1].stmt;
+				if (s->stmt[pc].var != SCRIPT_VAR_NONE)
+					s->vars[s->stmt[pc].var] = loops[depth - 1].counter;
+			} else {
+				depth--;
+			}
+			break;
+		}
+		pc++;
+	}
+}
+
+/* Legacy execution when the script does not fit in the statement table */
+static void script_run_lines(t_hydra_console *con, FIL *fp)
+{
 	uint8_t inbuf[256];
 	int i;
+
+	while(file_readline(fp, inbuf, 255)) {
+		i=0;
+		if(inbuf[0] == '#') {
+			continue;
+		}
+		while(inbuf[i] != '\0') {
+			tl_input(con->tl, inbuf[i]);
+			i++;
+		}
+	}
+}
+
+int execute_script(t_hydra_console *con, char *filename)
+{
+	t_script_hdr src;
+	t_script *s, *prev;
+	FILINFO fno;
+	FIL fp;
+	int ret;
+
 	if (!is_fs_ready()) {
 		if(mount() != 0) {
 			return FALSE;
 		}
 	}
 
-	if (!file_open(&fp, filename, 'r')) {
+	if (f_stat(filename, &fno) != FR_OK || !file_open(&fp, filename, 'r')) {
 		cprintf(con, "Failed to open file %s\r\n", filename);
 		return FALSE;
 	}
 
+	s = pool_alloc_bytes(sizeof(t_script));
+	if (s == NULL) {
+		tl_input(con->tl, 0x03);
+		script_run_lines(con, &fp);
+		file_close(&fp);
+		return TRUE;
+	}
+	memset(&src, 0, sizeof(t_script_hdr));
+	memcpy(src.magic, SCRIPT_CACHE_MAGIC, 4);
+	src.version = SCRIPT_CACHE_VERSION;
+	src.build_hash = script_build_hash();
+	src.dict_hash = script_dict_hash();
+	src.parsed_size = sizeof(t_tokenline_parsed);
+	src.src_size = fno.fsize;
+	src.src_date = fno.fdate;
+	src.src_time = fno.ftime;
+	s->filename = filename;
+	s->dirty = FALSE;
+	memset(s->vars, 0, sizeof(s->vars));
+
 	/* Clear any input in tokenline buffer */
 	tl_input(con->tl, 0x03);
 
-	while(file_readline(&fp, inbuf, 255)) {
-		i=0;
-		if(inbuf[0] == '#') {
-			continue;
+	if (!script_cache_load(s, &src)) {
+		memcpy(&s->hdr, &src, sizeof(t_script_hdr));
+		ret = script_load_source(con, s, &fp);
+		if (ret == SCRIPT_LOAD_FULL) {
+			cprintf(con, "%s: too big for script cache\r\n", filename);
+			pool_free(s);
+			f_lseek(&fp, 0);
+			script_run_lines(con, &fp);
+			file_close(&fp);
+			return TRUE;
 		}
-		while(inbuf[i] != '\0') {
-			tl_input(con->tl, inbuf[i]);
-			i++;
+		if (ret != SCRIPT_LOAD_OK) {
+			file_close(&fp);
+			pool_free(s);
+			return FALSE;
 		}
+		s->dirty = TRUE;
 	}
 	file_close(&fp);
+
+	/* Scripts can be nested with "sd script" */
+	prev = con->script;
+	con->script = s;
+	script_run(con, s);
+	con->script = prev;
+
+	if (s->dirty)
+		script_cache_save(con, s);
+	pool_free(s);
+
 	return TRUE;
 }
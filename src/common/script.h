@@ -16,4 +16,40 @@
  * limitations under the License.
  */
 
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+#include "common.h"
+
+/*
+ * Scripts are loaded once in a statement table. Each command line is
+ * tokenized the first time it runs and its parsed tokens are kept, so next
+ * runs call execute() directly. The table is saved in <script>.tlc and
+ * reused as long as the script file size/date and the firmware tokens are
+ * unchanged.
+ *
+ * Script syntax (one statement per line):
+ *  # comment
+ *  <console command>, $<var> is replaced by the variable value
+ *  .set <var> <value|$var>
+ *  .add <var> <value|$var>
+ *  .loop <count|$var> [<var>]  <var> counts from 0 to count-1
+ *  .end
+ * A parsed command is replayed in the mode it was first run in.
+ */
+
+#define SCRIPT_CACHE_EXT ".tlc"
+#define SCRIPT_CACHE_MAGIC "HSCR"
+#define SCRIPT_CACHE_VERSION (2)
+
+#define SCRIPT_LINE_MAX (256)
+#define SCRIPT_STMTS_MAX (256)
+#define SCRIPT_HEAP_SIZE (12288) /* Command text and parsed tokens */
+#define SCRIPT_VARS_MAX (16)
+#define SCRIPT_VAR_NAME_SIZE (12)
+#define SCRIPT_LOOP_DEPTH (8)
+#define SCRIPT_PATCH_MAX (8) /* Max variables in a command line */
+
 int execute_script(t_hydra_console *con, char *filename);
+
+#endif /* _SCRIPT_H_ */
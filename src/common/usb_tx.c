@@ -0,0 +1,95 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_tx.h"
+#include "microsd.h"
+
+static uint8_t usb1_tx_buf[BQ_BUFFER_SIZE(USB1_TX_BUFFERS_NUMBER, USB1_TX_BUFFERS_SIZE)];
+static uint8_t usb2_tx_buf[BQ_BUFFER_SIZE(USB2_TX_BUFFERS_NUMBER, USB2_TX_BUFFERS_SIZE)];
+
+/*
+ * Replace output queue buffers set by sduObjectInit(), the queue notify
+ * callback (which starts IN transfers) is kept.
+ */
+static void usb_tx_queue_init(SerialUSBDriver *sdup, uint8_t *buf,
+			      size_t size, size_t n)
+{
+	output_buffers_queue_t *obqp = &sdup->obqueue;
+
+	obqObjectInit(obqp, true, buf, size, n, obqp->notify, sdup);
+}
+
+/* Must be called after sduObjectInit() and before sduStart() */
+void usb_tx_init(SerialUSBDriver *sdup1, SerialUSBDriver *sdup2)
+{
+	usb_tx_queue_init(sdup1, usb1_tx_buf,
+			  USB1_TX_BUFFERS_SIZE, USB1_TX_BUFFERS_NUMBER);
+	usb_tx_queue_init(sdup2, usb2_tx_buf,
+			  USB2_TX_BUFFERS_SIZE, USB2_TX_BUFFERS_NUMBER);
+}
+
+/*
+ * Return an empty USB output buffer and its size in *size or NULL if no
+ * buffer is free before timeout or USB is disconnected.
+ * The buffer must be submitted with usb_tx_submit() before any other write
+ * on this console.
+ */
+uint8_t *usb_tx_get_buffer(t_hydra_console *con, uint32_t *size,
+			   sysinterval_t timeout)
+{
+	output_buffers_queue_t *obqp = &con->sdu->obqueue;
+
+	/* Keep order with data partially written by chnWrite() */
+	obqFlush(obqp);
+
+	if (obqGetEmptyBufferTimeout(obqp, timeout) != MSG_OK)
+		return NULL;
+
+	*size = obqp->top - obqp->ptr;
+	return obqp->ptr;
+}
+
+/*
+ * Send size bytes of buffer returned by usb_tx_get_buffer().
+ * size 0 gives the buffer back (it is reused by next write).
+ */
+void usb_tx_submit(t_hydra_console *con, uint32_t size)
+{
+	output_buffers_queue_t *obqp = &con->sdu->obqueue;
+
+	if (size == 0)
+		return;
+
+	if (con->log_file.obj.fs)
+		file_append(&(con->log_file), obqp->ptr, size);
+
+	obqPostFullBuffer(obqp, size);
+	usb_tx_perf(con, size);
+}
+
+/* Update output bytes and queue high-water mark (see perf.h) */
+void usb_tx_perf(t_hydra_console *con, uint32_t size)
+{
+	output_buffers_queue_t *obqp = &con->sdu->obqueue;
+	uint32_t filled;
+
+	filled = obqp->bn - obqp->bcounter;
+	con->perf.usb_tx_bytes += size;
+	if (filled > con->perf.usb_tx_hwm)
+		con->perf.usb_tx_hwm = filled;
+}
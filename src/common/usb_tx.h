@@ -0,0 +1,61 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_TX_H_
+#define _USB_TX_H_
+
+#include "ch.h"
+#include "hal.h"
+#include "common.h"
+
+/*
+ * Zero-copy USB CDC transmit.
+ * Producers get an empty USB output buffer, fill it in place and submit it,
+ * data is sent from this buffer to the IN endpoint without the copy done by
+ * chnWrite()/cprint().
+ * Data already written with cprint() is flushed before a buffer is returned
+ * so both APIs can be mixed on the same console.
+ *
+ * Each port uses its own output queue (USBx_TX_BUFFERS_NUMBER buffers of
+ * USBx_TX_BUFFERS_SIZE bytes) instead of the SERIAL_USB_BUFFERS_xxx ones
+ * from halconf.h (still used for reception).
+ * Buffers are in main RAM so they can be filled by DMA.
+ */
+
+/* Buffer size must be a multiple of USB endpoint maximum packet size (64) */
+#if !defined(USB1_TX_BUFFERS_SIZE)
+#define USB1_TX_BUFFERS_SIZE (512)
+#endif
+#if !defined(USB1_TX_BUFFERS_NUMBER)
+#define USB1_TX_BUFFERS_NUMBER (4)
+#endif
+
+#if !defined(USB2_TX_BUFFERS_SIZE)
+#define USB2_TX_BUFFERS_SIZE (512)
+#endif
+#if !defined(USB2_TX_BUFFERS_NUMBER)
+#define USB2_TX_BUFFERS_NUMBER (4)
+#endif
+
+void usb_tx_init(SerialUSBDriver *sdup1, SerialUSBDriver *sdup2);
+uint8_t *usb_tx_get_buffer(t_hydra_console *con, uint32_t *size,
+			   sysinterval_t timeout);
+void usb_tx_submit(t_hydra_console *con, uint32_t size);
+void usb_tx_perf(t_hydra_console *con, uint32_t size);
+
+#endif /* _USB_TX_H_ */
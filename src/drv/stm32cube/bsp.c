@@ -74,15 +74,21 @@ uint32_t HAL_RCC_GetPCLK2Freq(void)
 	return 84000000;
 }
 
+/*
+ CYCCNT is never cleared as bsp_get_cyclecounter64() and the perf counters
+ rely on it, delays compare the elapsed cycles with the start value.
+*/
+static uint32_t delay_start;
+
 bool delay_is_expired(bool start, uint32_t wait_nb_cycles)
 {
 	if(start == TRUE) {
 		/* Disable IRQ globally */
 		__asm__("cpsid i");
-		bsp_clear_cyclecounter();
+		delay_start = bsp_get_cyclecounter();
 	} else {
 		/* Minus 10 cycles to take into account code overhead */
-		if(bsp_get_cyclecounter() >= (wait_nb_cycles-10)) {
+		if((bsp_get_cyclecounter() - delay_start) >= (wait_nb_cycles-10)) {
 			/* Enable IRQ globally */
 			__asm__("cpsie i");
 			return TRUE;
@@ -93,12 +99,14 @@ bool delay_is_expired(bool start, uint32_t wait_nb_cycles)
 
 void wait_delay(uint32_t wait_nb_cycles)
 {
+	uint32_t start;
+
 	/* Disable IRQ globally */
 	__asm__("cpsid i");
 
-	bsp_clear_cyclecounter();
+	start = bsp_get_cyclecounter();
 	/* Minus 10 cycles to take into account code overhead */
-	while(bsp_get_cyclecounter() < (wait_nb_cycles-10)) {
+	while((bsp_get_cyclecounter() - start) < (wait_nb_cycles-10)) {
 		__asm__("nop");
 	}
 
@@ -43,7 +43,6 @@ typedef struct {
 #define DWT_CTRL		(DWTBase->CTRL)
 #define DWT_CTRL_CYCCNTENA	(0x1U << 0)
 
-#define bsp_clear_cyclecounter() ( DWTBase->CYCCNT = 0 )
 #define bsp_get_cyclecounter() ( DWTBase->CYCCNT )
 
 /* Macro for fast read, set & clear GPIO pin */
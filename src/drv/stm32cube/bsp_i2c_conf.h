@@ -21,4 +21,31 @@ limitations under the License.
 #define BSP_I2C1_SCL_PIN            GPIO_PIN_6
 #define BSP_I2C1_SDA_PIN            GPIO_PIN_7
 
+/* I2C1 peripheral (hw backend) */
+#define BSP_I2C1                    I2C1
+#define BSP_I2C1_AF                 GPIO_AF4_I2C1
+#define BSP_I2C1_GPIO_SPEED         GPIO_SPEED_FAST
+
+/*
+I2C1 RX DMA1 Stream0 Channel1
+I2C1 TX DMA1 Stream7 Channel1
+Conflict with mcuconf.h => #define STM32_SPI_SPI3_RX_DMA_STREAM STM32_DMA_STREAM_ID(1, 0)
+Conflict with mcuconf.h => #define STM32_SPI_SPI3_TX_DMA_STREAM STM32_DMA_STREAM_ID(1, 7)
+*/
+#define BSP_I2C1_DMA_RX_STREAM      DMA1_Stream0
+#define BSP_I2C1_DMA_TX_STREAM      DMA1_Stream7
+#define BSP_I2C1_DMA_CHANNEL        (1U << DMA_SxCR_CHSEL_Pos)
+#define BSP_I2C1_DMA_RX_ISR         (DMA1->LISR)
+#define BSP_I2C1_DMA_RX_IFCR        (DMA1->LIFCR)
+#define BSP_I2C1_DMA_RX_FLAGS       (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | \
+                                     DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+#define BSP_I2C1_DMA_RX_DONE        (DMA_LISR_TCIF0)
+#define BSP_I2C1_DMA_RX_ERRORS      (DMA_LISR_TEIF0 | DMA_LISR_DMEIF0)
+#define BSP_I2C1_DMA_TX_ISR         (DMA1->HISR)
+#define BSP_I2C1_DMA_TX_IFCR        (DMA1->HIFCR)
+#define BSP_I2C1_DMA_TX_FLAGS       (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | \
+                                     DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
+#define BSP_I2C1_DMA_TX_DONE        (DMA_HISR_TCIF7)
+#define BSP_I2C1_DMA_TX_ERRORS      (DMA_HISR_TEIF7 | DMA_HISR_DMEIF7)
+
 #endif /* _BSP_I2C_CONF_H_ */
@@ -12,8 +12,10 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "ch.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_conf.h"
+#include <string.h>
 
 #define BSP_I2C_DELAY_HC_50KHZ   (1680) /* 50KHz*2 (Half Clock) in number of cycles @168MHz */
 #define BSP_I2C_DELAY_HC_100KHZ  (840) /* 100KHz*2 (Half Clock) in number of cycles @168MHz */
@@ -30,6 +32,34 @@ const int i2c_speed[I2C_SPEED_MAX] = {
 int i2c_speed_delay;
 bool i2c_started;
 
+/* I2C1 peripheral speed in Hz for each dev_speed (0 = not supported) */
+static const uint32_t i2c_hw_speed[I2C_SPEED_MAX] = {
+	/* 0 */ 50000,
+	/* 1 */ 100000,
+	/* 2 */ 400000,
+	/* 3 */ 0 /* Fast-mode Plus is not supported by STM32F405 I2C */
+};
+
+#define I2C_HW_TIMEOUT_MAX (1000) // About 100ms (see common/chconf.h/CH_CFG_ST_FREQUENCY)
+
+/* I2C1 peripheral transfer state */
+#define I2C_HW_IDLE	(0)
+#define I2C_HW_STARTED	(1) /* START sent, next byte is the address */
+#define I2C_HW_TX	(2) /* Master transmitter */
+#define I2C_HW_NACK	(3) /* Last byte NACKed, STOP or START expected */
+#define I2C_HW_RX_ADDR	(4) /* Read address ACKed, SCL stretched until ADDR is cleared */
+#define I2C_HW_RX	(5) /* Master receiver (read_buf in progress) */
+
+static uint8_t i2c_backend;
+static uint8_t i2c_hw_state;
+static uint32_t i2c_hw_speed_hz;
+static volatile uint32_t dummy_read;
+
+/* DMA buffer in main SRAM (DMA cannot access CCM where stacks can be) */
+static uint8_t i2c_dma_buf[BSP_I2C_DMA_SIZE_MAX];
+/* Reads use the two halves alternately */
+#define I2C_HW_DMA_HALF (BSP_I2C_DMA_SIZE_MAX / 2)
+
 /* Set SCL LOW = 0/GND (0/GND => Set pin = logic reversed in open drain) */
 #define set_scl_low() (gpio_set_pin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SCL_PIN))
 /* Set SCL HIGH / Floating Input (HIGH => clr pin = logic reversed in open drain) */
@@ -81,6 +111,429 @@ static void i2c_gpio_hw_init(bsp_dev_i2c_t dev_num, uint32_t gpio_scl_sda_pull)
 	HAL_GPIO_Init(BSP_I2C1_SCL_SDA_GPIO_PORT, &gpio_init);
 }
 
+/** \brief I2C1 peripheral GPIO HW Init.
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num
+ * \param gpio_scl_sda_pull uint32_t: MODE_CONFIG_DEV_GPIO_PULLUP/PULLDOWN or NOPULL
+ * \return void
+ *
+ */
+static void i2c_hw_gpio_init(bsp_dev_i2c_t dev_num, uint32_t gpio_scl_sda_pull)
+{
+	(void)dev_num;
+	GPIO_InitTypeDef   gpio_init;
+
+	gpio_init.Pin = BSP_I2C1_SCL_PIN | BSP_I2C1_SDA_PIN;
+	gpio_init.Mode = GPIO_MODE_AF_OD;
+	gpio_init.Speed = BSP_I2C1_GPIO_SPEED;
+	gpio_init.Pull = gpio_scl_sda_pull;
+	gpio_init.Alternate = BSP_I2C1_AF;
+	HAL_GPIO_Init(BSP_I2C1_SCL_SDA_GPIO_PORT, &gpio_init);
+
+	__HAL_RCC_I2C1_CLK_ENABLE();
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	__HAL_RCC_I2C1_FORCE_RESET();
+	__HAL_RCC_I2C1_RELEASE_RESET();
+}
+
+/* Configure I2C1 clock for i2c_hw_speed_hz and enable it */
+static void i2c_hw_config(void)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	uint32_t pclk1, freq_mhz, ccr;
+
+	pclk1 = HAL_RCC_GetPCLK1Freq();
+	freq_mhz = pclk1 / 1000000;
+
+	i2c->CR1 = 0;
+	i2c->CR2 = freq_mhz;
+	if(i2c_hw_speed_hz <= 100000) {
+		/* Standard mode, Thigh = Tlow = CCR * Tpclk1, rise time 1000ns */
+		ccr = pclk1 / (i2c_hw_speed_hz * 2);
+		if(ccr < 4)
+			ccr = 4;
+		i2c->TRISE = freq_mhz + 1;
+	} else {
+		/* Fast mode duty 2:1, Thigh = CCR * Tpclk1, Tlow = 2 * CCR * Tpclk1, rise time 300ns */
+		ccr = pclk1 / (i2c_hw_speed_hz * 3);
+		if(ccr < 1)
+			ccr = 1;
+		ccr |= I2C_CCR_FS;
+		i2c->TRISE = ((freq_mhz * 300) / 1000) + 1;
+	}
+	i2c->CCR = ccr;
+	i2c->CR1 = I2C_CR1_PE;
+
+	i2c_hw_state = I2C_HW_IDLE;
+}
+
+static void i2c_hw_dma_stop(void)
+{
+	BSP_I2C1->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST);
+	BSP_I2C1_DMA_TX_STREAM->CR &= ~DMA_SxCR_EN;
+	BSP_I2C1_DMA_RX_STREAM->CR &= ~DMA_SxCR_EN;
+	while(BSP_I2C1_DMA_TX_STREAM->CR & DMA_SxCR_EN);
+	while(BSP_I2C1_DMA_RX_STREAM->CR & DMA_SxCR_EN);
+	BSP_I2C1_DMA_TX_IFCR = BSP_I2C1_DMA_TX_FLAGS;
+	BSP_I2C1_DMA_RX_IFCR = BSP_I2C1_DMA_RX_FLAGS;
+}
+
+static void i2c_hw_dma_start(DMA_Stream_TypeDef* stream, uint8_t* buf, uint32_t nb_data, uint32_t dir)
+{
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+
+	stream->PAR = (uint32_t)&BSP_I2C1->DR;
+	stream->M0AR = (uint32_t)buf;
+	stream->NDTR = nb_data;
+	stream->FCR = 0;
+	stream->CR = BSP_I2C1_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MINC | dir;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+/* Reset I2C1 after a bus error or a timeout */
+static void i2c_hw_recover(void)
+{
+	i2c_hw_dma_stop();
+	BSP_I2C1->CR1 |= I2C_CR1_SWRST;
+	BSP_I2C1->CR1 &= ~I2C_CR1_SWRST;
+	i2c_hw_config();
+}
+
+/** \brief Wait a SR1 flag.
+ *
+ * \param flag uint32_t: I2C_SR1_xxx flag(s) to wait.
+ * \param nack bool*: set to TRUE if the byte was NACKed (AF).
+ * \return bsp_status_t: BSP_OK if flag or NACK, else error (I2C1 is reset).
+ *
+ */
+static bsp_status_t i2c_hw_wait_flag(uint32_t flag, bool* nack)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	uint32_t tickstart, sr1;
+
+	*nack = FALSE;
+	tickstart = HAL_GetTick();
+	while(1) {
+		sr1 = i2c->SR1;
+		if(sr1 & flag)
+			return BSP_OK;
+
+		if(sr1 & I2C_SR1_AF) {
+			i2c->SR1 = ~I2C_SR1_AF;
+			*nack = TRUE;
+			return BSP_OK;
+		}
+
+		if(sr1 & (I2C_SR1_BERR | I2C_SR1_ARLO)) {
+			i2c_hw_recover();
+			return BSP_ERROR;
+		}
+
+		if((HAL_GetTick() - tickstart) >= I2C_HW_TIMEOUT_MAX) {
+			i2c_hw_recover();
+			return BSP_TIMEOUT;
+		}
+	}
+}
+
+/* Wait the end of a STOP/START request (cond), prefetched bytes are dropped */
+static bsp_status_t i2c_hw_wait_cond(uint32_t cond)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	uint32_t tickstart;
+
+	tickstart = HAL_GetTick();
+	while(i2c->CR1 & cond) {
+		if(i2c->SR1 & I2C_SR1_RXNE)
+			dummy_read = i2c->DR;
+
+		if((HAL_GetTick() - tickstart) >= I2C_HW_TIMEOUT_MAX) {
+			i2c_hw_recover();
+			return BSP_TIMEOUT;
+		}
+	}
+	if(i2c->SR1 & I2C_SR1_RXNE)
+		dummy_read = i2c->DR;
+
+	return BSP_OK;
+}
+
+/*
+ * STOP/START (cond) after a read address without data read: the receiver
+ * cannot end before one byte, it is NACKed and dropped.
+ */
+static bsp_status_t i2c_hw_rx_end(uint32_t cond)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+
+	i2c->CR1 &= ~I2C_CR1_ACK;
+	/* Clear ADDR */
+	dummy_read = i2c->SR1;
+	dummy_read = i2c->SR2;
+	i2c->CR1 |= cond;
+
+	return i2c_hw_wait_cond(cond);
+}
+
+static bsp_status_t i2c_hw_start(void)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	bsp_status_t status;
+	bool nack;
+
+	if(i2c_hw_state == I2C_HW_RX_ADDR) {
+		status = i2c_hw_rx_end(I2C_CR1_START);
+		if(status != BSP_OK)
+			return status;
+	} else {
+		i2c->CR1 |= I2C_CR1_START;
+	}
+
+	status = i2c_hw_wait_flag(I2C_SR1_SB, &nack);
+	if(status == BSP_OK)
+		i2c_hw_state = I2C_HW_STARTED;
+
+	return status;
+}
+
+static bsp_status_t i2c_hw_stop(void)
+{
+	bsp_status_t status;
+
+	switch(i2c_hw_state) {
+	case I2C_HW_IDLE:
+		return BSP_OK;
+
+	case I2C_HW_RX_ADDR:
+		status = i2c_hw_rx_end(I2C_CR1_STOP);
+		break;
+
+	default:
+		BSP_I2C1->CR1 |= I2C_CR1_STOP;
+		status = i2c_hw_wait_cond(I2C_CR1_STOP);
+		break;
+	}
+	i2c_hw_state = I2C_HW_IDLE;
+
+	return status;
+}
+
+static bsp_status_t i2c_hw_write_u8(uint8_t tx_data, uint8_t* tx_ack_flag)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	bsp_status_t status;
+	bool nack;
+
+	*tx_ack_flag = FALSE;
+	switch(i2c_hw_state) {
+	case I2C_HW_STARTED:
+		/* Address */
+		i2c->DR = tx_data;
+		status = i2c_hw_wait_flag(I2C_SR1_ADDR, &nack);
+		if(status != BSP_OK)
+			return status;
+		if(nack) {
+			i2c_hw_state = I2C_HW_NACK;
+			return BSP_OK;
+		}
+		if(tx_data & 1) {
+			/* Keep ADDR set until the read length is known */
+			i2c_hw_state = I2C_HW_RX_ADDR;
+		} else {
+			dummy_read = i2c->SR1;
+			dummy_read = i2c->SR2;
+			i2c_hw_state = I2C_HW_TX;
+		}
+		break;
+
+	case I2C_HW_TX:
+		i2c->DR = tx_data;
+		status = i2c_hw_wait_flag(I2C_SR1_BTF, &nack);
+		if(status != BSP_OK)
+			return status;
+		if(nack) {
+			i2c_hw_state = I2C_HW_NACK;
+			return BSP_OK;
+		}
+		break;
+
+	case I2C_HW_NACK:
+		/* Bus is held until STOP/START, nothing is sent */
+		return BSP_OK;
+
+	default:
+		return BSP_ERROR;
+	}
+	*tx_ack_flag = TRUE;
+
+	return BSP_OK;
+}
+
+static bsp_status_t i2c_hw_write_buf(uint8_t* tx_data, uint32_t nb_data, uint32_t* nb_ack)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	bsp_status_t status;
+	uint32_t tickstart, len, isr;
+	uint8_t ack;
+	bool nack;
+
+	*nb_ack = 0;
+	if(nb_data > 0 && i2c_hw_state == I2C_HW_STARTED) {
+		status = i2c_hw_write_u8(tx_data[0], &ack);
+		if(status != BSP_OK || !ack)
+			return status;
+		(*nb_ack)++;
+		tx_data++;
+		nb_data--;
+	}
+	if(nb_data == 0)
+		return BSP_OK;
+	if(i2c_hw_state != I2C_HW_TX)
+		return BSP_ERROR;
+
+	while(nb_data > 0) {
+		len = (nb_data > BSP_I2C_DMA_SIZE_MAX) ? BSP_I2C_DMA_SIZE_MAX : nb_data;
+		memcpy(i2c_dma_buf, tx_data, len);
+
+		BSP_I2C1_DMA_TX_IFCR = BSP_I2C1_DMA_TX_FLAGS;
+		i2c_hw_dma_start(BSP_I2C1_DMA_TX_STREAM, i2c_dma_buf, len, DMA_SxCR_DIR_0);
+		i2c->CR2 |= I2C_CR2_DMAEN;
+
+		tickstart = HAL_GetTick();
+		while(1) {
+			isr = BSP_I2C1_DMA_TX_ISR;
+			if(isr & BSP_I2C1_DMA_TX_DONE)
+				break;
+
+			if(i2c->SR1 & I2C_SR1_AF) {
+				i2c->SR1 = ~I2C_SR1_AF;
+				/* The NACKed byte is the last one written in DR */
+				len -= BSP_I2C1_DMA_TX_STREAM->NDTR;
+				i2c_hw_dma_stop();
+				*nb_ack += (len > 0) ? (len - 1) : 0;
+				i2c_hw_state = I2C_HW_NACK;
+				return BSP_OK;
+			}
+
+			if((isr & BSP_I2C1_DMA_TX_ERRORS) || (i2c->SR1 & (I2C_SR1_BERR | I2C_SR1_ARLO)) ||
+			   ((HAL_GetTick() - tickstart) >= I2C_HW_TIMEOUT_MAX)) {
+				i2c_hw_recover();
+				return BSP_ERROR;
+			}
+		}
+		i2c_hw_dma_stop();
+
+		*nb_ack += len;
+		tx_data += len;
+		nb_data -= len;
+	}
+
+	/* Wait ACK of last byte */
+	status = i2c_hw_wait_flag(I2C_SR1_BTF, &nack);
+	if(status != BSP_OK)
+		return status;
+	if(nack) {
+		(*nb_ack)--;
+		i2c_hw_state = I2C_HW_NACK;
+	}
+
+	return BSP_OK;
+}
+
+/*
+ * Read nb_data bytes after the read address, the last one is NACKed then
+ * STOP is sent.
+ * The receiver ACKs a byte as soon as it is received so the NACK has to be
+ * programmed before the last byte: single byte with ACK cleared before ADDR
+ * is cleared, else DMA with LAST (NACK after the byte following the last but
+ * one DMA transfer). Chunks use the two halves of i2c_dma_buf so the next
+ * DMA is started before the previous chunk is copied, the last chunk has at
+ * least 2 bytes so LAST is set before its last byte is received.
+ */
+static bsp_status_t i2c_hw_read_buf(uint8_t* rx_data, uint32_t nb_data)
+{
+	I2C_TypeDef* i2c = BSP_I2C1;
+	bsp_status_t status;
+	uint32_t tickstart, len, prev_len, isr, half;
+	bool nack;
+
+	if(i2c_hw_state != I2C_HW_RX_ADDR) {
+		memset(rx_data, 0xFF, nb_data);
+		return BSP_ERROR;
+	}
+
+	if(nb_data == 1) {
+		/* NACK single byte, STOP is sent after it */
+		i2c->CR1 &= ~I2C_CR1_ACK;
+		dummy_read = i2c->SR1;
+		dummy_read = i2c->SR2;
+		i2c->CR1 |= I2C_CR1_STOP;
+		i2c_hw_state = I2C_HW_RX;
+		status = i2c_hw_wait_flag(I2C_SR1_RXNE, &nack);
+		if(status != BSP_OK)
+			return status;
+		*rx_data = i2c->DR;
+		i2c_hw_state = I2C_HW_IDLE;
+		return i2c_hw_wait_cond(I2C_CR1_STOP);
+	}
+
+	i2c->CR1 |= I2C_CR1_ACK;
+	half = 0;
+	prev_len = 0;
+	while(nb_data > 0) {
+		len = (nb_data > I2C_HW_DMA_HALF) ? I2C_HW_DMA_HALF : nb_data;
+		/* Keep at least 2 bytes for the last chunk (LAST) */
+		if((nb_data - len) == 1)
+			len--;
+
+		/* Short gap between chunks: the receiver ACKs the next byte meanwhile */
+		chSysLock();
+		i2c_hw_dma_stop();
+		i2c_hw_dma_start(BSP_I2C1_DMA_RX_STREAM, &i2c_dma_buf[half], len, 0);
+		if(len == nb_data)
+			i2c->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+		else
+			i2c->CR2 |= I2C_CR2_DMAEN;
+		chSysUnlock();
+
+		if(i2c_hw_state == I2C_HW_RX_ADDR) {
+			/* Clear ADDR starts the reception */
+			dummy_read = i2c->SR1;
+			dummy_read = i2c->SR2;
+			i2c_hw_state = I2C_HW_RX;
+		}
+
+		/* Copy previous chunk while this one is received */
+		memcpy(rx_data, &i2c_dma_buf[half ^ I2C_HW_DMA_HALF], prev_len);
+		rx_data += prev_len;
+
+		tickstart = HAL_GetTick();
+		while(1) {
+			isr = BSP_I2C1_DMA_RX_ISR;
+			if(isr & BSP_I2C1_DMA_RX_DONE)
+				break;
+
+			if((isr & BSP_I2C1_DMA_RX_ERRORS) || (i2c->SR1 & (I2C_SR1_BERR | I2C_SR1_ARLO)) ||
+			   ((HAL_GetTick() - tickstart) >= I2C_HW_TIMEOUT_MAX)) {
+				i2c_hw_recover();
+				return BSP_ERROR;
+			}
+		}
+
+		prev_len = len;
+		nb_data -= len;
+		half ^= I2C_HW_DMA_HALF;
+	}
+	i2c_hw_dma_stop();
+	i2c->CR1 |= I2C_CR1_STOP;
+	i2c_hw_state = I2C_HW_IDLE;
+	memcpy(rx_data, &i2c_dma_buf[half ^ I2C_HW_DMA_HALF], prev_len);
+
+	return i2c_hw_wait_cond(I2C_CR1_STOP);
+}
+
 /** \brief Init I2C device.
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
@@ -100,6 +553,15 @@ bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mod
 	else
 		return BSP_ERROR;
 
+	i2c_backend = mode_conf->config.i2c.dev_backend;
+	if(i2c_backend == BSP_I2C_BACKEND_HW) {
+		i2c_hw_speed_hz = i2c_hw_speed[mode_conf->config.i2c.dev_speed];
+		if(i2c_hw_speed_hz == 0) {
+			i2c_backend = BSP_I2C_BACKEND_GPIO;
+			return BSP_ERROR;
+		}
+	}
+
 	/* Init the I2C */
 	switch(mode_conf->config.i2c.dev_gpio_pull) {
 	case MODE_CONFIG_DEV_GPIO_PULLUP:
@@ -115,6 +577,12 @@ bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mod
 		gpio_scl_sda_pull = GPIO_NOPULL;
 		break;
 	}
+	if(i2c_backend == BSP_I2C_BACKEND_HW) {
+		i2c_hw_gpio_init(dev_num, gpio_scl_sda_pull);
+		i2c_hw_dma_stop();
+		i2c_hw_config();
+		return BSP_OK;
+	}
 	i2c_gpio_hw_init(dev_num, gpio_scl_sda_pull);
 
 	set_sda_float();
@@ -132,6 +600,15 @@ bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mod
  */
 bsp_status_t bsp_i2c_master_deinit(bsp_dev_i2c_t dev_num)
 {
+	if(i2c_backend == BSP_I2C_BACKEND_HW) {
+		i2c_hw_dma_stop();
+		BSP_I2C1->CR1 = 0;
+		__HAL_RCC_I2C1_FORCE_RESET();
+		__HAL_RCC_I2C1_RELEASE_RESET();
+		__HAL_RCC_I2C1_CLK_DISABLE();
+		i2c_backend = BSP_I2C_BACKEND_GPIO;
+	}
+
 	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
 	i2c_gpio_hw_deinit(dev_num);
 
@@ -148,6 +625,9 @@ bsp_status_t bsp_i2c_start(bsp_dev_i2c_t dev_num)
 {
 	(void)dev_num;
 
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_start();
+
 	if(i2c_started == TRUE) {
 		/* Re-Start condition */
 		set_sda_float();
@@ -178,6 +658,9 @@ bsp_status_t bsp_i2c_stop(bsp_dev_i2c_t dev_num)
 {
 	(void)dev_num;
 
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_stop();
+
 	/* Generate STOP condition */
 	set_sda_low();
 	i2c_sw_delay();
@@ -206,6 +689,9 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 	int i;
 	unsigned char ack_val;
 
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_write_u8(tx_data, tx_ack_flag);
+
 	/* Write 8 bits */
 	for(i = 0; i < 8; i++) {
 		if(tx_data & 0x80)
@@ -243,6 +729,8 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 }
 
 /** \brief Write ACK or NACK at end of Read.
+ * Nothing is done with hw backend, the ACK/NACK is sent by the peripheral
+ * (see bsp_i2c_master_read_u8()).
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
  * \param enable_ack bool: TRUE means ACK, FALSE means NACK.
@@ -253,6 +741,9 @@ void bsp_i2c_read_ack(bsp_dev_i2c_t dev_num, bool enable_ack)
 {
 	(void)dev_num;
 
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return;
+
 	/* Write 1 bit ACK or NACK */
 	if(enable_ack == TRUE)
 		set_sda_low(); /* ACK */
@@ -268,6 +759,9 @@ void bsp_i2c_read_ack(bsp_dev_i2c_t dev_num, bool enable_ack)
 }
 
 /** \brief Read a Byte in blocking mode and set the status.
+ * With hw backend the peripheral cannot wait for bsp_i2c_read_ack(), the
+ * byte is NACKed and STOP is sent (use bsp_i2c_master_read_buf() to read
+ * more than one byte).
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
  * \param rx_data uint8_t*: The received byte.
@@ -280,6 +774,9 @@ bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
 	unsigned char data;
 	int i;
 
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_read_buf(rx_data, 1);
+
 	/* Read 8 bits */
 	data = 0;
 	for(i = 0; i < 8; i++) {
@@ -303,3 +800,63 @@ bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
 	return BSP_OK;
 }
 
+/** \brief Write bytes until a NACK, the first byte after a start is the address.
+ * With hw backend data bytes are sent by DMA.
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \param tx_data uint8_t*: data to send.
+ * \param nb_data uint32_t: number of bytes to send.
+ * \param nb_ack uint32_t*: number of bytes ACKed.
+ * \return bsp_status_t: status of the transfer.
+ *
+ */
+bsp_status_t bsp_i2c_master_write_buf(bsp_dev_i2c_t dev_num, uint8_t* tx_data, uint32_t nb_data, uint32_t* nb_ack)
+{
+	bsp_status_t status;
+	uint8_t ack;
+	uint32_t i;
+
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_write_buf(tx_data, nb_data, nb_ack);
+
+	*nb_ack = 0;
+	for(i = 0; i < nb_data; i++) {
+		status = bsp_i2c_master_write_u8(dev_num, tx_data[i], &ack);
+		if(status != BSP_OK || !ack)
+			return status;
+		(*nb_ack)++;
+	}
+
+	return BSP_OK;
+}
+
+/** \brief Read bytes after a read address, ACK all bytes except the last one
+ * (NACK) then send STOP. With hw backend bytes are received by DMA.
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \param rx_data uint8_t*: received bytes.
+ * \param nb_data uint32_t: number of bytes to read (at least 1).
+ * \return bsp_status_t: status of the transfer.
+ *
+ */
+bsp_status_t bsp_i2c_master_read_buf(bsp_dev_i2c_t dev_num, uint8_t* rx_data, uint32_t nb_data)
+{
+	bsp_status_t status;
+	uint32_t i;
+
+	if(nb_data == 0)
+		return bsp_i2c_stop(dev_num);
+
+	if(i2c_backend == BSP_I2C_BACKEND_HW)
+		return i2c_hw_read_buf(rx_data, nb_data);
+
+	for(i = 0; i < nb_data; i++) {
+		status = bsp_i2c_master_read_u8(dev_num, &rx_data[i]);
+		if(status != BSP_OK)
+			break;
+		bsp_i2c_read_ack(dev_num, (i + 1) < nb_data);
+	}
+	bsp_i2c_stop(dev_num);
+
+	return status;
+}
@@ -27,6 +27,12 @@ typedef enum {
 #include "bsp.h"
 #include "mode_config.h"
 
+/* i2c_config_t.dev_backend */
+#define BSP_I2C_BACKEND_GPIO	0 /* Bit-bang on PB6/PB7 */
+#define BSP_I2C_BACKEND_HW	1 /* I2C1 peripheral with DMA (up to 400kHz) */
+
+#define BSP_I2C_DMA_SIZE_MAX	(256) /* DMA transfers are split in chunks */
+
 bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_i2c_master_deinit(bsp_dev_i2c_t dev_num);
 
@@ -37,4 +43,7 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data);
 void bsp_i2c_read_ack(bsp_dev_i2c_t dev_num, bool enable_ack);
 
+bsp_status_t bsp_i2c_master_write_buf(bsp_dev_i2c_t dev_num, uint8_t* tx_data, uint32_t nb_data, uint32_t* nb_ack);
+bsp_status_t bsp_i2c_master_read_buf(bsp_dev_i2c_t dev_num, uint8_t* rx_data, uint32_t nb_data);
+
 #endif /* _BSP_I2C_MASTER_H_ */
@@ -21,8 +21,18 @@ Warning in order to use this driver all GPIOs peripherals shall be enabled.
 #define MMC_TIMEOUT_MAX (100000) // About 10sec (see common/chconf.h/CH_CFG_ST_FREQUENCY) can be aborted by UBTN too
 #define NB_MMC (1)
 
+#define MMC_DATA_ERRORS (SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | SDIO_FLAG_RXOVERR | \
+			 SDIO_FLAG_TXUNDERR | SDIO_FLAG_STBITERR)
+
+typedef struct {
+	bool pending;
+	bool write;
+	uint32_t nb_blocks;
+} mmc_transfer_t;
+
 static MMC_HandleTypeDef mmc_handle[NB_MMC];
 static mode_config_proto_t* mmc_mode_conf[NB_MMC];
+static mmc_transfer_t mmc_transfer[NB_MMC];
 static volatile uint16_t dummy_read;
 
 /**
@@ -41,6 +51,7 @@ static void mmc_gpio_hw_init(bsp_dev_mmc_t dev_num)
 
 	/* Enable the MMC peripheral */
 	__SDIO_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
 
 	GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
 	GPIO_InitStructure.Pull  = GPIO_NOPULL;
@@ -129,6 +140,19 @@ bsp_status_t bsp_mmc_init(bsp_dev_mmc_t dev_num, mode_config_proto_t* mode_conf)
 	}
 
 	status = (bsp_status_t) HAL_MMC_InitCard(hmmc);
+	if(status != BSP_OK) {
+		return status;
+	}
+
+	/* HAL_MMC_InitCard() keeps the 400KHz identification clock */
+	hmmc->Init.ClockDiv = BSP_MMC_TRANSFER_CLK_DIV;
+	SDIO_Init(hmmc->Instance, hmmc->Init);
+
+	/* Block length is set once for all transfers */
+	if(SDMMC_CmdBlockLength(hmmc->Instance, BSP_MMC_BLOCK_LEN) != HAL_MMC_ERROR_NONE) {
+		return BSP_ERROR;
+	}
+	mmc_transfer[dev_num].pending = FALSE;
 
 	return status;
 }
@@ -145,6 +169,10 @@ bsp_status_t bsp_mmc_deinit(bsp_dev_mmc_t dev_num)
 
 	hmmc = &mmc_handle[dev_num];
 
+	if(mmc_transfer[dev_num].pending) {
+		bsp_mmc_wait_blocks(dev_num);
+	}
+
 	/* De-initialize the MMC comunication bus */
 	status = (bsp_status_t) HAL_MMC_DeInit(hmmc);
 
@@ -267,40 +295,268 @@ bsp_status_t bsp_mmc_get_info(bsp_dev_mmc_t dev_num, bsp_mmc_info_t * mmc_info)
 	return BSP_OK;
 }
 
+/* Start SDIO DMA stream with peripheral flow control */
+static void mmc_dma_start(uint8_t* data, uint32_t nb_blocks, uint32_t dir)
+{
+	DMA_Stream_TypeDef* stream = BSP_MMC_DMA_STREAM;
+
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_MMC_DMA_IFCR = BSP_MMC_DMA_FLAGS;
+
+	stream->PAR = (uint32_t)&BSP_MMC->FIFO;
+	stream->M0AR = (uint32_t)data;
+	stream->NDTR = (nb_blocks * BSP_MMC_BLOCK_LEN) / 4;
+	stream->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+	stream->CR = BSP_MMC_DMA_CHANNEL | DMA_SxCR_PL |
+		     DMA_SxCR_MBURST_0 | DMA_SxCR_PBURST_0 |
+		     DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+		     DMA_SxCR_MINC | DMA_SxCR_PFCTRL | dir;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+static void mmc_dma_stop(void)
+{
+	DMA_Stream_TypeDef* stream = BSP_MMC_DMA_STREAM;
+
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_MMC_DMA_IFCR = BSP_MMC_DMA_FLAGS;
+}
+
+static uint32_t mmc_block_addr(MMC_HandleTypeDef* hmmc, uint32_t block_number)
+{
+	if(hmmc->MmcCard.CardType != MMC_HIGH_CAPACITY_CARD) {
+		return block_number * BSP_MMC_BLOCK_LEN;
+	}
+	return block_number;
+}
+
+static void mmc_config_data(MMC_HandleTypeDef* hmmc, uint32_t nb_blocks, uint32_t dir)
+{
+	SDIO_DataInitTypeDef config;
+
+	__HAL_MMC_DMA_ENABLE(hmmc);
+
+	config.DataTimeOut   = SDMMC_DATATIMEOUT;
+	config.DataLength    = nb_blocks * BSP_MMC_BLOCK_LEN;
+	config.DataBlockSize = SDIO_DATABLOCK_SIZE_512B;
+	config.TransferDir   = dir;
+	config.TransferMode  = SDIO_TRANSFER_MODE_BLOCK;
+	config.DPSM          = SDIO_DPSM_ENABLE;
+	(void)SDIO_ConfigData(hmmc->Instance, &config);
+}
+
 /**
-  * @brief  Sends a Byte in blocking mode and return the status.
+  * @brief  Start a DMA read of nb_blocks (CMD17 or CMD18), does not wait end of transfer.
   * @param  dev_num: MMC dev num.
-  * @param  tx_data: data to send.
-  * @param  nb_data: Number of data to send.
-  * @retval status of the transfer.
+  * @param  rx_data: Data to receive (32bits aligned, not in CCM).
+  * @param  block_number: First block.
+  * @param  nb_blocks: Number of blocks to receive.
+  * @retval status of the transfer start, use bsp_mmc_wait_blocks() to get end status.
   */
-bsp_status_t bsp_mmc_write_block(bsp_dev_mmc_t dev_num, uint8_t* tx_data, uint32_t block_number)
+bsp_status_t bsp_mmc_read_blocks_start(bsp_dev_mmc_t dev_num, uint8_t* rx_data, uint32_t block_number, uint32_t nb_blocks)
 {
 	MMC_HandleTypeDef* hmmc;
-	bsp_status_t status;
+	uint32_t errorstate;
 
 	hmmc = &mmc_handle[dev_num];
 
-	status = (bsp_status_t) HAL_MMC_WriteBlocks(hmmc, tx_data, block_number, 1, MMC_TIMEOUT_MAX);
+	if((nb_blocks == 0) || ((block_number + nb_blocks) > hmmc->MmcCard.LogBlockNbr)) {
+		return BSP_ERROR;
+	}
 
-	return status;
+	hmmc->Instance->DCTRL = 0;
+	__HAL_MMC_CLEAR_FLAG(hmmc, SDIO_STATIC_FLAGS);
+
+	mmc_dma_start(rx_data, nb_blocks, 0);
+	mmc_config_data(hmmc, nb_blocks, SDIO_TRANSFER_DIR_TO_SDIO);
+
+	if(nb_blocks > 1) {
+		errorstate = SDMMC_CmdReadMultiBlock(hmmc->Instance, mmc_block_addr(hmmc, block_number));
+	} else {
+		errorstate = SDMMC_CmdReadSingleBlock(hmmc->Instance, mmc_block_addr(hmmc, block_number));
+	}
+	if(errorstate != HAL_MMC_ERROR_NONE) {
+		hmmc->Instance->DCTRL = 0;
+		mmc_dma_stop();
+		__HAL_MMC_CLEAR_FLAG(hmmc, SDIO_STATIC_FLAGS);
+		return BSP_ERROR;
+	}
+
+	mmc_transfer[dev_num].pending = TRUE;
+	mmc_transfer[dev_num].write = FALSE;
+	mmc_transfer[dev_num].nb_blocks = nb_blocks;
+
+	return BSP_OK;
 }
 
 /**
-  * @brief  Read a Byte in blocking mode and return the status.
+  * @brief  Start a DMA write of nb_blocks (CMD24 or CMD25), does not wait end of transfer.
+  * @param  dev_num: MMC dev num.
+  * @param  tx_data: Data to send (32bits aligned, not in CCM).
+  * @param  block_number: First block.
+  * @param  nb_blocks: Number of blocks to send.
+  * @retval status of the transfer start, use bsp_mmc_wait_blocks() to get end status.
+  */
+bsp_status_t bsp_mmc_write_blocks_start(bsp_dev_mmc_t dev_num, uint8_t* tx_data, uint32_t block_number, uint32_t nb_blocks)
+{
+	MMC_HandleTypeDef* hmmc;
+	uint32_t errorstate;
+
+	hmmc = &mmc_handle[dev_num];
+
+	if((nb_blocks == 0) || ((block_number + nb_blocks) > hmmc->MmcCard.LogBlockNbr)) {
+		return BSP_ERROR;
+	}
+
+	hmmc->Instance->DCTRL = 0;
+	__HAL_MMC_CLEAR_FLAG(hmmc, SDIO_STATIC_FLAGS);
+
+	if(nb_blocks > 1) {
+		errorstate = SDMMC_CmdWriteMultiBlock(hmmc->Instance, mmc_block_addr(hmmc, block_number));
+	} else {
+		errorstate = SDMMC_CmdWriteSingleBlock(hmmc->Instance, mmc_block_addr(hmmc, block_number));
+	}
+	if(errorstate != HAL_MMC_ERROR_NONE) {
+		__HAL_MMC_CLEAR_FLAG(hmmc, SDIO_STATIC_FLAGS);
+		return BSP_ERROR;
+	}
+
+	mmc_dma_start(tx_data, nb_blocks, DMA_SxCR_DIR_0);
+	mmc_config_data(hmmc, nb_blocks, SDIO_TRANSFER_DIR_TO_CARD);
+
+	mmc_transfer[dev_num].pending = TRUE;
+	mmc_transfer[dev_num].write = TRUE;
+	mmc_transfer[dev_num].nb_blocks = nb_blocks;
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Wait end of transfer started by bsp_mmc_read_blocks_start()/bsp_mmc_write_blocks_start().
   * @param  dev_num: MMC dev num.
-  * @param  rx_data: Data to receive.
-  * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_mmc_read_block(bsp_dev_mmc_t dev_num, uint8_t* rx_data, uint32_t block_number)
+bsp_status_t bsp_mmc_wait_blocks(bsp_dev_mmc_t dev_num)
 {
 	MMC_HandleTypeDef* hmmc;
+	mmc_transfer_t* transfer;
 	bsp_status_t status;
+	uint32_t tickstart;
 
 	hmmc = &mmc_handle[dev_num];
+	transfer = &mmc_transfer[dev_num];
+
+	if(!transfer->pending) {
+		return BSP_ERROR;
+	}
+
+	status = BSP_OK;
+	tickstart = HAL_GetTick();
+	while(!__HAL_MMC_GET_FLAG(hmmc, SDIO_FLAG_DATAEND | MMC_DATA_ERRORS)) {
+		if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+			status = BSP_TIMEOUT;
+			break;
+		}
+	}
+	if((status == BSP_OK) &&
+	   (__HAL_MMC_GET_FLAG(hmmc, MMC_DATA_ERRORS) || (BSP_MMC_DMA_ISR & BSP_MMC_DMA_ERRORS))) {
+		status = BSP_ERROR;
+	}
+
+	/* Read: DMA stream is disabled by SDIO (flow controller) when its FIFO is flushed */
+	if((status == BSP_OK) && !transfer->write) {
+		while(BSP_MMC_DMA_STREAM->CR & DMA_SxCR_EN) {
+			if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+				status = BSP_TIMEOUT;
+				break;
+			}
+		}
+	}
+
+	hmmc->Instance->DCTRL = 0;
+	mmc_dma_stop();
 
-	status = (bsp_status_t) HAL_MMC_ReadBlocks(hmmc, rx_data, block_number, 1, MMC_TIMEOUT_MAX);
+	if((transfer->nb_blocks > 1) || (status != BSP_OK)) {
+		if((SDMMC_CmdStopTransfer(hmmc->Instance) != HAL_MMC_ERROR_NONE) && (status == BSP_OK)) {
+			status = BSP_ERROR;
+		}
+	}
+	__HAL_MMC_CLEAR_FLAG(hmmc, SDIO_STATIC_FLAGS);
+
+	/* Write: wait end of programming */
+	if(transfer->write) {
+		while(HAL_MMC_GetCardState(hmmc) != HAL_MMC_CARD_TRANSFER) {
+			if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+				status = BSP_TIMEOUT;
+				break;
+			}
+		}
+	}
+	transfer->pending = FALSE;
 
 	return status;
 }
+
+/**
+  * @brief  Read blocks with DMA in blocking mode and return the status.
+  * @param  dev_num: MMC dev num.
+  * @param  rx_data: Data to receive (32bits aligned, not in CCM).
+  * @param  block_number: First block.
+  * @param  nb_blocks: Number of blocks to receive.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_mmc_read_blocks(bsp_dev_mmc_t dev_num, uint8_t* rx_data, uint32_t block_number, uint32_t nb_blocks)
+{
+	bsp_status_t status;
+
+	status = bsp_mmc_read_blocks_start(dev_num, rx_data, block_number, nb_blocks);
+	if(status != BSP_OK) {
+		return status;
+	}
+	return bsp_mmc_wait_blocks(dev_num);
+}
+
+/**
+  * @brief  Write blocks with DMA in blocking mode and return the status.
+  * @param  dev_num: MMC dev num.
+  * @param  tx_data: Data to send (32bits aligned, not in CCM).
+  * @param  block_number: First block.
+  * @param  nb_blocks: Number of blocks to send.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_mmc_write_blocks(bsp_dev_mmc_t dev_num, uint8_t* tx_data, uint32_t block_number, uint32_t nb_blocks)
+{
+	bsp_status_t status;
+
+	status = bsp_mmc_write_blocks_start(dev_num, tx_data, block_number, nb_blocks);
+	if(status != BSP_OK) {
+		return status;
+	}
+	return bsp_mmc_wait_blocks(dev_num);
+}
+
+/**
+  * @brief  Write one block in blocking mode and return the status.
+  * @param  dev_num: MMC dev num.
+  * @param  tx_data: data to send.
+  * @param  block_number: Block to write.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_mmc_write_block(bsp_dev_mmc_t dev_num, uint8_t* tx_data, uint32_t block_number)
+{
+	return bsp_mmc_write_blocks(dev_num, tx_data, block_number, 1);
+}
+
+/**
+  * @brief  Read one block in blocking mode and return the status.
+  * @param  dev_num: MMC dev num.
+  * @param  rx_data: Data to receive.
+  * @param  block_number: Block to read.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_mmc_read_block(bsp_dev_mmc_t dev_num, uint8_t* rx_data, uint32_t block_number)
+{
+	return bsp_mmc_read_blocks(dev_num, rx_data, block_number, 1);
+}
@@ -29,5 +29,15 @@ limitations under the License.
 /* MMC D0 */
 #define BSP_MMC_D0_PORT       GPIOC
 #define BSP_MMC_D0_PIN        GPIO_PIN_8  /* PC.08 */
+/* MMC clock after card init 48MHz / (SDIO_TRANSFER_CLK_DIV + 2) = 24MHz */
+#define BSP_MMC_TRANSFER_CLK_DIV SDIO_TRANSFER_CLK_DIV
+/* MMC DMA (DMA2 Stream3 Channel4, same as ChibiOS SDC driver which is stopped in MMC mode) */
+#define BSP_MMC_DMA_STREAM    DMA2_Stream3
+#define BSP_MMC_DMA_CHANNEL   (4U << DMA_SxCR_CHSEL_Pos)
+#define BSP_MMC_DMA_ISR       (DMA2->LISR)
+#define BSP_MMC_DMA_IFCR      (DMA2->LIFCR)
+#define BSP_MMC_DMA_FLAGS     (DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | \
+                               DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+#define BSP_MMC_DMA_ERRORS    (DMA_LISR_TEIF3 | DMA_LISR_DMEIF3)
 
 #endif /* _BSP_MMC_CONF_H_ */
@@ -0,0 +1,281 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014-2015 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "bsp_onewire.h"
+#include "bsp_onewire_conf.h"
+#include <string.h>
+
+/*
+Warning in order to use this driver all GPIOs peripherals shall be enabled.
+*/
+#define ONEWIRE_TIMEOUT_MAX (1000) // About 100ms (see common/chconf.h/CH_CFG_ST_FREQUENCY)
+#define NB_ONEWIRE (BSP_DEV_ONEWIRE_END)
+
+/*
+UART speeds (8N1, LSB first):
+Reset: 0xF0 at 9600 bauds => 520us low then 520us presence window.
+Overdrive reset: 0xE0 at 115200 bauds => 52us low then 35us presence window.
+Slots: 0x00 at 115200 bauds => 78us low (write 0), 0xFF => 8.7us low (write 1/read).
+Overdrive slots: 0x00 at 1Mbauds => 9us low (write 0), 0xFF => 1us low (write 1/read).
+The UART samples the read bit in the middle of bit 0 (13us or 1.5us after falling edge).
+*/
+#define ONEWIRE_RESET_BAUDRATE (9600)
+#define ONEWIRE_RESET_DATA (0xF0)
+#define ONEWIRE_SLOT_BAUDRATE (115200)
+#define ONEWIRE_OD_RESET_BAUDRATE (115200)
+#define ONEWIRE_OD_RESET_DATA (0xE0)
+#define ONEWIRE_OD_SLOT_BAUDRATE (1000000)
+
+static UART_HandleTypeDef onewire_handle[NB_ONEWIRE];
+static mode_config_proto_t* onewire_mode_conf[NB_ONEWIRE];
+static volatile uint16_t dummy_read;
+
+/* DMA buffer in main SRAM (DMA cannot access CCM where stacks can be) */
+static uint8_t onewire_dma_buf[BSP_ONEWIRE_SLOTS_MAX];
+
+/**
+  * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
+  * @param  dev_num: ONEWIRE dev num
+  * @retval None
+  */
+static void onewire_gpio_hw_init(bsp_dev_onewire_t dev_num)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+	mode_config_proto_t* mode_conf;
+
+	mode_conf = onewire_mode_conf[dev_num];
+
+	/* Enable the UART and DMA peripherals */
+	__USART3_CLK_ENABLE();
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	/* DQ is open drain, an external pull-up is recommended */
+	GPIO_InitStructure.Mode = GPIO_MODE_AF_OD;
+	if(mode_conf->config.onewire.dev_gpio_pull == MODE_CONFIG_DEV_GPIO_PULLUP)
+		GPIO_InitStructure.Pull = GPIO_PULLUP;
+	else
+		GPIO_InitStructure.Pull = GPIO_NOPULL;
+	GPIO_InitStructure.Speed = BSP_ONEWIRE1_GPIO_SPEED;
+	GPIO_InitStructure.Alternate = BSP_ONEWIRE1_AF;
+	GPIO_InitStructure.Pin = BSP_ONEWIRE1_DQ_PIN;
+	HAL_GPIO_Init(BSP_ONEWIRE1_DQ_PORT, &GPIO_InitStructure);
+}
+
+/**
+  * @brief  DeInit low level hardware: GPIO, CLOCK, NVIC...
+  * @param  dev_num: ONEWIRE dev num
+  * @retval None
+  */
+static void onewire_gpio_hw_deinit(bsp_dev_onewire_t dev_num)
+{
+	(void)dev_num;
+
+	/* Reset peripherals */
+	__USART3_FORCE_RESET();
+	__USART3_RELEASE_RESET();
+
+	/* Disable peripherals GPIO */
+	HAL_GPIO_DeInit(BSP_ONEWIRE1_DQ_PORT, BSP_ONEWIRE1_DQ_PIN);
+}
+
+static void onewire_set_baudrate(UART_HandleTypeDef* huart, uint32_t baudrate)
+{
+	/* Wait end of previous byte, oversampling by 16 */
+	while(!(huart->Instance->SR & USART_SR_TC));
+	huart->Instance->BRR = (HAL_RCC_GetPCLK1Freq() + (baudrate / 2)) / baudrate;
+}
+
+static void onewire_dma_start(DMA_Stream_TypeDef* stream, UART_HandleTypeDef* huart,
+			      uint32_t nb_slots, uint32_t dir)
+{
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+
+	stream->PAR = (uint32_t)&huart->Instance->DR;
+	stream->M0AR = (uint32_t)onewire_dma_buf;
+	stream->NDTR = nb_slots;
+	stream->FCR = 0;
+	stream->CR = BSP_ONEWIRE1_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MINC | dir;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+static void onewire_dma_stop(void)
+{
+	BSP_ONEWIRE1_DMA_TX_STREAM->CR &= ~DMA_SxCR_EN;
+	BSP_ONEWIRE1_DMA_RX_STREAM->CR &= ~DMA_SxCR_EN;
+	while(BSP_ONEWIRE1_DMA_TX_STREAM->CR & DMA_SxCR_EN);
+	while(BSP_ONEWIRE1_DMA_RX_STREAM->CR & DMA_SxCR_EN);
+	BSP_ONEWIRE1_DMA_IFCR = BSP_ONEWIRE1_DMA_FLAGS;
+}
+
+/* Flush RX data register and clear errors (SR read followed by DR read) */
+static void onewire_flush(UART_HandleTypeDef* huart)
+{
+	dummy_read = huart->Instance->SR;
+	dummy_read = huart->Instance->DR;
+}
+
+/**
+  * @brief  Init ONEWIRE device (USART in half-duplex mode).
+  * @param  dev_num: ONEWIRE dev num.
+  * @param  mode_conf: Mode config proto.
+  * @retval status: status of the init.
+  */
+bsp_status_t bsp_onewire_init(bsp_dev_onewire_t dev_num, mode_config_proto_t* mode_conf)
+{
+	UART_HandleTypeDef* huart;
+	bsp_status_t status;
+
+	onewire_mode_conf[dev_num] = mode_conf;
+	huart = &onewire_handle[dev_num];
+
+	onewire_gpio_hw_init(dev_num);
+
+	__HAL_UART_RESET_HANDLE_STATE(huart);
+
+	huart->Instance = BSP_ONEWIRE1;
+	if(mode_conf->config.onewire.dev_speed == BSP_ONEWIRE_SPEED_OVERDRIVE)
+		huart->Init.BaudRate = ONEWIRE_OD_SLOT_BAUDRATE;
+	else
+		huart->Init.BaudRate = ONEWIRE_SLOT_BAUDRATE;
+	huart->Init.WordLength = UART_WORDLENGTH_8B;
+	huart->Init.StopBits = UART_STOPBITS_1;
+	huart->Init.Parity = UART_PARITY_NONE;
+	huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+	huart->Init.Mode = UART_MODE_TX_RX;
+	huart->Init.OverSampling = UART_OVERSAMPLING_16;
+
+	status = (bsp_status_t) HAL_HalfDuplex_Init(huart);
+
+	onewire_dma_stop();
+	onewire_flush(huart);
+
+	return status;
+}
+
+/**
+  * @brief  De-initialize the ONEWIRE device.
+  * @param  dev_num: ONEWIRE dev num.
+  * @retval status: status of the deinit.
+  */
+bsp_status_t bsp_onewire_deinit(bsp_dev_onewire_t dev_num)
+{
+	UART_HandleTypeDef* huart;
+	bsp_status_t status;
+
+	huart = &onewire_handle[dev_num];
+
+	onewire_dma_stop();
+
+	status = (bsp_status_t) HAL_UART_DeInit(huart);
+
+	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
+	onewire_gpio_hw_deinit(dev_num);
+
+	return status;
+}
+
+/**
+  * @brief  Send a reset pulse and check for presence pulse.
+  * @param  dev_num: ONEWIRE dev num.
+  * @param  presence: set to TRUE if at least one device answered.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_onewire_reset(bsp_dev_onewire_t dev_num, bool* presence)
+{
+	UART_HandleTypeDef* huart;
+	bool overdrive;
+	uint32_t tickstart;
+	uint8_t reset_data, rx_data;
+
+	huart = &onewire_handle[dev_num];
+	overdrive = (onewire_mode_conf[dev_num]->config.onewire.dev_speed == BSP_ONEWIRE_SPEED_OVERDRIVE);
+	reset_data = overdrive ? ONEWIRE_OD_RESET_DATA : ONEWIRE_RESET_DATA;
+
+	*presence = FALSE;
+	onewire_set_baudrate(huart, overdrive ? ONEWIRE_OD_RESET_BAUDRATE : ONEWIRE_RESET_BAUDRATE);
+	onewire_flush(huart);
+
+	huart->Instance->DR = reset_data;
+	tickstart = HAL_GetTick();
+	while(!(huart->Instance->SR & USART_SR_RXNE)) {
+		if((HAL_GetTick() - tickstart) >= ONEWIRE_TIMEOUT_MAX) {
+			onewire_set_baudrate(huart, overdrive ? ONEWIRE_OD_SLOT_BAUDRATE : ONEWIRE_SLOT_BAUDRATE);
+			return BSP_TIMEOUT;
+		}
+	}
+	/* Framing error is expected when bus is shorted, the echo is 0 */
+	rx_data = huart->Instance->DR;
+
+	onewire_set_baudrate(huart, overdrive ? ONEWIRE_OD_SLOT_BAUDRATE : ONEWIRE_SLOT_BAUDRATE);
+
+	if(rx_data == 0) {
+		return BSP_ERROR;
+	}
+	*presence = (rx_data != reset_data);
+	return BSP_OK;
+}
+
+/**
+  * @brief  Run a batch of time slots with DMA (one UART byte per slot).
+  * @param  dev_num: ONEWIRE dev num.
+  * @param  slots: BSP_ONEWIRE_SLOT_0/BSP_ONEWIRE_SLOT_1 to send, replaced by the echo.
+  * @param  nb_slots: Number of slots (max BSP_ONEWIRE_SLOTS_MAX).
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_onewire_slots(bsp_dev_onewire_t dev_num, uint8_t* slots, uint32_t nb_slots)
+{
+	UART_HandleTypeDef* huart;
+	bsp_status_t status;
+	uint32_t tickstart;
+
+	if((nb_slots == 0) || (nb_slots > BSP_ONEWIRE_SLOTS_MAX)) {
+		return BSP_ERROR;
+	}
+
+	huart = &onewire_handle[dev_num];
+	memcpy(onewire_dma_buf, slots, nb_slots);
+
+	onewire_dma_stop();
+	onewire_flush(huart);
+
+	/*
+	The echo of slot i is written after TX DMA has read slot i+1,
+	so the same buffer is used for TX and RX.
+	*/
+	onewire_dma_start(BSP_ONEWIRE1_DMA_RX_STREAM, huart, nb_slots, 0);
+	onewire_dma_start(BSP_ONEWIRE1_DMA_TX_STREAM, huart, nb_slots, DMA_SxCR_DIR_0);
+	huart->Instance->CR3 |= (USART_CR3_DMAR | USART_CR3_DMAT);
+
+	status = BSP_OK;
+	tickstart = HAL_GetTick();
+	while(!(BSP_ONEWIRE1_DMA_ISR & (BSP_ONEWIRE1_DMA_RX_DONE | BSP_ONEWIRE1_DMA_ERRORS))) {
+		if((HAL_GetTick() - tickstart) >= ONEWIRE_TIMEOUT_MAX) {
+			status = BSP_TIMEOUT;
+			break;
+		}
+	}
+	if((status == BSP_OK) && (BSP_ONEWIRE1_DMA_ISR & BSP_ONEWIRE1_DMA_ERRORS)) {
+		status = BSP_ERROR;
+	}
+
+	huart->Instance->CR3 &= ~(USART_CR3_DMAR | USART_CR3_DMAT);
+	onewire_dma_stop();
+
+	if(status == BSP_OK) {
+		memcpy(slots, onewire_dma_buf, nb_slots);
+	}
+	return status;
+}
@@ -0,0 +1,46 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014-2015 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _BSP_ONEWIRE_H_
+#define _BSP_ONEWIRE_H_
+
+#include "bsp.h"
+#include "mode_config.h"
+
+typedef enum {
+	BSP_DEV_ONEWIRE1 = 0,
+	BSP_DEV_ONEWIRE_END = 1
+} bsp_dev_onewire_t;
+
+#define BSP_ONEWIRE_SPEED_STANDARD	0
+#define BSP_ONEWIRE_SPEED_OVERDRIVE	1
+
+/*
+Each 1-Wire time slot is one UART byte, the echo of the byte is the bus state:
+write 0 slot sends BSP_ONEWIRE_SLOT_0.
+write 1 or read slot sends BSP_ONEWIRE_SLOT_1, read bit is 1 if echo is BSP_ONEWIRE_SLOT_1.
+*/
+#define BSP_ONEWIRE_SLOT_0	(0x00)
+#define BSP_ONEWIRE_SLOT_1	(0xFF)
+
+/* Max number of slots per bsp_onewire_slots() call (16 bytes) */
+#define BSP_ONEWIRE_SLOTS_MAX	(128)
+
+bsp_status_t bsp_onewire_init(bsp_dev_onewire_t dev_num, mode_config_proto_t* mode_conf);
+bsp_status_t bsp_onewire_deinit(bsp_dev_onewire_t dev_num);
+
+bsp_status_t bsp_onewire_reset(bsp_dev_onewire_t dev_num, bool* presence);
+bsp_status_t bsp_onewire_slots(bsp_dev_onewire_t dev_num, uint8_t* slots, uint32_t nb_slots);
+
+#endif /* _BSP_ONEWIRE_H_ */
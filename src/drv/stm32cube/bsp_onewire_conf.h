@@ -0,0 +1,46 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014-2015 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BSP_ONEWIRE_CONF_H_
+#define _BSP_ONEWIRE_CONF_H_
+
+/* ONEWIRE1 (USART3 half-duplex, only TX pin is used) */
+#define BSP_ONEWIRE1             USART3
+#define BSP_ONEWIRE1_GPIO_SPEED  GPIO_SPEED_FAST
+#define BSP_ONEWIRE1_AF          GPIO_AF7_USART3
+/* ONEWIRE1 DQ (USART3 TX, shared with SPI2 SCK) */
+#define BSP_ONEWIRE1_DQ_PORT     GPIOB
+#define BSP_ONEWIRE1_DQ_PIN      GPIO_PIN_10 /* PB.10 */
+
+/*
+USART3 RX DMA1 Stream1 Channel4
+USART3 TX DMA1 Stream3 Channel4
+Conflict with mcuconf.h => #define STM32_SPI_SPI2_RX_DMA_STREAM STM32_DMA_STREAM_ID(1, 3)
+(SPI2 cannot be used at same time as its SCK pin is the 1-Wire DQ pin)
+*/
+#define BSP_ONEWIRE1_DMA_RX_STREAM  DMA1_Stream1
+#define BSP_ONEWIRE1_DMA_TX_STREAM  DMA1_Stream3
+#define BSP_ONEWIRE1_DMA_CHANNEL    (4U << DMA_SxCR_CHSEL_Pos)
+#define BSP_ONEWIRE1_DMA_ISR        (DMA1->LISR)
+#define BSP_ONEWIRE1_DMA_IFCR       (DMA1->LIFCR)
+#define BSP_ONEWIRE1_DMA_FLAGS      (DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | \
+                                     DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1 | \
+                                     DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | \
+                                     DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+#define BSP_ONEWIRE1_DMA_RX_DONE    (DMA_LISR_TCIF1)
+#define BSP_ONEWIRE1_DMA_ERRORS     (DMA_LISR_TEIF1 | DMA_LISR_DMEIF1 | \
+                                     DMA_LISR_TEIF3 | DMA_LISR_DMEIF3)
+
+#endif /* _BSP_ONEWIRE_CONF_H_ */
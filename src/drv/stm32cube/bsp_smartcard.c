@@ -15,6 +15,7 @@ limitations under the License.
 #include "bsp_smartcard.h"
 #include "bsp_smartcard_conf.h"
 #include "bsp_gpio.h"
+#include <string.h>
 
 /*
 Warning in order to use this driver all GPIOs peripherals shall be enabled.
@@ -47,8 +48,9 @@ static void smartcard_gpio_hw_init(bsp_dev_smartcard_t dev_num)
 	GPIO_InitTypeDef GPIO_InitStructure;
 
 
-	/* Enable the SMARTCARD peripheral */
+	/* Enable the SMARTCARD and DMA peripherals */
 	__USART1_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
 
 	/* SMARTCARD1 CLK pin configuration */
 	GPIO_InitStructure.Pin = BSP_SMARTCARD1_CLK_PIN;
@@ -225,13 +227,22 @@ bsp_status_t bsp_smartcard_deinit(bsp_dev_smartcard_t dev_num)
   * @param  nb_data: Number of data to send.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint32_t nb_data)
 {
 	SMARTCARD_HandleTypeDef* hsmartcard;
 	hsmartcard = &smartcard_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_SMARTCARD_Transmit(hsmartcard, tx_data, nb_data, SMARTCARDx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SMARTCARD_Transmit(hsmartcard, tx_data, size, SMARTCARDx_TIMEOUT_MAX);
+		tx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		smartcard_error(dev_num);
 	}
@@ -245,14 +256,22 @@ bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_dat
   * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint32_t nb_data)
 {
 	SMARTCARD_HandleTypeDef* hsmartcard;
 	hsmartcard = &smartcard_handle[dev_num];
 
 	bsp_status_t status;
+	uint16_t size;
 	__HAL_SMARTCARD_FLUSH_DRREGISTER(hsmartcard);
-	status = (bsp_status_t) HAL_SMARTCARD_Receive(hsmartcard, rx_data, nb_data, SMARTCARDx_TIMEOUT_MAX);
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SMARTCARD_Receive(hsmartcard, rx_data, size, SMARTCARDx_TIMEOUT_MAX);
+		rx_data += size;
+		nb_data -= size;
+	}
 
 	if(status != BSP_OK) {
 		smartcard_error(dev_num);
@@ -295,17 +314,27 @@ bsp_status_t bsp_smartcard_read_u8_timeout(bsp_dev_smartcard_t dev_num, uint8_t*
   * @param  nb_data: Number of data to send & receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data)
 {
 	SMARTCARD_HandleTypeDef* hsmartcard;
 	hsmartcard = &smartcard_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_SMARTCARD_Transmit(hsmartcard, tx_data, nb_data, SMARTCARDx_TIMEOUT_MAX);
-	if(status == BSP_OK) {
-		status = (bsp_status_t) HAL_SMARTCARD_Receive(hsmartcard, rx_data, nb_data, SMARTCARDx_TIMEOUT_MAX);
-	} else {
-		smartcard_error(dev_num);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SMARTCARD_Transmit(hsmartcard, tx_data, size, SMARTCARDx_TIMEOUT_MAX);
+		if(status != BSP_OK) {
+			smartcard_error(dev_num);
+			break;
+		}
+		status = (bsp_status_t) HAL_SMARTCARD_Receive(hsmartcard, rx_data, size, SMARTCARDx_TIMEOUT_MAX);
+		tx_data += size;
+		rx_data += size;
+		nb_data -= size;
 	}
 	return status;
 }
@@ -430,3 +459,179 @@ float bsp_smartcard_get_clk_frequency(bsp_dev_smartcard_t dev_num)
 	return HAL_RCC_GetPCLK2Freq() / (hsmartcard->Init.Prescaler * 2);
 }
 
+
+static void smartcard_dma_start(DMA_Stream_TypeDef* stream, SMARTCARD_HandleTypeDef* hsmartcard,
+				uint8_t* data, uint32_t nb_data, uint32_t dir)
+{
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+
+	stream->PAR = (uint32_t)&hsmartcard->Instance->DR;
+	stream->M0AR = (uint32_t)data;
+	stream->NDTR = nb_data;
+	stream->FCR = 0;
+	stream->CR = BSP_SMARTCARD1_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MINC | dir;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+static void smartcard_dma_stop(DMA_Stream_TypeDef* stream)
+{
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+}
+
+/* DMA buffer in main SRAM (DMA cannot access CCM where stacks can be) */
+static uint8_t smartcard_dma_buf[BSP_SMARTCARD_DMA_SIZE_MAX];
+
+/**
+  * @brief  Sends bytes with DMA and wait end of transmission.
+  * @param  dev_num: SMARTCARD dev num.
+  * @param  tx_data: data to send.
+  * @param  nb_data: Number of data to send (max BSP_SMARTCARD_DMA_SIZE_MAX).
+  * @retval status of the transfer, BSP_BUSY if DMA stream is used by UART1.
+  */
+bsp_status_t bsp_smartcard_write_dma(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint32_t nb_data)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	bsp_status_t status;
+	uint32_t tickstart;
+
+	if((nb_data == 0) || (nb_data > BSP_SMARTCARD_DMA_SIZE_MAX)) {
+		return BSP_ERROR;
+	}
+	/* Stream used by UART1/LIN (see bsp_smartcard_conf.h) */
+	if(BSP_SMARTCARD1_DMA_TX_STREAM->CR & DMA_SxCR_EN) {
+		return BSP_BUSY;
+	}
+	hsmartcard = &smartcard_handle[dev_num];
+	memcpy(smartcard_dma_buf, tx_data, nb_data);
+
+	/* Receiver is disabled during transmission to not receive the echo */
+	hsmartcard->Instance->CR1 &= ~USART_CR1_RE;
+	__HAL_SMARTCARD_CLEAR_FLAG(hsmartcard, SMARTCARD_FLAG_TC);
+	BSP_SMARTCARD1_DMA_TX_IFCR = BSP_SMARTCARD1_DMA_TX_FLAGS;
+	smartcard_dma_start(BSP_SMARTCARD1_DMA_TX_STREAM, hsmartcard,
+			    smartcard_dma_buf, nb_data, DMA_SxCR_DIR_0);
+	hsmartcard->Instance->CR3 |= USART_CR3_DMAT;
+
+	status = BSP_OK;
+	tickstart = HAL_GetTick();
+	while(!(BSP_SMARTCARD1_DMA_TX_ISR & (BSP_SMARTCARD1_DMA_TX_DONE | BSP_SMARTCARD1_DMA_TX_ERRORS)) ||
+	      !(hsmartcard->Instance->SR & USART_SR_TC)) {
+		if(BSP_SMARTCARD1_DMA_TX_ISR & BSP_SMARTCARD1_DMA_TX_ERRORS) {
+			status = BSP_ERROR;
+			break;
+		}
+		if((HAL_GetTick() - tickstart) >= SMARTCARDx_TIMEOUT_MAX) {
+			status = BSP_TIMEOUT;
+			break;
+		}
+	}
+
+	hsmartcard->Instance->CR3 &= ~USART_CR3_DMAT;
+	smartcard_dma_stop(BSP_SMARTCARD1_DMA_TX_STREAM);
+	BSP_SMARTCARD1_DMA_TX_IFCR = BSP_SMARTCARD1_DMA_TX_FLAGS;
+	hsmartcard->Instance->CR1 |= USART_CR1_RE;
+
+	if(status != BSP_OK) {
+		smartcard_error(dev_num);
+	}
+	return status;
+}
+
+/**
+  * @brief  Receive bytes with DMA until nb_data are received or timeout.
+  * @param  dev_num: SMARTCARD dev num.
+  * @param  rx_data: Data to receive.
+  * @param  nb_data: Number of data to receive (max BSP_SMARTCARD_DMA_SIZE_MAX).
+  * @param  timeout: Number of ticks to wait for all data
+  * @retval Number of bytes received
+  */
+uint32_t bsp_smartcard_read_dma(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint32_t nb_data, uint32_t timeout)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	uint32_t tickstart, nb_rx;
+
+	if((nb_data == 0) || (nb_data > BSP_SMARTCARD_DMA_SIZE_MAX)) {
+		return 0;
+	}
+	/* Stream used by UART1/LIN RX ring (see bsp_smartcard_conf.h) */
+	if(BSP_SMARTCARD1_DMA_RX_STREAM->CR & DMA_SxCR_EN) {
+		return 0;
+	}
+	hsmartcard = &smartcard_handle[dev_num];
+
+	BSP_SMARTCARD1_DMA_RX_IFCR = BSP_SMARTCARD1_DMA_RX_FLAGS;
+	smartcard_dma_start(BSP_SMARTCARD1_DMA_RX_STREAM, hsmartcard,
+			    smartcard_dma_buf, nb_data, 0);
+	hsmartcard->Instance->CR3 |= USART_CR3_DMAR;
+
+	tickstart = HAL_GetTick();
+	while(BSP_SMARTCARD1_DMA_RX_STREAM->NDTR > 0) {
+		if((HAL_GetTick() - tickstart) >= timeout) {
+			break;
+		}
+	}
+
+	hsmartcard->Instance->CR3 &= ~USART_CR3_DMAR;
+	smartcard_dma_stop(BSP_SMARTCARD1_DMA_RX_STREAM);
+	BSP_SMARTCARD1_DMA_RX_IFCR = BSP_SMARTCARD1_DMA_RX_FLAGS;
+
+	nb_rx = nb_data - BSP_SMARTCARD1_DMA_RX_STREAM->NDTR;
+	memcpy(rx_data, smartcard_dma_buf, nb_rx);
+	return nb_rx;
+}
+
+/**
+ * @brief Set the ETU to Fi/Di clock cycles (after ATR or PPS).
+ * @param dev_num bsp_dev_smartcard_t
+ * @param fi clock rate conversion integer
+ * @param di baud rate adjustment integer
+ * @return status BSP_ERROR if ETU cannot be reached
+ *
+ */
+bsp_status_t bsp_smartcard_set_etu(bsp_dev_smartcard_t dev_num, uint32_t fi, uint32_t di)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	uint32_t brr;
+
+	hsmartcard = &smartcard_handle[dev_num];
+	if((fi == 0) || (di == 0)) {
+		return BSP_ERROR;
+	}
+
+	/*
+	CLK = PCLK2 / (2 * Prescaler), 1 ETU = Fi / Di CLK cycles
+	BRR (USARTDIV * 16 with oversampling by 16) = PCLK2 / baudrate = 2 * Prescaler * Fi / Di
+	*/
+	brr = ((2 * hsmartcard->Init.Prescaler * fi) + (di / 2)) / di;
+	if(brr < 16) {
+		return BSP_ERROR;
+	}
+
+	while(!(hsmartcard->Instance->SR & USART_SR_TC));
+	hsmartcard->Instance->BRR = brr;
+	hsmartcard->Init.BaudRate = bsp_smartcard_get_final_baudrate(dev_num);
+	smartcard_mode_conf[dev_num]->config.smartcard.dev_speed = hsmartcard->Init.BaudRate;
+
+	return BSP_OK;
+}
+
+/**
+ * @brief Enable/disable NACK on parity error (T=0 only, T=1 uses EDC)
+ * @param dev_num bsp_dev_smartcard_t
+ * @param state 1 to enable NACK
+ *
+ */
+void bsp_smartcard_set_nack(bsp_dev_smartcard_t dev_num, uint8_t state)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+
+	hsmartcard = &smartcard_handle[dev_num];
+	if(state) {
+		hsmartcard->Instance->CR3 |= USART_CR3_NACK;
+	} else {
+		hsmartcard->Instance->CR3 &= ~USART_CR3_NACK;
+	}
+}
@@ -26,15 +26,23 @@ typedef enum {
 bsp_status_t bsp_smartcard_init(bsp_dev_smartcard_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_smartcard_deinit(bsp_dev_smartcard_t dev_num);
 
-bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t nb_data);
-bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint32_t nb_data);
+bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint32_t nb_data);
 
 bsp_status_t bsp_smartcard_read_u8_timeout(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint8_t nb_data, uint32_t timeout);
-bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data);
 bsp_status_t bsp_smartcard_rxne(bsp_dev_smartcard_t dev_num);
 
 uint32_t bsp_smartcard_get_final_baudrate(bsp_dev_smartcard_t dev_num);
 
+/* Max bytes per bsp_smartcard_write_dma()/bsp_smartcard_read_dma() (T=1 block size) */
+#define BSP_SMARTCARD_DMA_SIZE_MAX (260)
+
+bsp_status_t bsp_smartcard_write_dma(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint32_t nb_data);
+uint32_t bsp_smartcard_read_dma(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint32_t nb_data, uint32_t timeout);
+bsp_status_t bsp_smartcard_set_etu(bsp_dev_smartcard_t dev_num, uint32_t fi, uint32_t di);
+void bsp_smartcard_set_nack(bsp_dev_smartcard_t dev_num, uint8_t state);
+
 uint8_t bsp_smartcard_get_cd(bsp_dev_smartcard_t dev_num);
 
 uint8_t bsp_smartcard_get_rst(bsp_dev_smartcard_t dev_num);
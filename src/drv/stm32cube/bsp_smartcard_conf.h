@@ -41,4 +41,24 @@ limitations under the License.
 #define BSP_SMARTCARD1_TX_PORT     GPIOB
 #define BSP_SMARTCARD1_TX_PIN      GPIO_PIN_6  /* PB.06 */
 
+/*
+USART1 RX DMA2 Stream2 Channel4
+USART1 TX DMA2 Stream7 Channel4
+Conflict with mcuconf.h => #define STM32_ADC_ADC2_DMA_STREAM STM32_DMA_STREAM_ID(2, 2)
+Same streams as bsp_uart_conf.h => BSP_UART1_DMA_RX_STREAM/BSP_UART1_DMA_TX_STREAM
+(UART1 RX ring and LIN), a running stream is not taken (BSP_BUSY)
+*/
+#define BSP_SMARTCARD1_DMA_RX_STREAM  DMA2_Stream2
+#define BSP_SMARTCARD1_DMA_TX_STREAM  DMA2_Stream7
+#define BSP_SMARTCARD1_DMA_CHANNEL    (4U << DMA_SxCR_CHSEL_Pos)
+#define BSP_SMARTCARD1_DMA_RX_IFCR    (DMA2->LIFCR)
+#define BSP_SMARTCARD1_DMA_RX_FLAGS   (DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | \
+                                       DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2)
+#define BSP_SMARTCARD1_DMA_TX_ISR     (DMA2->HISR)
+#define BSP_SMARTCARD1_DMA_TX_IFCR    (DMA2->HIFCR)
+#define BSP_SMARTCARD1_DMA_TX_FLAGS   (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | \
+                                       DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
+#define BSP_SMARTCARD1_DMA_TX_DONE    (DMA_HISR_TCIF7)
+#define BSP_SMARTCARD1_DMA_TX_ERRORS  (DMA_HISR_TEIF7 | DMA_HISR_DMEIF7)
+
 #endif /* _BSP_SMARTCARD_CONF_H_ */
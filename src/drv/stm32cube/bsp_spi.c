@@ -305,13 +305,22 @@ uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num)
   * @param  nb_data: Number of data to send.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint32_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_SPI_Transmit(hspi, tx_data, nb_data, SPIx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SPI_Transmit(hspi, tx_data, size, SPIx_TIMEOUT_MAX);
+		tx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
@@ -325,13 +334,22 @@ bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t n
   * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint32_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_SPI_Receive(hspi, rx_data, nb_data, SPIx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SPI_Receive(hspi, rx_data, size, SPIx_TIMEOUT_MAX);
+		rx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
@@ -345,13 +363,23 @@ bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb
   * @param  nb_data: Number of data to send & receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_SPI_TransmitReceive(hspi, tx_data, rx_data, nb_data, SPIx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_SPI_TransmitReceive(hspi, tx_data, rx_data, size, SPIx_TIMEOUT_MAX);
+		tx_data += size;
+		rx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
@@ -32,8 +32,8 @@ void bsp_spi_unselect(bsp_dev_spi_t dev_num);
 uint8_t bsp_spi_get_cs(bsp_dev_spi_t dev_num);
 uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num);
 
-bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t nb_data);
-bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb_data);
-bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint32_t nb_data);
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint32_t nb_data);
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data);
 
 #endif /* _BSP_SPI_H_ */
@@ -25,6 +25,29 @@ Warning in order to use this driver all GPIOs peripherals shall be enabled.
 #define CLOCK_DIV8 (8)
 #define CLOCK_DIV16 (16)
 
+typedef struct {
+	DMA_Stream_TypeDef* rx_stream;
+	DMA_Stream_TypeDef* tx_stream;
+	uint32_t channel;
+	volatile uint32_t* rx_ifcr;
+	uint32_t rx_flags;
+	volatile uint32_t* tx_ifcr;
+	uint32_t tx_flags;
+} uart_dma_t;
+
+static const uart_dma_t uart_dma[NB_UART] = {
+	{
+		BSP_UART1_DMA_RX_STREAM, BSP_UART1_DMA_TX_STREAM, BSP_UART1_DMA_CHANNEL,
+		&BSP_UART1_DMA_RX_IFCR, BSP_UART1_DMA_RX_FLAGS,
+		&BSP_UART1_DMA_TX_IFCR, BSP_UART1_DMA_TX_FLAGS
+	},
+	{
+		BSP_UART2_DMA_RX_STREAM, BSP_UART2_DMA_TX_STREAM, BSP_UART2_DMA_CHANNEL,
+		&BSP_UART2_DMA_RX_IFCR, BSP_UART2_DMA_RX_FLAGS,
+		&BSP_UART2_DMA_TX_IFCR, BSP_UART2_DMA_TX_FLAGS
+	},
+};
+
 static UART_HandleTypeDef uart_handle[NB_UART];
 static mode_config_proto_t* uart_mode_conf[NB_UART];
 static volatile uint16_t dummy_read;
@@ -212,6 +235,134 @@ bsp_status_t bsp_lin_break(bsp_dev_uart_t dev_num)
 	return status;
 }
 
+/**
+  * @brief  Return and clear LIN break detection flag, can be called from ISR.
+  * @param  dev_num: UART dev num.
+  * @retval TRUE if a break was received since last call.
+  */
+bool bsp_lin_break_detected(bsp_dev_uart_t dev_num)
+{
+	USART_TypeDef* usart;
+
+	usart = uart_handle[dev_num].Instance;
+	if(!(usart->SR & USART_SR_LBD))
+		return FALSE;
+	usart->SR = ~USART_SR_LBD;
+	return TRUE;
+}
+
+static void uart_dma_stream_stop(DMA_Stream_TypeDef* stream)
+{
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+}
+
+/**
+  * @brief  Start UART RX DMA in circular mode.
+  * @param  dev_num: UART dev num.
+  * @param  rx_buf: Ring buffer (shall be in main SRAM).
+  * @param  size: Ring buffer size.
+  * @retval status: BSP_BUSY if stream is running with another buffer.
+  */
+bsp_status_t bsp_uart_dma_rx_start(bsp_dev_uart_t dev_num, uint8_t* rx_buf, uint32_t size)
+{
+	UART_HandleTypeDef* huart;
+	const uart_dma_t* dma;
+
+	huart = &uart_handle[dev_num];
+	dma = &uart_dma[dev_num];
+
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	/* Stream running for another buffer/driver (see bsp_uart_conf.h) */
+	if((dma->rx_stream->CR & DMA_SxCR_EN) &&
+	   (dma->rx_stream->M0AR != (uint32_t)rx_buf)) {
+		return BSP_BUSY;
+	}
+	uart_dma_stream_stop(dma->rx_stream);
+	*dma->rx_ifcr = dma->rx_flags;
+
+	/* Clear pending overrun */
+	dummy_read = huart->Instance->SR;
+	dummy_read = huart->Instance->DR;
+
+	dma->rx_stream->PAR = (uint32_t)&huart->Instance->DR;
+	dma->rx_stream->M0AR = (uint32_t)rx_buf;
+	dma->rx_stream->NDTR = size;
+	dma->rx_stream->CR = dma->channel | DMA_SxCR_PL_1 |
+			     DMA_SxCR_MINC | DMA_SxCR_CIRC;
+	dma->rx_stream->CR |= DMA_SxCR_EN;
+	huart->Instance->CR3 |= (USART_CR3_DMAR | USART_CR3_DMAT);
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Bytes remaining before RX DMA wraps (see bsp_uart_dma_rx_start()).
+  * @param  dev_num: UART dev num.
+  * @retval Remaining bytes.
+  */
+uint32_t bsp_uart_dma_rx_remaining(bsp_dev_uart_t dev_num)
+{
+	return uart_dma[dev_num].rx_stream->NDTR;
+}
+
+/**
+  * @brief  Start a TX DMA transfer, can be called from ISR.
+  * @param  dev_num: UART dev num.
+  * @param  tx_buf: Data (shall be in main SRAM and kept until end of transfer).
+  * @param  nb_data: Number of bytes.
+  * @param  lin_break: Send a LIN break before data.
+  * @retval status: BSP_BUSY if previous transfer is not finished.
+  */
+bsp_status_t bsp_uart_dma_tx(bsp_dev_uart_t dev_num, uint8_t* tx_buf, uint32_t nb_data,
+			     bool lin_break)
+{
+	UART_HandleTypeDef* huart;
+	const uart_dma_t* dma;
+
+	huart = &uart_handle[dev_num];
+	dma = &uart_dma[dev_num];
+
+	if(dma->tx_stream->CR & DMA_SxCR_EN)
+		return BSP_BUSY;
+	*dma->tx_ifcr = dma->tx_flags;
+
+	/* Break is sent after current character, then DMA data */
+	if(lin_break)
+		huart->Instance->CR1 |= USART_CR1_SBK;
+
+	dma->tx_stream->PAR = (uint32_t)&huart->Instance->DR;
+	dma->tx_stream->M0AR = (uint32_t)tx_buf;
+	dma->tx_stream->NDTR = nb_data;
+	dma->tx_stream->CR = dma->channel | DMA_SxCR_PL_1 |
+			     DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+	dma->tx_stream->CR |= DMA_SxCR_EN;
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Stop RX and TX DMA (see bsp_uart_dma_rx_start()).
+  * @param  dev_num: UART dev num.
+  * @retval None
+  */
+void bsp_uart_dma_stop(bsp_dev_uart_t dev_num)
+{
+	UART_HandleTypeDef* huart;
+	const uart_dma_t* dma;
+
+	huart = &uart_handle[dev_num];
+	dma = &uart_dma[dev_num];
+
+	huart->Instance->CR3 &= ~(USART_CR3_DMAR | USART_CR3_DMAT);
+	uart_dma_stream_stop(dma->rx_stream);
+	uart_dma_stream_stop(dma->tx_stream);
+	*dma->rx_ifcr = dma->rx_flags;
+	*dma->tx_ifcr = dma->tx_flags;
+}
+
 /**
   * @brief  De-initialize the UART comunication bus
   * @param  dev_num: UART dev num.
@@ -240,13 +391,22 @@ bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num)
   * @param  nb_data: Number of data to send.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint32_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, nb_data, UARTx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, size, UARTx_TIMEOUT_MAX);
+		tx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		uart_error(dev_num);
 	}
@@ -260,13 +420,22 @@ bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t
   * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint32_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, nb_data, UARTx_TIMEOUT_MAX);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, size, UARTx_TIMEOUT_MAX);
+		rx_data += size;
+		nb_data -= size;
+	}
 	if(status != BSP_OK) {
 		uart_error(dev_num);
 	}
@@ -307,17 +476,27 @@ bsp_status_t bsp_uart_read_u8_timeout(bsp_dev_uart_t dev_num, uint8_t* rx_data,
   * @param  nb_data: Number of data to send & receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
-	status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, nb_data, UARTx_TIMEOUT_MAX);
-	if(status == BSP_OK) {
-		status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, nb_data, UARTx_TIMEOUT_MAX);
-	} else {
-		uart_error(dev_num);
+	uint16_t size;
+
+	status = BSP_OK;
+	while((nb_data > 0) && (status == BSP_OK)) {
+		/* HAL transfer size is 16bits */
+		size = (nb_data > UINT16_MAX) ? UINT16_MAX : nb_data;
+		status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, size, UARTx_TIMEOUT_MAX);
+		if(status != BSP_OK) {
+			uart_error(dev_num);
+			break;
+		}
+		status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, size, UARTx_TIMEOUT_MAX);
+		tx_data += size;
+		rx_data += size;
+		nb_data -= size;
 	}
 	return status;
 }
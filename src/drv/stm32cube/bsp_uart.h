@@ -32,14 +32,22 @@ typedef enum {
 bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num);
 
-bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t nb_data);
-bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint32_t nb_data);
+bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint32_t nb_data);
 bsp_status_t bsp_uart_read_u8_timeout(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data, uint32_t timeout);
-bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint32_t nb_data);
 bsp_status_t bsp_uart_rxne(bsp_dev_uart_t dev_num);
 
 uint32_t bsp_uart_get_final_baudrate(bsp_dev_uart_t dev_num);
 
 bsp_status_t bsp_lin_break(bsp_dev_uart_t dev_num);
+bool bsp_lin_break_detected(bsp_dev_uart_t dev_num);
+
+/* DMA transfers, used by LIN scheduler (see bsp_uart_conf.h for DMA streams) */
+bsp_status_t bsp_uart_dma_rx_start(bsp_dev_uart_t dev_num, uint8_t* rx_buf, uint32_t size);
+uint32_t bsp_uart_dma_rx_remaining(bsp_dev_uart_t dev_num);
+bsp_status_t bsp_uart_dma_tx(bsp_dev_uart_t dev_num, uint8_t* tx_buf, uint32_t nb_data,
+			     bool lin_break);
+void bsp_uart_dma_stop(bsp_dev_uart_t dev_num);
 
 #endif /* _BSP_UART_H_ */
@@ -26,6 +26,25 @@ limitations under the License.
 /* UART1 RX */
 #define BSP_UART1_RX_PORT     GPIOA
 #define BSP_UART1_RX_PIN      GPIO_PIN_10  /* PA.10 */
+/*
+UART1 RX DMA2 Stream2 Channel4
+UART1 TX DMA2 Stream7 Channel4
+Same streams as mcuconf.h => STM32_UART_USART1_RX_DMA_STREAM/STM32_UART_USART1_TX_DMA_STREAM
+Conflict with mcuconf.h => #define STM32_ADC_ADC2_DMA_STREAM STM32_DMA_STREAM_ID(2, 2)
+Same streams as bsp_smartcard_conf.h (USART1) => BSP_SMARTCARD1_DMA_RX_STREAM/BSP_SMARTCARD1_DMA_TX_STREAM
+(LIN/UART RX ring runs until stopped, smartcard DMA returns BSP_BUSY while
+it runs and bsp_uart_dma_rx_start() returns BSP_BUSY during a smartcard
+transfer)
+*/
+#define BSP_UART1_DMA_RX_STREAM  DMA2_Stream2
+#define BSP_UART1_DMA_TX_STREAM  DMA2_Stream7
+#define BSP_UART1_DMA_CHANNEL    (4U << DMA_SxCR_CHSEL_Pos)
+#define BSP_UART1_DMA_RX_IFCR    (DMA2->LIFCR)
+#define BSP_UART1_DMA_RX_FLAGS   (DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | \
+                                  DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2)
+#define BSP_UART1_DMA_TX_IFCR    (DMA2->HIFCR)
+#define BSP_UART1_DMA_TX_FLAGS   (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | \
+                                  DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
 
 /* UART2 */
 #define BSP_UART2              USART2
@@ -37,5 +56,20 @@ limitations under the License.
 /* UART2 RX */
 #define BSP_UART2_RX_PORT     GPIOA
 #define BSP_UART2_RX_PIN      GPIO_PIN_3 /* PA.03 */
+/*
+UART2 RX DMA1 Stream5 Channel4
+UART2 TX DMA1 Stream6 Channel4
+Conflict with bsp_dac_conf.h => DAC1_DMA_STREAM/DAC2_DMA_STREAM
+(DAC and LIN2 scheduler cannot be used at same time)
+*/
+#define BSP_UART2_DMA_RX_STREAM  DMA1_Stream5
+#define BSP_UART2_DMA_TX_STREAM  DMA1_Stream6
+#define BSP_UART2_DMA_CHANNEL    (4U << DMA_SxCR_CHSEL_Pos)
+#define BSP_UART2_DMA_RX_IFCR    (DMA1->HIFCR)
+#define BSP_UART2_DMA_RX_FLAGS   (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | \
+                                  DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+#define BSP_UART2_DMA_TX_IFCR    (DMA1->HIFCR)
+#define BSP_UART2_DMA_TX_FLAGS   (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | \
+                                  DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
 
 #endif /* _BSP_UART_CONF_H_ */
@@ -8,6 +8,7 @@ STM32CUBESRC = ./drv/stm32cube/bsp.c \
                ./drv/stm32cube/bsp_i2c_slave.c \
                ./drv/stm32cube/bsp_spi.c \
                ./drv/stm32cube/bsp_uart.c \
+               ./drv/stm32cube/bsp_onewire.c \
                ./drv/stm32cube/bsp_smartcard.c \
                ./drv/stm32cube/bsp_rng.c \
                ./drv/stm32cube/bsp_can.c \
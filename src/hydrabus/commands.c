@@ -102,6 +102,7 @@ const t_token_dict tl_dict[] = {
 	{ T_BIN, "bin" },
 	{ T_DIRECT_MODE_0, "dm0" },
 	{ T_DIRECT_MODE_1, "dm1" },
+	{ T_INVENTORY, "inventory" },
 #endif
 	{ T_SNIFF, "sniff" },
 	{ T_GPIO, "gpio" },
@@ -111,6 +112,8 @@ const t_token_dict tl_dict[] = {
 	{ T_TOKENLINE, "tokenline" },
 	{ T_TIMING, "timing" },
 	{ T_DEBUG_TEST_RX, "test-rx" },
+	{ T_DEBUG_TEST_TX, "test-tx" },
+	{ T_DEBUG_TEST_LOOPBACK, "test-loopback" },
 	{ T_RM, "rm" },
 	{ T_MKDIR, "mkdir" },
 	{ T_LOGGING, "logging" },
@@ -163,6 +166,36 @@ const t_token_dict tl_dict[] = {
 	{ T_CONVENTION, "convention" },
 	{ T_DELAY, "delay" },
 	{ T_MMC, "mmc" },
+	{ T_MACRO, "macro" },
+	{ T_RUN, "run" },
+	{ T_REPEAT, "repeat" },
+	{ T_SAVE, "save" },
+	{ T_LOAD, "load" },
+	{ T_PERIODIC, "periodic" },
+	{ T_BUDGET, "budget" },
+	{ T_STANDARD, "standard" },
+	{ T_OVERDRIVE, "overdrive" },
+	{ T_RECORD, "record" },
+	{ T_PPS, "pps" },
+	{ T_APDU, "apdu" },
+	{ T_HW, "hw" },
+	{ T_EEPROM, "eeprom" },
+	{ T_WIDTH, "width" },
+	{ T_PAGE, "page" },
+	{ T_SIZE, "size" },
+	{ T_ONFI, "onfi" },
+	{ T_OOB, "oob" },
+	{ T_BLOCK, "block" },
+	{ T_PERF, "perf" },
+	{ T_CARD, "card" },
+	{ T_FACILITY, "facility" },
+	{ T_FORMAT, "format" },
+	{ T_SCHEDULE, "schedule" },
+	{ T_RESPONSE, "response" },
+	{ T_DATA, "data" },
+	{ T_CLASSIC, "classic" },
+	{ T_DUMP, "dump" },
+	{ T_ALL, "all" },
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
@@ -334,6 +367,19 @@ t_token tokens_mode_nfc_scan[] = {
 	{ }
 };
 
+t_token tokens_mode_nfc_inventory[] = {
+	{
+		T_SAMPLES,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of inventory rounds (default until interrupted)"
+	},
+	{
+		T_BIN,
+		.help = "Output binary records instead of summary"
+	},
+	{ }
+};
+
 t_token tokens_mode_nfc_emul_mf_ul[] = {
 	{
 		T_FILE,
@@ -366,7 +412,7 @@ t_token tokens_mode_nfc_sniff[] = {
 	},
 	{
 		T_PCAP,
-		.help = "Save output file in Wireshark PCAP format"
+		.help = "Save output file in Wireshark pcapng format"
 	},
 	{ }
 };
@@ -385,6 +431,11 @@ t_token tokens_mode_nfc_sniff[] = {
 		.subtokens = tokens_mode_nfc_scan,\
 		.help = "Scan"\
 	},\
+	{\
+		T_INVENTORY,\
+		.subtokens = tokens_mode_nfc_inventory,\
+		.help = "Continuous inventory with tags de-duplication"\
+	},\
 	{\
 		T_READ_MF_ULTRALIGHT,\
 		.arg_type = T_ARG_STRING,\
@@ -454,6 +505,57 @@ t_token tokens_parity[] = {
 	{ T_ODD },
 };
 
+/* Mode periodic service (see hydrabus_periodic.c) */
+t_token tokens_mode_periodic[] = {
+	{
+		T_PERIOD,
+		.arg_type = T_ARG_UINT,
+		.help = "Call period in us"
+	},
+	{
+		T_BUDGET,
+		.arg_type = T_ARG_UINT,
+		.help = "Max duration of a call in us (longer calls are counted)"
+	},
+	{
+		T_ON,
+		.help = "Start periodic service"
+	},
+	{
+		T_OFF,
+		.help = "Stop periodic service"
+	},
+	{ }
+};
+
+/* Mode macros (see hydrabus_macro.c) */
+#define MODE_MACRO_TOKENS \
+	{\
+		T_MACRO,\
+		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,\
+		.help = "Define macro :<num> with following commands (list without :<num>)"\
+	},\
+	{\
+		T_RUN,\
+		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,\
+		.help = "Run macro :<num>"\
+	},\
+	{\
+		T_REPEAT,\
+		.arg_type = T_ARG_UINT,\
+		.help = "Number of macro runs"\
+	},\
+	{\
+		T_SAVE,\
+		.arg_type = T_ARG_STRING,\
+		.help = "Save mode macros in file (macro save <filename>)"\
+	},\
+	{\
+		T_LOAD,\
+		.arg_type = T_ARG_STRING,\
+		.help = "Load mode macros from file (macro load <filename>)"\
+	},
+
 #define UART_PARAMETERS \
 	{\
 		T_DEVICE,\
@@ -550,6 +652,12 @@ t_token tokens_mode_uart[] = {
 		T_SCAN,
 		.help = "Measure baudrate (PC6)"
 	},
+	{
+		T_PERIODIC,
+		.subtokens = tokens_mode_periodic,
+		.help = "Print received bytes in background (show statistics without on/off)"
+	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit UART mode"
@@ -649,7 +757,16 @@ t_token tokens_mode_smartcard[] = {
 	},
 	{
 		T_ATR,
-		.help = "Read card ATR"
+		.help = "Read card ATR and negotiate its highest Fi/Di (PPS)"
+	},
+	{
+		T_PPS,
+		.help = "Negotiate highest Fi/Di of ATR again (PPS)"
+	},
+	{
+		T_APDU,
+		.arg_type = T_ARG_STRING,
+		.help = "Send APDU in hex (T=1) and read response"
 	},
 	/* BP commands */
 	{
@@ -699,6 +816,7 @@ t_token tokens_mode_smartcard[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit SMARTCARD mode"
@@ -718,6 +836,59 @@ t_token tokens_smartcard[] = {
 		.help = "LIN device (1/2)"\
 	},\
 
+t_token tokens_lin_schedule[] = {
+	{
+		T_ID,
+		.arg_type = T_ARG_UINT,
+		.help = "Frame ID (0-63), adds a slot"
+	},
+	{
+		T_PERIOD,
+		.arg_type = T_ARG_UINT,
+		.help = "Time before next slot in ms (default 10)"
+	},
+	{
+		T_DATA,
+		.arg_type = T_ARG_STRING,
+		.help = "Published data (up to 8 bytes), a slave responds otherwise"
+	},
+	{
+		T_CLEAR,
+		.help = "Remove all slots"
+	},
+	{ }
+};
+
+t_token tokens_lin_response[] = {
+	{
+		T_ID,
+		.arg_type = T_ARG_UINT,
+		.help = "Frame ID (0-63)"
+	},
+	{
+		T_DATA,
+		.arg_type = T_ARG_STRING,
+		.help = "Response data (up to 8 bytes), removed if not set"
+	},
+	{
+		T_CLEAR,
+		.help = "Remove all responses"
+	},
+	{ }
+};
+
+t_token tokens_lin_run[] = {
+	{
+		T_BIN,
+		.help = "Write binary records"
+	},
+	{
+		T_CLASSIC,
+		.help = "Send classic checksum (LIN 1.x)"
+	},
+	{ }
+};
+
 t_token tokens_mode_lin[] = {
 	{
 		T_SHOW,
@@ -731,6 +902,26 @@ t_token tokens_mode_lin[] = {
 	},
 	LIN_PARAMETERS
 	/* LIN-specific commands */
+	{
+		T_SCHEDULE,
+		.subtokens = tokens_lin_schedule,
+		.help = "Add slot to master schedule and show it"
+	},
+	{
+		T_RESPONSE,
+		.subtokens = tokens_lin_response,
+		.help = "Set slave response and show responses"
+	},
+	{
+		T_RUN,
+		.subtokens = tokens_lin_run,
+		.help = "Run schedule as master until interrupted"
+	},
+	{
+		T_SNIFF,
+		.subtokens = tokens_lin_run,
+		.help = "Print frames and send responses as slave until interrupted"
+	},
 	{
 		T_READ,
 		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,
@@ -787,6 +978,7 @@ t_token tokens_mode_lin[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit LIN mode"
@@ -890,6 +1082,12 @@ t_token tokens_mode_can[] = {
 		T_SLCAN,
 		.help = "slcan (LAWICEL) mode"
 	},
+	{
+		T_PERIODIC,
+		.subtokens = tokens_mode_periodic,
+		.help = "Print received frames in background (show statistics without on/off)"
+	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit CAN mode"
@@ -913,8 +1111,58 @@ t_token tokens_can[] = {
 		T_FREQUENCY,\
 		.arg_type = T_ARG_FLOAT,\
 		.help = "Bus frequency"\
+	},\
+	{\
+		T_GPIO,\
+		.help = "Bit-bang bus (default)"\
+	},\
+	{\
+		T_HW,\
+		.help = "I2C1 peripheral with DMA bus (up to 400kHz)"\
 	},
 
+t_token tokens_i2c_eeprom[] = {
+	{
+		T_DEVICE,
+		.arg_type = T_ARG_UINT,
+		.help = "7-bit device address (default 0x50)"
+	},
+	{
+		T_WIDTH,
+		.arg_type = T_ARG_UINT,
+		.help = "Memory address width in bytes (1/2, default 1)"
+	},
+	{
+		T_PAGE,
+		.arg_type = T_ARG_UINT,
+		.help = "Write page size in bytes (default 8)"
+	},
+	{
+		T_START,
+		.arg_type = T_ARG_UINT,
+		.help = "Start memory address (default 0)"
+	},
+	{
+		T_SIZE,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of bytes (default file size for write)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename"
+	},
+	{
+		T_READ,
+		.help = "Dump memory to console (hexdump) or to file"
+	},
+	{
+		T_WRITE,
+		.help = "Program memory from file"
+	},
+	{ }
+};
+
 t_token tokens_mode_i2c[] = {
 	{
 		T_SHOW,
@@ -936,6 +1184,11 @@ t_token tokens_mode_i2c[] = {
 		T_SNIFF,
 		.help = "Sniff I2C bus"
 	},
+	{
+		T_EEPROM,
+		.subtokens = tokens_i2c_eeprom,
+		.help = "Dump/program 24Cxx memory"
+	},
 	{
 		T_START,
 		.help = "Start"
@@ -1004,6 +1257,7 @@ t_token tokens_mode_i2c[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit I2C mode"
@@ -1042,6 +1296,54 @@ t_token tokens_i2c[] = {
 	{ T_LSB_FIRST, \
 		.help = "Send/receive LSB first" },
 
+t_token tokens_spi_flash[] = {
+	{
+		T_START,
+		.arg_type = T_ARG_UINT,
+		.help = "Start memory address (default 0)"
+	},
+	{
+		T_SIZE,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of bytes (default file size for write)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename"
+	},
+	{
+		T_ID,
+		.help = "Show JEDEC ID and geometry (default)"
+	},
+	{
+		T_READ,
+		.help = "Dump memory to console (hexdump) or to file"
+	},
+	{
+		T_WRITE,
+		.help = "Erase, program and verify memory from file"
+	},
+	{
+		T_ERASE,
+		.help = "Erase size bytes or all (aligned on smallest erase size)"
+	},
+	{
+		T_ALL,
+		.help = "Erase from start up to end of memory"
+	},
+	{ }
+};
+
+t_token tokens_spi_sniff[] = {
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename (pcapng)"
+	},
+	{ }
+};
+
 t_token tokens_mode_spi[] = {
 	{
 		T_SHOW,
@@ -1055,6 +1357,16 @@ t_token tokens_mode_spi[] = {
 	},
 	SPI_PARAMETERS
 	/* SPI-specific commands */
+	{
+		T_FLASH,
+		.subtokens = tokens_spi_flash,
+		.help = "Read/erase/program 25xx SPI NOR memory"
+	},
+	{
+		T_SNIFF,
+		.subtokens = tokens_spi_sniff,
+		.help = "Sniff SPI bus (SPI1 MOSI, SPI2 MISO, CS PA15)"
+	},
 	{
 		T_READ,
 		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,
@@ -1123,6 +1435,7 @@ t_token tokens_mode_spi[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit SPI mode"
@@ -1283,6 +1596,7 @@ t_token tokens_mode_jtag[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit JTAG mode"
@@ -1303,7 +1617,15 @@ t_token tokens_jtag[] = {
 	{ T_MSB_FIRST, \
 		.help = "Send/receive MSB first" }, \
 	{ T_LSB_FIRST, \
-		.help = "Send/receive LSB first" },
+		.help = "Send/receive LSB first" }, \
+	{ T_GPIO, \
+		.help = "Bit-bang bus on PB11 (default)" }, \
+	{ T_UART, \
+		.help = "USART3 half-duplex with DMA bus on PB10" }, \
+	{ T_STANDARD, \
+		.help = "Standard speed (default)" }, \
+	{ T_OVERDRIVE, \
+		.help = "Overdrive speed (uart only)" },
 
 t_token tokens_mode_onewire[] = {
 	{
@@ -1390,6 +1712,7 @@ t_token tokens_mode_onewire[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit 1-wire mode"
@@ -1524,6 +1847,7 @@ t_token tokens_mode_twowire[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit 2-wire mode"
@@ -1644,6 +1968,7 @@ t_token tokens_mode_threewire[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit 3-wire mode"
@@ -1656,17 +1981,64 @@ t_token tokens_threewire[] = {
 	{ }
 };
 
+#define FLASH_PARAMETERS \
+	{ T_PAGE, \
+		.arg_type = T_ARG_UINT, \
+		.help = "Page data size in bytes" }, \
+	{ T_OOB, \
+		.arg_type = T_ARG_UINT, \
+		.help = "Page spare (OOB) size in bytes" }, \
+	{ T_BLOCK, \
+		.arg_type = T_ARG_UINT, \
+		.help = "Pages per block" }, \
+	{ T_SIZE, \
+		.arg_type = T_ARG_UINT, \
+		.help = "Number of blocks" },
+
+t_token tokens_flash_read[] = {
+	{
+		T_START,
+		.arg_type = T_ARG_UINT,
+		.help = "First page (default 0)"
+	},
+	{
+		T_SIZE,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of pages (default 1)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename"
+	},
+	{ }
+};
+
 t_token tokens_mode_flash[] = {
 	{
 		T_SHOW,
 		.subtokens = tokens_mode_show,
 		.help = "Show flash parameters"
 	},
+	FLASH_PARAMETERS
 	/* flash-specific commands */
 	{
 		T_ID,
 		.help = "Displays the ID and status registers"
 	},
+	{
+		T_ONFI,
+		.help = "Read ONFI parameter page and set geometry"
+	},
+	{
+		T_DUMP,
+		.subtokens = tokens_flash_read,
+		.help = "Read pages with OOB (hexdump or file)"
+	},
+	{
+		T_SCAN,
+		.help = "Scan factory bad block markers"
+	},
 	/* BP commands */
 	{
 		T_EXIT,
@@ -1676,6 +2048,7 @@ t_token tokens_mode_flash[] = {
 };
 
 t_token tokens_flash[] = {
+	FLASH_PARAMETERS
 	{ }
 };
 
@@ -1753,6 +2126,14 @@ t_token tokens_gpio[] = {
 		T_CONTINUOUS,
 		.help = "Read continuously"
 	},
+	{
+		T_RECORD,
+		.help = "Record timestamped edges (EXTI) until UBTN is pressed"
+	},
+	{
+		T_SD,
+		.help = "Write recorded edges to a file on SD card"
+	},
 	{
 		T_ON,
 		.help = "Set GPIO pin"
@@ -1769,6 +2150,25 @@ t_token tokens_gpio[] = {
 		.arg_type = T_ARG_TOKEN, \
 		.subtokens = tokens_gpio_pull, \
 		.help = "GPIO pull (up/down/floating)" },
+t_token tokens_wiegand_card[] = {
+	{
+		T_ID,
+		.arg_type = T_ARG_UINT,
+		.help = "Card number"
+	},
+	{
+		T_FACILITY,
+		.arg_type = T_ARG_UINT,
+		.help = "Facility code (default 0)"
+	},
+	{
+		T_FORMAT,
+		.arg_type = T_ARG_UINT,
+		.help = "Frame length 26/34/37 bits (default 26)"
+	},
+	{ }
+};
+
 t_token tokens_mode_wiegand[] = {
 	{
 		T_SHOW,
@@ -1777,6 +2177,15 @@ t_token tokens_mode_wiegand[] = {
 	},
 	WIEGAND_PARAMETERS
 	/* wiegand-specific commands */
+	{
+		T_SNIFF,
+		.help = "Print frames until interrupted"
+	},
+	{
+		T_CARD,
+		.subtokens = tokens_wiegand_card,
+		.help = "Send card number with parity"
+	},
 	{
 		T_READ,
 		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,
@@ -1837,6 +2246,7 @@ t_token tokens_mode_wiegand[] = {
 		T_AUX_READ,
 		.help = "Read AUX[0](PC4)"
 	},
+	MODE_MACRO_TOKENS
 	{
 		T_EXIT,
 		.help = "Exit wiegand mode"
@@ -1998,7 +2408,7 @@ t_token tokens_sd[] = {
 	},
 	{
 		T_TESTPERF,
-		.help = "Test SD card performance"
+		.help = "Test SD card read/write performance (raw writes rewrite existing data)"
 	},
 	{
 		T_CAT,
@@ -2028,12 +2438,25 @@ t_token tokens_sd[] = {
 	{ }
 };
 
+t_token tokens_show_perf[] = {
+	{
+		T_CLEAR,
+		.help = "Clear counters after display"
+	},
+	{ }
+};
+
 t_token tokens_show[] = {
 	{ T_SYSTEM },
 	{ T_MEMORY },
 	{ T_THREADS },
 	{ T_SD },
 	{ T_DEBUG },
+	{
+		T_PERF,
+		.subtokens = tokens_show_perf,
+		.help = "Performance counters"
+	},
 	{ }
 };
 
@@ -2050,6 +2473,14 @@ t_token tokens_debug[] = {
 		T_DEBUG_TEST_RX,
 		.help = "Test USB1 or 2 RX(read all data until UBTN+Key pressed)"
 	},
+	{
+		T_DEBUG_TEST_TX,
+		.help = "Test USB1 or 2 TX(send pattern until UBTN or Key pressed)"
+	},
+	{
+		T_DEBUG_TEST_LOOPBACK,
+		.help = "Test USB1 or 2 loopback(echo data until UBTN or 2s idle)"
+	},
 	{
 		T_ON,
 		.help = "Enable"
@@ -2135,7 +2566,7 @@ t_token tl_tokens[] = {
 		T_GPIO,
 		.subtokens = tokens_gpio,
 		.help = "Get or set GPIO pins",
-		.help_full = "Configuration: gpio <PA0-15, PB0-11, PC0-15, PA*> <mode (in/out/open-drain)> [pull (up/down/floating)]\r\nInteraction: gpio <PA0-15, PB0-11, PC0-15, PA*> [period (nb ms)] <read/continuous> or <on/off>"
+		.help_full = "Configuration: gpio <PA0-15, PB0-11, PC0-15, PA*> <mode (in/out/open-drain)> [pull (up/down/floating)]\r\nInteraction: gpio <PA0-15, PB0-11, PC0-15, PA*> [period (nb ms)] <read/continuous> or <on/off> or record [sd]"
 	},
 	{
 		T_SPI,
@@ -94,6 +94,7 @@ enum {
 	T_BIN,
 	T_DIRECT_MODE_0,
 	T_DIRECT_MODE_1,
+	T_INVENTORY,
 #endif
 	T_SNIFF,
 	T_GPIO,
@@ -103,6 +104,8 @@ enum {
 	T_TOKENLINE,
 	T_TIMING,
 	T_DEBUG_TEST_RX,
+	T_DEBUG_TEST_TX,
+	T_DEBUG_TEST_LOOPBACK,
 	T_RM,
 	T_MKDIR,
 	T_LOGGING,
@@ -155,6 +158,36 @@ enum {
 	T_CONVENTION,
 	T_DELAY,
 	T_MMC,
+	T_MACRO,
+	T_RUN,
+	T_REPEAT,
+	T_SAVE,
+	T_LOAD,
+	T_PERIODIC,
+	T_BUDGET,
+	T_STANDARD,
+	T_OVERDRIVE,
+	T_RECORD,
+	T_PPS,
+	T_APDU,
+	T_HW,
+	T_EEPROM,
+	T_WIDTH,
+	T_PAGE,
+	T_SIZE,
+	T_ONFI,
+	T_OOB,
+	T_BLOCK,
+	T_PERF,
+	T_CARD,
+	T_FACILITY,
+	T_FORMAT,
+	T_SCHEDULE,
+	T_RESPONSE,
+	T_DATA,
+	T_CLASSIC,
+	T_DUMP,
+	T_ALL,
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
@@ -20,6 +20,7 @@
 #include "common.h"
 #include "tokenline.h"
 #include "bsp_gpio.h"
+#include "hydrabus_edge.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -81,7 +82,7 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	uint16_t gpio[3] = { 0 };
 
-	int mode, pull, state, port, pin, read, period, continuous, t, max;
+	int mode, pull, state, port, pin, read, period, continuous, record, to_file, t, max;
 	bool mode_changed, pull_changed;
 	char *str, *s;
 
@@ -94,6 +95,8 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p)
 	period = 100;
 	read = FALSE;
 	continuous = FALSE;
+	record = FALSE;
+	to_file = FALSE;
 	while (p->tokens[t]) {
 		switch (p->tokens[t]) {
 		case T_MODE:
@@ -142,6 +145,12 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_CONTINUOUS:
 			continuous = TRUE;
 			break;
+		case T_RECORD:
+			record = TRUE;
+			break;
+		case T_SD:
+			to_file = TRUE;
+			break;
 		case T_ARG_STRING:
 			str = p->buf + p->tokens[++t];
 			if (strlen(str) < 3) {
@@ -199,8 +208,8 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p)
 		return FALSE;
 	}
 
-	if (!state && !read) {
-		cprintf(con, "Please select either 'read' or on/off.\r\n");
+	if (!state && !read && !record) {
+		cprintf(con, "Please select either 'read', 'record' or on/off.\r\n");
 		return FALSE;
 	}
 
@@ -214,7 +223,9 @@ int cmd_gpio(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 	}
 
-	if (!state) {
+	if (record) {
+		gpio_edge_record(con, gpio, to_file);
+	} else if (!state) {
 		if (continuous)
 			read_continuous(con, gpio, period);
 		else
@@ -6,10 +6,17 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_pwm.c \
             hydrabus/gpio.c \
             hydrabus/hydrabus_mode.c \
+            hydrabus/hydrabus_macro.c \
+            hydrabus/hydrabus_periodic.c \
+            hydrabus/hydrabus_edge.c \
             hydrabus/hydrabus_mode_spi.c \
+            hydrabus/hydrabus_spi_sniff.c \
+            hydrabus/hydrabus_spi_flash.c \
             hydrabus/hydrabus_mode_uart.c \
             hydrabus/hydrabus_mode_smartcard.c \
+            hydrabus/hydrabus_smartcard_t1.c \
             hydrabus/hydrabus_mode_i2c.c \
+            hydrabus/hydrabus_i2c_eeprom.c \
             hydrabus/hydrabus_sump.c \
             hydrabus/hydrabus_mode_jtag.c \
             hydrabus/hydrabus_rng.c \
@@ -18,6 +25,7 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_mode_threewire.c \
             hydrabus/hydrabus_mode_can.c \
             hydrabus/hydrabus_mode_flash.c \
+            hydrabus/hydrabus_flash_nand.c \
             hydrabus/hydrabus_bbio.c \
             hydrabus/hydrabus_bbio_spi.c \
             hydrabus/hydrabus_bbio_pin.c \
@@ -31,10 +39,13 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_bbio_flash.c \
             hydrabus/hydrabus_bbio_adc.c \
             hydrabus/hydrabus_bbio_freq.c \
+            hydrabus/hydrabus_bbio_perf.c \
             hydrabus/hydrabus_sd.c \
             hydrabus/hydrabus_trigger.c \
             hydrabus/hydrabus_mode_wiegand.c \
+            hydrabus/hydrabus_wiegand.c \
             hydrabus/hydrabus_mode_lin.c \
+            hydrabus/hydrabus_lin.c \
             hydrabus/hydrabus_bbio_aux.c \
             hydrabus/hydrabus_aux.c \
             hydrabus/hydrabus_serprog.c \
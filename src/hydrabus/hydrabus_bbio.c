@@ -36,6 +36,7 @@
 #include "hydrabus_bbio_smartcard.h"
 #include "hydrabus_bbio_adc.h"
 #include "hydrabus_bbio_freq.h"
+#include "hydrabus_bbio_perf.h"
 #include "hydrabus_bbio_aux.h"
 #include "hydrabus_bbio_mmc.h"
 #ifdef HYDRANFC
@@ -110,6 +111,9 @@ int cmd_bbio(t_hydra_console *con)
 			case BBIO_FREQ:
 				bbio_freq(con);
 				continue;
+			case BBIO_PERF:
+				bbio_perf(con);
+				continue;
 			case BBIO_RESET:
 				break;
 			default:
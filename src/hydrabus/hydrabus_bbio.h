@@ -48,6 +48,10 @@
 #define BBIO_VOLT	0b00010100
 #define BBIO_VOLT_CONT	0b00010101
 #define BBIO_FREQ	0b00010110
+#define BBIO_PERF	0b00010111
+
+/* BBIO_PERF flags */
+#define BBIO_PERF_CLEAR	0b00000001
 
 /*
  * SPI-specific commands
@@ -56,6 +60,14 @@
 #define BBIO_SPI_CS_HIGH	0b00000011
 #define BBIO_SPI_WRITE_READ	0b00000100
 #define BBIO_SPI_WRITE_READ_NCS	0b00000101
+#define BBIO_SPI_FLASH_ID	0b00000111
+#define BBIO_SPI_FLASH_READ	0b00001000
+#define BBIO_SPI_FLASH_WRITE	0b00001001
+#define BBIO_SPI_FLASH_ERASE	0b00001010
+#define BBIO_SPI_FLASH_ERASE_FLAG	0b00000001 /* BBIO_SPI_FLASH_WRITE flags */
+#define BBIO_SPI_FLASH_VERIFY_FLAG	0b00000010 /* BBIO_SPI_FLASH_WRITE flags */
+#define BBIO_SPI_SNIFF_DMA	0b00001100
+#define BBIO_SPI_SNIFF_TO_SD	0b00000001 /* BBIO_SPI_SNIFF_DMA flag */
 #define BBIO_SPI_SNIFF_ALL	0b00001101
 #define BBIO_SPI_SNIFF_CS_LOW	0b00001110
 #define BBIO_SPI_SNIFF_CS_HIGH	0b00001111
@@ -78,6 +90,8 @@
 #define BBIO_I2C_ACK_BIT	0b00000110
 #define BBIO_I2C_NACK_BIT	0b00000111
 #define BBIO_I2C_WRITE_READ	0b00001000
+#define BBIO_I2C_EEPROM_READ	0b00001001
+#define BBIO_I2C_EEPROM_WRITE	0b00001010
 #define BBIO_I2C_START_SNIFF	0b00001111
 #define BBIO_I2C_BULK_WRITE	0b00010000
 #define BBIO_I2C_CONFIG_PERIPH	0b01000000
@@ -158,8 +172,12 @@
 #define BBIO_FLASH_WRITE_CMD	0b00000110
 #define BBIO_FLASH_READ_BYTE	0b00000111
 #define BBIO_FLASH_WAIT_READY	0b00001000
+#define BBIO_FLASH_ONFI		0b00001001
 #define BBIO_FLASH_SD_DUMP_OFF	0b00001010
 #define BBIO_FLASH_SD_DUMP_ON	0b00001011
+#define BBIO_FLASH_GEOMETRY	0b00001100
+#define BBIO_FLASH_READ_PAGES	0b00001101
+#define BBIO_FLASH_BAD_BLOCKS	0b00001110
 #define BBIO_FLASH_WRITE_ADDR	0b00010000
 
 /*
@@ -201,6 +219,22 @@
 #define BBIO_MMC_READ_PAGE	0b00000100
 #define BBIO_MMC_WRITE_PAGE	0b00000101
 #define BBIO_MMC_EXT_CSD	0b00000110
+#define BBIO_MMC_READ_BLOCKS	0b00000111
 #define BBIO_MMC_CONFIG		0b10000000
 
 int cmd_bbio(t_hydra_console *con);
+
+/* Big endian 32bits parameters of BBIO commands */
+static inline uint32_t bbio_get_be32(const uint8_t *data)
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+	       ((uint32_t)data[2] << 8) | data[3];
+}
+
+static inline void bbio_put_be32(uint8_t *data, uint32_t value)
+{
+	data[0] = value >> 24;
+	data[1] = value >> 16;
+	data[2] = value >> 8;
+	data[3] = value;
+}
@@ -27,6 +27,7 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_flash.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_flash_nand.h"
 
 
 static void bbio_mode_id(t_hydra_console *con)
@@ -34,11 +35,38 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_FLASH_HEADER, 4);
 }
 
+/* Send 0x01 then bad block bitmap (bit set for a bad block, LSB first) */
+static void bbio_flash_bad_blocks(t_hydra_console *con, uint8_t *buf, uint32_t buf_size)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	flash_config_t *geo = &proto->config.flash;
+	uint32_t block, idx;
+
+	cprint(con, "\x01", 1);
+	idx = 0;
+	memset(buf, 0, buf_size);
+	for (block = 0; block < geo->nb_blocks; block++) {
+		if (nand_block_is_bad(geo, block))
+			buf[idx] |= 1 << (block & 7);
+		if ((block & 7) == 7 || block == geo->nb_blocks - 1) {
+			idx++;
+			if (idx == buf_size || block == geo->nb_blocks - 1) {
+				cprint(con, (char *)buf, idx);
+				memset(buf, 0, idx);
+				idx = 0;
+			}
+		}
+	}
+}
+
 void bbio_mode_flash(t_hydra_console *con)
 {
 	FIL outfile;
 	uint32_t to_rx, to_tx, i;
+	uint32_t page, nb_pages;
 	uint8_t bbio_subcommand;
+	t_nand_onfi onfi;
+	mode_config_proto_t* proto = &con->mode->proto;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	bool to_sd = FALSE;
@@ -126,6 +154,46 @@ void bbio_mode_flash(t_hydra_console *con)
 					cprint(con, (char *)rx_data, to_rx);
 				}
 				break;
+			case BBIO_FLASH_ONFI:
+				/* rx_data is larger than the 3 parameter page copies */
+				if(nand_read_onfi(&proto->config.flash, &onfi, rx_data)) {
+					cprint(con, "\x01", 1);
+					cprint(con, (char *)rx_data, NAND_ONFI_PARAM_SIZE);
+				} else {
+					cprint(con, "\x00", 1);
+				}
+				break;
+			case BBIO_FLASH_GEOMETRY:
+				chnRead(con->sdu, rx_data, 16);
+				if(nand_set_geometry(&proto->config.flash,
+						     bbio_get_be32(&rx_data[0]),
+						     bbio_get_be32(&rx_data[4]),
+						     bbio_get_be32(&rx_data[8]),
+						     bbio_get_be32(&rx_data[12]))) {
+					cprint(con, "\x01", 1);
+				} else {
+					cprint(con, "\x00", 1);
+				}
+				break;
+			case BBIO_FLASH_READ_PAGES:
+				chnRead(con->sdu, rx_data, 8);
+				page = bbio_get_be32(&rx_data[0]);
+				nb_pages = bbio_get_be32(&rx_data[4]);
+				if(to_sd) {
+					if(nand_read_pages_file(&proto->config.flash,
+								page, nb_pages, &outfile)) {
+						cprint(con, "\x01", 1);
+					} else {
+						cprint(con, "\x00", 1);
+					}
+				} else {
+					nand_read_pages_usb(con, &proto->config.flash,
+							    page, nb_pages);
+				}
+				break;
+			case BBIO_FLASH_BAD_BLOCKS:
+				bbio_flash_bad_blocks(con, rx_data, 0x1000);
+				break;
 			case BBIO_FLASH_SD_DUMP_ON:
 				to_sd = TRUE;
 				if(file_open(&outfile, "sd_dump.bin", 'w')) {
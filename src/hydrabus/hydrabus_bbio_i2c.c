@@ -28,9 +28,13 @@
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_i2c_eeprom.h"
 
 #define I2C_DEV_NUM (1)
 
+/* EEPROM commands parameters: device, width, page(2), address(4), size(4) */
+#define BBIO_I2C_EEPROM_PARAMS_LEN (12)
+
 void bbio_i2c_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -40,6 +44,7 @@ void bbio_i2c_init_proto_default(t_hydra_console *con)
 	proto->config.i2c.dev_gpio_pull = MODE_CONFIG_DEV_GPIO_PULLUP;
 	proto->config.i2c.dev_speed = 1;
 	proto->config.i2c.ack_pending = 0;
+	proto->config.i2c.dev_backend = BSP_I2C_BACKEND_GPIO;
 }
 
 void bbio_i2c_sniff(t_hydra_console *con)
@@ -83,6 +88,81 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_I2C_HEADER, 4);
 }
 
+/* Read parameters (big endian), return FALSE if memory is not valid */
+static bool bbio_i2c_eeprom_params(t_hydra_console *con, uint8_t *buf, t_i2c_eeprom *eep,
+				   uint32_t *addr, uint32_t *size)
+{
+	chnRead(con->sdu, buf, BBIO_I2C_EEPROM_PARAMS_LEN);
+	*addr = bbio_get_be32(&buf[4]);
+	*size = bbio_get_be32(&buf[8]);
+
+	return i2c_eeprom_init(eep, buf[0], buf[1], (buf[2] << 8) + buf[3]);
+}
+
+/*
+ * Stream size bytes from addr by chunks of I2C_EEPROM_CHUNK_SIZE.
+ * Each chunk is sent as 0x01 + data, 0x00 is sent on error or abort (UBTN).
+ */
+static void bbio_i2c_eeprom_read(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_eeprom eep;
+	uint32_t addr, size, nb;
+
+	if (!bbio_i2c_eeprom_params(con, buf, &eep, &addr, &size)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	while (size > 0) {
+		nb = (size < I2C_EEPROM_CHUNK_SIZE) ? size : I2C_EEPROM_CHUNK_SIZE;
+		if (hydrabus_ubtn() ||
+		    i2c_eeprom_read(proto->dev_num, &eep, addr, buf, nb) != BSP_OK) {
+			cprint(con, "\x00", 1);
+			return;
+		}
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)buf, nb);
+		addr += nb;
+		size -= nb;
+	}
+}
+
+/*
+ * Parameters are acknowledged with 0x01, then host sends data by chunks of
+ * I2C_EEPROM_CHUNK_SIZE, each chunk is programmed (ACK polling between pages)
+ * and acknowledged with 0x01, 0x00 on error.
+ * Last chunk is acknowledged at the end of the write cycle.
+ */
+static void bbio_i2c_eeprom_write(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_eeprom eep;
+	uint32_t addr, size, nb;
+	bsp_status_t status;
+
+	if (!bbio_i2c_eeprom_params(con, buf, &eep, &addr, &size)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	cprint(con, "\x01", 1);
+
+	while (size > 0) {
+		nb = (size < I2C_EEPROM_CHUNK_SIZE) ? size : I2C_EEPROM_CHUNK_SIZE;
+		chnRead(con->sdu, buf, nb);
+		status = i2c_eeprom_write(proto->dev_num, &eep, addr, buf, nb);
+		addr += nb;
+		size -= nb;
+		if (status == BSP_OK && size == 0)
+			status = i2c_eeprom_wait_ready(proto->dev_num, &eep);
+		if (status != BSP_OK) {
+			cprint(con, "\x00", 1);
+			return;
+		}
+		cprint(con, "\x01", 1);
+	}
+}
+
 void bbio_mode_i2c(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
@@ -91,6 +171,7 @@ void bbio_mode_i2c(t_hydra_console *con)
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t data;
 	uint8_t tx_ack_flag;
+	uint32_t nb_ack;
 	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -153,42 +234,26 @@ void bbio_mode_i2c(t_hydra_console *con)
 				bsp_i2c_start(proto->dev_num);
 
 				/* Send all I2C Data */
-				for(i = 0; i < to_tx; i++)
-				{
-					bsp_i2c_master_write_u8(proto->dev_num, tx_data[i], &tx_ack_flag);
-					if(tx_ack_flag != TRUE)
-					{
-						break; /* Error */
-					}
-				}
-				if(tx_ack_flag != TRUE)
+				bsp_i2c_master_write_buf(proto->dev_num, tx_data, to_tx, &nb_ack);
+				if(nb_ack != to_tx)
 				{
 					/* Error */
 					cprint(con, "\x00", 1);
 					break; /* Return now */
 				}
 
-				/* Read all I2C Data */
-				if(to_rx >= 1)
-				{
-					/* Read I2C bytes with ACK */
-					for(i = 0; i < to_rx - 1; i++)
-					{
-						bsp_i2c_master_read_u8(proto->dev_num, &rx_data[i]);
-						bsp_i2c_read_ack(proto->dev_num, TRUE);
-					}
-
-					/* Send NACK for last I2C byte read */
-					bsp_i2c_master_read_u8(proto->dev_num, &rx_data[i]);
-					bsp_i2c_read_ack(proto->dev_num, FALSE);
-				}
-
-				/* Send I2C Stop */
-				bsp_i2c_stop(proto->dev_num);
+				/* Read all I2C Data, NACK last byte and send I2C Stop */
+				bsp_i2c_master_read_buf(proto->dev_num, rx_data, to_rx);
 
 				cprint(con, "\x01", 1);
 				cprint(con, (char *)rx_data, to_rx);
 				break;
+			case BBIO_I2C_EEPROM_READ:
+				bbio_i2c_eeprom_read(con, rx_data);
+				break;
+			case BBIO_I2C_EEPROM_WRITE:
+				bbio_i2c_eeprom_write(con, tx_data);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
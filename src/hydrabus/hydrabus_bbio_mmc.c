@@ -30,6 +30,9 @@
 
 extern const SDCConfig sdccfg;
 
+/* Blocks sent per chunk by BBIO_MMC_READ_BLOCKS (one 4096 bytes buffer) */
+#define BBIO_MMC_CHUNK_BLOCKS (0x1000 / BSP_MMC_BLOCK_LEN)
+
 void bbio_mmc_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -43,10 +46,57 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_MMC_HEADER, 4);
 }
 
+/*
+ * Stream nb_blocks from block_number by chunks of BBIO_MMC_CHUNK_BLOCKS.
+ * Each chunk is sent as 0x01 + data, 0x00 is sent on error or abort (UBTN).
+ * Next chunk is read by DMA while current one is sent on USB.
+ */
+static void bbio_mmc_read_blocks(t_hydra_console *con, uint8_t *buf0, uint8_t *buf1,
+				 uint32_t block_number, uint32_t nb_blocks)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *buf[2] = { buf0, buf1 };
+	uint32_t idx, nb, next_nb;
+	bsp_status_t status;
+
+	idx = 0;
+	nb = (nb_blocks < BBIO_MMC_CHUNK_BLOCKS) ? nb_blocks : BBIO_MMC_CHUNK_BLOCKS;
+	status = bsp_mmc_read_blocks_start(proto->dev_num, buf[idx], block_number, nb);
+
+	while(status == BSP_OK) {
+		status = bsp_mmc_wait_blocks(proto->dev_num);
+		if(status != BSP_OK) {
+			break;
+		}
+		block_number += nb;
+		nb_blocks -= nb;
+
+		next_nb = (nb_blocks < BBIO_MMC_CHUNK_BLOCKS) ? nb_blocks : BBIO_MMC_CHUNK_BLOCKS;
+		if(next_nb > 0) {
+			if(hydrabus_ubtn()) {
+				status = BSP_ERROR;
+			} else {
+				status = bsp_mmc_read_blocks_start(proto->dev_num, buf[idx ^ 1],
+								   block_number, next_nb);
+			}
+		}
+
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)buf[idx], nb * BSP_MMC_BLOCK_LEN);
+
+		if(next_nb == 0) {
+			return;
+		}
+		idx ^= 1;
+		nb = next_nb;
+	}
+	cprint(con, "\x00", 1);
+}
+
 void bbio_mode_mmc(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
-	uint32_t block_number;
+	uint32_t block_number, nb_blocks;
 	uint32_t * mmc_cid;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
@@ -112,6 +162,14 @@ void bbio_mode_mmc(t_hydra_console *con)
 					cprint(con, "\x00", 1);
 				}
 				break;
+			case BBIO_MMC_READ_BLOCKS:
+				chnRead(con->sdu, rx_data, 8);
+				block_number = (rx_data[0] << 24) + (rx_data[1]<<16);
+				block_number |= (rx_data[2] << 8) + rx_data[3];
+				nb_blocks = (rx_data[4] << 24) + (rx_data[5]<<16);
+				nb_blocks |= (rx_data[6] << 8) + rx_data[7];
+				bbio_mmc_read_blocks(con, rx_data, tx_data, block_number, nb_blocks);
+				break;
 			case BBIO_MMC_WRITE_PAGE:
 				chnRead(con->sdu, rx_data, 4);
 				block_number = (rx_data[0] << 24) + (rx_data[1]<<16);
@@ -38,7 +38,7 @@ static void bbio_mode_id(t_hydra_console *con)
 void bbio_mode_onewire(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
-	uint8_t bbio_subcommand, i;
+	uint8_t bbio_subcommand;
 	uint8_t rx_data[16], tx_data[16];
 	uint8_t data;
 	bsp_status_t status;
@@ -73,9 +73,7 @@ void bbio_mode_onewire(t_hydra_console *con)
 					data = (bbio_subcommand & 0b1111) + 1;
 
 					chnRead(con->sdu, tx_data, data);
-					for(i=0; i<data; i++) {
-						onewire_write_u8(con, tx_data[i]);
-					}
+					onewire_write_bytes(con, tx_data, data);
 					cprint(con, "\x01", 1);
 				} else if ((bbio_subcommand & BBIO_ONEWIRE_CONFIG_PERIPH) == BBIO_ONEWIRE_CONFIG_PERIPH) {
 					proto->config.onewire.dev_gpio_pull = (bbio_subcommand & 0b100)?1:0;
@@ -0,0 +1,121 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "hydrabus_bbio.h"
+
+#define BBIO_PERF_MODE_NAME_LEN (12)
+#define BBIO_PERF_THREAD_NAME_LEN (16)
+
+/* Cycles to ms */
+#define BBIO_PERF_MS(c) ((uint32_t)((c) / (STM32_HCLK / 1000)))
+
+extern t_token_dict tl_dict[];
+
+static void bbio_perf_u32(t_hydra_console *con, uint32_t val)
+{
+	cprint(con, (char *)&val, 4);
+}
+
+static void bbio_perf_name(t_hydra_console *con, const char *name, uint32_t len)
+{
+	char buf[BBIO_PERF_THREAD_NAME_LEN];
+
+	memset(buf, 0, sizeof(buf));
+	if (name != NULL)
+		strncpy(buf, name, len);
+	cprint(con, buf, len);
+}
+
+/*
+ * Send performance counters, command is followed by one flags byte
+ * (BBIO_PERF_CLEAR clears counters after they are sent).
+ * All values are uint32_t little endian, durations are in ms (ISR longest
+ * in cycles at STM32_HCLK):
+ * elapsed, ISR count/time/longest, USB tx bytes/high-water/buffers,
+ * pool high-water/blocks,
+ * modes number (uint8_t) then for each mode name (12 bytes, NUL padded),
+ * bytes in/out, commands, errors, overruns,
+ * threads number (uint8_t) then for each thread name (16 bytes, NUL
+ * padded) and CPU time.
+ */
+void bbio_perf(t_hydra_console *con)
+{
+	const t_perf_mode_slot *slot;
+	t_perf_isr isr;
+	thread_t *tp;
+	uint8_t flags, nb;
+
+	if (chnRead(con->sdu, &flags, 1) != 1)
+		return;
+
+	bbio_perf_u32(con, BBIO_PERF_MS(perf_elapsed_cycles()));
+
+	perf_isr_get(&isr);
+	bbio_perf_u32(con, isr.count);
+	bbio_perf_u32(con, BBIO_PERF_MS(isr.cycles));
+	bbio_perf_u32(con, isr.cycles_max);
+
+	bbio_perf_u32(con, con->perf.usb_tx_bytes);
+	bbio_perf_u32(con, con->perf.usb_tx_hwm);
+	bbio_perf_u32(con, con->sdu->obqueue.bn);
+
+	bbio_perf_u32(con, pool_stats_used_max());
+	bbio_perf_u32(con, POOL_BLOCK_NUMBER);
+
+	for (nb = 0; perf_mode_slot(nb) != NULL; nb++);
+	cprint(con, (char *)&nb, 1);
+	for (nb = 0; (slot = perf_mode_slot(nb)) != NULL; nb++) {
+		bbio_perf_name(con, tl_dict[slot->token].tokenstr,
+			       BBIO_PERF_MODE_NAME_LEN);
+		bbio_perf_u32(con, slot->cnt.bytes_in);
+		bbio_perf_u32(con, slot->cnt.bytes_out);
+		bbio_perf_u32(con, slot->cnt.commands);
+		bbio_perf_u32(con, slot->cnt.errors);
+		bbio_perf_u32(con, slot->cnt.overruns);
+	}
+
+	/* Sent threads number is kept if threads are created or ended meanwhile */
+	nb = 0;
+	tp = chRegFirstThread();
+	do {
+		nb++;
+		tp = chRegNextThread(tp);
+	} while (tp != NULL);
+	cprint(con, (char *)&nb, 1);
+	tp = chRegFirstThread();
+	do {
+		if (nb > 0) {
+			bbio_perf_name(con, tp->name, BBIO_PERF_THREAD_NAME_LEN);
+			bbio_perf_u32(con, BBIO_PERF_MS(tp->perf_cycles));
+			nb--;
+		}
+		tp = chRegNextThread(tp);
+	} while (tp != NULL);
+	/* Threads ended since count */
+	while (nb > 0) {
+		bbio_perf_name(con, NULL, BBIO_PERF_THREAD_NAME_LEN);
+		bbio_perf_u32(con, 0);
+		nb--;
+	}
+
+	if (flags & BBIO_PERF_CLEAR)
+		perf_clear(con);
+}
@@ -26,7 +26,13 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_spi.h"
 #include "bsp_spi.h"
+#include "usb_tx.h"
+#include "microsd.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_spi_sniff.h"
+#include "hydrabus_spi_flash.h"
+
+#define BBIO_SPI_SNIFF_FILE "spi_sniff.pcapng"
 
 void bbio_spi_init_proto_default(t_hydra_console *con)
 {
@@ -87,6 +93,250 @@ void bbio_spi_sniff(t_hydra_console *con)
 	status = bsp_spi_deinit(BSP_DEV_SPI2);
 }
 
+/*
+ * DMA sniffer, command is followed by one flags byte
+ * (BBIO_SPI_SNIFF_TO_SD writes a pcapng in BBIO_SPI_SNIFF_FILE).
+ * Status is sent then records (see hydrabus_spi_sniff.h) until a byte is
+ * received, with SD status, frames and overruns (uint32_t LE) are sent
+ * when sniffer is stopped.
+ */
+static void bbio_spi_sniff_dma(t_hydra_console *con)
+{
+	t_spi_sniff_stats stats;
+	FIL outfile;
+	uint8_t flags, status;
+
+	if(chnRead(con->sdu, &flags, 1) != 1) {
+		return;
+	}
+
+	if(flags & BBIO_SPI_SNIFF_TO_SD) {
+		if(file_open(&outfile, BBIO_SPI_SNIFF_FILE, 'w') == FALSE) {
+			cprint(con, "\x00", 1);
+			return;
+		}
+		f_truncate(&outfile);
+	}
+
+	if(spi_sniff_start(con)) {
+		cprint(con, "\x01", 1);
+		if(flags & BBIO_SPI_SNIFF_TO_SD) {
+			spi_sniff_run(con, SPI_SNIFF_OUT_FILE, &outfile, &stats);
+		} else {
+			spi_sniff_run(con, SPI_SNIFF_OUT_USB, NULL, &stats);
+		}
+	} else {
+		cprint(con, "\x00", 1);
+		if(flags & BBIO_SPI_SNIFF_TO_SD) {
+			file_close(&outfile);
+			flags &= ~BBIO_SPI_SNIFF_TO_SD;
+		}
+	}
+	spi_sniff_stop(con);
+
+	if(flags & BBIO_SPI_SNIFF_TO_SD) {
+		status = file_close(&outfile) ? 1 : 0;
+		cprint(con, (char *)&status, 1);
+		cprint(con, (char *)&stats.nb_frames, 4);
+		cprint(con, (char *)&stats.nb_overruns, 4);
+	}
+}
+
+/* Send status then read SPI data directly in USB output buffers */
+static void bbio_spi_read_usb(t_hydra_console *con, uint32_t to_rx)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *out;
+	uint32_t out_size, idx, n;
+
+	out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+	if(out == NULL) {
+		return;
+	}
+	out[0] = 1;
+	idx = 1;
+	while(to_rx > 0) {
+		if(idx == out_size) {
+			usb_tx_submit(con, idx);
+			out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+			if(out == NULL) {
+				return;
+			}
+			idx = 0;
+		}
+		n = MIN(to_rx, out_size - idx);
+		bsp_spi_read_u8(proto->dev_num, out+idx, n);
+		idx += n;
+		to_rx -= n;
+	}
+	usb_tx_submit(con, idx);
+}
+
+/*
+ * Send 0x01 then JEDEC ID(3), SFDP(1), address bytes(1), size(4),
+ * page size(2) and erase types size(4)/opcode(1) (smallest first, size 0
+ * if unused), 0x00 if no memory is found.
+ */
+static void bbio_spi_flash_id(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_spi_flash flash;
+	uint32_t idx;
+	int i;
+
+	if(!spi_flash_probe(proto->dev_num, &flash)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	buf[0] = 1;
+	memcpy(&buf[1], flash.jedec_id, 3);
+	buf[4] = flash.sfdp;
+	buf[5] = flash.addr_bytes;
+	bbio_put_be32(&buf[6], flash.size);
+	buf[10] = flash.page_size >> 8;
+	buf[11] = flash.page_size;
+	idx = 12;
+	for(i = 0; i < SPI_FLASH_ERASE_TYPES; i++) {
+		bbio_put_be32(&buf[idx], flash.erase_size[i]);
+		buf[idx + 4] = flash.erase_opcode[i];
+		idx += 5;
+	}
+	cprint(con, (char *)buf, idx);
+}
+
+/* Read address(4) and size(4), probe memory and check bounds */
+static bool bbio_spi_flash_params(t_hydra_console *con, uint8_t *buf,
+				  t_spi_flash *flash, uint32_t *addr, uint32_t *size)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	chnRead(con->sdu, buf, 8);
+	*addr = bbio_get_be32(&buf[0]);
+	*size = bbio_get_be32(&buf[4]);
+
+	if(!spi_flash_probe(proto->dev_num, flash)) {
+		return FALSE;
+	}
+	return (*addr < flash->size) && (*size <= flash->size - *addr);
+}
+
+/*
+ * Send 0x01 then size bytes read from address in one continuous read,
+ * followed by CRC-32 of data (4 bytes), 0x00 on error.
+ */
+static void bbio_spi_flash_read(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_spi_flash flash;
+	uint32_t addr, size, crc, out_size, idx, n;
+	uint8_t *out;
+
+	if(!bbio_spi_flash_params(con, buf, &flash, &addr, &size)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+	if(out == NULL) {
+		return;
+	}
+	out[0] = 1;
+	idx = 1;
+	crc = 0;
+	spi_flash_read_open(proto->dev_num, &flash, addr);
+	while(size > 0) {
+		if(idx == out_size) {
+			usb_tx_submit(con, idx);
+			out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+			if(out == NULL) {
+				spi_flash_read_close(proto->dev_num);
+				return;
+			}
+			idx = 0;
+		}
+		n = MIN(size, out_size - idx);
+		bsp_spi_read_u8(proto->dev_num, out+idx, n);
+		crc = spi_flash_crc32(crc, out+idx, n);
+		idx += n;
+		size -= n;
+	}
+	spi_flash_read_close(proto->dev_num);
+	usb_tx_submit(con, idx);
+
+	bbio_put_be32(buf, crc);
+	cprint(con, (char *)buf, 4);
+}
+
+/*
+ * Program a streamed image, parameters are address(4), size(4) and flags(1).
+ * 0x01 is sent when the image can be sent (0x00 otherwise), then one status
+ * byte per SPI_FLASH_CHUNK_SIZE chunk of image (last one may be shorter)
+ * when it is programmed and the CRC-32 of data programmed (4 bytes) at the
+ * end.
+ * After an error, remaining chunks are read and acknowledged with 0x00 so
+ * the host does not need to stop streaming.
+ */
+static void bbio_spi_flash_write(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_spi_flash flash;
+	t_spi_flash_write wr;
+	uint32_t addr, size, nb;
+	uint8_t flags, wr_flags;
+	bool ok;
+
+	ok = bbio_spi_flash_params(con, tx_data, &flash, &addr, &size);
+	chnRead(con->sdu, &flags, 1);
+
+	wr_flags = 0;
+	if(flags & BBIO_SPI_FLASH_ERASE_FLAG) {
+		wr_flags |= SPI_FLASH_WRITE_ERASE;
+	}
+	if(flags & BBIO_SPI_FLASH_VERIFY_FLAG) {
+		wr_flags |= SPI_FLASH_WRITE_VERIFY;
+	}
+	if(!ok || !spi_flash_write_start(&flash, &wr, addr, size, wr_flags)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	cprint(con, "\x01", 1);
+
+	while(size > 0) {
+		nb = MIN(size, SPI_FLASH_CHUNK_SIZE);
+		chnRead(con->sdu, tx_data, nb);
+		size -= nb;
+		if(ok) {
+			ok = spi_flash_write_chunk(proto->dev_num, &flash, &wr,
+						   tx_data, nb, rx_data) == BSP_OK;
+		}
+		cprint(con, ok ? "\x01" : "\x00", 1);
+	}
+
+	bbio_put_be32(tx_data, wr.crc);
+	cprint(con, (char *)tx_data, 4);
+}
+
+/* Erase address(4) and size(4), both aligned on smallest erase size */
+static void bbio_spi_flash_erase(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_spi_flash flash;
+	uint32_t addr, size, mask;
+
+	if(!bbio_spi_flash_params(con, buf, &flash, &addr, &size)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	mask = flash.erase_size[0] - 1;
+	if((addr & mask) || (size & mask) ||
+	   spi_flash_erase(proto->dev_num, &flash, addr, size) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	cprint(con, "\x01", 1);
+}
+
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_SPI_HEADER, 4);
@@ -137,6 +387,21 @@ void bbio_mode_spi(t_hydra_console *con)
 			case BBIO_SPI_SNIFF_CS_HIGH:
 				bbio_spi_sniff(con);
 				break;
+			case BBIO_SPI_SNIFF_DMA:
+				bbio_spi_sniff_dma(con);
+				break;
+			case BBIO_SPI_FLASH_ID:
+				bbio_spi_flash_id(con, rx_data);
+				break;
+			case BBIO_SPI_FLASH_READ:
+				bbio_spi_flash_read(con, rx_data);
+				break;
+			case BBIO_SPI_FLASH_WRITE:
+				bbio_spi_flash_write(con, tx_data, rx_data);
+				break;
+			case BBIO_SPI_FLASH_ERASE:
+				bbio_spi_flash_erase(con, rx_data);
+				break;
 			case BBIO_SPI_WRITE_READ:
 			case BBIO_SPI_WRITE_READ_NCS:
 				chnRead(con->sdu, rx_data, 4);
@@ -165,24 +430,10 @@ void bbio_mode_spi(t_hydra_console *con)
 						i+=255;
 					}
 				}
-				i=0;
-				while(i<to_rx) {
-					if((to_rx-i) >= 255) {
-						bsp_spi_read_u8(proto->dev_num,
-						                rx_data+i,
-						                255);
-					} else {
-						bsp_spi_read_u8(proto->dev_num,
-						                rx_data+i,
-						                to_rx-i);
-					}
-					i+=255;
-				}
+				bbio_spi_read_usb(con, to_rx);
 				if(bbio_subcommand == BBIO_SPI_WRITE_READ) {
 					bsp_spi_unselect(proto->dev_num);
 				}
-				cprint(con, "\x01", 1);
-				cprint(con, (char *)rx_data, to_rx);
 				break;
 			case BBIO_SPI_AVR:
 				cprint(con, "\x01", 1);
@@ -0,0 +1,274 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "bsp.h"
+#include "ff.h"
+#include "microsd.h"
+
+#include "hydrabus_edge.h"
+
+/*
+ * GPIO edge recorder: each selected pin raises an EXTI interrupt on both
+ * edges, the interrupt stores (pin, level, DWT timestamp) in a lock-free
+ * ring and the console thread streams records to USB or to a file on SD
+ * card and keeps per pin statistics.
+ * The 32bits DWT timestamps are extended to 64bits when they are read, a
+ * record shall be read less than 2^32 cycles (25.56s) after the edge.
+ */
+
+#define EDGE_CYCLES_PER_US (STM32_HCLK / 1000000)
+#define EDGE_NB_PINS (16)
+#define EDGE_FILE_BUF_SIZE (4096)
+#define EDGE_LINE_MAX (48)
+
+typedef struct {
+	uint32_t nb_rising;
+	uint32_t nb_falling;
+	uint64_t last_ts;
+	uint64_t min_dt;
+	uint64_t max_dt;
+	uint64_t sum_dt;
+} t_edge_stats;
+
+static ioportid_t const edge_ports[EDGE_NB_PORTS] = { GPIOA, GPIOB, GPIOC };
+
+static t_edge_ring edge_ring HOT_DATA;
+static t_edge_stats edge_stats[EDGE_NB_PORTS][EDGE_NB_PINS] HOT_DATA;
+static bool edge_busy = false;
+
+static FIL edge_file;
+static filename_t edge_filename;
+static uint8_t edge_file_buf[EDGE_FILE_BUF_SIZE];
+
+HOT_FUNC
+static void edge_cb(void *arg)
+{
+	t_edge_record rec;
+	uint32_t id;
+
+	rec.timestamp = bsp_get_cyclecounter();
+	id = (uint32_t)arg;
+	rec.port = id >> 4;
+	rec.pin = id & 0x0F;
+	rec.level = palReadPad(edge_ports[rec.port], rec.pin);
+	rec.reserved = 0;
+	edge_ring_push(&edge_ring, &rec);
+}
+
+static void edge_events(uint16_t *gpio, bool enable)
+{
+	uint32_t port, pin;
+
+	for (port = 0; port < EDGE_NB_PORTS; port++) {
+		for (pin = 0; pin < EDGE_NB_PINS; pin++) {
+			if (!(gpio[port] & (1 << pin)))
+				continue;
+			if (enable) {
+				palEnablePadEvent(edge_ports[port], pin, PAL_EVENT_MODE_BOTH_EDGES);
+				palSetPadCallback(edge_ports[port], pin, edge_cb,
+						  (void *)((port << 4) | pin));
+			} else {
+				palDisablePadEvent(edge_ports[port], pin);
+			}
+		}
+	}
+}
+
+static bool edge_file_create(void)
+{
+	uint32_t i;
+	FRESULT err;
+
+	if (!is_fs_ready()) {
+		if (mount() != 0)
+			return false;
+	}
+
+	err = FR_EXIST;
+	for (i = 0; i < 999; i++) {
+		snprintf(edge_filename.filename, FILENAME_SIZE, "0:edge%ld.csv", i);
+		err = f_open(&edge_file, edge_filename.filename, FA_WRITE | FA_CREATE_NEW);
+		if (err != FR_EXIST)
+			break;
+	}
+	return err == FR_OK;
+}
+
+static bool edge_file_write(uint32_t len)
+{
+	UINT written;
+
+	if (f_write(&edge_file, edge_file_buf, len, &written) != FR_OK)
+		return false;
+	return written == len;
+}
+
+static void edge_stats_update(t_edge_record *rec, uint64_t ts)
+{
+	t_edge_stats *st;
+	uint64_t dt;
+
+	st = &edge_stats[rec->port][rec->pin];
+	if ((st->nb_rising + st->nb_falling) > 0) {
+		dt = ts - st->last_ts;
+		if (dt < st->min_dt)
+			st->min_dt = dt;
+		if (dt > st->max_dt)
+			st->max_dt = dt;
+		st->sum_dt += dt;
+	}
+	st->last_ts = ts;
+	if (rec->level)
+		st->nb_rising++;
+	else
+		st->nb_falling++;
+}
+
+static void edge_stats_print(t_hydra_console *con, uint16_t *gpio, uint64_t duration,
+			     uint32_t nb_records)
+{
+	t_edge_stats *st;
+	uint32_t port, pin, nb;
+
+	cprintf(con, "%ld records in %ld ms, %ld lost\r\n", nb_records,
+		(uint32_t)(duration / (EDGE_CYCLES_PER_US * 1000)), edge_ring.nb_lost);
+	cprintf(con, "Pin   rising  falling   min(us)   avg(us)   max(us)\r\n");
+	for (port = 0; port < EDGE_NB_PORTS; port++) {
+		for (pin = 0; pin < EDGE_NB_PINS; pin++) {
+			if (!(gpio[port] & (1 << pin)))
+				continue;
+			st = &edge_stats[port][pin];
+			nb = st->nb_rising + st->nb_falling;
+			cprintf(con, "P%c%-2ld %8ld %8ld", port + 'A', pin,
+				st->nb_rising, st->nb_falling);
+			if (nb > 1) {
+				cprintf(con, " %9ld %9ld %9ld\r\n",
+					(uint32_t)(st->min_dt / EDGE_CYCLES_PER_US),
+					(uint32_t)(st->sum_dt / (nb - 1) / EDGE_CYCLES_PER_US),
+					(uint32_t)(st->max_dt / EDGE_CYCLES_PER_US));
+			} else {
+				cprintf(con, "         -         -         -\r\n");
+			}
+		}
+	}
+}
+
+void gpio_edge_record(t_hydra_console *con, uint16_t *gpio, bool to_file)
+{
+	t_edge_record rec;
+	uint64_t start, now, ts;
+	uint32_t port, pin, lines, sec, us, nb_records, buf_idx;
+	char line[EDGE_LINE_MAX];
+	int len;
+	bool error;
+
+	/* One EXTI line per pin number: PA1 and PB1 cannot be recorded together */
+	lines = 0;
+	for (port = 0; port < EDGE_NB_PORTS; port++) {
+		if (lines & gpio[port]) {
+			cprintf(con, "Pins with same number on different ports cannot be recorded together.\r\n");
+			return;
+		}
+		lines |= gpio[port];
+	}
+
+	chSysLock();
+	if (edge_busy) {
+		chSysUnlock();
+		cprintf(con, "Edge recorder already used by other console.\r\n");
+		return;
+	}
+	edge_busy = true;
+	chSysUnlock();
+
+	if (to_file) {
+		if (!edge_file_create()) {
+			cprintf(con, "Unable to create file on SD card.\r\n");
+			edge_busy = false;
+			return;
+		}
+		cprintf(con, "Recording to %s\r\n", edge_filename.filename);
+		buf_idx = snprintf((char *)edge_file_buf, EDGE_FILE_BUF_SIZE, "time_s,pin,level\n");
+	} else {
+		buf_idx = 0;
+	}
+
+	memset(edge_stats, 0, sizeof(edge_stats));
+	for (port = 0; port < EDGE_NB_PORTS; port++) {
+		for (pin = 0; pin < EDGE_NB_PINS; pin++)
+			edge_stats[port][pin].min_dt = UINT64_MAX;
+	}
+	edge_ring_init(&edge_ring);
+	nb_records = 0;
+	error = false;
+
+	cprintf(con, "Interrupt by pressing user button.\r\n");
+	start = bsp_get_cyclecounter64();
+	edge_events(gpio, true);
+
+	while (!hydrabus_ubtn() && !error) {
+		if (!edge_ring_pop(&edge_ring, &rec)) {
+			/* Keep the 64bits cycle counter up to date when idle */
+			bsp_get_cyclecounter64();
+			chThdSleepMilliseconds(1);
+			continue;
+		}
+		/* Read after the record so it is not older than its timestamp */
+		now = bsp_get_cyclecounter64();
+		ts = now - (uint32_t)((uint32_t)now - rec.timestamp) - start;
+		edge_stats_update(&rec, ts);
+		nb_records++;
+
+		sec = (uint32_t)(ts / STM32_HCLK);
+		us = (uint32_t)((ts % STM32_HCLK) / EDGE_CYCLES_PER_US);
+		if (to_file) {
+			len = snprintf((char *)&edge_file_buf[buf_idx], EDGE_LINE_MAX,
+				       "%ld.%06ld,P%c%ld,%d\n", sec, us, rec.port + 'A',
+				       (uint32_t)rec.pin, rec.level);
+			buf_idx += len;
+			if (buf_idx > (EDGE_FILE_BUF_SIZE - EDGE_LINE_MAX)) {
+				error = !edge_file_write(buf_idx);
+				buf_idx = 0;
+			}
+		} else {
+			len = snprintf(line, EDGE_LINE_MAX, "%5ld.%06ld P%c%-2ld %d\r\n",
+				       sec, us, rec.port + 'A',
+				       (uint32_t)rec.pin, rec.level);
+			cprint(con, line, len);
+		}
+	}
+
+	edge_events(gpio, false);
+	now = bsp_get_cyclecounter64();
+
+	if (to_file) {
+		if (!error && (buf_idx > 0))
+			error = !edge_file_write(buf_idx);
+		if (f_close(&edge_file) != FR_OK)
+			error = true;
+		if (error)
+			cprintf(con, "Error writing %s\r\n", edge_filename.filename);
+	}
+
+	edge_stats_print(con, gpio, now - start, nb_records);
+	edge_busy = false;
+}
@@ -0,0 +1,89 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_EDGE_H_
+#define _HYDRABUS_EDGE_H_
+
+#include "common.h"
+
+/* Number of records in ring, shall be a power of 2 (8 bytes per record) */
+#define EDGE_RING_SIZE (1024)
+#define EDGE_RING_MASK (EDGE_RING_SIZE - 1)
+
+#define EDGE_NB_PORTS (3) /* PA, PB, PC */
+
+typedef struct {
+	uint32_t timestamp; /* DWT cycle counter at interrupt entry */
+	uint8_t port; /* 0=PA, 1=PB, 2=PC */
+	uint8_t pin;
+	uint8_t level; /* Pin level read after the edge */
+	uint8_t reserved;
+} t_edge_record;
+
+/*
+ * Single producer (EXTI interrupts, all at the same priority so they do not
+ * preempt each other) / single consumer (recorder thread) lock-free ring.
+ * head is only written by producer, tail only by consumer, indexes are free
+ * running and wrap at 2^32.
+ */
+typedef struct {
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t nb_lost; /* Records dropped because ring was full */
+	t_edge_record records[EDGE_RING_SIZE];
+} t_edge_ring;
+
+static inline void edge_ring_init(t_edge_ring *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->nb_lost = 0;
+}
+
+static inline void edge_ring_push(t_edge_ring *ring, const t_edge_record *rec)
+{
+	uint32_t head;
+
+	head = ring->head;
+	if ((head - ring->tail) >= EDGE_RING_SIZE) {
+		ring->nb_lost++;
+		return;
+	}
+	ring->records[head & EDGE_RING_MASK] = *rec;
+	/* Record shall be written before it is published */
+	__asm__ volatile("" ::: "memory");
+	ring->head = head + 1;
+}
+
+static inline bool edge_ring_pop(t_edge_ring *ring, t_edge_record *rec)
+{
+	uint32_t tail;
+
+	tail = ring->tail;
+	if (tail == ring->head)
+		return false;
+	*rec = ring->records[tail & EDGE_RING_MASK];
+	/* Record shall be read before its slot is released */
+	__asm__ volatile("" ::: "memory");
+	ring->tail = tail + 1;
+	return true;
+}
+
+void gpio_edge_record(t_hydra_console *con, uint16_t *gpio, bool to_file);
+
+#endif /* _HYDRABUS_EDGE_H_ */
@@ -0,0 +1,419 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hydrabus.h"
+#include "bsp.h"
+#include "usb_tx.h"
+#include "hydrabus_flash_nand.h"
+
+#define NAND_OP_READ0		(0x00)
+#define NAND_OP_READ1		(0x01) /* Small page, second half */
+#define NAND_OP_READOOB		(0x50) /* Small page, spare area */
+#define NAND_OP_READSTART	(0x30)
+#define NAND_OP_READID		(0x90)
+#define NAND_OP_PARAM		(0xEC)
+
+#define NAND_SMALL_PAGE_SIZE	(512)
+
+static void nand_command(uint8_t cmd)
+{
+	flash_write_command(NULL, cmd);
+}
+
+/* Write nb address cycles, LSB first */
+static void nand_address(uint32_t addr, uint32_t nb)
+{
+	uint32_t i;
+
+	for (i = 0; i < nb; i++)
+		flash_write_address(NULL, addr >> (8 * i));
+}
+
+static bool nand_wait_ready(void)
+{
+	uint32_t tickstart;
+
+	/* tWB: R/B# goes low up to 100ns after WE# high */
+	DelayUs(1);
+
+	tickstart = HAL_GetTick();
+	while (!(GPIOB->IDR & (1 << FLASH_READ_BUSY))) {
+		if ((HAL_GetTick() - tickstart) >= NAND_TIMEOUT_MAX)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Read nb_data bytes at current column, data pins are set in input mode
+ * once then only RE# is toggled (BSRR) for each byte.
+ */
+HOT_FUNC
+void nand_read_data(uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	GPIOC->MODER &= 0xFFFF0000;
+	GPIOC->PUPDR &= 0xFFFF0000;
+
+	for (i = 0; i < nb_data; i++) {
+		GPIOB->BSRR.H.clear = (1 << FLASH_READ_ENABLE);
+		delay_tREA();
+		rx_data[i] = GPIOC->IDR;
+		GPIOB->BSRR.H.set = (1 << FLASH_READ_ENABLE);
+	}
+}
+
+/*
+ * Select chip and load page in data register, data is read from column
+ * with nand_read_data() until nand_page_close().
+ */
+bool nand_page_open(const flash_config_t *geo, uint32_t page, uint32_t column)
+{
+	flash_chip_en_low();
+
+	if (geo->col_cycles == 1) {
+		/* Small page: area is selected by the read command */
+		if (column < 256) {
+			nand_command(NAND_OP_READ0);
+		} else if (column < NAND_SMALL_PAGE_SIZE) {
+			nand_command(NAND_OP_READ1);
+			column -= 256;
+		} else {
+			nand_command(NAND_OP_READOOB);
+			column -= NAND_SMALL_PAGE_SIZE;
+		}
+		nand_address(column, 1);
+		nand_address(page, geo->row_cycles);
+	} else {
+		nand_command(NAND_OP_READ0);
+		nand_address(column, geo->col_cycles);
+		nand_address(page, geo->row_cycles);
+		nand_command(NAND_OP_READSTART);
+	}
+
+	if (!nand_wait_ready()) {
+		flash_chip_en_high();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void nand_page_close(void)
+{
+	flash_chip_en_high();
+}
+
+/* Read page data and OOB (nand_page_total() bytes) */
+bool nand_read_page(const flash_config_t *geo, uint32_t page, uint8_t *rx_data)
+{
+	if (!nand_page_open(geo, page, 0))
+		return FALSE;
+	nand_read_data(rx_data, nand_page_total(geo));
+	nand_page_close();
+	return TRUE;
+}
+
+/* Address cycles are deduced from geometry like for most legacy chips */
+bool nand_set_geometry(flash_config_t *geo, uint32_t page_size, uint32_t oob_size,
+		       uint32_t pages_per_block, uint32_t nb_blocks)
+{
+	if (page_size < NAND_SMALL_PAGE_SIZE || (page_size & (page_size - 1)) ||
+	    (page_size + oob_size) > NAND_PAGE_MAX)
+		return FALSE;
+	if (pages_per_block < 2 || (pages_per_block & (pages_per_block - 1)))
+		return FALSE;
+	if (nb_blocks == 0)
+		return FALSE;
+
+	geo->page_size = page_size;
+	geo->oob_size = oob_size;
+	geo->pages_per_block = pages_per_block;
+	geo->nb_blocks = nb_blocks;
+	geo->col_cycles = (page_size > NAND_SMALL_PAGE_SIZE) ? 2 : 1;
+	geo->row_cycles = ((pages_per_block * nb_blocks) > 0x10000) ? 3 : 2;
+	return TRUE;
+}
+
+static uint16_t nand_onfi_crc16(const uint8_t *data, uint32_t len)
+{
+	uint16_t crc;
+	int i;
+
+	crc = 0x4F4E;
+	while (len--) {
+		crc ^= *data++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
+	}
+	return crc;
+}
+
+static uint32_t nand_get_le32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/* Copy a space padded ONFI string */
+static void nand_onfi_string(char *out, const uint8_t *data, uint32_t len)
+{
+	memcpy(out, data, len);
+	out[len] = 0;
+	while (len > 0 && out[len - 1] == ' ')
+		out[--len] = 0;
+}
+
+/*
+ * Read ONFI parameter page (first copy with a valid CRC) in param
+ * (NAND_ONFI_PARAM_SIZE * NAND_ONFI_PARAM_COPIES bytes buffer) and set
+ * geometry from it.
+ * Return FALSE if chip is not ONFI or no copy is valid.
+ */
+bool nand_read_onfi(flash_config_t *geo, t_nand_onfi *onfi, uint8_t *param)
+{
+	uint8_t *copy;
+	uint16_t crc;
+	uint32_t i;
+	bool ok;
+
+	flash_chip_en_low();
+	nand_command(NAND_OP_READID);
+	nand_address(0x20, 1);
+	DelayUs(1); /* tWHR */
+	nand_read_data(param, 4);
+	if (memcmp(param, "ONFI", 4) != 0) {
+		flash_chip_en_high();
+		return FALSE;
+	}
+
+	nand_command(NAND_OP_PARAM);
+	nand_address(0x00, 1);
+	ok = nand_wait_ready();
+	if (ok)
+		nand_read_data(param, NAND_ONFI_PARAM_SIZE * NAND_ONFI_PARAM_COPIES);
+	flash_chip_en_high();
+	if (!ok)
+		return FALSE;
+
+	for (i = 0; i < NAND_ONFI_PARAM_COPIES; i++) {
+		copy = &param[i * NAND_ONFI_PARAM_SIZE];
+		crc = copy[254] | (copy[255] << 8);
+		if (memcmp(copy, "ONFI", 4) == 0 && nand_onfi_crc16(copy, 254) == crc)
+			break;
+	}
+	if (i == NAND_ONFI_PARAM_COPIES)
+		return FALSE;
+	if (i > 0)
+		memcpy(param, copy, NAND_ONFI_PARAM_SIZE);
+
+	nand_onfi_string(onfi->manufacturer, &param[32], 12);
+	nand_onfi_string(onfi->model, &param[44], 20);
+
+	/* Blocks of all LUNs are addressed as one array */
+	if (!nand_set_geometry(geo, nand_get_le32(&param[80]),
+			       param[84] | (param[85] << 8),
+			       nand_get_le32(&param[92]),
+			       nand_get_le32(&param[96]) * param[100]))
+		return FALSE;
+	if ((param[101] & 0x0F) && (param[101] >> 4)) {
+		geo->row_cycles = param[101] & 0x0F;
+		geo->col_cycles = param[101] >> 4;
+	}
+	return TRUE;
+}
+
+/*
+ * Factory bad block marker is the first spare byte (sixth on small page
+ * chips) of first, second or last page of block, any value but 0xFF.
+ */
+bool nand_block_is_bad(const flash_config_t *geo, uint32_t block)
+{
+	uint32_t pages[3];
+	uint32_t column, i;
+	uint8_t marker;
+
+	pages[0] = block * geo->pages_per_block;
+	pages[1] = pages[0] + 1;
+	pages[2] = pages[0] + geo->pages_per_block - 1;
+	column = geo->page_size;
+	if (geo->page_size == NAND_SMALL_PAGE_SIZE)
+		column += 5;
+
+	for (i = 0; i < 3; i++) {
+		if (!nand_page_open(geo, pages[i], column))
+			return TRUE;
+		nand_read_data(&marker, 1);
+		nand_page_close();
+		if (marker != 0xFF)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Stream pages (data + OOB) read directly in USB output buffers, buffers are
+ * sent by USB while next one is read.
+ * Each page is sent as 0x01 + data, 0x00 is sent on error or abort (UBTN).
+ */
+bool nand_read_pages_usb(t_hydra_console *con, const flash_config_t *geo,
+			 uint32_t page, uint32_t nb_pages)
+{
+	uint8_t *out;
+	uint32_t out_size, idx, remain, n;
+	bool ok;
+
+	out = NULL;
+	out_size = 0;
+	idx = 0;
+	ok = TRUE;
+	while (nb_pages > 0) {
+		if (hydrabus_ubtn() || !nand_page_open(geo, page, 0)) {
+			ok = FALSE;
+			break;
+		}
+		remain = nand_page_total(geo) + 1;
+		while (remain > 0) {
+			if (idx == out_size) {
+				if (out != NULL)
+					usb_tx_submit(con, idx);
+				out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+				if (out == NULL) {
+					nand_page_close();
+					return FALSE;
+				}
+				idx = 0;
+			}
+			if (remain == nand_page_total(geo) + 1) {
+				out[idx++] = 1;
+				remain--;
+				continue;
+			}
+			n = MIN(remain, out_size - idx);
+			nand_read_data(out + idx, n);
+			idx += n;
+			remain -= n;
+		}
+		nand_page_close();
+		page++;
+		nb_pages--;
+	}
+	if (out != NULL)
+		usb_tx_submit(con, idx);
+	if (!ok)
+		cprint(con, "\x00", 1);
+	return ok;
+}
+
+typedef struct {
+	FIL *file;
+	mailbox_t mb_full;
+	mailbox_t mb_free;
+	msg_t mb_full_buf[2];
+	msg_t mb_free_buf[2];
+	uint8_t *buf[2];
+	uint32_t len[2];
+	bool error;
+} t_nand_writer;
+
+/* Write filled buffers in file, stops on a negative buffer index */
+static THD_FUNCTION(nand_writer_thread, arg)
+{
+	t_nand_writer *w = (t_nand_writer *)arg;
+	msg_t idx;
+	UINT written;
+
+	while (chMBFetchTimeout(&w->mb_full, &idx, TIME_INFINITE) == MSG_OK && idx >= 0) {
+		if (!w->error) {
+			if (f_write(w->file, w->buf[idx], w->len[idx], &written) != FR_OK ||
+			    written != w->len[idx])
+				w->error = TRUE;
+		}
+		chMBPostTimeout(&w->mb_free, idx, TIME_INFINITE);
+	}
+}
+
+/*
+ * Read pages (data + OOB) in two buffers, a writer thread writes a buffer in
+ * file (SDIO DMA) while the other one is read from NAND.
+ */
+bool nand_read_pages_file(const flash_config_t *geo, uint32_t page, uint32_t nb_pages,
+			  FIL *file)
+{
+	t_nand_writer w;
+	thread_t *thread;
+	uint32_t total, pages_per_chunk, nb, i;
+	msg_t idx;
+	bool ok;
+
+	total = nand_page_total(geo);
+	pages_per_chunk = NAND_CHUNK_SIZE / total;
+	if (pages_per_chunk == 0)
+		pages_per_chunk = 1;
+
+	w.file = file;
+	w.error = FALSE;
+	w.buf[0] = pool_alloc_bytes(pages_per_chunk * total);
+	w.buf[1] = pool_alloc_bytes(pages_per_chunk * total);
+	if (w.buf[0] == NULL || w.buf[1] == NULL) {
+		pool_free(w.buf[0]);
+		pool_free(w.buf[1]);
+		return FALSE;
+	}
+
+	chMBObjectInit(&w.mb_full, w.mb_full_buf, 2);
+	chMBObjectInit(&w.mb_free, w.mb_free_buf, 2);
+	chMBPostTimeout(&w.mb_free, 0, TIME_IMMEDIATE);
+	chMBPostTimeout(&w.mb_free, 1, TIME_IMMEDIATE);
+
+	/* Higher priority so file write restarts as soon as SDIO is done */
+	thread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "nand_writer",
+				     NORMALPRIO + 1, nand_writer_thread, &w);
+	if (thread == NULL) {
+		pool_free(w.buf[0]);
+		pool_free(w.buf[1]);
+		return FALSE;
+	}
+
+	ok = TRUE;
+	while (nb_pages > 0) {
+		chMBFetchTimeout(&w.mb_free, &idx, TIME_INFINITE);
+		if (w.error || hydrabus_ubtn()) {
+			ok = FALSE;
+			break;
+		}
+		nb = MIN(nb_pages, pages_per_chunk);
+		for (i = 0; ok && i < nb; i++)
+			ok = nand_read_page(geo, page + i, w.buf[idx] + i * total);
+		if (!ok)
+			break;
+
+		w.len[idx] = nb * total;
+		chMBPostTimeout(&w.mb_full, idx, TIME_INFINITE);
+		page += nb;
+		nb_pages -= nb;
+	}
+
+	chMBPostTimeout(&w.mb_full, -1, TIME_INFINITE);
+	chThdWait(thread);
+
+	pool_free(w.buf[0]);
+	pool_free(w.buf[1]);
+	return ok && !w.error;
+}
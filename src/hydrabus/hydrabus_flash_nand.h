@@ -0,0 +1,68 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_FLASH_NAND_H_
+#define _HYDRABUS_FLASH_NAND_H_
+
+#include "common.h"
+#include "ff.h"
+#include "hydrabus_mode_flash.h"
+
+/*
+ * Parallel NAND page engine (data PC0-PC7, control pins see
+ * hydrabus_mode_flash.h).
+ * Pages are read with their spare area (OOB) in a register level loop,
+ * data pins stay in input mode for the whole page.
+ */
+
+#define NAND_ONFI_PARAM_SIZE (256)
+#define NAND_ONFI_PARAM_COPIES (3)
+
+#define NAND_PAGE_MAX (16384 + 1664) /* Data + OOB */
+#define NAND_CHUNK_SIZE (8192) /* Page buffers used to write in file */
+
+/* R/B# wait (see common/chconf.h/CH_CFG_ST_FREQUENCY) */
+#define NAND_TIMEOUT_MAX (1000) /* About 100ms */
+
+typedef struct {
+	char manufacturer[12 + 1];
+	char model[20 + 1];
+} t_nand_onfi;
+
+/* Page size with OOB, 0 if geometry is not set */
+static inline uint32_t nand_page_total(const flash_config_t *geo)
+{
+	return geo->page_size + geo->oob_size;
+}
+
+bool nand_set_geometry(flash_config_t *geo, uint32_t page_size, uint32_t oob_size,
+		       uint32_t pages_per_block, uint32_t nb_blocks);
+bool nand_read_onfi(flash_config_t *geo, t_nand_onfi *onfi, uint8_t *param);
+
+bool nand_page_open(const flash_config_t *geo, uint32_t page, uint32_t column);
+void nand_read_data(uint8_t *rx_data, uint32_t nb_data);
+void nand_page_close(void);
+bool nand_read_page(const flash_config_t *geo, uint32_t page, uint8_t *rx_data);
+
+bool nand_block_is_bad(const flash_config_t *geo, uint32_t block);
+bool nand_read_pages_usb(t_hydra_console *con, const flash_config_t *geo,
+			 uint32_t page, uint32_t nb_pages);
+bool nand_read_pages_file(const flash_config_t *geo, uint32_t page, uint32_t nb_pages,
+			  FIL *file);
+
+#endif /* _HYDRABUS_FLASH_NAND_H_ */
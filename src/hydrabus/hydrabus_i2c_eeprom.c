@@ -0,0 +1,175 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_i2c_eeprom.h"
+
+/* Set memory parameters, return FALSE if they are not valid */
+bool i2c_eeprom_init(t_i2c_eeprom *eep, uint32_t dev_addr, uint32_t addr_width,
+		     uint32_t page_size)
+{
+	if (dev_addr > 0x77)
+		return FALSE;
+	if (addr_width < 1 || addr_width > I2C_EEPROM_ADDR_WIDTH_MAX)
+		return FALSE;
+	if (page_size < 1 || page_size > I2C_EEPROM_PAGE_MAX)
+		return FALSE;
+
+	eep->dev_addr = dev_addr;
+	eep->addr_width = addr_width;
+	eep->page_size = page_size;
+	return TRUE;
+}
+
+/* Device address byte (R/W bit cleared) with memory address high bits */
+static uint8_t i2c_eeprom_dev_byte(const t_i2c_eeprom *eep, uint32_t addr)
+{
+	return (eep->dev_addr | ((addr >> (8 * eep->addr_width)) & 0x07)) << 1;
+}
+
+/* Memory address bytes, MSB first */
+static void i2c_eeprom_addr_bytes(const t_i2c_eeprom *eep, uint32_t addr, uint8_t *out)
+{
+	int i;
+
+	for (i = 0; i < eep->addr_width; i++)
+		out[i] = addr >> (8 * (eep->addr_width - 1 - i));
+}
+
+/*
+ * Send START + device address until the device ACKs it (it does not during
+ * an internal write cycle), the transfer is left open on success.
+ */
+static bsp_status_t i2c_eeprom_poll(bsp_dev_i2c_t dev_num, uint8_t dev_byte)
+{
+	uint32_t tickstart;
+	uint8_t ack;
+	bsp_status_t status;
+
+	tickstart = HAL_GetTick();
+	while (1) {
+		bsp_i2c_start(dev_num);
+		status = bsp_i2c_master_write_u8(dev_num, dev_byte, &ack);
+		if (status == BSP_OK && ack)
+			return BSP_OK;
+		bsp_i2c_stop(dev_num);
+
+		if ((HAL_GetTick() - tickstart) >= I2C_EEPROM_POLL_TIMEOUT)
+			return BSP_TIMEOUT;
+	}
+}
+
+/* Wait end of last write cycle */
+bsp_status_t i2c_eeprom_wait_ready(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep)
+{
+	bsp_status_t status;
+
+	status = i2c_eeprom_poll(dev_num, eep->dev_addr << 1);
+	if (status == BSP_OK)
+		bsp_i2c_stop(dev_num);
+	return status;
+}
+
+/*
+ * Sequential read, one random read transfer per device address block
+ * (address high bits are in device address so counter may not roll over).
+ */
+bsp_status_t i2c_eeprom_read(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep,
+			     uint32_t addr, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint8_t hdr[1 + I2C_EEPROM_ADDR_WIDTH_MAX];
+	uint32_t block_size, nb, nb_ack;
+	bsp_status_t status;
+
+	block_size = 1 << (8 * eep->addr_width);
+	while (nb_data > 0) {
+		nb = block_size - (addr & (block_size - 1));
+		if (nb > nb_data)
+			nb = nb_data;
+
+		hdr[0] = i2c_eeprom_dev_byte(eep, addr);
+		i2c_eeprom_addr_bytes(eep, addr, &hdr[1]);
+
+		bsp_i2c_start(dev_num);
+		status = bsp_i2c_master_write_buf(dev_num, hdr, 1 + eep->addr_width, &nb_ack);
+		if (status == BSP_OK && nb_ack == (uint32_t)(1 + eep->addr_width)) {
+			/* Repeated START then read with NACK on last byte and STOP */
+			hdr[0] |= 1;
+			bsp_i2c_start(dev_num);
+			status = bsp_i2c_master_write_buf(dev_num, hdr, 1, &nb_ack);
+			if (status == BSP_OK && nb_ack == 1)
+				status = bsp_i2c_master_read_buf(dev_num, rx_data, nb);
+			else
+				status = BSP_ERROR;
+		} else {
+			status = BSP_ERROR;
+		}
+
+		if (status != BSP_OK) {
+			bsp_i2c_stop(dev_num);
+			return status;
+		}
+		addr += nb;
+		rx_data += nb;
+		nb_data -= nb;
+	}
+
+	return BSP_OK;
+}
+
+/*
+ * Page write, each page is started with ACK polling so the previous write
+ * cycle is finished without a fixed delay.
+ * The last write cycle is not waited (see i2c_eeprom_wait_ready()).
+ */
+bsp_status_t i2c_eeprom_write(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep,
+			      uint32_t addr, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint8_t hdr[I2C_EEPROM_ADDR_WIDTH_MAX];
+	uint32_t nb, nb_ack;
+	bsp_status_t status;
+
+	while (nb_data > 0) {
+		nb = eep->page_size - (addr % eep->page_size);
+		if (nb > nb_data)
+			nb = nb_data;
+
+		status = i2c_eeprom_poll(dev_num, i2c_eeprom_dev_byte(eep, addr));
+		if (status != BSP_OK)
+			return status;
+
+		i2c_eeprom_addr_bytes(eep, addr, hdr);
+		status = bsp_i2c_master_write_buf(dev_num, hdr, eep->addr_width, &nb_ack);
+		if (status == BSP_OK && nb_ack == eep->addr_width) {
+			status = bsp_i2c_master_write_buf(dev_num, tx_data, nb, &nb_ack);
+			if (status == BSP_OK && nb_ack != nb)
+				status = BSP_ERROR;
+		} else {
+			status = BSP_ERROR;
+		}
+		/* STOP starts the write cycle */
+		bsp_i2c_stop(dev_num);
+		if (status != BSP_OK)
+			return status;
+
+		addr += nb;
+		tx_data += nb;
+		nb_data -= nb;
+	}
+
+	return BSP_OK;
+}
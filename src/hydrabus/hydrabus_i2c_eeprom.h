@@ -0,0 +1,52 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_I2C_EEPROM_H_
+#define _HYDRABUS_I2C_EEPROM_H_
+
+#include "common.h"
+#include "bsp_i2c_master.h"
+
+/*
+ * 24Cxx style I2C memories (EEPROM, FRAM).
+ * Memory address bits above addr_width bytes are sent in the low bits of the
+ * device address (24C04/08/16 with 1 byte, AT24CM01/02 with 2 bytes).
+ */
+
+#define I2C_EEPROM_ADDR_WIDTH_MAX (2)
+#define I2C_EEPROM_PAGE_MAX (256)
+#define I2C_EEPROM_CHUNK_SIZE (4096) /* Read/write buffer used by console and BBIO */
+
+/* Write cycle ACK polling (see common/chconf.h/CH_CFG_ST_FREQUENCY) */
+#define I2C_EEPROM_POLL_TIMEOUT (500) /* About 50ms */
+
+typedef struct {
+	uint8_t dev_addr; /* 7-bit device address */
+	uint8_t addr_width; /* Memory address bytes (1 to I2C_EEPROM_ADDR_WIDTH_MAX) */
+	uint16_t page_size; /* Write page size (1 to I2C_EEPROM_PAGE_MAX) */
+} t_i2c_eeprom;
+
+bool i2c_eeprom_init(t_i2c_eeprom *eep, uint32_t dev_addr, uint32_t addr_width,
+		     uint32_t page_size);
+bsp_status_t i2c_eeprom_read(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep,
+			     uint32_t addr, uint8_t *rx_data, uint32_t nb_data);
+bsp_status_t i2c_eeprom_write(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep,
+			      uint32_t addr, uint8_t *tx_data, uint32_t nb_data);
+bsp_status_t i2c_eeprom_wait_ready(bsp_dev_i2c_t dev_num, const t_i2c_eeprom *eep);
+
+#endif /* _HYDRABUS_I2C_EEPROM_H_ */
@@ -0,0 +1,423 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "bsp.h"
+
+#include "hydrabus_lin.h"
+
+#define LIN_RX_MASK (LIN_RX_BUF_SIZE - 1)
+#define LIN_RECORDS_MASK (LIN_RECORDS_NB - 1)
+#define LIN_SYNC (0x55)
+
+/*
+ * Written by virtual timer callback and by console thread with kernel
+ * locked.
+ */
+typedef struct {
+	bsp_dev_uart_t dev;
+	bool master;
+	bool classic; /* Checksum of sent data */
+	uint32_t idle; /* Frame end (DWT cycles) */
+	uint32_t brk_bytes; /* Max bytes received between two polls */
+	uint32_t rd; /* Ring bytes read */
+	uint32_t last; /* Last byte received (DWT cycles) */
+	systime_t slot_start;
+	sysinterval_t slot_wait;
+	uint32_t slot; /* Next slot */
+	uint32_t frame_len; /* Can be above LIN_FRAME_MAX */
+	uint32_t frame_ts;
+	uint8_t frame_flags;
+	bool responded; /* Response sent or not expected for this header */
+	uint8_t frame[LIN_FRAME_MAX];
+	uint32_t head;
+	uint32_t tail;
+	t_lin_stats stats;
+	t_lin_record records[LIN_RECORDS_NB];
+} t_lin_engine;
+
+static t_lin_engine lin_eng HOT_DATA;
+static bool lin_busy = false;
+static virtual_timer_t lin_vt;
+
+/* DMA buffers in main SRAM (DMA cannot access CCM) */
+static uint8_t lin_rx_buf[LIN_RX_BUF_SIZE];
+static uint8_t lin_tx_buf[LIN_FRAME_MAX];
+
+static t_lin_slot lin_slots[LIN_SLOTS_MAX];
+static uint32_t lin_nb_slots;
+static t_lin_response lin_responses[LIN_ID_NB];
+
+uint8_t lin_checksum(uint8_t pid, const uint8_t *data, uint32_t nb_data, bool classic)
+{
+	uint32_t i, sum;
+
+	sum = classic ? 0 : pid;
+	for (i = 0; i < nb_data; i++) {
+		sum += data[i];
+		if (sum > 0xff)
+			sum -= 0xff;
+	}
+	return ~sum;
+}
+
+void lin_schedule_clear(void)
+{
+	lin_nb_slots = 0;
+}
+
+/* Scheduler shall be stopped */
+bool lin_schedule_add(const t_lin_slot *slot)
+{
+	if (lin_nb_slots >= LIN_SLOTS_MAX)
+		return FALSE;
+	if (slot->id >= LIN_ID_NB || slot->length > LIN_DATA_MAX)
+		return FALSE;
+	lin_slots[lin_nb_slots++] = *slot;
+	return TRUE;
+}
+
+uint32_t lin_schedule_get(const t_lin_slot **slots)
+{
+	*slots = lin_slots;
+	return lin_nb_slots;
+}
+
+void lin_response_clear(void)
+{
+	memset(lin_responses, 0, sizeof(lin_responses));
+}
+
+/* Scheduler shall be stopped, nb_data 0 removes response */
+bool lin_response_set(uint8_t id, const uint8_t *data, uint32_t nb_data)
+{
+	if (id >= LIN_ID_NB || nb_data > LIN_DATA_MAX)
+		return FALSE;
+	lin_responses[id].length = nb_data;
+	memcpy(lin_responses[id].data, data, nb_data);
+	return TRUE;
+}
+
+const t_lin_response *lin_response_get(uint8_t id)
+{
+	return &lin_responses[id & (LIN_ID_NB - 1)];
+}
+
+/* Index of sync byte (after break bytes) */
+static uint32_t lin_frame_sync(const t_lin_engine *eng, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n && eng->frame[i] == 0; i++);
+	return i;
+}
+
+/* Decode and queue current frame */
+HOT_FUNC
+static void lin_frame_end(t_lin_engine *eng)
+{
+	t_lin_record *rec;
+	uint32_t n, h, len;
+	const uint8_t *p;
+	uint8_t id;
+
+	if ((eng->head - eng->tail) >= LIN_RECORDS_NB) {
+		eng->stats.nb_lost++;
+		goto out;
+	}
+	rec = &eng->records[eng->head & LIN_RECORDS_MASK];
+	memset(rec, 0, sizeof(t_lin_record));
+	rec->timestamp = eng->frame_ts;
+	rec->flags = eng->frame_flags;
+
+	n = MIN(eng->frame_len, LIN_FRAME_MAX);
+	if (eng->frame_len > LIN_FRAME_MAX)
+		rec->flags |= LIN_FLAG_OVERFLOW;
+	h = lin_frame_sync(eng, n);
+	p = &eng->frame[h];
+	n -= h;
+
+	if (n < 1 || p[0] != LIN_SYNC) {
+		/* Raw bytes */
+		rec->flags |= LIN_FLAG_NO_SYNC;
+		rec->length = MIN(n, LIN_DATA_MAX);
+		memcpy(rec->data, p, rec->length);
+	} else if (n < 2) {
+		rec->flags |= LIN_FLAG_NO_RESPONSE;
+	} else {
+		rec->pid = p[1];
+		id = rec->pid & 0x3f;
+		if (lin_pid(id) != rec->pid)
+			rec->flags |= LIN_FLAG_PARITY;
+
+		if (n == 2) {
+			rec->flags |= LIN_FLAG_NO_RESPONSE;
+		} else {
+			len = n - 3;
+			if (len > LIN_DATA_MAX) {
+				rec->flags |= LIN_FLAG_OVERFLOW;
+				len = LIN_DATA_MAX;
+			}
+			rec->length = len;
+			memcpy(rec->data, &p[2], len);
+			rec->checksum = p[n - 1];
+
+			if (rec->flags & LIN_FLAG_OVERFLOW)
+				;
+			else if (id < LIN_ID_DIAG &&
+				 lin_checksum(rec->pid, rec->data, len, FALSE) == rec->checksum)
+				;
+			else if (lin_checksum(rec->pid, rec->data, len, TRUE) == rec->checksum)
+				rec->flags |= LIN_FLAG_CLASSIC;
+			else
+				rec->flags |= LIN_FLAG_CHECKSUM;
+		}
+	}
+
+	if (rec->flags & (LIN_FLAG_NO_SYNC | LIN_FLAG_PARITY | LIN_FLAG_CHECKSUM))
+		eng->stats.nb_errors++;
+	eng->stats.nb_frames++;
+	eng->head++;
+out:
+	eng->frame_len = 0;
+	eng->frame_flags = 0;
+	eng->responded = FALSE;
+}
+
+HOT_FUNC
+static void lin_frame_add(t_lin_engine *eng, uint8_t data, uint32_t now)
+{
+	if (eng->frame_len == 0)
+		eng->frame_ts = now;
+	if (eng->frame_len < LIN_FRAME_MAX)
+		eng->frame[eng->frame_len] = data;
+	if (eng->frame_len < 0xff)
+		eng->frame_len++;
+	eng->last = now;
+}
+
+/* Read ring bytes received since last poll */
+HOT_FUNC
+static void lin_rx(t_lin_engine *eng, uint32_t now)
+{
+	uint32_t wr, nb, brk, i;
+	uint8_t data;
+	bool brk_detected;
+
+	/*
+	 * Break byte (0x00 with framing error) is received just before break
+	 * is detected. LBD is read before DMA position so only bytes received
+	 * since detection (less than a poll period) can follow the break byte.
+	 * In these last bytes, a 0x00 followed by sync is taken, else a 0x00
+	 * last byte (sync not received yet). A 0x00 data byte of previous
+	 * frame or after the header is not taken.
+	 */
+	brk_detected = bsp_lin_break_detected(eng->dev);
+	wr = (LIN_RX_BUF_SIZE - bsp_uart_dma_rx_remaining(eng->dev)) & LIN_RX_MASK;
+	nb = (wr - eng->rd) & LIN_RX_MASK;
+
+	brk = nb;
+	if (brk_detected) {
+		for (i = nb; i > 0 && (nb - i) <= eng->brk_bytes; i--) {
+			if (lin_rx_buf[(eng->rd + i - 1) & LIN_RX_MASK] != 0)
+				continue;
+			if (i == nb) {
+				brk = i - 1;
+			} else if (lin_rx_buf[(eng->rd + i) & LIN_RX_MASK] == LIN_SYNC) {
+				brk = i - 1;
+				break;
+			}
+		}
+		/* Break byte read by previous poll, sync (if any) starts this one */
+		if (brk == nb && eng->frame_len > 1 && eng->frame_len <= LIN_FRAME_MAX &&
+		    eng->frame[eng->frame_len - 1] == 0 &&
+		    (nb == 0 || lin_rx_buf[eng->rd & LIN_RX_MASK] == LIN_SYNC)) {
+			eng->frame_len--;
+			lin_frame_end(eng);
+			lin_frame_add(eng, 0, eng->last);
+		}
+	}
+
+	for (i = 0; i < nb; i++) {
+		data = lin_rx_buf[eng->rd++ & LIN_RX_MASK];
+		if (i == brk && eng->frame_len > 0)
+			lin_frame_end(eng);
+		lin_frame_add(eng, data, now);
+	}
+	eng->rd &= LIN_RX_MASK;
+}
+
+/* Send slave response as soon as header is received */
+HOT_FUNC
+static void lin_respond(t_lin_engine *eng)
+{
+	const t_lin_response *resp;
+	uint32_t n, h;
+	uint8_t pid, id;
+
+	n = MIN(eng->frame_len, LIN_FRAME_MAX);
+	h = lin_frame_sync(eng, n);
+	if (n < h + 2)
+		return;
+	eng->responded = TRUE;
+	if (eng->frame[h] != LIN_SYNC || n > h + 2)
+		return;
+
+	pid = eng->frame[h + 1];
+	id = pid & 0x3f;
+	resp = &lin_responses[id];
+	if (lin_pid(id) != pid || resp->length == 0)
+		return;
+
+	memcpy(lin_tx_buf, resp->data, resp->length);
+	lin_tx_buf[resp->length] = lin_checksum(pid, resp->data, resp->length,
+						eng->classic || id >= LIN_ID_DIAG);
+	if (bsp_uart_dma_tx(eng->dev, lin_tx_buf, resp->length + 1, FALSE) == BSP_OK)
+		eng->frame_flags |= LIN_FLAG_TX;
+}
+
+/* Start next slot when its time is reached */
+HOT_FUNC
+static void lin_schedule(t_lin_engine *eng)
+{
+	const t_lin_slot *slot;
+	uint32_t n;
+	uint8_t pid;
+
+	if (chVTTimeElapsedSinceX(eng->slot_start) < eng->slot_wait)
+		return;
+
+	slot = &lin_slots[eng->slot];
+	eng->slot = (eng->slot + 1) % lin_nb_slots;
+	eng->slot_start += eng->slot_wait;
+	eng->slot_wait = TIME_MS2I(slot->period);
+
+	/* Previous frame is still on bus */
+	if (eng->frame_len > 0) {
+		eng->stats.nb_late++;
+		return;
+	}
+
+	pid = lin_pid(slot->id);
+	lin_tx_buf[0] = LIN_SYNC;
+	lin_tx_buf[1] = pid;
+	n = 2;
+	if (slot->flags & LIN_SLOT_PUBLISH) {
+		memcpy(&lin_tx_buf[2], slot->data, slot->length);
+		lin_tx_buf[2 + slot->length] = lin_checksum(pid, slot->data, slot->length,
+							    eng->classic || slot->id >= LIN_ID_DIAG);
+		n += slot->length + 1;
+	}
+
+	if (bsp_uart_dma_tx(eng->dev, lin_tx_buf, n, TRUE) != BSP_OK) {
+		eng->stats.nb_late++;
+		return;
+	}
+	eng->frame_flags = LIN_FLAG_TX;
+	eng->responded = (slot->flags & LIN_SLOT_PUBLISH) ? TRUE : FALSE;
+}
+
+HOT_FUNC
+static void lin_poll(void *arg)
+{
+	t_lin_engine *eng = &lin_eng;
+	uint32_t now;
+
+	(void)arg;
+
+	now = bsp_get_cyclecounter();
+	lin_rx(eng, now);
+	if (eng->frame_len > 0 && !eng->responded)
+		lin_respond(eng);
+	if (eng->frame_len > 0 && (now - eng->last) > eng->idle)
+		lin_frame_end(eng);
+	if (eng->master && lin_nb_slots > 0)
+		lin_schedule(eng);
+
+	chSysLockFromISR();
+	chVTSetI(&lin_vt, LIN_POLL_TICKS, lin_poll, NULL);
+	chSysUnlockFromISR();
+}
+
+/*
+ * UART shall be initialized in LIN mode, classic selects LIN 1.x checksum
+ * for sent data.
+ * Schedule is run only in master mode, response table is used in both modes.
+ */
+bool lin_start(bsp_dev_uart_t dev_num, uint32_t baudrate, bool master, bool classic)
+{
+	if (lin_busy || baudrate == 0)
+		return FALSE;
+	lin_busy = TRUE;
+
+	memset(&lin_eng, 0, sizeof(lin_eng));
+	lin_eng.dev = dev_num;
+	lin_eng.master = master;
+	lin_eng.classic = classic;
+	/* 10 bits per byte */
+	lin_eng.idle = (uint32_t)(((uint64_t)STM32_HCLK * 10 * LIN_IDLE_BYTES) / baudrate);
+	/* Poll period (one more tick of latency) plus sync byte */
+	lin_eng.brk_bytes = 2 + ((LIN_POLL_TICKS + 1) * baudrate) /
+			    (CH_CFG_ST_FREQUENCY * 10);
+
+	/* USART1 DMA streams are shared with smartcard (see bsp_uart_conf.h) */
+	if (bsp_uart_dma_rx_start(dev_num, lin_rx_buf, LIN_RX_BUF_SIZE) != BSP_OK) {
+		lin_busy = FALSE;
+		return FALSE;
+	}
+	bsp_lin_break_detected(dev_num);
+
+	chVTObjectInit(&lin_vt);
+	chSysLock();
+	lin_eng.slot_start = chVTGetSystemTimeX();
+	chVTSetI(&lin_vt, LIN_POLL_TICKS, lin_poll, NULL);
+	chSysUnlock();
+
+	return TRUE;
+}
+
+/* Get next frame, FALSE if none */
+bool lin_get(t_lin_record *rec)
+{
+	t_lin_engine *eng = &lin_eng;
+	bool found;
+
+	chSysLock();
+	found = (eng->tail != eng->head);
+	if (found)
+		*rec = eng->records[eng->tail++ & LIN_RECORDS_MASK];
+	chSysUnlock();
+
+	return found;
+}
+
+void lin_stats_get(t_lin_stats *stats)
+{
+	chSysLock();
+	*stats = lin_eng.stats;
+	chSysUnlock();
+}
+
+void lin_stop(void)
+{
+	chVTReset(&lin_vt);
+	bsp_uart_dma_stop(lin_eng.dev);
+	lin_busy = FALSE;
+}
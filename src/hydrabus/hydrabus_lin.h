@@ -0,0 +1,118 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_LIN_H_
+#define _HYDRABUS_LIN_H_
+
+#include "common.h"
+#include "bsp_uart.h"
+
+/*
+ * LIN scheduler running in a virtual timer callback every LIN_POLL_TICKS:
+ * - master: schedule slots are started on time, break is sent with SBK then
+ *   sync, protected ID and (for published slots) data with checksum by DMA.
+ * - slave: response table data is sent by DMA as soon as a header with a
+ *   known ID is received.
+ * All bus bytes (including echo of sent ones) are received in a circular
+ * DMA ring, a frame ends when bus is idle for LIN_IDLE_BYTES bytes.
+ * Frames are decoded (PID parity, classic/enhanced checksum) and queued as
+ * t_lin_record so they are not lost while console or USB is busy.
+ */
+
+#define LIN_DATA_MAX (8)
+#define LIN_ID_NB (64)
+#define LIN_SLOTS_MAX (16)
+#define LIN_RECORDS_NB (32) /* Frames not yet read, power of 2 */
+#define LIN_RX_BUF_SIZE (256) /* Power of 2 */
+#define LIN_FRAME_MAX (16) /* Break + sync + PID + data + checksum */
+#define LIN_IDLE_BYTES (5) /* Idle time ending a frame (response space included) */
+
+/* Minimal virtual timer delay (see common/chconf.h/CH_CFG_ST_TIMEDELTA) */
+#define LIN_POLL_TICKS (2) /* About 200us */
+
+/* IDs 60 to 63 always use classic checksum */
+#define LIN_ID_DIAG (60)
+
+/* t_lin_slot.flags */
+#define LIN_SLOT_PUBLISH BIT(0) /* Master sends data, otherwise a slave does */
+
+/* t_lin_record.flags */
+#define LIN_FLAG_NO_SYNC BIT(0) /* Sync byte is not 0x55 */
+#define LIN_FLAG_PARITY BIT(1) /* Bad PID parity bits */
+#define LIN_FLAG_CHECKSUM BIT(2) /* Bad checksum */
+#define LIN_FLAG_NO_RESPONSE BIT(3) /* Header without response */
+#define LIN_FLAG_CLASSIC BIT(4) /* Checksum is classic (LIN 1.x) */
+#define LIN_FLAG_OVERFLOW BIT(5) /* More than LIN_DATA_MAX data bytes */
+#define LIN_FLAG_TX BIT(6) /* Frame or response sent by scheduler */
+
+typedef struct {
+	uint8_t id;
+	uint8_t flags;
+	uint8_t length; /* Data bytes */
+	uint8_t reserved;
+	uint16_t period; /* Time before next slot (ms) */
+	uint8_t data[LIN_DATA_MAX]; /* Published data */
+} t_lin_slot;
+
+typedef struct {
+	uint8_t length; /* 0 if no response */
+	uint8_t data[LIN_DATA_MAX];
+} t_lin_response;
+
+/* Binary record (little endian) */
+typedef struct __attribute__ ((packed)) {
+	uint32_t timestamp; /* First byte received (DWT cycles) */
+	uint8_t pid; /* Protected ID */
+	uint8_t length; /* Data bytes */
+	uint8_t checksum;
+	uint8_t flags;
+	uint8_t data[LIN_DATA_MAX];
+} t_lin_record;
+
+typedef struct {
+	uint32_t nb_frames;
+	uint32_t nb_errors; /* Frames with NO_SYNC/PARITY/CHECKSUM flags */
+	uint32_t nb_lost; /* Frames dropped because queue was full */
+	uint32_t nb_late; /* Slots not sent as previous transfer was running */
+} t_lin_stats;
+
+static inline uint8_t lin_pid(uint8_t id)
+{
+	uint8_t p0, p1;
+
+	id &= 0x3f;
+	p0 = (id ^ (id >> 1) ^ (id >> 2) ^ (id >> 4)) & 1;
+	p1 = ~((id >> 1) ^ (id >> 3) ^ (id >> 4) ^ (id >> 5)) & 1;
+	return id | (p0 << 6) | (p1 << 7);
+}
+
+uint8_t lin_checksum(uint8_t pid, const uint8_t *data, uint32_t nb_data, bool classic);
+
+void lin_schedule_clear(void);
+bool lin_schedule_add(const t_lin_slot *slot);
+uint32_t lin_schedule_get(const t_lin_slot **slots);
+void lin_response_clear(void);
+bool lin_response_set(uint8_t id, const uint8_t *data, uint32_t nb_data);
+const t_lin_response *lin_response_get(uint8_t id);
+
+bool lin_start(bsp_dev_uart_t dev_num, uint32_t baudrate, bool master, bool classic);
+bool lin_get(t_lin_record *rec);
+void lin_stats_get(t_lin_stats *stats);
+void lin_stop(void);
+
+#endif /* _HYDRABUS_LIN_H_ */
@@ -0,0 +1,660 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h> /* snprintf */
+#include <string.h>
+
+#include "common.h"
+#include "tokenline.h"
+#include "microsd.h"
+
+#include "hydrabus.h"
+#include "hydrabus_mode.h"
+#include "hydrabus_aux.h"
+#include "hydrabus_macro.h"
+
+#define MAYBE_CALL(x) { if (x) x(con); }
+
+/* MACRO_FILE_MAGIC(4) + version(1) + number of macros(1) + mode name length(1) */
+#define MACRO_FILE_HDR_SIZE (7)
+/* num(1) + size(2) */
+#define MACRO_FILE_ENTRY_HDR_SIZE (3)
+
+extern t_token_dict tl_dict[];
+
+typedef struct {
+	uint8_t code[MODE_CONFIG_MACRO_SIZE];
+	uint32_t size;
+	bool overflow;
+} t_macro_asm;
+
+static const char * const macro_op_str[] = {
+	[MACRO_OP_START] = "[",
+	[MACRO_OP_START_WR] = "{",
+	[MACRO_OP_STOP] = "]",
+	[MACRO_OP_CLKH] = "/",
+	[MACRO_OP_CLKL] = "\\",
+	[MACRO_OP_DATH] = "-",
+	[MACRO_OP_DATL] = "_",
+	[MACRO_OP_DATS] = "!",
+	[MACRO_OP_CLK] = "^",
+	[MACRO_OP_BITR] = ".",
+	[MACRO_OP_DELAY_US] = "&",
+	[MACRO_OP_DELAY_MS] = "%",
+	[MACRO_OP_READ] = "read",
+	[MACRO_OP_HD] = "hd",
+	[MACRO_OP_WRITE] = "write",
+	[MACRO_OP_AUX_ON] = "A",
+	[MACRO_OP_AUX_OFF] = "a",
+	[MACRO_OP_AUX_READ] = "@",
+};
+
+static void macro_emit(t_macro_asm *a, const void *data, uint32_t len)
+{
+	if ((a->size + len) > MODE_CONFIG_MACRO_SIZE) {
+		a->overflow = TRUE;
+		return;
+	}
+	memcpy(&a->code[a->size], data, len);
+	a->size += len;
+}
+
+static void macro_emit_op(t_macro_asm *a, uint8_t op)
+{
+	macro_emit(a, &op, 1);
+}
+
+static void macro_emit_op_u32(t_macro_asm *a, uint8_t op, uint32_t arg)
+{
+	macro_emit_op(a, op);
+	macro_emit(a, &arg, sizeof(uint32_t));
+}
+
+/* Return ":<num>" suffix of token t (default_val if none), *t is moved to last token used */
+static uint32_t macro_suffix(t_tokenline_parsed *p, int *t, uint32_t default_val)
+{
+	uint32_t val;
+
+	if (p->tokens[*t + 1] != T_ARG_TOKEN_SUFFIX_INT)
+		return default_val;
+
+	*t += 2;
+	memcpy(&val, p->buf + p->tokens[*t], sizeof(uint32_t));
+	return val;
+}
+
+/*
+ * Compile bytes (with ":<num>" repeat) or a string starting at token t in
+ * one MACRO_OP_WRITE.
+ * Return last token used or -1 on error.
+ */
+static int macro_compile_write(t_hydra_console *con, t_tokenline_parsed *p,
+			       int t, uint32_t count, t_macro_asm *a)
+{
+	uint8_t *data = con->mode->proto.buffer_tx;
+	uint32_t arg_uint, repeat, nb_data;
+	uint16_t len;
+
+	nb_data = 0;
+	if (p->tokens[t] == T_ARG_STRING) {
+		t++;
+		nb_data = parse_escaped_string(p->buf + p->tokens[t], data);
+	} else {
+		t--;
+		while (p->tokens[t + 1] == T_ARG_UINT) {
+			t += 2;
+			memcpy(&arg_uint, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (arg_uint > 0xff) {
+				cprintf(con, "Please specify one byte at a time.\r\n");
+				return -1;
+			}
+			repeat = macro_suffix(p, &t, 1);
+			if ((nb_data + repeat) > MODE_CONFIG_PROTO_BUFFER_SIZE) {
+				cprintf(con, "Repeat count exceeds buffer size.\r\n");
+				return -1;
+			}
+			while (repeat--)
+				data[nb_data++] = arg_uint;
+		}
+	}
+
+	if (nb_data == 0) {
+		cprintf(con, "Nothing to write.\r\n");
+		return -1;
+	}
+
+	len = nb_data;
+	macro_emit_op_u32(a, MACRO_OP_WRITE, count);
+	macro_emit(a, &len, sizeof(uint16_t));
+	macro_emit(a, data, nb_data);
+
+	return t;
+}
+
+/* Compile tokens from t to end of line, return FALSE on error */
+static bool macro_compile(t_hydra_console *con, t_tokenline_parsed *p,
+			  int t, t_macro_asm *a)
+{
+	uint32_t count;
+
+	a->size = 0;
+	a->overflow = FALSE;
+	for (; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_CS_ON:
+		case T_START:
+		case T_LEFT_SQ:
+			macro_emit_op(a, MACRO_OP_START);
+			break;
+		case T_LEFT_CURLY:
+			macro_emit_op(a, MACRO_OP_START_WR);
+			break;
+		case T_CS_OFF:
+		case T_STOP:
+		case T_RIGHT_SQ:
+		case T_RIGHT_CURLY:
+			macro_emit_op(a, MACRO_OP_STOP);
+			break;
+		case T_SLASH:
+			macro_emit_op(a, MACRO_OP_CLKH);
+			break;
+		case T_BACKSLASH:
+			macro_emit_op(a, MACRO_OP_CLKL);
+			break;
+		case T_MINUS:
+			macro_emit_op(a, MACRO_OP_DATH);
+			break;
+		case T_UNDERSCORE:
+			macro_emit_op(a, MACRO_OP_DATL);
+			break;
+		case T_EXCLAMATION:
+			macro_emit_op(a, MACRO_OP_DATS);
+			break;
+		case T_CARET:
+			macro_emit_op(a, MACRO_OP_CLK);
+			break;
+		case T_DOT:
+			macro_emit_op(a, MACRO_OP_BITR);
+			break;
+		case T_AMPERSAND:
+			count = macro_suffix(p, &t, 1);
+			macro_emit_op_u32(a, MACRO_OP_DELAY_US, count);
+			break;
+		case T_PERCENT:
+			count = macro_suffix(p, &t, 1);
+			macro_emit_op_u32(a, MACRO_OP_DELAY_MS, count);
+			break;
+		case T_READ:
+			count = macro_suffix(p, &t, 1);
+			macro_emit_op_u32(a, MACRO_OP_READ, count);
+			break;
+		case T_HD:
+			count = macro_suffix(p, &t, 1);
+			macro_emit_op_u32(a, MACRO_OP_HD, count);
+			break;
+		case T_WRITE:
+			count = macro_suffix(p, &t, 1);
+			t = macro_compile_write(con, p, t + 1, count, a);
+			if (t < 0)
+				return FALSE;
+			break;
+		case T_ARG_UINT:
+		case T_ARG_STRING:
+			t = macro_compile_write(con, p, t, 1, a);
+			if (t < 0)
+				return FALSE;
+			break;
+		case T_AUX_ON:
+			macro_emit_op(a, MACRO_OP_AUX_ON);
+			break;
+		case T_AUX_OFF:
+			macro_emit_op(a, MACRO_OP_AUX_OFF);
+			break;
+		case T_AUX_READ:
+			macro_emit_op(a, MACRO_OP_AUX_READ);
+			break;
+		case T_TILDE:
+			cprintf(con, "Random byte is not supported in macro.\r\n");
+			return FALSE;
+		default:
+			cprintf(con, "'%s' is not supported in macro.\r\n",
+				tl_dict[p->tokens[t]].tokenstr);
+			return FALSE;
+		}
+	}
+
+	if (a->overflow) {
+		cprintf(con, "Macro too long (max %d bytes).\r\n",
+			MODE_CONFIG_MACRO_SIZE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Check bytecode read from a file */
+static bool macro_check(const uint8_t *code, uint32_t size)
+{
+	uint32_t pc;
+	uint16_t len;
+
+	pc = 0;
+	while (pc < size) {
+		switch (code[pc++]) {
+		case MACRO_OP_START:
+		case MACRO_OP_START_WR:
+		case MACRO_OP_STOP:
+		case MACRO_OP_CLKH:
+		case MACRO_OP_CLKL:
+		case MACRO_OP_DATH:
+		case MACRO_OP_DATL:
+		case MACRO_OP_DATS:
+		case MACRO_OP_CLK:
+		case MACRO_OP_BITR:
+		case MACRO_OP_AUX_ON:
+		case MACRO_OP_AUX_OFF:
+		case MACRO_OP_AUX_READ:
+			break;
+		case MACRO_OP_DELAY_US:
+		case MACRO_OP_DELAY_MS:
+		case MACRO_OP_READ:
+		case MACRO_OP_HD:
+			pc += sizeof(uint32_t);
+			break;
+		case MACRO_OP_WRITE:
+			if ((pc + sizeof(uint32_t) + sizeof(uint16_t)) > size)
+				return FALSE;
+			memcpy(&len, &code[pc + sizeof(uint32_t)], sizeof(uint16_t));
+			if (len == 0 || len > MODE_CONFIG_PROTO_BUFFER_SIZE)
+				return FALSE;
+			pc += sizeof(uint32_t) + sizeof(uint16_t) + len;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+
+	return (pc == size);
+}
+
+/* Return the macro num (1 to MODE_CONFIG_MACRO_NB) if it is usable in current mode */
+static mode_config_macro_t *macro_get(t_hydra_console *con, uint32_t num)
+{
+	mode_config_macro_t *macro;
+
+	if (num < 1 || num > MODE_CONFIG_MACRO_NB)
+		return NULL;
+	macro = &con->mode->macro[num - 1];
+	if (macro->mode != con->console_mode ||
+	    macro->size > MODE_CONFIG_MACRO_SIZE ||
+	    !macro_check(macro->code, macro->size))
+		return NULL;
+	return macro;
+}
+
+static void macro_exec(t_hydra_console *con, uint8_t *code, uint32_t size)
+{
+	const mode_exec_t *exec = con->mode->exec;
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t pc, arg;
+	uint16_t len;
+	uint8_t op;
+
+	pc = 0;
+	while (pc < size) {
+		op = code[pc++];
+		arg = 0;
+		if (op >= MACRO_OP_DELAY_US && op <= MACRO_OP_WRITE) {
+			memcpy(&arg, &code[pc], sizeof(uint32_t));
+			pc += sizeof(uint32_t);
+		}
+
+		switch (op) {
+		case MACRO_OP_START:
+			proto->wwr = 0;
+			MAYBE_CALL(exec->start);
+			break;
+		case MACRO_OP_START_WR:
+			proto->wwr = 1;
+			MAYBE_CALL(exec->start);
+			break;
+		case MACRO_OP_STOP:
+			proto->wwr = 0;
+			MAYBE_CALL(exec->stop);
+			break;
+		case MACRO_OP_CLKH:
+			MAYBE_CALL(exec->clkh);
+			break;
+		case MACRO_OP_CLKL:
+			MAYBE_CALL(exec->clkl);
+			break;
+		case MACRO_OP_DATH:
+			MAYBE_CALL(exec->dath);
+			break;
+		case MACRO_OP_DATL:
+			MAYBE_CALL(exec->datl);
+			break;
+		case MACRO_OP_DATS:
+			MAYBE_CALL(exec->dats);
+			break;
+		case MACRO_OP_CLK:
+			MAYBE_CALL(exec->clk);
+			break;
+		case MACRO_OP_BITR:
+			MAYBE_CALL(exec->bitr);
+			break;
+		case MACRO_OP_DELAY_US:
+			DelayUs(arg);
+			break;
+		case MACRO_OP_DELAY_MS:
+			cprintf(con, hydrabus_mode_str_mdelay, arg);
+			DelayUs(arg * 1000);
+			break;
+		case MACRO_OP_READ:
+			hydrabus_mode_read_data(con, arg);
+			break;
+		case MACRO_OP_HD:
+			hydrabus_mode_hexdump_data(con, arg);
+			break;
+		case MACRO_OP_WRITE:
+			memcpy(&len, &code[pc], sizeof(uint16_t));
+			pc += sizeof(uint16_t);
+			hydrabus_mode_write_data(con, &code[pc], len, arg);
+			pc += len;
+			break;
+		case MACRO_OP_AUX_ON:
+			cmd_aux_write(0, 1);
+			break;
+		case MACRO_OP_AUX_OFF:
+			cmd_aux_write(0, 0);
+			break;
+		case MACRO_OP_AUX_READ:
+			cprintf(con, "AUX: %d\r\n", cmd_aux_read(0));
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/* Print macro as mode commands */
+static void macro_print(t_hydra_console *con, uint32_t num,
+			mode_config_macro_t *macro)
+{
+	uint8_t *code = macro->code;
+	uint32_t pc, arg, i;
+	uint16_t len;
+	uint8_t op;
+
+	cprintf(con, "Macro %lu:", num);
+	pc = 0;
+	while (pc < macro->size) {
+		op = code[pc++];
+		cprintf(con, " %s", macro_op_str[op]);
+		if (op < MACRO_OP_DELAY_US || op > MACRO_OP_WRITE)
+			continue;
+
+		memcpy(&arg, &code[pc], sizeof(uint32_t));
+		pc += sizeof(uint32_t);
+		if (arg != 1)
+			cprintf(con, ":%lu", arg);
+
+		if (op == MACRO_OP_WRITE) {
+			memcpy(&len, &code[pc], sizeof(uint16_t));
+			pc += sizeof(uint16_t);
+			for (i = 0; i < len; i++)
+				cprintf(con, " 0x%02x", code[pc + i]);
+			pc += len;
+		}
+	}
+	cprintf(con, "\r\n");
+}
+
+static void macro_list(t_hydra_console *con)
+{
+	mode_config_macro_t *macro;
+	uint32_t i, nb;
+
+	nb = 0;
+	for (i = 0; i < MODE_CONFIG_MACRO_NB; i++) {
+		macro = macro_get(con, i + 1);
+		if (macro == NULL)
+			continue;
+		macro_print(con, i + 1, macro);
+		nb++;
+	}
+	if (nb == 0)
+		cprintf(con, "No macro defined.\r\n");
+
+	/* Mode builtin macros */
+	if (con->mode->exec->macro != NULL)
+		con->mode->exec->macro(con, 0);
+}
+
+static void macro_define(t_hydra_console *con, t_tokenline_parsed *p,
+			 int t, uint32_t num)
+{
+	mode_config_macro_t *macro = &con->mode->macro[num - 1];
+	t_macro_asm a;
+
+	if (!macro_compile(con, p, t, &a))
+		return;
+
+	if (a.size == 0) {
+		macro->mode = 0;
+		cprintf(con, "Macro %lu deleted.\r\n", num);
+		return;
+	}
+
+	macro->mode = con->console_mode;
+	macro->size = a.size;
+	memcpy(macro->code, a.code, a.size);
+	cprintf(con, "Macro %lu defined (%lu bytes).\r\n", num, a.size);
+}
+
+static void macro_save(t_hydra_console *con, const char *filename)
+{
+	const char *mode_name = tl_dict[con->console_mode].tokenstr;
+	mode_config_macro_t *macro;
+	uint8_t hdr[MACRO_FILE_HDR_SIZE];
+	uint8_t entry[MACRO_FILE_ENTRY_HDR_SIZE];
+	uint32_t i, nb;
+	bool ok;
+	FIL fp;
+
+	nb = 0;
+	for (i = 0; i < MODE_CONFIG_MACRO_NB; i++) {
+		if (macro_get(con, i + 1) != NULL)
+			nb++;
+	}
+
+	if (!file_open(&fp, filename, 'w') || f_truncate(&fp) != FR_OK) {
+		cprintf(con, "Failed to open file %s\r\n", filename);
+		return;
+	}
+
+	memcpy(hdr, MACRO_FILE_MAGIC, 4);
+	hdr[4] = MACRO_FILE_VERSION;
+	hdr[5] = nb;
+	hdr[6] = strlen(mode_name);
+	ok = file_append(&fp, hdr, sizeof(hdr)) &&
+	     file_append(&fp, (uint8_t *)mode_name, hdr[6]);
+
+	for (i = 0; ok && i < MODE_CONFIG_MACRO_NB; i++) {
+		macro = macro_get(con, i + 1);
+		if (macro == NULL)
+			continue;
+		entry[0] = i + 1;
+		entry[1] = macro->size & 0xFF;
+		entry[2] = macro->size >> 8;
+		ok = file_append(&fp, entry, sizeof(entry)) &&
+		     file_append(&fp, macro->code, macro->size);
+	}
+
+	if (!file_close(&fp) || !ok) {
+		cprintf(con, "Failed to write file %s\r\n", filename);
+		return;
+	}
+	cprintf(con, "%lu macro(s) saved in %s\r\n", nb, filename);
+}
+
+/* Macros are loaded in a pool buffer and copied only if the whole file is valid */
+static void macro_load(t_hydra_console *con, const char *filename)
+{
+	const char *mode_name = tl_dict[con->console_mode].tokenstr;
+	mode_config_macro_t *macros;
+	uint8_t hdr[MACRO_FILE_HDR_SIZE];
+	uint8_t entry[MACRO_FILE_ENTRY_HDR_SIZE];
+	char name[256];
+	uint32_t i, nb, num, size;
+	bool ok;
+	FIL fp;
+
+	if (!file_open(&fp, filename, 'r')) {
+		cprintf(con, "Failed to open file %s\r\n", filename);
+		return;
+	}
+
+	macros = pool_alloc_bytes(sizeof(con->mode->macro));
+	if (macros == NULL) {
+		cprintf(con, "Error, unable to get buffer space.\r\n");
+		file_close(&fp);
+		return;
+	}
+	memset(macros, 0, sizeof(con->mode->macro));
+
+	ok = (file_read(&fp, hdr, sizeof(hdr)) == sizeof(hdr)) &&
+	     (memcmp(hdr, MACRO_FILE_MAGIC, 4) == 0) &&
+	     (hdr[4] == MACRO_FILE_VERSION) &&
+	     (file_read(&fp, (uint8_t *)name, hdr[6]) == hdr[6]);
+	if (ok) {
+		name[hdr[6]] = 0;
+		if (strcmp(name, mode_name) != 0) {
+			cprintf(con, "Macros are for %s mode.\r\n", name);
+			ok = FALSE;
+		}
+	}
+
+	nb = ok ? hdr[5] : 0;
+	for (i = 0; ok && i < nb; i++) {
+		ok = (file_read(&fp, entry, sizeof(entry)) == sizeof(entry));
+		num = entry[0];
+		size = entry[1] | (entry[2] << 8);
+		if (!ok || num < 1 || num > MODE_CONFIG_MACRO_NB ||
+		    size == 0 || size > MODE_CONFIG_MACRO_SIZE) {
+			ok = FALSE;
+			break;
+		}
+		ok = (file_read(&fp, macros[num - 1].code, size) == size) &&
+		     macro_check(macros[num - 1].code, size);
+		macros[num - 1].mode = con->console_mode;
+		macros[num - 1].size = size;
+	}
+	file_close(&fp);
+
+	if (ok) {
+		for (i = 0; i < MODE_CONFIG_MACRO_NB; i++) {
+			if (macros[i].mode != 0)
+				con->mode->macro[i] = macros[i];
+		}
+		cprintf(con, "%lu macro(s) loaded from %s\r\n", nb, filename);
+	} else {
+		cprintf(con, "Invalid macro file %s\r\n", filename);
+	}
+	pool_free(macros);
+}
+
+/*
+ * "macro" or "macro:0" list macros, "macro:<num> <commands>" define macro
+ * (delete it without commands), "macro save/load <filename>" save/load
+ * macros of current mode.
+ * Returns the number of tokens eaten.
+ */
+int hydrabus_macro(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	char filename[FILENAME_SIZE];
+	uint32_t num;
+	int t;
+
+	t = token_pos;
+	if (p->tokens[t + 1] == T_ARG_TOKEN_SUFFIX_INT) {
+		num = macro_suffix(p, &t, 0);
+		if (num == 0)
+			macro_list(con);
+		else if (num > MODE_CONFIG_MACRO_NB)
+			cprintf(con, "Macro number must be 1 to %d.\r\n",
+				MODE_CONFIG_MACRO_NB);
+		else
+			macro_define(con, p, t + 1, num);
+		/* All following tokens are used */
+		while (p->tokens[t + 1])
+			t++;
+		return t - token_pos;
+	}
+
+	if ((p->tokens[t + 1] == T_SAVE || p->tokens[t + 1] == T_LOAD) &&
+	    p->tokens[t + 2] == T_ARG_STRING) {
+		snprintf(filename, FILENAME_SIZE, "0:%s", p->buf + p->tokens[t + 3]);
+		if (p->tokens[t + 1] == T_SAVE)
+			macro_save(con, filename);
+		else
+			macro_load(con, filename);
+		t += 3;
+		return t - token_pos;
+	}
+
+	macro_list(con);
+	return t - token_pos;
+}
+
+/*
+ * "run:<num> [repeat <count>]" execute macro count times or until UBTN is
+ * pressed, mode builtin macro is used if macro is not defined.
+ * Returns the number of tokens eaten.
+ */
+int hydrabus_macro_run(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	mode_config_macro_t *macro;
+	uint32_t num, repeat, i;
+	int t;
+
+	t = token_pos;
+	num = macro_suffix(p, &t, 0);
+	repeat = 1;
+	if (p->tokens[t + 1] == T_REPEAT && p->tokens[t + 2] == T_ARG_UINT) {
+		memcpy(&repeat, p->buf + p->tokens[t + 3], sizeof(uint32_t));
+		t += 3;
+	}
+
+	macro = macro_get(con, num);
+
+	for (i = 0; i < repeat; i++) {
+		if (hydrabus_ubtn())
+			break;
+		if (macro != NULL) {
+			macro_exec(con, macro->code, macro->size);
+		} else if (con->mode->exec->macro != NULL) {
+			con->mode->exec->macro(con, num);
+		} else {
+			cprintf(con, "Macro %lu not defined.\r\n", num);
+			break;
+		}
+	}
+
+	return t - token_pos;
+}
@@ -0,0 +1,60 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_MACRO_H_
+#define _HYDRABUS_MACRO_H_
+
+#include "common.h"
+#include "tokenline.h"
+
+/*
+ * Mode macros: "macro:<num> <commands>" compiles mode commands in a bytecode
+ * stored in con->mode->macro[], "run:<num> [repeat <count>]" executes it
+ * without tokenline parsing.
+ * Supported commands: [ ] { } cs-on cs-off start stop / \ - _ ! ^ . & %
+ * read hd write <bytes/string> A a @
+ */
+
+/* Bytecode opcodes, operands are little endian */
+#define MACRO_OP_START (0x01)
+#define MACRO_OP_START_WR (0x02) /* '{' Start with Write & Read */
+#define MACRO_OP_STOP (0x03)
+#define MACRO_OP_CLKH (0x04)
+#define MACRO_OP_CLKL (0x05)
+#define MACRO_OP_DATH (0x06)
+#define MACRO_OP_DATL (0x07)
+#define MACRO_OP_DATS (0x08)
+#define MACRO_OP_CLK (0x09)
+#define MACRO_OP_BITR (0x0A)
+#define MACRO_OP_DELAY_US (0x0B) /* uint32_t usec */
+#define MACRO_OP_DELAY_MS (0x0C) /* uint32_t msec */
+#define MACRO_OP_READ (0x0D) /* uint32_t count */
+#define MACRO_OP_HD (0x0E) /* uint32_t count */
+#define MACRO_OP_WRITE (0x0F) /* uint32_t count, uint16_t len, uint8_t data[len] */
+#define MACRO_OP_AUX_ON (0x10)
+#define MACRO_OP_AUX_OFF (0x11)
+#define MACRO_OP_AUX_READ (0x12)
+
+/* Macro file: header, mode name then for each macro num(1), size(2), code */
+#define MACRO_FILE_MAGIC "HMAC"
+#define MACRO_FILE_VERSION (1)
+
+int hydrabus_macro(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+int hydrabus_macro_run(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+
+#endif /* _HYDRABUS_MACRO_H_ */
@@ -24,6 +24,8 @@
 
 #include "hydrabus.h"
 #include "hydrabus_mode.h"
+#include "hydrabus_macro.h"
+#include "hydrabus_periodic.h"
 #include "hydrabus_trigger.h"
 #include "hydrabus_aux.h"
 #include "mode_config.h"
@@ -173,6 +175,7 @@ int cmd_mode_init(t_hydra_console *con, t_tokenline_parsed *p)
 		if (!tl_mode_push(con->tl, modes[i].tokens))
 			return FALSE;
 		con->console_mode = modes[i].token;
+		con->perf.mode = perf_mode_get(modes[i].token);
 		tl_set_prompt(con->tl, (char *)con->mode->exec->get_prompt(con));
 	}
 
@@ -185,6 +188,8 @@ int cmd_mode_exec(t_hydra_console *con, t_tokenline_parsed *p)
 	int t, tokens_used, factor, ret;
 	bool done;
 
+	PERF_MODE_ADD(con, commands, 1);
+
 	ret = TRUE;
 	done = FALSE;
 	for (t = 0; !done && p->tokens[t]; t++) {
@@ -278,6 +283,15 @@ int cmd_mode_exec(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_TRIGGER:
 			t += cmd_trigger(con, p, t + 1);
 			break;
+		case T_MACRO:
+			t += hydrabus_macro(con, p, t);
+			break;
+		case T_RUN:
+			t += hydrabus_macro_run(con, p, t);
+			break;
+		case T_PERIODIC:
+			t += hydrabus_periodic(con, p, t);
+			break;
 		case T_AUX_ON:
 			cmd_aux_write(0, 1);
 			break;
@@ -288,6 +302,7 @@ int cmd_mode_exec(t_hydra_console *con, t_tokenline_parsed *p)
 			cprintf(con, mode_str_aux_read, cmd_aux_read(0));
 			break;
 		case T_EXIT:
+			hydrabus_periodic_stop(con);
 			MAYBE_CALL(con->mode->exec->cleanup);
 			mode_exit(con, p);
 			break;
@@ -378,9 +393,8 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 			       int t)
 {
 	mode_config_proto_t* p_proto = &con->mode->proto;
-	uint32_t mode_status;
 	unsigned int num_bytes = 0;
-	int tokens_used, i;
+	int tokens_used;
 	int count = 1;
 
 	tokens_used = 0;
@@ -403,76 +417,148 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 	if (!num_bytes)
 		return 0;
 
+	hydrabus_mode_write_data(con, p_proto->buffer_tx, num_bytes, count);
+
+	return tokens_used;
+}
+
+/*
+ * Write (or Write & Read after '{') nb_data bytes of tx_data count times,
+ * errors are printed.
+ */
+void hydrabus_mode_write_data(t_hydra_console *con, uint8_t *tx_data,
+			      uint32_t nb_data, uint32_t count)
+{
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	uint32_t mode_status;
+	uint32_t i;
+
 	for (i = 0; i < count; i++) {
 		if (p_proto->wwr == 1) {
 			/* Write & Read */
 			mode_status = !HYDRABUS_MODE_STATUS_OK;
 			if(con->mode->exec->write_read != NULL) {
 				mode_status = con->mode->exec->write_read(con,
-						p_proto->buffer_tx, p_proto->buffer_rx, num_bytes);
+						tx_data, p_proto->buffer_rx, nb_data);
 			}
 
-			if (mode_status != HYDRABUS_MODE_STATUS_OK)
+			if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+				PERF_MODE_ADD(con, errors, 1);
 				hydrabus_mode_write_read_error(con, mode_status);
+			} else {
+				PERF_MODE_ADD(con, bytes_out, nb_data);
+				PERF_MODE_ADD(con, bytes_in, nb_data);
+			}
 		} else {
 			/* Write only */
 			mode_status = !HYDRABUS_MODE_STATUS_OK;
 			if(con->mode->exec->write != NULL) {
 				mode_status = con->mode->exec->write(con,
-								     p_proto->buffer_tx, num_bytes);
+								     tx_data, nb_data);
 			}
-			if (mode_status != HYDRABUS_MODE_STATUS_OK)
+			if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+				PERF_MODE_ADD(con, errors, 1);
 				hydrabus_mode_write_error(con, mode_status);
+			} else {
+				PERF_MODE_ADD(con, bytes_out, nb_data);
+			}
 		}
 	}
-
-	return tokens_used;
 }
 
 /* Returns the number of tokens eaten. */
 static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 			      int token_pos)
 {
-	mode_config_proto_t* p_proto;
-	uint32_t mode_status;
-	int count, t;
-
-	p_proto = &con->mode->proto;
+	uint32_t count;
+	int t;
 
 	t = token_pos;
 	if (p->tokens[t + 1] == T_ARG_TOKEN_SUFFIX_INT) {
 		t += 2;
-		memcpy(&count, p->buf + p->tokens[t], sizeof(int));
+		memcpy(&count, p->buf + p->tokens[t], sizeof(uint32_t));
 	} else {
 		count = 1;
 	}
 
-	mode_status = !HYDRABUS_MODE_STATUS_OK;
-	if(con->mode->exec->read != NULL) {
-		mode_status = con->mode->exec->read(con, p_proto->buffer_rx, count);
-	}
-	if (mode_status != HYDRABUS_MODE_STATUS_OK)
-		hydrabus_mode_read_error(con, mode_status);
+	hydrabus_mode_read_data(con, count);
 
 	return t - token_pos;
 }
 
-/* Returns the number of tokens eaten. */
-static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
-			      int token_pos)
+/* Read count bytes, data are printed by mode read */
+void hydrabus_mode_read_data(t_hydra_console *con, uint32_t count)
 {
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	uint32_t mode_status;
+	uint32_t to_rx;
 
-	/* Keep a multiple of 16 to be aligned in the hexdump */
-	#define HEXDUMP_CHUNK_SIZE 64
+	/* proto->buffer_rx is filled by chunks, each chunk is printed by read */
+	do {
+		to_rx = (count > MODE_CONFIG_PROTO_BUFFER_SIZE) ? MODE_CONFIG_PROTO_BUFFER_SIZE : count;
+		mode_status = !HYDRABUS_MODE_STATUS_OK;
+		if(con->mode->exec->read != NULL) {
+			mode_status = con->mode->exec->read(con, p_proto->buffer_rx, to_rx);
+		}
+		if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+			PERF_MODE_ADD(con, errors, 1);
+			hydrabus_mode_read_error(con, mode_status);
+			break;
+		}
+		PERF_MODE_ADD(con, bytes_in, to_rx);
+		count -= to_rx;
+	} while (count > 0);
+}
 
-	mode_config_proto_t* p_proto;
+/*
+ * Read nb_data from current mode and give them to sink by chunks of buf_size
+ * bytes (buf is provided by caller, it can be a pool buffer).
+ * Stop on read error, sink error or UBTN pressed.
+ * Return status 0=OK
+ */
+uint32_t hydrabus_mode_read_stream(t_hydra_console *con, uint8_t *buf, uint32_t buf_size,
+				   uint32_t nb_data, mode_sink_t sink, void *ctx)
+{
+	const mode_exec_t *exec = con->mode->exec;
 	uint32_t mode_status;
+	uint32_t to_rx;
+
+	if(exec->dump == NULL) {
+		return !HYDRABUS_MODE_STATUS_OK;
+	}
+
+	mode_status = HYDRABUS_MODE_STATUS_OK;
+	while((nb_data > 0) && !hydrabus_ubtn()) {
+		to_rx = (nb_data > buf_size) ? buf_size : nb_data;
+		mode_status = exec->dump(con, buf, to_rx);
+		if(mode_status != HYDRABUS_MODE_STATUS_OK) {
+			PERF_MODE_ADD(con, errors, 1);
+			break;
+		}
+		PERF_MODE_ADD(con, bytes_in, to_rx);
+		mode_status = sink(con, buf, to_rx, ctx);
+		if(mode_status != HYDRABUS_MODE_STATUS_OK)
+			break;
+		nb_data -= to_rx;
+	}
+	return mode_status;
+}
+
+static uint32_t hydrabus_mode_hexdump_sink(t_hydra_console *con, uint8_t *data,
+					   uint32_t nb_data, void *ctx)
+{
+	(void)ctx;
+
+	print_hex(con, data, nb_data);
+	return HYDRABUS_MODE_STATUS_OK;
+}
+
+/* Returns the number of tokens eaten. */
+static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
+			      int token_pos)
+{
 	uint32_t count;
-	uint32_t bytes_read = 0;
 	int t;
-	uint8_t to_rx;
-
-	p_proto = &con->mode->proto;
 
 	t = token_pos;
 	if (p->tokens[t + 1] == T_ARG_TOKEN_SUFFIX_INT) {
@@ -482,24 +568,35 @@ static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
 		count = 1;
 	}
 
-	while((bytes_read < count) && !hydrabus_ubtn()){
-		mode_status = !HYDRABUS_MODE_STATUS_OK;
-		if((count-bytes_read) >= HEXDUMP_CHUNK_SIZE) {
-			to_rx = HEXDUMP_CHUNK_SIZE;
-		} else {
-			to_rx = (count-bytes_read);
-		}
+	hydrabus_mode_hexdump_data(con, count);
 
-		if(con->mode->exec->read != NULL) {
-			mode_status = con->mode->exec->dump(con, p_proto->buffer_rx, to_rx);
-		}
-		if (mode_status == HYDRABUS_MODE_STATUS_OK) {
-			print_hex(con, p_proto->buffer_rx, to_rx);
-		} else {
-			hydrabus_mode_read_error(con, mode_status);
-		}
+	return t - token_pos;
+}
 
-		bytes_read += to_rx;
+/* Read count bytes and print them as hexdump */
+void hydrabus_mode_hexdump_data(t_hydra_console *con, uint32_t count)
+{
+	/* Keep a multiple of 16 to be aligned in the hexdump */
+	#define HEXDUMP_BUF_SIZE 4096
+
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	uint32_t mode_status;
+	uint32_t buf_size;
+	uint8_t *buf;
+
+	/* Use proto->buffer_rx if pool is full */
+	buf_size = HEXDUMP_BUF_SIZE;
+	buf = pool_alloc_bytes(buf_size);
+	if(buf == 0) {
+		buf = p_proto->buffer_rx;
+		buf_size = sizeof(p_proto->buffer_rx);
 	}
-	return t - token_pos;
+
+	mode_status = hydrabus_mode_read_stream(con, buf, buf_size, count,
+						hydrabus_mode_hexdump_sink, NULL);
+	if (mode_status != HYDRABUS_MODE_STATUS_OK)
+		hydrabus_mode_read_error(con, mode_status);
+
+	if(buf != p_proto->buffer_rx)
+		pool_free(buf);
 }
@@ -52,6 +52,15 @@ extern const char hydrabus_mode_str_mul_value_u8[];
 /* "\r\n" */
 extern const char hydrabus_mode_str_mul_br[];
 
+/* "DELAY: %lu ms\r\n" */
+extern const char hydrabus_mode_str_mdelay[];
+
+/*
+ * Sink receiving data read by hydrabus_mode_read_stream()
+ * data is only valid during the call (return status 0=OK else stop the stream)
+ */
+typedef uint32_t (*mode_sink_t)(t_hydra_console *con, uint8_t *data, uint32_t nb_data, void *ctx);
+
 typedef struct mode_exec_t {
 	/* Initialize mode hardware. */
 	int (*init)(t_hydra_console *con, t_tokenline_parsed *p);
@@ -62,13 +71,13 @@ typedef struct mode_exec_t {
 	/* Stop command ']' */
 	void (*stop)(t_hydra_console *con);
 	/* Write/Send data (return status 0=OK) */
-	uint32_t (*write)(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data);
+	uint32_t (*write)(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data);
 	/* Read data command 'read' or 'read:n' (return status 0=OK) */
-	uint32_t (*read)(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data);
-	/* Dump data */
-	uint32_t (*dump)(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data);
+	uint32_t (*read)(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
+	/* Dump data, rx_data is provided by caller and can be a pool buffer (return status 0=OK) */
+	uint32_t (*dump)(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
 	/* Write & Read data (return status 0=OK) */
-	uint32_t (*write_read)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data);
+	uint32_t (*write_read)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data);
 	/* Set CLK High (x-WIRE or other raw mode) command '/' */
 	void (*clkh)(t_hydra_console *con);
 	/* Set CLK Low (x-WIRE or other raw mode) command '\' */
@@ -85,6 +94,8 @@ typedef struct mode_exec_t {
 	void (*bitr)(t_hydra_console *con);
 	/* Periodic service called (like UART sniffer) */
 	uint32_t (*periodic)(t_hydra_console *con);
+	/* Periodic service stopped, release what periodic() started */
+	void (*periodic_stop)(t_hydra_console *con);
 	/* Macro command "(x)", "(0)" List current macros */
 	void (*macro)(t_hydra_console *con, uint32_t macro_num);
 	/* Exit mode, disable hardware. */
@@ -94,6 +105,12 @@ typedef struct mode_exec_t {
 } mode_exec_t;
 
 void print_freq(t_hydra_console *con, uint32_t freq);
+void hydrabus_mode_write_data(t_hydra_console *con, uint8_t *tx_data,
+			      uint32_t nb_data, uint32_t count);
+void hydrabus_mode_read_data(t_hydra_console *con, uint32_t count);
+void hydrabus_mode_hexdump_data(t_hydra_console *con, uint32_t count);
+uint32_t hydrabus_mode_read_stream(t_hydra_console *con, uint8_t *buf, uint32_t buf_size,
+				   uint32_t nb_data, mode_sink_t sink, void *ctx);
 
 #endif /* _HYDRABUS_MODE_H_ */
 
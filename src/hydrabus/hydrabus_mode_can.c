@@ -27,7 +27,7 @@
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data);
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
 
 static const char* str_pins_can[] = {
 	"TX: PB9\r\nRX: PB8\r\n",
@@ -507,11 +507,11 @@ static uint32_t can_send_msg(t_hydra_console *con, can_tx_frame *tx_msg)
 }
 
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
-	uint8_t i = 0;
+	uint32_t i = 0;
 	can_tx_frame tx_msg;
 
 	if(proto->config.can.dev_mode == BSP_CAN_MODE_RO) {
@@ -558,7 +558,7 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -590,6 +590,21 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
+/* Print frames received since last call (CAN monitor in background) */
+static uint32_t periodic(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t rx_data[8];
+	uint32_t status;
+
+	while (bsp_can_rxne(proto->dev_num) > 0) {
+		status = read(con, rx_data, 0);
+		if (status != BSP_OK)
+			return status;
+	}
+	return BSP_OK;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -634,6 +649,7 @@ const mode_exec_t mode_can_exec = {
 	.exec = &exec,
 	.write = &write,
 	.read = &read,
+	.periodic = &periodic,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -22,11 +22,16 @@
 #include "bsp.h"
 #include "bsp_gpio.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_flash_nand.h"
+#include "microsd.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
 static void flash_display_id(t_hydra_console *con);
+static bool flash_onfi(t_hydra_console *con);
+static int flash_read(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+static void flash_scan(t_hydra_console *con);
 
 static const char* str_prompt_flash[] = {
 	"nandflash" PROMPT,
@@ -45,15 +50,6 @@ static void delay_tWHR(void)
 	__asm__("nop");
 }
 
-/* RE# Access Time - Around 30ns */
-static void delay_tREA(void)
-{
-	__asm__("nop");
-	__asm__("nop");
-	__asm__("nop");
-	__asm__("nop");
-}
-
 void flash_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -64,6 +60,8 @@ void flash_init_proto_default(t_hydra_console *con)
 	proto->config.flash.dev_gpio_pull = MODE_CONFIG_DEV_GPIO_NOPULL;
 	proto->config.flash.dev_bit_lsb_msb = DEV_FIRSTBIT_MSB;
 	proto->config.flash.dev_numbits = 3;
+	/* 1Gbit SLC (2048+64 bytes pages, 64 pages per block) until ONFI */
+	nand_set_geometry(&proto->config.flash, 2048, 64, 64, 1024);
 }
 
 static void show_params(t_hydra_console *con)
@@ -71,6 +69,11 @@ static void show_params(t_hydra_console *con)
 	mode_config_proto_t* proto = &con->mode->proto;
 
 	cprintf(con, "Address bytes : %d\r\n", proto->config.flash.dev_numbits);
+	cprintf(con, "Page : %lu+%lu bytes, %lu pages per block, %lu blocks\r\n",
+		proto->config.flash.page_size, proto->config.flash.oob_size,
+		proto->config.flash.pages_per_block, proto->config.flash.nb_blocks);
+	cprintf(con, "Address cycles : %d column, %d row\r\n",
+		proto->config.flash.col_cycles, proto->config.flash.row_cycles);
 }
 
 static void flash_data_mode_input(void)
@@ -238,17 +241,21 @@ static int init(t_hydra_console *con, t_tokenline_parsed *p)
 	/* Defaults */
 	flash_init_proto_default(con);
 
+	flash_pin_init(con);
+	flash_onfi(con);
+
 	/* Process cmdline arguments, skipping "flash". */
 	tokens_used = 1 + exec(con, p, 1);
 
-	flash_pin_init(con);
-
 	return tokens_used;
 }
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
+	flash_config_t *geo = &proto->config.flash;
+	uint32_t arg_u32;
+	bool ok;
 	int t;
 
 	for (t = token_pos; p->tokens[t]; t++) {
@@ -256,6 +263,35 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_SHOW:
 			t += show(con, p);
 			break;
+		case T_PAGE:
+		case T_OOB:
+		case T_BLOCK:
+		case T_SIZE:
+			memcpy(&arg_u32, p->buf + p->tokens[t + 2], sizeof(uint32_t));
+			switch (p->tokens[t]) {
+			case T_PAGE:
+				ok = nand_set_geometry(geo, arg_u32, geo->oob_size,
+						       geo->pages_per_block, geo->nb_blocks);
+				break;
+			case T_OOB:
+				ok = nand_set_geometry(geo, geo->page_size, arg_u32,
+						       geo->pages_per_block, geo->nb_blocks);
+				break;
+			case T_BLOCK:
+				ok = nand_set_geometry(geo, geo->page_size, geo->oob_size,
+						       arg_u32, geo->nb_blocks);
+				break;
+			default:
+				ok = nand_set_geometry(geo, geo->page_size, geo->oob_size,
+						       geo->pages_per_block, arg_u32);
+				break;
+			}
+			t += 2;
+			if (!ok) {
+				cprintf(con, "Invalid geometry.\r\n");
+				return t - token_pos;
+			}
+			break;
 		case T_PULL:
 			switch (p->tokens[++t]) {
 			case T_UP:
@@ -279,6 +315,16 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_ID:
 			flash_display_id(con);
 			break;
+		case T_ONFI:
+			if (!flash_onfi(con))
+				cprintf(con, "No valid ONFI parameter page.\r\n");
+			break;
+		case T_DUMP:
+			t += flash_read(con, p, t + 1);
+			break;
+		case T_SCAN:
+			flash_scan(con);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -360,6 +406,112 @@ static void flash_display_id(t_hydra_console *con)
 	cprintf(con, "%02X\r\n", data);
 }
 
+/* Read ONFI parameter page, geometry is set from it */
+static bool flash_onfi(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_nand_onfi onfi;
+	uint8_t *param;
+	bool ok;
+
+	param = pool_alloc_bytes(NAND_ONFI_PARAM_SIZE * NAND_ONFI_PARAM_COPIES);
+	if (param == NULL)
+		return FALSE;
+
+	ok = nand_read_onfi(&proto->config.flash, &onfi, param);
+	pool_free(param);
+	if (ok) {
+		cprintf(con, "ONFI : %s %s\r\n", onfi.manufacturer, onfi.model);
+		show_params(con);
+	}
+	return ok;
+}
+
+/* "dump [start <page>] [size <pages>] [filename <f>]" */
+static int flash_read(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	flash_config_t *geo = &proto->config.flash;
+	uint32_t page, nb_pages, i;
+	uint8_t *buf;
+	char *filename;
+	FIL fp;
+	int t;
+
+	page = 0;
+	nb_pages = 1;
+	filename = NULL;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_START:
+			t += 2;
+			memcpy(&page, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_SIZE:
+			t += 2;
+			memcpy(&nb_pages, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_FILE:
+			t += 2;
+			filename = p->buf + p->tokens[t];
+			break;
+		}
+	}
+
+	if (filename != NULL) {
+		if (!file_open(&fp, filename, 'w') || f_truncate(&fp) != FR_OK) {
+			cprintf(con, "Failed to open file %s\r\n", filename);
+			return t - token_pos;
+		}
+		if (!nand_read_pages_file(geo, page, nb_pages, &fp))
+			cprintf(con, "Read error or abort, file %s is incomplete\r\n", filename);
+		else
+			cprintf(con, "%lu pages written to %s\r\n", nb_pages, filename);
+		file_close(&fp);
+		return t - token_pos;
+	}
+
+	buf = pool_alloc_bytes(nand_page_total(geo));
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory.\r\n");
+		return t - token_pos;
+	}
+	for (i = 0; i < nb_pages; i++) {
+		if (hydrabus_ubtn())
+			break;
+		if (!nand_read_page(geo, page + i, buf)) {
+			cprintf(con, "Page %lu: timeout\r\n", page + i);
+			break;
+		}
+		cprintf(con, "Page %lu:\r\n", page + i);
+		print_hex_addr(con, 0, buf, nand_page_total(geo));
+	}
+	pool_free(buf);
+
+	return t - token_pos;
+}
+
+static void flash_scan(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	flash_config_t *geo = &proto->config.flash;
+	uint32_t block, nb_bad;
+
+	nb_bad = 0;
+	for (block = 0; block < geo->nb_blocks; block++) {
+		if (hydrabus_ubtn()) {
+			cprintf(con, "Aborted at block %lu\r\n", block);
+			break;
+		}
+		if (nand_block_is_bad(geo, block)) {
+			cprintf(con, "Bad block %lu (page %lu)\r\n",
+				block, block * geo->pages_per_block);
+			nb_bad++;
+		}
+	}
+	cprintf(con, "%lu bad blocks\r\n", nb_bad);
+}
+
 static int show(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	int tokens_used;
@@ -17,6 +17,9 @@
 * limitations under the License.
 */
 
+#ifndef _HYDRABUS_MODE_FLASH_H_
+#define _HYDRABUS_MODE_FLASH_H_
+
 #include "hydrabus_mode.h"
 
 #define FLASH_ADDR_LATCH	2
@@ -26,11 +29,25 @@
 #define FLASH_WRITE_ENABLE	1
 #define FLASH_READ_BUSY		0
 
+/* RE# Access Time - Around 30ns */
+static inline void delay_tREA(void)
+{
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+}
+
 void flash_init_proto_default(t_hydra_console *con);
 bool flash_pin_init(t_hydra_console *con);
 void flash_send_bit(uint8_t bit);
 void flash_write_value(t_hydra_console *con, uint8_t tx_data);
 void flash_write_command(t_hydra_console *con, uint8_t tx_data);
 void flash_write_address(t_hydra_console *con, uint8_t tx_data);
+uint8_t flash_read_value(t_hydra_console *con);
+void flash_chip_en_high(void);
+void flash_chip_en_low(void);
 inline void flash_wait_ready(void);
 void flash_cleanup(t_hydra_console *con);
+
+#endif /* _HYDRABUS_MODE_FLASH_H_ */
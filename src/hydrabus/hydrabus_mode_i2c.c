@@ -20,11 +20,15 @@
 #include "hydrabus_mode_i2c.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
+#include "hydrabus_i2c_eeprom.h"
+#include "microsd.h"
+#include "hexdump.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
 static void scan(t_hydra_console *con, t_tokenline_parsed *p);
+static int eeprom(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static void sniff(t_hydra_console *con);
 
 #define I2C_DEV_NUM (1)
@@ -40,6 +44,7 @@ static const char* str_i2c_nack = { "NACK" };
 static const char* str_i2c_nack_br = { "NACK\r\n" };
 
 static const char* str_bsp_init_err= { "bsp_i2c_master_init() error %d\r\n" };
+static const char* str_hw_speed_err= { "hw backend supports up to 400kHz\r\n" };
 
 #define SPEED_NB (4)
 static uint32_t speeds[SPEED_NB] = {
@@ -61,6 +66,7 @@ static void init_proto_default(t_hydra_console *con)
 	proto->config.i2c.dev_speed = 1;
 	proto->config.i2c.ack_pending = 0;
 	proto->config.i2c.dev_mode = DEV_MASTER;
+	proto->config.i2c.dev_backend = BSP_I2C_BACKEND_GPIO;
 }
 
 static void show_params(t_hydra_console *con)
@@ -68,11 +74,12 @@ static void show_params(t_hydra_console *con)
 	uint8_t i, cnt;
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	cprintf(con, "GPIO resistor: %s\r\nMode: %s\r\nFrequency: ",
+	cprintf(con, "GPIO resistor: %s\r\nMode: %s\r\nBackend: %s\r\nFrequency: ",
 		proto->config.i2c.dev_gpio_pull == MODE_CONFIG_DEV_GPIO_PULLUP ? "pull-up" :
 		proto->config.i2c.dev_gpio_pull == MODE_CONFIG_DEV_GPIO_PULLDOWN ? "pull-down" :
 		"floating",
-		proto->config.i2c.dev_mode == DEV_MASTER ? "master" : "slave");
+		proto->config.i2c.dev_mode == DEV_MASTER ? "master" : "slave",
+		proto->config.i2c.dev_backend == BSP_I2C_BACKEND_HW ? "hw (I2C1 + DMA)" : "gpio");
 
 	print_freq(con, speeds[proto->config.i2c.dev_speed]);
 
@@ -150,12 +157,32 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			bsp_status = bsp_i2c_master_init(proto->dev_num, proto);
 			if( bsp_status != BSP_OK) {
 				cprintf(con, str_bsp_init_err, bsp_status);
+				if(proto->config.i2c.dev_backend == BSP_I2C_BACKEND_HW)
+					cprintf(con, str_hw_speed_err);
+				return t;
+			}
+			break;
+		case T_GPIO:
+		case T_HW:
+			proto->config.i2c.dev_backend = (p->tokens[t] == T_HW) ?
+							 BSP_I2C_BACKEND_HW : BSP_I2C_BACKEND_GPIO;
+			proto->config.i2c.ack_pending = 0;
+			bsp_status = bsp_i2c_master_init(proto->dev_num, proto);
+			if( bsp_status != BSP_OK) {
+				cprintf(con, str_bsp_init_err, bsp_status);
+				if(proto->config.i2c.dev_backend == BSP_I2C_BACKEND_HW)
+					cprintf(con, str_hw_speed_err);
+				proto->config.i2c.dev_backend = BSP_I2C_BACKEND_GPIO;
+				bsp_i2c_master_init(proto->dev_num, proto);
 				return t;
 			}
 			break;
 		case T_SCAN:
 			scan(con, p);
 			break;
+		case T_EEPROM:
+			t += eeprom(con, p, t + 1);
+			break;
 		case T_SNIFF:
 			sniff(con);
 			break;
@@ -196,9 +223,9 @@ static void stop(t_hydra_console *con)
 	cprintf(con, str_i2c_stop_br);
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	uint8_t tx_ack_flag;
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -232,12 +259,38 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+/*
+ * hw backend: the I2C1 peripheral ACKs a byte as soon as it is received, so
+ * a read cannot wait for the next command to choose ACK or NACK. The whole
+ * read is done at once, the last byte is NACKed then STOP is sent.
+ */
+static uint32_t read_hw(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
+	uint32_t status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = bsp_i2c_master_read_buf(proto->dev_num, rx_data, nb_data);
+	if(status != BSP_OK)
+		return status;
+
+	for(i = 0; i < nb_data; i++) {
+		cprintf(con, hydrabus_mode_str_mul_read);
+		cprintf(con, hydrabus_mode_str_mul_value_u8, rx_data[i]);
+		cprintf(con, (i + 1) < nb_data ? str_i2c_ack_br : str_i2c_nack_br);
+	}
+	return status;
+}
+
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	if(proto->config.i2c.dev_backend == BSP_I2C_BACKEND_HW)
+		return read_hw(con, rx_data, nb_data);
+
 	status = BSP_ERROR;
 	for(i = 0; i < nb_data; i++) {
 		if(proto->config.i2c.ack_pending) {
@@ -260,11 +313,17 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
-	uint8_t i, tmp;
+	uint32_t i;
+	uint8_t tmp;
 	mode_config_proto_t* proto = &con->mode->proto;
+
+	/* See read_hw() */
+	if(proto->config.i2c.dev_backend == BSP_I2C_BACKEND_HW)
+		return bsp_i2c_master_read_buf(proto->dev_num, rx_data, nb_data);
+
 	status = BSP_ERROR;
 	for(i = 0; i < nb_data; i++) {
 		if(proto->config.i2c.ack_pending) {
@@ -335,24 +394,162 @@ static void scan(t_hydra_console *con, t_tokenline_parsed *p)
 		cprintf(con, "No devices found.\r\n");
 }
 
+/* range_read_to_file() chunk, ctx is the t_i2c_eeprom */
+static bool eeprom_read_chunk(t_hydra_console *con, void *ctx, uint32_t addr,
+			      uint8_t *buf, uint32_t nb)
+{
+	if (i2c_eeprom_read(con->mode->proto.dev_num, ctx, addr, buf, nb) != BSP_OK) {
+		cprintf(con, "Read error at 0x%08lX\r\n", addr);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* range_write_from_file() chunk, ctx is the t_i2c_eeprom */
+static bool eeprom_write_chunk(t_hydra_console *con, void *ctx, uint32_t addr,
+			       uint8_t *buf, uint32_t nb)
+{
+	if (i2c_eeprom_write(con->mode->proto.dev_num, ctx, addr, buf, nb) != BSP_OK) {
+		cprintf(con, "Write error at 0x%08lX\r\n", addr);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static int eeprom(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_eeprom eep;
+	t_range_io io;
+	uint32_t dev_addr, addr_width, page_size, start, size;
+	uint8_t *buf;
+	char *filename;
+	int t, action;
+
+	dev_addr = 0x50;
+	addr_width = 1;
+	page_size = 8;
+	start = 0;
+	size = 0;
+	filename = NULL;
+	action = 0;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_DEVICE:
+			t += 2;
+			memcpy(&dev_addr, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_WIDTH:
+			t += 2;
+			memcpy(&addr_width, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_PAGE:
+			t += 2;
+			memcpy(&page_size, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_START:
+			t += 2;
+			memcpy(&start, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_SIZE:
+			t += 2;
+			memcpy(&size, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_FILE:
+			t += 2;
+			filename = p->buf + p->tokens[t];
+			break;
+		case T_READ:
+		case T_WRITE:
+			action = p->tokens[t];
+			break;
+		}
+	}
+
+	if (!i2c_eeprom_init(&eep, dev_addr, addr_width, page_size)) {
+		cprintf(con, "Invalid device, width or page.\r\n");
+		return t - token_pos;
+	}
+	if (action == 0) {
+		cprintf(con, "Please choose one of 'read' or 'write'.\r\n");
+		return t - token_pos;
+	}
+	if (action == T_READ && size == 0) {
+		cprintf(con, "Please specify read size.\r\n");
+		return t - token_pos;
+	}
+	if (action == T_WRITE && filename == NULL) {
+		cprintf(con, "Please specify a filename.\r\n");
+		return t - token_pos;
+	}
+
+	buf = pool_alloc_bytes(I2C_EEPROM_CHUNK_SIZE);
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory.\r\n");
+		return t - token_pos;
+	}
+
+	if(proto->config.i2c.ack_pending) {
+		bsp_i2c_read_ack(proto->dev_num, FALSE);
+		bsp_i2c_stop(proto->dev_num);
+		proto->config.i2c.ack_pending = 0;
+	}
+
+	io.begin = NULL;
+	io.ctx = &eep;
+	io.buf = buf;
+	io.chunk_size = I2C_EEPROM_CHUNK_SIZE;
+	if (action == T_READ) {
+		io.chunk = eeprom_read_chunk;
+		if (range_read_to_file(con, &io, start, size, filename) &&
+		    filename != NULL)
+			cprintf(con, "%lu bytes written to %s\r\n", size, filename);
+	} else {
+		io.chunk = eeprom_write_chunk;
+		if (range_write_from_file(con, &io, start, &size, filename) &&
+		    i2c_eeprom_wait_ready(proto->dev_num, &eep) == BSP_OK)
+			cprintf(con, "%lu bytes programmed from %s\r\n", size, filename);
+	}
+
+	pool_free(buf);
+
+	return t - token_pos;
+}
+
+/* Output is formatted in a buffer written with one cprint() when full */
+#define SNIFF_PRINT_BUF_SIZE (256)
 static void print_sniff_buffer(t_hydra_console *con, uint16_t *buffer, uint16_t length)
 {
+	char buf[SNIFF_PRINT_BUF_SIZE];
+	uint32_t idx = 0;
 	uint16_t i = 0;
 	while(i < length) {
+		/* Longest output "0xXX+" */
+		if((idx + 5) > sizeof(buf)) {
+			cprint(con, buf, idx);
+			idx = 0;
+		}
 		switch(buffer[i]) {
 		case 0x400:
-			cprint(con, "[", 1);
+			buf[idx++] = '[';
 			break;
 		case 0x200:
-			cprint(con, "]\r\n", 3);
+			buf[idx++] = ']';
+			buf[idx++] = '\r';
+			buf[idx++] = '\n';
 			break;
 		default:
-			cprintf(con, "0x%02x", buffer[i]>>1);
-			cprint(con, buffer[i] & 1 ? "-" : "+", 1);
+			buf[idx++] = '0';
+			buf[idx++] = 'x';
+			hexdump_u8(&buf[idx], buffer[i] >> 1, hexdump_digits_lower);
+			idx += 2;
+			buf[idx++] = buffer[i] & 1 ? '-' : '+';
 			break;
 		}
 		i++;
 	}
+	if(idx > 0)
+		cprint(con, buf, idx);
 }
 
 static void sniff(t_hydra_console *con)
@@ -916,9 +916,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	for (i = 0; i < nb_data; i++) {
 		jtag_write_u8(con, tx_data[i]);
 	}
@@ -937,9 +937,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 
 	for(i = 0; i < nb_data; i++) {
 		rx_data[i] = jtag_read_u8(con);
@@ -20,10 +20,14 @@
 #include "hydrabus_mode_lin.h"
 #include "bsp_uart.h"
 #include "hydrabus_trigger.h"
+#include "hydrabus_lin.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
+static int schedule(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+static int response(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+static int run(t_hydra_console *con, t_tokenline_parsed *p, int token_pos, bool master);
 
 static const char* str_pins_lin[] = {
 	"TX: PA9\r\nRX: PA10\r\n",
@@ -61,6 +65,8 @@ static int init(t_hydra_console *con, t_tokenline_parsed *p)
 
 	/* Defaults */
 	init_proto_default(con);
+	lin_schedule_clear();
+	lin_response_clear();
 
 	/* Process cmdline arguments, skipping "lin". */
 	tokens_used = 1 + exec(con, p, 1);
@@ -79,6 +85,231 @@ static void lin_send_break(t_hydra_console *con)
 	cprint(con, "<BREAK>\r\n", 10);
 }
 
+static void print_data(t_hydra_console *con, const uint8_t *data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	cprint(con, "[", 1);
+	for (i = 0; i < nb_data; i++)
+		cprintf(con, i > 0 ? " 0x%02X" : "0x%02X", data[i]);
+	cprint(con, "]", 1);
+}
+
+static void print_record(t_hydra_console *con, const t_lin_record *rec)
+{
+	if (rec->flags & LIN_FLAG_NO_SYNC) {
+		cprintf(con, "No sync ");
+		print_data(con, rec->data, rec->length);
+	} else {
+		cprintf(con, "ID 0x%02X (PID 0x%02X)", rec->pid & 0x3f, rec->pid);
+		if (!(rec->flags & LIN_FLAG_NO_RESPONSE)) {
+			cprint(con, " ", 1);
+			print_data(con, rec->data, rec->length);
+			cprintf(con, " checksum 0x%02X", rec->checksum);
+		}
+	}
+	cprintf(con, "%s%s%s%s%s%s\r\n",
+		(rec->flags & LIN_FLAG_CLASSIC) ? " classic" : "",
+		(rec->flags & LIN_FLAG_TX) ? " (sent)" : "",
+		(rec->flags & LIN_FLAG_NO_RESPONSE) ? " no response" : "",
+		(rec->flags & LIN_FLAG_PARITY) ? " parity error" : "",
+		(rec->flags & LIN_FLAG_CHECKSUM) ? " checksum error" : "",
+		(rec->flags & LIN_FLAG_OVERFLOW) ? " overflow" : "");
+}
+
+/* Add a slot, clear or show master schedule */
+static int schedule(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	const t_lin_slot *slots;
+	t_lin_slot slot;
+	uint8_t buf[256];
+	uint32_t arg, i, nb;
+	bool add;
+	int t;
+
+	memset(&slot, 0, sizeof(slot));
+	slot.period = 10;
+	add = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_ID:
+			t += 2;
+			memcpy(&arg, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (arg >= LIN_ID_NB) {
+				cprintf(con, "ID must be 0 to 63.\r\n");
+				return t - token_pos;
+			}
+			slot.id = arg;
+			add = TRUE;
+			break;
+		case T_PERIOD:
+			t += 2;
+			memcpy(&arg, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (arg < 1 || arg > 0xffff) {
+				cprintf(con, "Period must be 1 to 65535 ms.\r\n");
+				return t - token_pos;
+			}
+			slot.period = arg;
+			break;
+		case T_DATA:
+			t += 2;
+			nb = parse_escaped_string(p->buf + p->tokens[t], buf);
+			if (nb < 1 || nb > LIN_DATA_MAX) {
+				cprintf(con, "Data must be 1 to 8 bytes.\r\n");
+				return t - token_pos;
+			}
+			memcpy(slot.data, buf, nb);
+			slot.length = nb;
+			slot.flags |= LIN_SLOT_PUBLISH;
+			break;
+		case T_CLEAR:
+			lin_schedule_clear();
+			break;
+		}
+	}
+
+	if (add && !lin_schedule_add(&slot))
+		cprintf(con, "Schedule is full (%d slots).\r\n", LIN_SLOTS_MAX);
+
+	nb = lin_schedule_get(&slots);
+	for (i = 0; i < nb; i++) {
+		cprintf(con, "%2lu: ID 0x%02X %5ums ", i, slots[i].id, slots[i].period);
+		if (slots[i].flags & LIN_SLOT_PUBLISH)
+			print_data(con, slots[i].data, slots[i].length);
+		else
+			cprintf(con, "subscribe");
+		cprintf(con, "\r\n");
+	}
+	if (nb == 0)
+		cprintf(con, "Schedule is empty.\r\n");
+
+	return t - token_pos;
+}
+
+/* Set, clear or show slave responses */
+static int response(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	const t_lin_response *resp;
+	uint8_t buf[256];
+	uint32_t arg, i, nb;
+	bool set;
+	int t;
+
+	arg = 0;
+	nb = 0;
+	set = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_ID:
+			t += 2;
+			memcpy(&arg, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (arg >= LIN_ID_NB) {
+				cprintf(con, "ID must be 0 to 63.\r\n");
+				return t - token_pos;
+			}
+			set = TRUE;
+			break;
+		case T_DATA:
+			t += 2;
+			nb = parse_escaped_string(p->buf + p->tokens[t], buf);
+			if (nb < 1 || nb > LIN_DATA_MAX) {
+				cprintf(con, "Data must be 1 to 8 bytes.\r\n");
+				return t - token_pos;
+			}
+			break;
+		case T_CLEAR:
+			lin_response_clear();
+			break;
+		}
+	}
+
+	if (set)
+		lin_response_set(arg, buf, nb);
+
+	nb = 0;
+	for (i = 0; i < LIN_ID_NB; i++) {
+		resp = lin_response_get(i);
+		if (resp->length == 0)
+			continue;
+		cprintf(con, "ID 0x%02lX ", i);
+		print_data(con, resp->data, resp->length);
+		cprintf(con, "\r\n");
+		nb++;
+	}
+	if (nb == 0)
+		cprintf(con, "No response.\r\n");
+
+	return t - token_pos;
+}
+
+/*
+ * Run scheduler (master) or only send responses (slave) and print frames
+ * until UBTN or a key is pressed.
+ */
+static int run(t_hydra_console *con, t_tokenline_parsed *p, int token_pos, bool master)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	const t_lin_slot *slots;
+	t_lin_record rec;
+	t_lin_stats stats;
+	uint32_t prev, nb_frames;
+	bool bin, classic;
+	uint8_t data;
+	int t;
+
+	bin = FALSE;
+	classic = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_BIN:
+			bin = TRUE;
+			break;
+		case T_CLASSIC:
+			classic = TRUE;
+			break;
+		}
+	}
+
+	if (master && lin_schedule_get(&slots) == 0) {
+		cprintf(con, "Schedule is empty.\r\n");
+		return t - token_pos;
+	}
+	if (!lin_start(proto->dev_num, bsp_uart_get_final_baudrate(proto->dev_num),
+		       master, classic)) {
+		cprintf(con, "Scheduler already running.\r\n");
+		return t - token_pos;
+	}
+	if (!bin)
+		cprintf(con, "Interrupt by pressing user button or any key.\r\n");
+
+	nb_frames = 0;
+	prev = 0;
+	while (!hydrabus_ubtn() && chnReadTimeout(con->sdu, &data, 1, TIME_IMMEDIATE) == 0) {
+		if (!lin_get(&rec)) {
+			chThdSleepMilliseconds(1);
+			continue;
+		}
+		if (bin) {
+			cprint(con, (char *)&rec, sizeof(rec));
+			continue;
+		}
+		if (nb_frames > 0)
+			cprintf(con, "+%luus ", (rec.timestamp - prev) / (STM32_HCLK / 1000000));
+		prev = rec.timestamp;
+		nb_frames++;
+		print_record(con, &rec);
+	}
+	lin_stop();
+
+	if (!bin) {
+		lin_stats_get(&stats);
+		cprintf(con, "%lu frames, %lu errors, %lu lost, %lu late slots\r\n",
+			stats.nb_frames, stats.nb_errors, stats.nb_lost, stats.nb_late);
+	}
+
+	return t - token_pos;
+}
+
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -111,6 +342,18 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			t++;
 			t += cmd_trigger(con, p, t);
 			break;
+		case T_SCHEDULE:
+			t += schedule(con, p, t + 1);
+			break;
+		case T_RESPONSE:
+			t += response(con, p, t + 1);
+			break;
+		case T_RUN:
+			t += run(con, p, t + 1, TRUE);
+			break;
+		case T_SNIFF:
+			t += run(con, p, t + 1, FALSE);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -119,9 +362,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -142,9 +385,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -165,7 +408,7 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -175,9 +418,9 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
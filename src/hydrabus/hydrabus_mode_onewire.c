@@ -21,6 +21,7 @@
 #include "hydrabus.h"
 #include "bsp.h"
 #include "bsp_gpio.h"
+#include "bsp_onewire.h"
 #include "hydrabus_mode_onewire.h"
 #include <string.h>
 
@@ -40,6 +41,8 @@ void onewire_init_proto_default(t_hydra_console *con)
 	proto->config.onewire.dev_gpio_mode = MODE_CONFIG_DEV_GPIO_OUT_OPENDRAIN;
 	proto->config.onewire.dev_gpio_pull = MODE_CONFIG_DEV_GPIO_NOPULL;
 	proto->config.onewire.dev_bit_lsb_msb = DEV_FIRSTBIT_LSB;
+	proto->config.onewire.dev_backend = ONEWIRE_BACKEND_GPIO;
+	proto->config.onewire.dev_speed = BSP_ONEWIRE_SPEED_STANDARD;
 }
 
 static void show_params(t_hydra_console *con)
@@ -54,17 +57,31 @@ static void show_params(t_hydra_console *con)
 
 	cprintf(con, "Bit order: %s first\r\n",
 		proto->config.onewire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB ? "MSB" : "LSB");
+
+	cprintf(con, "Backend: %s\r\nSpeed: %s\r\n",
+		proto->config.onewire.dev_backend == ONEWIRE_BACKEND_UART ?
+		"uart (USART3 half-duplex DMA)" : "gpio",
+		proto->config.onewire.dev_speed == BSP_ONEWIRE_SPEED_OVERDRIVE ?
+		"overdrive" : "standard");
 }
 
 bool onewire_pin_init(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	if(proto->config.onewire.dev_backend == ONEWIRE_BACKEND_UART) {
+		return bsp_onewire_init(BSP_DEV_ONEWIRE1, proto) == BSP_OK;
+	}
 	bsp_gpio_init(BSP_GPIO_PORTB, ONEWIRE_PIN,
 		      proto->config.onewire.dev_gpio_mode, proto->config.onewire.dev_gpio_pull);
 	return true;
 }
 
+static inline bool onewire_is_uart(t_hydra_console *con)
+{
+	return con->mode->proto.config.onewire.dev_backend == ONEWIRE_BACKEND_UART;
+}
+
 static inline void onewire_mode_input(t_hydra_console *con)
 {
 	(void) con;
@@ -87,7 +104,7 @@ inline void onewire_low(void)
 	bsp_gpio_clr(BSP_GPIO_PORTB, ONEWIRE_PIN);
 }
 
-void onewire_write_bit(t_hydra_console *con, uint8_t bit)
+static void onewire_gpio_write_bit(t_hydra_console *con, uint8_t bit)
 {
 	onewire_mode_output(con);
 	onewire_low();
@@ -102,7 +119,7 @@ void onewire_write_bit(t_hydra_console *con, uint8_t bit)
 	}
 }
 
-uint8_t onewire_read_bit(t_hydra_console *con)
+static uint8_t onewire_gpio_read_bit(t_hydra_console *con)
 {
 	uint8_t bit=0;
 
@@ -117,14 +134,75 @@ uint8_t onewire_read_bit(t_hydra_console *con)
 	return bit;
 }
 
+/*
+ * Run nb_slots time slots (BSP_ONEWIRE_SLOT_0: write 0, BSP_ONEWIRE_SLOT_1:
+ * write 1 or read), slots[] is replaced by the bus state of each slot.
+ * UART backend sends them by batches of BSP_ONEWIRE_SLOTS_MAX with DMA so
+ * timings are generated by the USART and not affected by interrupts.
+ */
+static bsp_status_t onewire_slots(t_hydra_console *con, uint8_t *slots, uint32_t nb_slots)
+{
+	bsp_status_t status;
+	uint32_t i, nb;
+
+	if(onewire_is_uart(con)) {
+		while(nb_slots > 0) {
+			nb = (nb_slots > BSP_ONEWIRE_SLOTS_MAX) ? BSP_ONEWIRE_SLOTS_MAX : nb_slots;
+			status = bsp_onewire_slots(BSP_DEV_ONEWIRE1, slots, nb);
+			if(status != BSP_OK) {
+				return status;
+			}
+			slots += nb;
+			nb_slots -= nb;
+		}
+		return BSP_OK;
+	}
+
+	for(i = 0; i < nb_slots; i++) {
+		if(slots[i] == BSP_ONEWIRE_SLOT_0) {
+			onewire_gpio_write_bit(con, 0);
+		} else {
+			slots[i] = onewire_gpio_read_bit(con) ? BSP_ONEWIRE_SLOT_1 : BSP_ONEWIRE_SLOT_0;
+		}
+	}
+	return BSP_OK;
+}
+
+void onewire_write_bit(t_hydra_console *con, uint8_t bit)
+{
+	uint8_t slot;
+
+	slot = bit ? BSP_ONEWIRE_SLOT_1 : BSP_ONEWIRE_SLOT_0;
+	onewire_slots(con, &slot, 1);
+}
+
+uint8_t onewire_read_bit(t_hydra_console *con)
+{
+	uint8_t slot;
+
+	slot = BSP_ONEWIRE_SLOT_1;
+	if(onewire_slots(con, &slot, 1) != BSP_OK) {
+		return 1;
+	}
+	return slot == BSP_ONEWIRE_SLOT_1;
+}
+
 static void dath(t_hydra_console *con)
 {
+	if(onewire_is_uart(con)) {
+		cprintf(con, "Not available with uart backend\r\n");
+		return;
+	}
 	onewire_high();
 	cprintf(con, "PIN HIGH\r\n");
 }
 
 static void datl(t_hydra_console *con)
 {
+	if(onewire_is_uart(con)) {
+		cprintf(con, "Not available with uart backend\r\n");
+		return;
+	}
 	onewire_low();
 	cprintf(con, "PIN LOW\r\n");
 }
@@ -135,103 +213,251 @@ static void bitr(t_hydra_console *con)
 	cprintf(con, hydrabus_mode_str_read_one_u8, rx_data);
 }
 
-void onewire_start(t_hydra_console *con)
+/* Reset pulse, return true if at least one device answered */
+bool onewire_reset(t_hydra_console *con)
 {
+	bool presence;
+
+	if(onewire_is_uart(con)) {
+		if(bsp_onewire_reset(BSP_DEV_ONEWIRE1, &presence) != BSP_OK) {
+			return false;
+		}
+		return presence;
+	}
+
 	onewire_mode_output(con);
 	onewire_low();
 	DelayUs(480);
 	onewire_high();
 	DelayUs(70);
 	onewire_mode_input(con);
-	// Can check for device presence here
+	presence = !bsp_gpio_pin_read(BSP_GPIO_PORTB, ONEWIRE_PIN);
 	DelayUs(410);
+	return presence;
+}
 
+void onewire_start(t_hydra_console *con)
+{
+	onewire_reset(con);
 }
 
-void onewire_write_u8(t_hydra_console *con, uint8_t tx_data)
+/* Write bytes LSB first whatever the bit order (ROM/function commands) */
+static void onewire_write_raw(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	mode_config_proto_t* proto = &con->mode->proto;
-	uint8_t i;
+	uint8_t slots[BSP_ONEWIRE_SLOTS_MAX];
+	uint32_t i, j, nb;
+
+	while(nb_data > 0) {
+		nb = (nb_data > (BSP_ONEWIRE_SLOTS_MAX / 8)) ? (BSP_ONEWIRE_SLOTS_MAX / 8) : nb_data;
+		for(i = 0; i < nb; i++) {
+			for(j = 0; j < 8; j++) {
+				slots[(i * 8) + j] = ((tx_data[i] >> j) & 1) ?
+						     BSP_ONEWIRE_SLOT_1 : BSP_ONEWIRE_SLOT_0;
+			}
+		}
+		onewire_slots(con, slots, nb * 8);
+		tx_data += nb;
+		nb_data -= nb;
+	}
+}
 
-	onewire_mode_output(con);
+void onewire_write_bytes(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t data;
+	uint32_t i;
 
-	if(proto->config.rawwire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB) {
-		tx_data = reverse_u8(tx_data);
+	if(proto->config.onewire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB) {
+		for(i = 0; i < nb_data; i++) {
+			data = reverse_u8(tx_data[i]);
+			onewire_write_raw(con, &data, 1);
+		}
+	} else {
+		onewire_write_raw(con, tx_data, nb_data);
 	}
-	for (i=0; i<8; i++) {
-		onewire_write_bit(con, (tx_data>>i) & 1);
+}
+
+void onewire_read_bytes(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t slots[BSP_ONEWIRE_SLOTS_MAX];
+	uint32_t i, j, nb;
+
+	while(nb_data > 0) {
+		nb = (nb_data > (BSP_ONEWIRE_SLOTS_MAX / 8)) ? (BSP_ONEWIRE_SLOTS_MAX / 8) : nb_data;
+		memset(slots, BSP_ONEWIRE_SLOT_1, nb * 8);
+		if(onewire_slots(con, slots, nb * 8) != BSP_OK) {
+			memset(slots, BSP_ONEWIRE_SLOT_1, nb * 8);
+		}
+		for(i = 0; i < nb; i++) {
+			rx_data[i] = 0;
+			for(j = 0; j < 8; j++) {
+				if(slots[(i * 8) + j] == BSP_ONEWIRE_SLOT_1) {
+					rx_data[i] |= 1 << j;
+				}
+			}
+			if(proto->config.onewire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB) {
+				rx_data[i] = reverse_u8(rx_data[i]);
+			}
+		}
+		rx_data += nb;
+		nb_data -= nb;
 	}
 }
 
+void onewire_write_u8(t_hydra_console *con, uint8_t tx_data)
+{
+	onewire_write_bytes(con, &tx_data, 1);
+}
+
 uint8_t onewire_read_u8(t_hydra_console *con)
 {
-	mode_config_proto_t* proto = &con->mode->proto;
 	uint8_t value;
-	uint8_t i;
 
+	onewire_read_bytes(con, &value, 1);
+	return value;
+}
 
-	value = 0;
-	for(i=0; i<8; i++) {
-		value |= (onewire_read_bit(con) << i);
-	}
-	if(proto->config.rawwire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB) {
-		value = reverse_u8(value);
+/* Dallas/Maxim CRC8 (x^8 + x^5 + x^4 + 1, LSB first) */
+static uint8_t onewire_crc8(const uint8_t *data, uint32_t nb_data)
+{
+	uint8_t crc = 0;
+	uint32_t i, j;
+
+	for(i = 0; i < nb_data; i++) {
+		crc ^= data[i];
+		for(j = 0; j < 8; j++) {
+			crc = (crc & 1) ? ((crc >> 1) ^ 0x8C) : (crc >> 1);
+		}
 	}
-	return value;
+	return crc;
 }
 
-void onewire_scan(t_hydra_console *con)
+/*
+ * Search next ROM (Maxim AN187), rom[] holds the previous ROM on entry.
+ * Each bit is one batch of 3 slots: direction of previous bit then id bit
+ * and complement bit, so there is one DMA transfer per ROM bit.
+ * Return false when there is no more device.
+ */
+static bool onewire_search(t_hydra_console *con, uint8_t *rom,
+			   uint8_t *last_discrepancy, bool *last_device)
 {
-	uint8_t id_bit_number = 0;
-	uint8_t last_zero = 0;
-	uint8_t id_bit = 0, cmp_id_bit = 0;
-	uint8_t search_direction = 0;
-	uint8_t LastDiscrepancy = 0;
-	uint8_t LastDeviceFlag = 0;
-	uint8_t i;
-	uint8_t ROM_NO[8] = {0};
-	onewire_start(con);
-	onewire_write_u8(con, 0xf0);
-	cprintf(con, "Discovered devices : ");
-	while(!LastDeviceFlag && !hydrabus_ubtn()) {
-		do{
-			id_bit = onewire_read_bit(con);
-			cmp_id_bit = onewire_read_bit(con);
-			if(id_bit && cmp_id_bit) {
-				break;
+	uint8_t cmd = ONEWIRE_CMD_SEARCHROM;
+	uint8_t slots[3];
+	uint8_t id_bit, cmp_id_bit, direction;
+	uint8_t bit, last_zero;
+	uint32_t nb;
+
+	if(*last_device || !onewire_reset(con)) {
+		return false;
+	}
+	onewire_write_raw(con, &cmd, 1);
+
+	last_zero = 0;
+	direction = 0;
+	for(bit = 1; bit <= 64; bit++) {
+		nb = 0;
+		if(bit > 1) {
+			slots[nb++] = direction ? BSP_ONEWIRE_SLOT_1 : BSP_ONEWIRE_SLOT_0;
+		}
+		slots[nb++] = BSP_ONEWIRE_SLOT_1;
+		slots[nb++] = BSP_ONEWIRE_SLOT_1;
+		if(onewire_slots(con, slots, nb) != BSP_OK) {
+			return false;
+		}
+		id_bit = (slots[nb - 2] == BSP_ONEWIRE_SLOT_1);
+		cmp_id_bit = (slots[nb - 1] == BSP_ONEWIRE_SLOT_1);
+
+		if(id_bit && cmp_id_bit) {
+			/* No device answered */
+			return false;
+		} else if(id_bit != cmp_id_bit) {
+			direction = id_bit;
+		} else {
+			/* Discrepancy: both 0 and 1 are present */
+			if(bit < *last_discrepancy) {
+				direction = (rom[(bit - 1) / 8] >> ((bit - 1) % 8)) & 1;
 			} else {
-				if (!id_bit && !cmp_id_bit) {
-					if (id_bit_number == LastDiscrepancy) {
-						search_direction = 1;
-					} else {
-						if (id_bit_number > LastDiscrepancy) {
-							search_direction = 0;
-						} else {
-							search_direction = 
-								(ROM_NO[id_bit_number/8]
-								& (id_bit_number%8))>0;
-						}
-					}
-					if(search_direction == 0) {
-						last_zero = id_bit_number;
-					}
-				} else {
-					search_direction = id_bit;
-				}
+				direction = (bit == *last_discrepancy);
+			}
+			if(direction == 0) {
+				last_zero = bit;
 			}
-			ROM_NO[id_bit_number/8] |= search_direction<<(id_bit_number%8);
-			onewire_write_bit(con, search_direction);
-			id_bit_number++;
-		}while(id_bit_number<64);
-		LastDiscrepancy = last_zero;
-		if (LastDiscrepancy == 0) {
-			LastDeviceFlag = true;
 		}
-		for(i=0; i<8; i++) {
-			cprintf(con, "%02X ", ROM_NO[i]);
+
+		if(direction) {
+			rom[(bit - 1) / 8] |= 1 << ((bit - 1) % 8);
+		} else {
+			rom[(bit - 1) / 8] &= ~(1 << ((bit - 1) % 8));
 		}
-		cprintf(con, "\r\n");
 	}
+	slots[0] = direction ? BSP_ONEWIRE_SLOT_1 : BSP_ONEWIRE_SLOT_0;
+	if(onewire_slots(con, slots, 1) != BSP_OK) {
+		return false;
+	}
+
+	*last_discrepancy = last_zero;
+	if(last_zero == 0) {
+		*last_device = true;
+	}
+	return true;
+}
+
+void onewire_scan(t_hydra_console *con)
+{
+	uint8_t rom[ONEWIRE_ROM_SIZE] = {0};
+	uint8_t last_discrepancy = 0;
+	bool last_device = false;
+	uint32_t nb_devices = 0;
+
+	cprintf(con, "Discovered devices:\r\n");
+	while(!hydrabus_ubtn() &&
+	      onewire_search(con, rom, &last_discrepancy, &last_device)) {
+		nb_devices++;
+		cprintf(con, "%02X %02X %02X %02X %02X %02X %02X %02X %s\r\n",
+			rom[0], rom[1], rom[2], rom[3], rom[4], rom[5], rom[6], rom[7],
+			onewire_crc8(rom, ONEWIRE_ROM_SIZE) == 0 ? "" : "(CRC error)");
+	}
+	cprintf(con, "%d device(s) found\r\n", nb_devices);
+}
+
+/*
+ * Switch all devices to overdrive: standard speed reset and Overdrive Skip
+ * ROM, then reset at overdrive speed. A standard speed reset returns them to
+ * standard speed.
+ */
+static void onewire_set_speed(t_hydra_console *con, uint8_t speed)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t cmd = ONEWIRE_CMD_OD_SKIPROM;
+	bool presence;
+
+	if((speed == BSP_ONEWIRE_SPEED_OVERDRIVE) && !onewire_is_uart(con)) {
+		cprintf(con, "Overdrive needs uart backend\r\n");
+		return;
+	}
+
+	proto->config.onewire.dev_speed = BSP_ONEWIRE_SPEED_STANDARD;
+	onewire_pin_init(con);
+	presence = onewire_reset(con);
+	if(speed == BSP_ONEWIRE_SPEED_OVERDRIVE) {
+		onewire_write_raw(con, &cmd, 1);
+		proto->config.onewire.dev_speed = BSP_ONEWIRE_SPEED_OVERDRIVE;
+		presence = onewire_reset(con);
+	}
+	if(!presence) {
+		cprintf(con, "No device present\r\n");
+	}
+}
+
+static void onewire_set_backend(t_hydra_console *con, uint8_t backend)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	onewire_cleanup(con);
+	proto->config.onewire.dev_backend = backend;
+	proto->config.onewire.dev_speed = BSP_ONEWIRE_SPEED_STANDARD;
+	onewire_pin_init(con);
 }
 
 static int init(t_hydra_console *con, t_tokenline_parsed *p)
@@ -246,7 +472,9 @@ static int init(t_hydra_console *con, t_tokenline_parsed *p)
 
 	onewire_pin_init(con);
 
-	onewire_low();
+	if(!onewire_is_uart(con)) {
+		onewire_low();
+	}
 
 	show_params(con);
 
@@ -283,6 +511,18 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_LSB_FIRST:
 			proto->config.onewire.dev_bit_lsb_msb = DEV_FIRSTBIT_LSB;
 			break;
+		case T_GPIO:
+			onewire_set_backend(con, ONEWIRE_BACKEND_GPIO);
+			break;
+		case T_UART:
+			onewire_set_backend(con, ONEWIRE_BACKEND_UART);
+			break;
+		case T_STANDARD:
+			onewire_set_speed(con, BSP_ONEWIRE_SPEED_STANDARD);
+			break;
+		case T_OVERDRIVE:
+			onewire_set_speed(con, BSP_ONEWIRE_SPEED_OVERDRIVE);
+			break;
 		case T_SCAN:
 			onewire_scan(con);
 			break;
@@ -294,12 +534,11 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
-	for (i = 0; i < nb_data; i++) {
-		onewire_write_u8(con, tx_data[i]);
-	}
+	uint32_t i;
+
+	onewire_write_bytes(con, tx_data, nb_data);
 	if(nb_data == 1) {
 		/* Write 1 data */
 		cprintf(con, hydrabus_mode_str_write_one_u8, tx_data[0]);
@@ -315,13 +554,11 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 
-	for(i = 0; i < nb_data; i++) {
-		rx_data[i] = onewire_read_u8(con);
-	}
+	onewire_read_bytes(con, rx_data, nb_data);
 	if(nb_data == 1) {
 		/* Read 1 data */
 		cprintf(con, hydrabus_mode_str_read_one_u8, rx_data[0]);
@@ -337,21 +574,17 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	uint8_t i;
-
-	i = 0;
-	while(i < nb_data){
-		rx_data[i] = onewire_read_u8(con);
-		i++;
-	}
+	onewire_read_bytes(con, rx_data, nb_data);
 	return BSP_OK;
 }
 
 void onewire_cleanup(t_hydra_console *con)
 {
-	(void)con;
+	if(onewire_is_uart(con)) {
+		bsp_onewire_deinit(BSP_DEV_ONEWIRE1);
+	}
 }
 
 static int show(t_hydra_console *con, t_tokenline_parsed *p)
@@ -361,7 +594,8 @@ static int show(t_hydra_console *con, t_tokenline_parsed *p)
 	tokens_used = 0;
 	if (p->tokens[1] == T_PINS) {
 		tokens_used++;
-		cprintf(con, "PIN: PB%d\r\n", ONEWIRE_PIN);
+		cprintf(con, "PIN: PB%d\r\n",
+			onewire_is_uart(con) ? ONEWIRE_UART_PIN : ONEWIRE_PIN);
 	} else {
 		show_params(con);
 	}
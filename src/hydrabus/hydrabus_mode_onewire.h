@@ -20,12 +20,20 @@
 #include "hydrabus_mode.h"
 
 #define ONEWIRE_PIN	 11
+#define ONEWIRE_UART_PIN	 10
+
+/* Bus backends */
+#define ONEWIRE_BACKEND_GPIO	0 /* Bit-bang on PB11 */
+#define ONEWIRE_BACKEND_UART	1 /* USART3 half-duplex with DMA on PB10 */
+
+#define ONEWIRE_ROM_SIZE	8
 
 /* OneWire commands */
 #define ONEWIRE_CMD_READROM			0x33
 #define ONEWIRE_CMD_MATCHROM			0x55
 #define ONEWIRE_CMD_SEARCHROM			0xF0
 #define ONEWIRE_CMD_SKIPROM			0xCC
+#define ONEWIRE_CMD_OD_SKIPROM			0x3C
 
 
 void onewire_init_proto_default(t_hydra_console *con);
@@ -34,8 +42,11 @@ uint8_t onewire_read_u8(t_hydra_console *con);
 void onewire_write_u8(t_hydra_console *con, uint8_t tx_data);
 inline void onewire_low(void);
 inline void onewire_high(void);
-void onewire_send_bit(t_hydra_console *con, uint8_t bit);
+void onewire_write_bit(t_hydra_console *con, uint8_t bit);
 uint8_t onewire_read_bit(t_hydra_console *con);
+void onewire_write_bytes(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data);
+void onewire_read_bytes(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
 void onewire_cleanup(t_hydra_console *con);
+bool onewire_reset(t_hydra_console *con);
 void onewire_start(t_hydra_console *con);
 void onewire_scan(t_hydra_console *con);
@@ -20,12 +20,44 @@
 #include "hydrabus_mode_smartcard.h"
 #include "bsp.h"
 #include "bsp_smartcard.h"
+#include "hydrabus_smartcard_t1.h"
 #include <string.h>
+#include <stdlib.h>
 
 #define SMARTCARD_DEFAULT_SPEED (9600)
+#define SMARTCARD_DEFAULT_FI (372)
+#define SMARTCARD_DEFAULT_DI (1)
+#define SMARTCARD_PPS_TIMEOUT TIME_MS2I(100)
+#define SMARTCARD_APDU_MAX (T1_INF_SIZE_MAX + 7) /* Extended APDU header + 254 bytes */
+#define SMARTCARD_RESP_MAX (258) /* 256 bytes + SW1 SW2 */
+
+static const uint16_t Fi [] = {372, 372, 558, 744, 1116, 1488, 1860, 0xFF, 0xFF, 512, 768, 1024, 1536, 2048, 0xFF, 0xFF};
+static const uint8_t Di [] = {0xFF, 1, 2, 4, 8, 16, 32, 64, 12, 20, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static const uint8_t FMax [] = {4, 5, 6, 8, 12, 16, 20, 0xFF, 0xFF, 5, 7.5, 10, 15, 20, 0xFF, 0xFF};
+
+/* Card parameters from ATR */
+typedef struct {
+	bool valid;
+	bool ta1_present;
+	uint8_t ta1;
+	bool specific_mode; /* TA2 present, card does not accept PPS */
+	uint8_t protocol; /* First offered protocol (T=0 or T=1) */
+	uint8_t ifsc; /* T=1 */
+	uint8_t bwi; /* T=1 */
+	uint8_t cwi; /* T=1 */
+	bool edc_crc; /* T=1 CRC instead of LRC (not supported) */
+	uint32_t fi; /* Current Fi/Di */
+	uint32_t di;
+	bool t1_ready; /* S(IFS) sent */
+} t_smartcard_card;
+
+static t_smartcard_card smartcard_card;
+static t_smartcard_t1 smartcard_t1;
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
+static void smartcard_parse_atr(uint8_t *atr, uint32_t atr_size);
+static void smartcard_pps(t_hydra_console *con);
 
 static const char* str_pins_smartcard[] = {
 	"/VCC: PA5\r\nRST: PA6\r\nCD: PA7\r\nCLK: PA8\r\nTX : PB6\r\n"
@@ -37,10 +69,10 @@ static const char* str_prompt_smartcard[] = {
 static const char* str_bsp_init_err= { "bsp_smartcard_init() error %d\r\n" };
 
 /* Since the hardware cannot apply inverse convention, we manage it here */
-static void apply_convention(t_hydra_console *con, uint8_t * data, uint8_t nb_data)
+static void apply_convention(t_hydra_console *con, uint8_t * data, uint32_t nb_data)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
-	uint8_t i;
+	uint32_t i;
 	if(proto->config.smartcard.dev_convention == DEV_CONVENTION_INVERSE) {
 		for(i=0; i<nb_data; i++) {
 			data[i] = data[i] ^ 0xff;
@@ -83,6 +115,11 @@ static void show_params(t_hydra_console *con)
 		proto->config.smartcard.dev_prescaler);
 	print_freq(con, bsp_smartcard_get_clk_frequency(proto->dev_num));
 	cprint(con, "\r\n", 2);
+
+	if(smartcard_card.valid) {
+		cprintf(con, "Protocol: T=%d\r\nFi=%d, Di=%d\r\n", smartcard_card.protocol,
+			smartcard_card.fi, smartcard_card.di);
+	}
 }
 
 static int init(t_hydra_console *con, t_tokenline_parsed *p)
@@ -122,9 +159,6 @@ static void smartcard_get_atr(t_hydra_console *con)
 	uint8_t r = 1;
 	uint8_t checksum = 0;
 	uint8_t more_td = 1;
-	uint16_t Fi [] = {372, 372, 558, 744, 1116, 1488, 1860, 0xFF, 0xFF, 512, 768, 1024, 1536, 2048, 0xFF, 0xFF};
-	uint8_t Di [] = {0xFF, 1, 2, 4, 8, 16, 32, 64, 12, 20, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-	uint8_t FMax [] = {4, 5, 6, 8, 12, 16, 20, 0xFF, 0xFF, 5, 7.5, 10, 15, 20, 0xFF, 0xFF};
 	uint16_t F = 0;
 	uint8_t D = 0;
 	uint16_t E = 0;
@@ -133,6 +167,9 @@ static void smartcard_get_atr(t_hydra_console *con)
 	/* Defaults */
 	init_proto_default(con);
 	bsp_smartcard_init(proto->dev_num, proto);
+	smartcard_card.valid = false;
+	smartcard_card.fi = SMARTCARD_DEFAULT_FI;
+	smartcard_card.di = SMARTCARD_DEFAULT_DI;
 
 	bsp_smartcard_set_rst(proto->dev_num, 0);                       // Start with RST low.
 	DelayMs(1);							// RST low for at least 400 clocks (tb).
@@ -226,9 +263,272 @@ static void smartcard_get_atr(t_hydra_console *con)
 	if(checksum) {
 		bsp_smartcard_read_u8(proto->dev_num, atr+r, 1);
 		apply_convention(con, atr+r, 1);
-		print_hex(con, atr, r+1);
+		r++;
+	}
+	print_hex(con, atr, r);
+
+	smartcard_parse_atr(atr, r);
+	cprintf(con, "Protocol: T=%d\r\n", smartcard_card.protocol);
+	if(smartcard_card.protocol == 1) {
+		bsp_smartcard_set_nack(proto->dev_num, 0);
+		cprintf(con, "IFSC=%d, BWI=%d, CWI=%d\r\n", smartcard_card.ifsc,
+			smartcard_card.bwi, smartcard_card.cwi);
+	}
+
+	/*
+	 * Negotiate TA1 Fi/Di if it is faster than default, a card in specific
+	 * mode does not accept PPS ("pps" command applies TA1 without it).
+	 */
+	if(smartcard_card.ta1_present && !smartcard_card.specific_mode &&
+	   (Fi[smartcard_card.ta1 >> 4] * SMARTCARD_DEFAULT_DI) <
+	   (SMARTCARD_DEFAULT_FI * Di[smartcard_card.ta1 & 0x0F])) {
+		smartcard_pps(con);
+	}
+}
+
+/* Parse interface bytes (ISO7816-3 8.2.3), ATR is in direct convention */
+static void smartcard_parse_atr(uint8_t *atr, uint32_t atr_size)
+{
+	t_smartcard_card *card = &smartcard_card;
+	uint32_t i, n;
+	uint8_t y, t;
+	bool t1_ta, t1_tb, t1_tc;
+
+	card->ta1_present = false;
+	card->ta1 = 0x11;
+	card->specific_mode = false;
+	card->protocol = 0;
+	card->ifsc = T1_IFS_DEFAULT;
+	card->bwi = 4;
+	card->cwi = 13;
+	card->edc_crc = false;
+	card->t1_ready = false;
+	t1_ta = t1_tb = t1_tc = false;
+
+	y = atr[1] >> 4;
+	t = 0;
+	i = 2;
+	/* n is the index of the group, bytes after TDn belong to protocol T of TDn */
+	for(n = 1; i < atr_size; n++) {
+		if((y & 0x1) && (i < atr_size)) {
+			if(n == 1) {
+				card->ta1_present = true;
+				card->ta1 = atr[i];
+			} else if(n == 2) {
+				card->specific_mode = true;
+			} else if((t == 1) && !t1_ta) {
+				card->ifsc = atr[i];
+				t1_ta = true;
+			}
+			i++;
+		}
+		if((y & 0x2) && (i < atr_size)) {
+			if((n >= 3) && (t == 1) && !t1_tb) {
+				card->bwi = atr[i] >> 4;
+				card->cwi = atr[i] & 0x0F;
+				t1_tb = true;
+			}
+			i++;
+		}
+		if((y & 0x4) && (i < atr_size)) {
+			if((n >= 3) && (t == 1) && !t1_tc) {
+				card->edc_crc = atr[i] & 0x1;
+				t1_tc = true;
+			}
+			i++;
+		}
+		if(!(y & 0x8) || (i >= atr_size)) {
+			break;
+		}
+		t = atr[i] & 0x0F;
+		if(n == 1) {
+			card->protocol = t;
+		}
+		y = atr[i] >> 4;
+		i++;
+	}
+	card->valid = true;
+}
+
+/* Protocol and Parameters Selection to TA1 Fi/Di (the highest the card supports) */
+static void smartcard_pps(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_smartcard_card *card = &smartcard_card;
+	uint8_t pps[4], resp[4];
+	uint32_t f, d, clk, nb;
+
+	if(!card->valid) {
+		cprintf(con, "Read ATR first\r\n");
+		return;
+	}
+	f = Fi[card->ta1 >> 4];
+	d = Di[card->ta1 & 0x0F];
+	if((f == 0xFF) || (d == 0xFF)) {
+		cprintf(con, "Invalid TA1: %02X\r\n", card->ta1);
+		return;
+	}
+	clk = (uint32_t)bsp_smartcard_get_clk_frequency(proto->dev_num);
+	if(clk > (FMax[card->ta1 >> 4] * 1000000)) {
+		cprintf(con, "CLK is above card fMax=%d MHz, decrease it with prescaler\r\n",
+			FMax[card->ta1 >> 4]);
+		return;
+	}
+
+	if(card->specific_mode) {
+		/* No PPS in specific mode, TA1 applies directly */
+		cprintf(con, "Card in specific mode\r\n");
 	} else {
-		print_hex(con, atr, r);
+		pps[0] = 0xFF;
+		pps[1] = 0x10 | card->protocol; /* PPS1 present */
+		pps[2] = card->ta1;
+		pps[3] = pps[0] ^ pps[1] ^ pps[2];
+		cprintf(con, "PPS: ");
+		print_hex(con, pps, 4);
+		apply_convention(con, pps, 4);
+		if(bsp_smartcard_write_dma(proto->dev_num, pps, 4) != BSP_OK) {
+			cprintf(con, "PPS write error\r\n");
+			return;
+		}
+		nb = bsp_smartcard_read_dma(proto->dev_num, resp, 4, SMARTCARD_PPS_TIMEOUT);
+		apply_convention(con, resp, nb);
+		apply_convention(con, pps, 4);
+		cprintf(con, "Response: ");
+		print_hex(con, resp, nb);
+		if((nb == 4) && (memcmp(pps, resp, 4) == 0)) {
+			/* Accepted */
+		} else if((nb == 3) && (resp[0] == 0xFF) && !(resp[1] & 0x10) &&
+			  ((resp[0] ^ resp[1] ^ resp[2]) == 0)) {
+			cprintf(con, "Card keeps default Fi/Di\r\n");
+			return;
+		} else {
+			cprintf(con, "PPS failed, card shall be reset (atr)\r\n");
+			return;
+		}
+	}
+
+	if(bsp_smartcard_set_etu(proto->dev_num, f, d) != BSP_OK) {
+		cprintf(con, "Fi=%d, Di=%d not reachable\r\n", f, d);
+		return;
+	}
+	card->fi = f;
+	card->di = d;
+	cprintf(con, "Fi=%d, Di=%d, %d cycles/ETU, %d bps\r\n", f, d, f / d,
+		proto->config.smartcard.dev_speed);
+}
+
+/* ETU in ns */
+static uint32_t smartcard_etu_ns(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t clk_khz;
+
+	clk_khz = (uint32_t)bsp_smartcard_get_clk_frequency(proto->dev_num) / 1000;
+	return (smartcard_card.fi * 1000000 / smartcard_card.di) / clk_khz;
+}
+
+static bool smartcard_t1_send(void *user, const uint8_t *block, uint32_t len)
+{
+	t_hydra_console *con = user;
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t tx[T1_BLOCK_SIZE_MAX];
+
+	memcpy(tx, block, len);
+	apply_convention(con, tx, len);
+	return bsp_smartcard_write_dma(proto->dev_num, tx, len) == BSP_OK;
+}
+
+static int smartcard_t1_recv(void *user, uint8_t *block, uint32_t max, uint8_t wtx)
+{
+	t_hydra_console *con = user;
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t clk_khz, bwt_ms, cwt_ms, len, nb;
+
+	/* BWT = 11 ETU + 2^BWI * 960 * 372 / f, CWT = 11 + 2^CWI ETU */
+	clk_khz = (uint32_t)bsp_smartcard_get_clk_frequency(proto->dev_num) / 1000;
+	bwt_ms = (((1 << smartcard_card.bwi) * 960 * 372) / clk_khz) + 2;
+	bwt_ms *= wtx;
+
+	nb = bsp_smartcard_read_dma(proto->dev_num, block, T1_PROLOGUE_SIZE, TIME_MS2I(bwt_ms));
+	if(nb < T1_PROLOGUE_SIZE) {
+		return -1;
+	}
+	apply_convention(con, block, T1_PROLOGUE_SIZE);
+	len = block[2] + 1;
+	if((T1_PROLOGUE_SIZE + len) > max) {
+		return -1;
+	}
+	cwt_ms = ((((len * 12) + 11 + (1 << smartcard_card.cwi)) * smartcard_etu_ns(con)) / 1000000) + 2;
+	nb = bsp_smartcard_read_dma(proto->dev_num, &block[T1_PROLOGUE_SIZE], len, TIME_MS2I(cwt_ms));
+	apply_convention(con, &block[T1_PROLOGUE_SIZE], nb);
+	return T1_PROLOGUE_SIZE + nb;
+}
+
+static int hex_to_bin(const char *str, uint8_t *bin, uint32_t max)
+{
+	uint32_t len, i;
+	char hex[3];
+	char *end;
+
+	len = strlen(str);
+	if((len == 0) || (len & 1) || ((len / 2) > max)) {
+		return -1;
+	}
+	hex[2] = 0;
+	for(i = 0; i < len / 2; i++) {
+		hex[0] = str[i * 2];
+		hex[1] = str[(i * 2) + 1];
+		bin[i] = strtoul(hex, &end, 16);
+		if(*end != 0) {
+			return -1;
+		}
+	}
+	return len / 2;
+}
+
+static void smartcard_apdu(t_hydra_console *con, const char *str)
+{
+	t_smartcard_card *card = &smartcard_card;
+	uint8_t apdu[SMARTCARD_APDU_MAX];
+	uint8_t resp[SMARTCARD_RESP_MAX];
+	int len, ret;
+
+	len = hex_to_bin(str, apdu, sizeof(apdu));
+	if(len < 4) {
+		cprintf(con, "APDU shall be at least 4 hex bytes (CLA INS P1 P2)\r\n");
+		return;
+	}
+	if(!card->valid || (card->protocol != 1)) {
+		cprintf(con, "APDU needs a T=1 card, read ATR first (use write/read for T=0)\r\n");
+		return;
+	}
+	if(card->edc_crc) {
+		cprintf(con, "T=1 CRC EDC is not supported\r\n");
+		return;
+	}
+
+	if(!card->t1_ready) {
+		smartcard_t1_init(&smartcard_t1, card->ifsc);
+		smartcard_t1.user = con;
+		smartcard_t1.send = &smartcard_t1_send;
+		smartcard_t1.recv = &smartcard_t1_recv;
+		if(!smartcard_t1_set_ifsd(&smartcard_t1, T1_INF_SIZE_MAX)) {
+			cprintf(con, "S(IFS) not accepted, IFSD=%d\r\n", smartcard_t1.ifsd);
+		}
+		card->t1_ready = true;
+	}
+	smartcard_t1.user = con;
+
+	ret = smartcard_t1_transceive(&smartcard_t1, apdu, len, resp, sizeof(resp));
+	if(ret < 0) {
+		cprintf(con, "T=1 error %d (blocks TX=%d RX=%d retries=%d)\r\n", ret,
+			smartcard_t1.nb_blocks_tx, smartcard_t1.nb_blocks_rx,
+			smartcard_t1.nb_retries);
+		return;
+	}
+	print_hex(con, resp, ret);
+	if(ret >= 2) {
+		cprintf(con, "SW=%02X%02X\r\n", resp[ret - 2], resp[ret - 1]);
 	}
 }
 
@@ -430,6 +730,13 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_ATR:
 			smartcard_get_atr(con);
 			break;
+		case T_PPS:
+			smartcard_pps(con);
+			break;
+		case T_APDU:
+			t += 2;
+			smartcard_apdu(con, p->buf + p->tokens[t]);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -438,9 +745,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -462,9 +769,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -486,7 +793,7 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -497,9 +804,9 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -18,12 +18,17 @@
  */
 
 #include "hydrabus_mode_spi.h"
+#include "hydrabus_spi_sniff.h"
+#include "hydrabus_spi_flash.h"
 #include "bsp_spi.h"
 #include "common.h"
+#include "microsd.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
+static int sniff(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+static int flash(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 
 static const char* str_pins_spi1= {
 	"CS:   PA15\r\nSCK:  PB3\r\nMISO: PB4\r\nMOSI: PB5\r\n"
@@ -242,6 +247,12 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 				return t;
 			}
 			break;
+		case T_SNIFF:
+			t += sniff(con, p, t + 1);
+			break;
+		case T_FLASH:
+			t += flash(con, p, t + 1);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -250,6 +261,236 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
+static void flash_show(t_hydra_console *con, const t_spi_flash *flash)
+{
+	int i;
+
+	cprintf(con, "JEDEC ID: 0x%02X 0x%02X 0x%02X (%s)\r\n",
+		flash->jedec_id[0], flash->jedec_id[1], flash->jedec_id[2],
+		flash->sfdp ? "SFDP" : "no SFDP");
+	cprintf(con, "Size: %lu bytes, page: %d bytes, address: %d bytes\r\n",
+		flash->size, flash->page_size, flash->addr_bytes);
+	cprintf(con, "Erase:");
+	for (i = 0; i < SPI_FLASH_ERASE_TYPES; i++) {
+		if (flash->erase_size[i] != 0)
+			cprintf(con, " %luB(0x%02X)", flash->erase_size[i],
+				flash->erase_opcode[i]);
+	}
+	cprintf(con, "\r\n");
+}
+
+/* range_read_to_file()/range_write_from_file() context */
+typedef struct {
+	const t_spi_flash *flash;
+	t_spi_flash_write wr;
+	uint8_t *verify_buf;
+	uint32_t crc;
+} t_flash_io;
+
+static bool flash_read_chunk(t_hydra_console *con, void *ctx, uint32_t addr,
+			     uint8_t *buf, uint32_t nb)
+{
+	t_flash_io *fio = ctx;
+
+	if (spi_flash_read(con->mode->proto.dev_num, fio->flash, addr, buf, nb) != BSP_OK) {
+		cprintf(con, "Read error at 0x%08lX\r\n", addr);
+		return FALSE;
+	}
+	fio->crc = spi_flash_crc32(fio->crc, buf, nb);
+	return TRUE;
+}
+
+/* Erase, program and verify */
+static bool flash_write_begin(t_hydra_console *con, void *ctx, uint32_t start,
+			      uint32_t size)
+{
+	t_flash_io *fio = ctx;
+
+	if (!spi_flash_write_start(fio->flash, &fio->wr, start, size,
+				   SPI_FLASH_WRITE_ERASE | SPI_FLASH_WRITE_VERIFY)) {
+		cprintf(con, "Invalid start or size (start must be aligned on %lu bytes).\r\n",
+			fio->flash->erase_size[0]);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static bool flash_write_chunk(t_hydra_console *con, void *ctx, uint32_t addr,
+			      uint8_t *buf, uint32_t nb)
+{
+	t_flash_io *fio = ctx;
+
+	(void)addr;
+	if (spi_flash_write_chunk(con->mode->proto.dev_num, fio->flash, &fio->wr,
+				  buf, nb, fio->verify_buf) != BSP_OK) {
+		cprintf(con, "Write/verify error at 0x%08lX\r\n", fio->wr.addr);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static int flash(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_spi_flash flash;
+	t_flash_io fio;
+	t_range_io io;
+	uint32_t start, size, mask;
+	uint8_t *buf, *verify_buf;
+	char *filename;
+	int t, action;
+	bool all;
+
+	start = 0;
+	size = 0;
+	filename = NULL;
+	action = T_ID;
+	all = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_START:
+			t += 2;
+			memcpy(&start, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_SIZE:
+			t += 2;
+			memcpy(&size, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_FILE:
+			t += 2;
+			filename = p->buf + p->tokens[t];
+			break;
+		case T_ALL:
+			all = TRUE;
+			break;
+		case T_ID:
+		case T_READ:
+		case T_WRITE:
+		case T_ERASE:
+			action = p->tokens[t];
+			break;
+		}
+	}
+
+	if (action == T_ERASE && size == 0 && !all) {
+		cprintf(con, "Please specify erase size or all.\r\n");
+		return t - token_pos;
+	}
+	if (!spi_flash_probe(proto->dev_num, &flash)) {
+		cprintf(con, "No SPI flash found.\r\n");
+		return t - token_pos;
+	}
+	if (action == T_ID) {
+		flash_show(con, &flash);
+		return t - token_pos;
+	}
+
+	if (start >= flash.size) {
+		cprintf(con, "Start is above memory size.\r\n");
+		return t - token_pos;
+	}
+	if (action != T_WRITE && (all || size == 0 || size > flash.size - start))
+		size = flash.size - start;
+	if (action == T_READ && filename == NULL && size > SPI_FLASH_CHUNK_SIZE) {
+		cprintf(con, "Please specify read size (up to %d bytes) or a filename.\r\n",
+			SPI_FLASH_CHUNK_SIZE);
+		return t - token_pos;
+	}
+	if (action == T_WRITE && filename == NULL) {
+		cprintf(con, "Please specify a filename.\r\n");
+		return t - token_pos;
+	}
+
+	if (action == T_ERASE) {
+		mask = flash.erase_size[0] - 1;
+		if ((start & mask) || (size & mask)) {
+			cprintf(con, "Start and size must be aligned on %lu bytes.\r\n",
+				flash.erase_size[0]);
+		} else if (spi_flash_erase(proto->dev_num, &flash, start, size) != BSP_OK) {
+			cprintf(con, "Erase error.\r\n");
+		} else {
+			cprintf(con, "%lu bytes erased\r\n", size);
+		}
+		return t - token_pos;
+	}
+
+	buf = pool_alloc_bytes(SPI_FLASH_CHUNK_SIZE);
+	verify_buf = pool_alloc_bytes(SPI_FLASH_CHUNK_SIZE);
+	fio.flash = &flash;
+	fio.verify_buf = verify_buf;
+	fio.crc = 0;
+	io.ctx = &fio;
+	io.buf = buf;
+	io.chunk_size = SPI_FLASH_CHUNK_SIZE;
+	if (buf == NULL || verify_buf == NULL) {
+		cprintf(con, "Not enough memory.\r\n");
+	} else if (action == T_READ) {
+		io.begin = NULL;
+		io.chunk = flash_read_chunk;
+		if (range_read_to_file(con, &io, start, size, filename) &&
+		    filename != NULL)
+			cprintf(con, "%lu bytes written to %s (CRC32 0x%08lX)\r\n",
+				size, filename, fio.crc);
+	} else {
+		io.begin = flash_write_begin;
+		io.chunk = flash_write_chunk;
+		if (range_write_from_file(con, &io, start, &size, filename))
+			cprintf(con, "%lu bytes programmed from %s (CRC32 0x%08lX)\r\n",
+				size, filename, fio.wr.crc);
+	}
+	pool_free(buf);
+	pool_free(verify_buf);
+
+	return t - token_pos;
+}
+
+static int sniff(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	t_spi_sniff_stats stats;
+	char *filename;
+	FIL fp;
+	int t;
+
+	filename = NULL;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_FILE:
+			t += 2;
+			filename = p->buf + p->tokens[t];
+			break;
+		}
+	}
+
+	if (filename != NULL) {
+		if (!file_open(&fp, filename, 'w') || f_truncate(&fp) != FR_OK) {
+			cprintf(con, "Failed to open file %s\r\n", filename);
+			return t - token_pos;
+		}
+	}
+
+	if (!spi_sniff_start(con)) {
+		cprintf(con, "Not enough memory or DMA stream busy.\r\n");
+		spi_sniff_stop(con);
+		if (filename != NULL)
+			file_close(&fp);
+		return t - token_pos;
+	}
+
+	cprintf(con, "Interrupt by pressing user button or any key.\r\n");
+	if (filename != NULL)
+		spi_sniff_run(con, SPI_SNIFF_OUT_FILE, &fp, &stats);
+	else
+		spi_sniff_run(con, SPI_SNIFF_OUT_TEXT, NULL, &stats);
+	spi_sniff_stop(con);
+
+	if (filename != NULL && !file_close(&fp))
+		cprintf(con, "Failed to write file %s\r\n", filename);
+	cprintf(con, "%lu frames, %lu bytes, %lu overruns\r\n",
+		stats.nb_frames, stats.nb_bytes, stats.nb_overruns);
+
+	return t - token_pos;
+}
+
 static void start(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -266,9 +507,9 @@ static void stop(t_hydra_console *con)
 	cprintf(con, hydrabus_mode_str_cs_disabled);
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -289,9 +530,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -312,7 +553,7 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -321,9 +562,9 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
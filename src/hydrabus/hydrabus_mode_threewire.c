@@ -131,6 +131,7 @@ inline void threewire_clock(t_hydra_console *con)
 	}
 }
 
+HOT_FUNC
 uint8_t threewire_send_bit(t_hydra_console *con, uint8_t bit)
 {
 	if (bit) {
@@ -147,6 +148,7 @@ uint8_t threewire_read_bit(t_hydra_console *con)
 	return bsp_gpio_pin_read(BSP_GPIO_PORTB, proto->config.rawwire.sdi_pin);
 }
 
+HOT_FUNC
 uint8_t threewire_read_bit_clock(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -205,6 +207,7 @@ static void bitr(t_hydra_console *con)
 	cprintf(con, hydrabus_mode_str_read_one_u8, rx_data);
 }
 
+HOT_FUNC
 void threewire_write_u8(t_hydra_console *con, uint8_t tx_data)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -219,6 +222,7 @@ void threewire_write_u8(t_hydra_console *con, uint8_t tx_data)
 	}
 }
 
+HOT_FUNC
 uint8_t threewire_read_u8(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -341,9 +345,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	for (i = 0; i < nb_data; i++) {
 		threewire_write_u8(con, tx_data[i]);
 	}
@@ -362,9 +366,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 
 	for(i = 0; i < nb_data; i++) {
 		rx_data[i] = threewire_read_u8(con);
@@ -384,9 +388,9 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 
 	for(i=0; i<nb_data; i++) {
 		rx_data[i] = threewire_write_read_u8(con, tx_data[i]);
@@ -403,9 +407,9 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return BSP_OK;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	uint8_t i;
+	uint32_t i;
 
 	i = 0;
 	while(i < nb_data){
@@ -143,6 +143,7 @@ inline void twowire_clock(t_hydra_console *con)
 	}
 }
 
+HOT_FUNC
 uint8_t twowire_send_bit(t_hydra_console *con, uint8_t bit)
 {
 	twowire_sda_mode_output(con);
@@ -163,6 +164,7 @@ uint8_t twowire_read_bit(t_hydra_console *con)
 	return bsp_gpio_pin_read(BSP_GPIO_PORTC, proto->config.rawwire.sdi_pin);
 }
 
+HOT_FUNC
 uint8_t twowire_read_bit_clock(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -223,6 +225,7 @@ static void bitr(t_hydra_console *con)
 	cprintf(con, hydrabus_mode_str_read_one_u8, rx_data);
 }
 
+HOT_FUNC
 uint8_t twowire_write_u8(t_hydra_console *con, uint8_t tx_data)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -237,6 +240,7 @@ uint8_t twowire_write_u8(t_hydra_console *con, uint8_t tx_data)
 	return BSP_OK;
 }
 
+HOT_FUNC
 uint8_t twowire_read_u8(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -445,9 +449,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	for (i = 0; i < nb_data; i++) {
 		twowire_write_u8(con, tx_data[i]);
 	}
@@ -466,9 +470,9 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 
 	for(i = 0; i < nb_data; i++) {
 		rx_data[i] = twowire_read_u8(con);
@@ -488,9 +492,9 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	uint8_t i;
+	uint32_t i;
 
 	i = 0;
 	while(i < nb_data){
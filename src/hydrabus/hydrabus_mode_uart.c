@@ -24,6 +24,22 @@
 
 #define UART_DEFAULT_SPEED (9600)
 
+/*
+ * Background capture (periodic service): UART RX circular DMA in a ring
+ * read by periodic(), the DMA streams are stopped when the service stops and
+ * before any other command receives data.
+ */
+#define UART_RX_RING_SIZE (512)
+
+typedef struct {
+	uint8_t buf[UART_RX_RING_SIZE];
+	uint32_t rd; /* Index of next byte to print */
+	bool running;
+} t_uart_rx_ring;
+
+/* Main SRAM (DMA) */
+static t_uart_rx_ring uart_rx_ring[BSP_DEV_UART_END];
+
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
 
@@ -149,6 +165,16 @@ static void baudrate(t_hydra_console *con)
 	bsp_freq_deinit(proto->dev_num);
 }
 
+static void uart_rx_ring_stop(mode_config_proto_t* proto)
+{
+	t_uart_rx_ring *ring = &uart_rx_ring[proto->dev_num];
+
+	if (!ring->running)
+		return;
+	bsp_uart_dma_stop(proto->dev_num);
+	ring->running = FALSE;
+}
+
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -159,6 +185,8 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	int baudrate_err_int_part;
 	int baudrate_err_dec_part;
 
+	uart_rx_ring_stop(proto);
+
 	for (t = token_pos; p->tokens[t]; t++) {
 		switch (p->tokens[t]) {
 		case T_SHOW:
@@ -261,9 +289,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -284,12 +312,14 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	uart_rx_ring_stop(proto);
+
 	status = bsp_uart_read_u8(proto->dev_num, rx_data, nb_data);
 	if(status == BSP_OK) {
 		if(nb_data == 1) {
@@ -307,22 +337,26 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	uart_rx_ring_stop(proto);
+
 	status = bsp_uart_read_u8(proto->dev_num, rx_data, nb_data);
 
 	return status;
 }
 
-static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	uint32_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	uart_rx_ring_stop(proto);
+
 	status = bsp_uart_write_read_u8(proto->dev_num, tx_data, rx_data, nb_data);
 	if(status == BSP_OK) {
 		if(nb_data == 1) {
@@ -338,10 +372,56 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return status;
 }
 
+/*
+ * Print bytes received since last call (UART sniffer in background).
+ * Reception is done by DMA in uart_rx_ring, the period shall be lower than
+ * the time to receive UART_RX_RING_SIZE bytes (44ms at 115200 bauds).
+ */
+static uint32_t periodic(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_uart_rx_ring *ring = &uart_rx_ring[proto->dev_num];
+	uint32_t wr, nb_data;
+
+	/* (Re)start the ring on first call so old data are not printed */
+	if (con->periodic.nb_calls == 0 || !ring->running) {
+		uart_rx_ring_stop(proto);
+		ring->rd = 0;
+		if (bsp_uart_dma_rx_start(proto->dev_num, ring->buf,
+					  UART_RX_RING_SIZE) != BSP_OK)
+			return BSP_ERROR;
+		ring->running = TRUE;
+		return BSP_OK;
+	}
+
+	wr = (UART_RX_RING_SIZE - bsp_uart_dma_rx_remaining(proto->dev_num)) %
+	     UART_RX_RING_SIZE;
+	if (wr < ring->rd) {
+		nb_data = UART_RX_RING_SIZE - ring->rd;
+		print_hex_bytes(con, "RX:", &ring->buf[ring->rd], nb_data);
+		ring->rd = 0;
+	}
+	if (wr > ring->rd) {
+		nb_data = wr - ring->rd;
+		print_hex_bytes(con, "RX:", &ring->buf[ring->rd], nb_data);
+		ring->rd = wr;
+	}
+	return BSP_OK;
+}
+
+static void periodic_stop(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	uart_rx_ring_stop(proto);
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	uart_rx_ring_stop(proto);
+
 	bsp_uart_deinit(proto->dev_num);
 }
 
@@ -375,6 +455,8 @@ const mode_exec_t mode_uart_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.periodic = &periodic,
+	.periodic_stop = &periodic_stop,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
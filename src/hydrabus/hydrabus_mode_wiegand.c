@@ -27,6 +27,8 @@
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
+static void sniff(t_hydra_console *con);
+static int card(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 
 static const char* str_prompt_wiegand[] = {
 	"wiegand1" PROMPT,
@@ -86,42 +88,80 @@ bool wiegand_pin_init(t_hydra_console *con)
 	return true;
 }
 
-inline void wiegand_d0_high(void)
+static inline void wiegand_d0_high(void)
 {
 	bsp_gpio_set(BSP_GPIO_PORTB, WIEGAND_D0_PIN);
 }
 
-inline void wiegand_d0_low(void)
+static inline void wiegand_d0_low(void)
 {
 	bsp_gpio_clr(BSP_GPIO_PORTB, WIEGAND_D0_PIN);
 }
 
-inline void wiegand_d1_high(void)
+static inline void wiegand_d1_high(void)
 {
 	bsp_gpio_set(BSP_GPIO_PORTB, WIEGAND_D1_PIN);
 }
 
-inline void wiegand_d1_low(void)
+static inline void wiegand_d1_low(void)
 {
 	bsp_gpio_clr(BSP_GPIO_PORTB, WIEGAND_D1_PIN);
 }
 
-void wiegand_write_bit(t_hydra_console *con, uint8_t bit)
+/* Wait us microseconds with bsp_tim (started by wiegand_send()) */
+static void wiegand_tim_wait(uint32_t us)
+{
+	uint32_t n;
+
+	while (us > 0) {
+		n = (us > WIEGAND_TIM_PERIOD_MAX) ? WIEGAND_TIM_PERIOD_MAX : us;
+		TIM4->ARR = n - 1;
+		TIM4->CNT = 0;
+		bsp_tim_clr_irq();
+		bsp_tim_wait_irq();
+		us -= n;
+	}
+}
+
+/*
+ * Send frame bits with timer timed pulses, kernel is locked during pulses so
+ * their width is not changed by interrupts.
+ * Pulse gap is also waited after last bit.
+ */
+void wiegand_send(t_hydra_console *con, const t_wiegand_frame *frame)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t i;
 
 	wiegand_mode_output(con);
-	if(bit){
-		wiegand_d1_low();
-		DelayUs(proto->config.wiegand.dev_pulse_width);
-		wiegand_d1_high();
-		DelayUs(proto->config.wiegand.dev_pulse_gap);
-	}else{
-		wiegand_d0_low();
-		DelayUs(proto->config.wiegand.dev_pulse_width);
-		wiegand_d0_high();
-		DelayUs(proto->config.wiegand.dev_pulse_gap);
+	bsp_tim_init(WIEGAND_TIM_PERIOD_MAX, WIEGAND_TIM_PRESCALER,
+		     BSP_TIM_CLOCKDIVISION_DIV1, BSP_TIM_COUNTERMODE_UP);
+
+	for (i = 0; i < frame->nb_bits; i++) {
+		chSysLock();
+		if (wiegand_frame_bit(frame, i)) {
+			wiegand_d1_low();
+			wiegand_tim_wait(proto->config.wiegand.dev_pulse_width);
+			wiegand_d1_high();
+		} else {
+			wiegand_d0_low();
+			wiegand_tim_wait(proto->config.wiegand.dev_pulse_width);
+			wiegand_d0_high();
+		}
+		chSysUnlock();
+		wiegand_tim_wait(proto->config.wiegand.dev_pulse_gap);
 	}
+
+	bsp_tim_deinit();
+}
+
+static void wiegand_write_bit(t_hydra_console *con, uint8_t bit)
+{
+	t_wiegand_frame frame;
+
+	frame.nb_bits = 1;
+	frame.bits[0] = bit ? 0x80 : 0;
+	wiegand_send(con, &frame);
 }
 
 static void dath(t_hydra_console *con)
@@ -136,60 +176,144 @@ static void datl(t_hydra_console *con)
 	cprintf(con, "BIT 0\r\n");
 }
 
-// Returns the status of the pins on 2 bits
-// value is inverted because a logical 0 means there is a transmission
-static uint8_t wiegand_sense_pins(void)
+/* Frame ends when no bit is received during two bit periods */
+static uint32_t wiegand_frame_gap(t_hydra_console *con)
 {
-	uint8_t v;
-
-	v = !bsp_gpio_pin_read(BSP_GPIO_PORTB, WIEGAND_D1_PIN)<<1;
-	v |= (!bsp_gpio_pin_read(BSP_GPIO_PORTB, WIEGAND_D0_PIN));
+	mode_config_proto_t* proto = &con->mode->proto;
 
-	return v;
+	return 2 * (proto->config.wiegand.dev_pulse_width +
+		    proto->config.wiegand.dev_pulse_gap);
 }
 
-uint8_t wiegand_read(t_hydra_console *con, uint8_t *rx_data)
+/* Wait one frame (up to WIEGAND_TIMEOUT_MAX), FALSE on timeout or UBTN */
+bool wiegand_read(t_hydra_console *con, t_wiegand_frame *frame)
 {
 	uint32_t start_time;
-	uint16_t i = 0;
-	uint8_t tmp = 0;
+	bool found;
 
 	wiegand_mode_input(con);
+	if (!wiegand_capture_start(wiegand_frame_gap(con)))
+		return FALSE;
 
-	//Wait for first bit
+	found = FALSE;
 	start_time = HAL_GetTick();
-	while(tmp == 0 && !hydrabus_ubtn()) {
-		if((HAL_GetTick()-start_time) > WIEGAND_TIMEOUT_MAX) {
-			return 0;
-		}
-		tmp = wiegand_sense_pins();
+	while (!hydrabus_ubtn() && (HAL_GetTick() - start_time) < WIEGAND_TIMEOUT_MAX) {
+		found = wiegand_capture_get(frame);
+		if (found)
+			break;
+		chThdSleepMilliseconds(1);
 	}
+	wiegand_capture_stop();
 
-	while(i < 255 && !hydrabus_ubtn()) {
-		tmp = wiegand_sense_pins();
-		if(tmp == 0) {
-			if((HAL_GetTick()-start_time) > WIEGAND_TIMEOUT_FRAME) {
-				return i;
-			}
-		} else {
-			rx_data[i++] = tmp;
-			while(wiegand_sense_pins() != 0) {
-			}
-			start_time = HAL_GetTick();
+	return found;
+}
+
+void wiegand_write_u8(t_hydra_console *con, uint8_t tx_data)
+{
+	t_wiegand_frame frame;
+
+	frame.nb_bits = 8;
+	frame.bits[0] = tx_data;
+	wiegand_send(con, &frame);
+}
+
+/* Bits then card fields if frame has a known format */
+static void print_frame(t_hydra_console *con, const t_wiegand_frame *frame)
+{
+	char bits[WIEGAND_BITS_MAX + 1];
+	t_wiegand_card card;
+	uint32_t i;
+
+	for (i = 0; i < frame->nb_bits; i++)
+		bits[i] = '0' + wiegand_frame_bit(frame, i);
+	bits[i] = 0;
+
+	cprintf(con, "%d bits: %s", frame->nb_bits, bits);
+	if (frame->flags & WIEGAND_FLAG_OVERFLOW)
+		cprintf(con, " (overflow)");
+	if (frame->flags & WIEGAND_FLAG_COLLISION)
+		cprintf(con, " (D0/D1 collision)");
+	if (wiegand_decode(frame, &card))
+		cprintf(con, "\r\n%s FC: %lu CN: %lu parity %s",
+			card.format->name, card.facility, card.card,
+			card.parity_ok ? "OK" : "error");
+	cprintf(con, "\r\n");
+}
+
+/* Print frames until UBTN or a key is pressed */
+static void sniff(t_hydra_console *con)
+{
+	t_wiegand_frame frame;
+	uint32_t prev, nb_frames;
+	uint8_t data;
+
+	wiegand_mode_input(con);
+	if (!wiegand_capture_start(wiegand_frame_gap(con))) {
+		cprintf(con, "Capture already running.\r\n");
+		return;
+	}
+	cprintf(con, "Interrupt by pressing user button or any key.\r\n");
+
+	nb_frames = 0;
+	prev = 0;
+	while (!hydrabus_ubtn() && chnReadTimeout(con->sdu, &data, 1, TIME_IMMEDIATE) == 0) {
+		if (!wiegand_capture_get(&frame)) {
+			chThdSleepMilliseconds(1);
+			continue;
 		}
+		if (nb_frames > 0)
+			cprintf(con, "+%luus ", (frame.timestamp - prev) / (STM32_HCLK / 1000000));
+		prev = frame.timestamp;
+		nb_frames++;
+		print_frame(con, &frame);
 	}
-	return 0;
+	wiegand_capture_stop();
+
+	cprintf(con, "%lu frames, %lu lost\r\n", nb_frames, wiegand_capture_lost());
 }
 
-void wiegand_write_u8(t_hydra_console *con, uint8_t tx_data)
+/* Send a card number with parity bits */
+static int card(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
-	uint8_t i;
+	const t_wiegand_format *format;
+	t_wiegand_frame frame;
+	uint32_t nb_bits, facility, number;
+	int t;
 
-	wiegand_mode_output(con);
+	nb_bits = 26;
+	facility = 0;
+	number = 0;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_ID:
+			t += 2;
+			memcpy(&number, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_FACILITY:
+			t += 2;
+			memcpy(&facility, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_FORMAT:
+			t += 2;
+			memcpy(&nb_bits, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		}
+	}
 
-	for (i=0; i<8; i++) {
-		wiegand_write_bit(con, (tx_data>>(7-i)) & 1);
+	format = wiegand_format_get(nb_bits);
+	if (format == NULL) {
+		cprintf(con, "Unknown format, supported formats: 26, 34 and 37 bits.\r\n");
+		return t - token_pos;
+	}
+	if (!wiegand_encode(format, facility, number, &frame)) {
+		cprintf(con, "Facility or card number too large for %s.\r\n", format->name);
+		return t - token_pos;
 	}
+
+	wiegand_send(con, &frame);
+	print_frame(con, &frame);
+
+	return t - token_pos;
 }
 
 static int init(t_hydra_console *con, t_tokenline_parsed *p)
@@ -233,6 +357,12 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			}
 			wiegand_pin_init(con);
 			break;
+		case T_SNIFF:
+			sniff(con);
+			break;
+		case T_CARD:
+			t += card(con, p, t + 1);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -241,9 +371,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return t - token_pos;
 }
 
-static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
+static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
 {
-	int i;
+	uint32_t i;
 	for (i = 0; i < nb_data; i++) {
 		wiegand_write_u8(con, tx_data[i]);
 	}
@@ -262,20 +392,18 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
-static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
+static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
 {
-	uint8_t i;
-	uint8_t nb_bits;
+	t_wiegand_frame frame;
 
-	while(nb_data > 0) {
-		nb_bits = wiegand_read(con, rx_data);
+	(void)rx_data;
 
+	while(nb_data > 0) {
 		cprintf(con, hydrabus_mode_str_mul_read);
-		for(i = 0; i < nb_bits; i++) {
-			cprintf(con, "%d ",
-				rx_data[i] == 0b10 ? 1 : 0);
-		}
-		cprintf(con, hydrabus_mode_str_mul_br);
+		if (wiegand_read(con, &frame))
+			print_frame(con, &frame);
+		else
+			cprintf(con, hydrabus_mode_str_mul_br);
 		nb_data--;
 	}
 	return BSP_OK;
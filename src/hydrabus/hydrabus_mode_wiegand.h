@@ -18,19 +18,20 @@
 */
 
 #include "hydrabus_mode.h"
+#include "hydrabus_wiegand.h"
 
 #define WIEGAND_D0_PIN	 8
 #define WIEGAND_D1_PIN	 9
 
-#define WIEGAND_TIMEOUT_MAX 100000  // Max 200ms between bits
-#define WIEGAND_TIMEOUT_FRAME 2000  // Max 200ms between bits
+#define WIEGAND_TIMEOUT_MAX 100000  // Max 10s to wait a frame
+
+/* Pulses are timed by bsp_tim (84MHz timer clock) with 1us resolution */
+#define WIEGAND_TIM_PRESCALER (84)
+#define WIEGAND_TIM_PERIOD_MAX (65536)
 
 void wiegand_init_proto_default(t_hydra_console *con);
 bool wiegand_pin_init(t_hydra_console *con);
-uint8_t wiegand_read(t_hydra_console *con, uint8_t *rx_data);
+bool wiegand_read(t_hydra_console *con, t_wiegand_frame *frame);
+void wiegand_send(t_hydra_console *con, const t_wiegand_frame *frame);
 void wiegand_write_u8(t_hydra_console *con, uint8_t tx_data);
-inline void wiegand_d0_high(void);
-inline void wiegand_d0_low(void);
-inline void wiegand_d1_high(void);
-inline void wiegand_d1_low(void);
 void wiegand_cleanup(t_hydra_console *con);
@@ -0,0 +1,181 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "tokenline.h"
+#include "bsp.h"
+
+#include "hydrabus_mode.h"
+#include "hydrabus_periodic.h"
+
+/*
+ * Background scheduler of mode periodic service: a thread per console calls
+ * con->mode->exec->periodic() every period while the console is idle (waiting
+ * for input), so monitoring runs while user keeps issuing commands.
+ * con->mutex is held by the console thread while it processes input, the
+ * service is delayed (not missed) while it is locked.
+ */
+
+static uint32_t periodic_now_us(void)
+{
+	return (uint32_t)(bsp_get_cyclecounter64() / (STM32_HCLK / 1000000));
+}
+
+static THD_FUNCTION(periodic_thread, arg)
+{
+	t_hydra_console *con = arg;
+	t_periodic_sched *sched = &con->periodic;
+	uint32_t (*periodic)(t_hydra_console *con);
+	uint32_t start, delay, status, overruns;
+
+	chRegSetThreadName("periodic");
+	periodic = con->mode->exec->periodic;
+
+	while (!chThdShouldTerminateX()) {
+		delay = periodic_sched_delay(sched, periodic_now_us());
+		if (delay > 0) {
+			chThdSleepMicroseconds(delay);
+			continue;
+		}
+
+		/* Console is executing a command */
+		if (!chMtxTryLock(&con->mutex)) {
+			chThdSleep(1);
+			continue;
+		}
+		overruns = sched->nb_overruns;
+		start = periodic_now_us();
+		status = periodic(con);
+		periodic_sched_done(sched, start, periodic_now_us());
+		PERF_MODE_ADD(con, overruns, sched->nb_overruns - overruns);
+		chMtxUnlock(&con->mutex);
+
+		if (status != HYDRABUS_MODE_STATUS_OK) {
+			cprintf(con, "Periodic service stopped, error %d\r\n", status);
+			break;
+		}
+	}
+}
+
+static bool periodic_start(t_hydra_console *con, uint32_t period_us,
+			   uint32_t budget_us)
+{
+	hydrabus_periodic_stop(con);
+
+	periodic_sched_init(&con->periodic, period_us, budget_us,
+			    periodic_now_us());
+	con->periodic_thread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE,
+						   "periodic", NORMALPRIO,
+						   periodic_thread, con);
+	return (con->periodic_thread != NULL);
+}
+
+/* Stop periodic service, it must be called before mode cleanup */
+void hydrabus_periodic_stop(t_hydra_console *con)
+{
+	if (con->periodic_thread == NULL)
+		return;
+
+	chThdTerminate(con->periodic_thread);
+	chThdWait(con->periodic_thread);
+	con->periodic_thread = NULL;
+	if (con->mode->exec->periodic_stop != NULL)
+		con->mode->exec->periodic_stop(con);
+}
+
+static void periodic_show(t_hydra_console *con)
+{
+	t_periodic_sched *sched = &con->periodic;
+	bool running;
+
+	running = (con->periodic_thread != NULL) &&
+		  !chThdTerminatedX(con->periodic_thread);
+	cprintf(con, "Periodic service: %s period: %dus budget: %dus\r\n",
+		running ? "ON" : "OFF", sched->period_us, sched->budget_us);
+	cprintf(con, "Calls: %d overruns: %d missed: %d avg: %dus max: %dus\r\n",
+		sched->nb_calls, sched->nb_overruns, sched->nb_missed,
+		periodic_sched_avg_us(sched), sched->max_us);
+}
+
+/*
+ * "periodic [period <us>] [budget <us>] [on/off]", without on/off the
+ * state and statistics are displayed.
+ * period and budget are applied immediately if service is running.
+ * Returns the number of tokens eaten.
+ */
+int hydrabus_periodic(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	uint32_t period_us, budget_us;
+	int t, action;
+
+	if (con->mode->exec->periodic == NULL) {
+		cprintf(con, "Periodic service not supported in this mode.\r\n");
+		return 0;
+	}
+
+	period_us = con->periodic.period_us;
+	if (period_us == 0)
+		period_us = PERIODIC_DEFAULT_PERIOD_US;
+	budget_us = con->periodic.budget_us;
+	if (budget_us == 0)
+		budget_us = PERIODIC_DEFAULT_BUDGET_US;
+
+	action = 0;
+	for (t = token_pos + 1; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_PERIOD:
+			t += 2;
+			memcpy(&period_us, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (period_us < PERIODIC_MIN_PERIOD_US ||
+			    period_us > PERIODIC_MAX_PERIOD_US) {
+				cprintf(con, "Period must be %d to %dus.\r\n",
+					PERIODIC_MIN_PERIOD_US, PERIODIC_MAX_PERIOD_US);
+				while (p->tokens[t + 1])
+					t++;
+				return t - token_pos;
+			}
+			break;
+		case T_BUDGET:
+			t += 2;
+			memcpy(&budget_us, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_ON:
+		case T_OFF:
+			action = p->tokens[t];
+			break;
+		}
+	}
+	con->periodic.period_us = period_us;
+	con->periodic.budget_us = budget_us;
+
+	if (action == T_ON) {
+		if (periodic_start(con, period_us, budget_us))
+			cprintf(con, "Periodic service started.\r\n");
+		else
+			cprintf(con, "Error, unable to start periodic service.\r\n");
+	} else if (action == T_OFF) {
+		hydrabus_periodic_stop(con);
+		periodic_show(con);
+	} else {
+		periodic_show(con);
+	}
+
+	return t - token_pos - 1;
+}
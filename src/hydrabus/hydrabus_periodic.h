@@ -0,0 +1,33 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_PERIODIC_H_
+#define _HYDRABUS_PERIODIC_H_
+
+#include "common.h"
+#include "tokenline.h"
+
+#define PERIODIC_DEFAULT_PERIOD_US (1000)
+#define PERIODIC_DEFAULT_BUDGET_US (500)
+#define PERIODIC_MIN_PERIOD_US (100) /* 1 system tick */
+#define PERIODIC_MAX_PERIOD_US (1000000)
+
+int hydrabus_periodic(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
+void hydrabus_periodic_stop(t_hydra_console *con);
+
+#endif /* _HYDRABUS_PERIODIC_H_ */
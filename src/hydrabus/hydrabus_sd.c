@@ -65,6 +65,12 @@ int cmd_sd_test_perf(t_hydra_console *con, t_tokenline_parsed *p)
 		return FALSE;
 #endif
 
+	if (!sd_perf_write(con))
+		return FALSE;
+
+	if (!sd_perf_file(con))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -19,12 +19,75 @@
 
 #include "common.h"
 #include "tokenline.h"
+#include <string.h>
 
 #include "hydrabus_bbio.h"
 #include "hydrabus_serprog.h"
 #include "hydrabus_mode_spi.h"
 #include "bsp_spi.h"
 
+/*
+ * Operation buffer commands (S_CMD_O_INIT/O_DELAY/O_EXEC) are stored as
+ * received and run by S_CMD_O_EXEC.
+ * S_CMD_Q_CHIPSIZE, S_CMD_R_BYTE/R_NBYTES and S_CMD_O_WRITEB/O_WRITEN are
+ * parallel bus memory cycles and are not supported as only SPI bus type is
+ * advertised, SPI memories are read and written with S_CMD_O_SPIOP.
+ * Host may send up to SERPROG_SERBUF_SIZE bytes of commands before reading
+ * answers (USB flow control prevents overflow).
+ */
+#define SERPROG_OPBUF_SIZE (4096)
+#define SERPROG_SERBUF_SIZE (4096)
+#define SERPROG_SPIOP_SIZE (4096) /* O_SPIOP write and read buffers */
+/* Write-N length used by host for O_SPIOP data: opcode and 4 address bytes */
+#define SERPROG_WRNMAXLEN (SERPROG_SPIOP_SIZE - 5)
+#define SERPROG_RDNMAXLEN (SERPROG_SPIOP_SIZE)
+#define SERPROG_OP_DELAY_LEN (5) /* O_DELAY and its 32bits parameter */
+
+static void serprog_put_le24(uint8_t *data, uint32_t value)
+{
+	data[0] = value;
+	data[1] = value >> 8;
+	data[2] = value >> 16;
+}
+
+/* Store S_CMD_O_DELAY with its parameter in opbuf, FALSE if it does not fit */
+static bool serprog_opbuf_add(t_hydra_console *con, uint8_t *opbuf, uint32_t *opbuf_len,
+			      uint8_t cmd)
+{
+	uint8_t params[4];
+
+	chnRead(con->sdu, params, sizeof(params));
+	if(*opbuf_len + SERPROG_OP_DELAY_LEN > SERPROG_OPBUF_SIZE) {
+		return FALSE;
+	}
+
+	opbuf[*opbuf_len] = cmd;
+	memcpy(&opbuf[*opbuf_len + 1], params, sizeof(params));
+	*opbuf_len += SERPROG_OP_DELAY_LEN;
+	return TRUE;
+}
+
+/* Run operations stored in opbuf */
+static bool serprog_opbuf_exec(uint8_t *opbuf, uint32_t opbuf_len)
+{
+	uint32_t idx;
+	uint8_t *op;
+
+	idx = 0;
+	while(idx < opbuf_len) {
+		op = &opbuf[idx];
+		switch(op[0]) {
+		case S_CMD_O_DELAY:
+			DelayUs(op[1] + (op[2] << 8) + (op[3] << 16) + ((uint32_t)op[4] << 24));
+			idx += SERPROG_OP_DELAY_LEN;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 void bbio_serprog_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -42,16 +105,19 @@ void bbio_serprog_init_proto_default(t_hydra_console *con)
 void bbio_mode_serprog(t_hydra_console *con)
 {
 	uint8_t serprog_command;
-	uint32_t to_rx, to_tx, i;
+	uint32_t to_rx, to_tx, i, opbuf_len;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
+	uint8_t *opbuf = pool_alloc_bytes(SERPROG_OPBUF_SIZE);
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	if(tx_data == 0 || rx_data == 0) {
+	if(tx_data == 0 || rx_data == 0 || opbuf == 0) {
 		pool_free(tx_data);
 		pool_free(rx_data);
+		pool_free(opbuf);
 		return;
 	}
+	opbuf_len = 0;
 
 	bbio_serprog_init_proto_default(con);
 
@@ -70,7 +136,8 @@ void bbio_mode_serprog(t_hydra_console *con)
 				break;
 			case S_CMD_Q_CMDMAP:
 				cprint(con, S_ACK, 1);
-				cprint(con, "\x3f\x01\x3f\x00", 4);
+				/* No parallel bus commands (0x06, 0x09, 0x0A, 0x0C, 0x0D) */
+				cprint(con, "\xbf\xc9\x3f\x00", 4);
 				cprint(con, "\x00\x00\x00\x00", 4);
 				cprint(con, "\x00\x00\x00\x00", 4);
 				cprint(con, "\x00\x00\x00\x00", 4);
@@ -85,8 +152,34 @@ void bbio_mode_serprog(t_hydra_console *con)
 				break;
 			case S_CMD_Q_SERBUF:
 				cprint(con, S_ACK, 1);
-				//16 bytes  UART buffer
-				cprint(con, "\x10\x00", 2);
+				tx_data[0] = SERPROG_SERBUF_SIZE & 0xff;
+				tx_data[1] = SERPROG_SERBUF_SIZE >> 8;
+				cprint(con, (char *)tx_data, 2);
+				break;
+			case S_CMD_Q_OPBUF:
+				cprint(con, S_ACK, 1);
+				tx_data[0] = SERPROG_OPBUF_SIZE & 0xff;
+				tx_data[1] = SERPROG_OPBUF_SIZE >> 8;
+				cprint(con, (char *)tx_data, 2);
+				break;
+			case S_CMD_O_INIT:
+				opbuf_len = 0;
+				cprint(con, S_ACK, 1);
+				break;
+			case S_CMD_O_DELAY:
+				if(serprog_opbuf_add(con, opbuf, &opbuf_len, serprog_command)) {
+					cprint(con, S_ACK, 1);
+				} else {
+					cprint(con, S_NAK, 1);
+				}
+				break;
+			case S_CMD_O_EXEC:
+				if(serprog_opbuf_exec(opbuf, opbuf_len)) {
+					cprint(con, S_ACK, 1);
+				} else {
+					cprint(con, S_NAK, 1);
+				}
+				opbuf_len = 0;
 				break;
 			case S_CMD_Q_BUSTYPE:
 				cprint(con, S_ACK, 1);
@@ -103,19 +196,19 @@ void bbio_mode_serprog(t_hydra_console *con)
 				break;
 			case S_CMD_Q_WRNMAXLEN:
 				cprint(con, S_ACK, 1);
-				//4096 bytes write buffer
-				cprint(con, "\x00\x10\x00", 3);
+				serprog_put_le24(tx_data, SERPROG_WRNMAXLEN);
+				cprint(con, (char *)tx_data, 3);
 				break;
 			case S_CMD_Q_RDNMAXLEN:
 				cprint(con, S_ACK, 1);
-				//4096 bytes write buffer
-				cprint(con, "\x00\x10\x00", 3);
+				serprog_put_le24(tx_data, SERPROG_RDNMAXLEN);
+				cprint(con, (char *)tx_data, 3);
 				break;
 			case S_CMD_O_SPIOP:
 				chnRead(con->sdu, rx_data, 6);
 				to_tx = (rx_data[2] << 16) + (rx_data[1] << 8) + rx_data[0];
 				to_rx = (rx_data[5] << 16) + (rx_data[4] << 8) + rx_data[3];
-				if ((to_tx > 4096) || (to_rx > 4096)) {
+				if ((to_tx > SERPROG_SPIOP_SIZE) || (to_rx > SERPROG_SPIOP_SIZE)) {
 					cprint(con, S_NAK, 1);
 					break;
 				}
@@ -202,6 +295,7 @@ void bbio_mode_serprog(t_hydra_console *con)
 	}
 	pool_free(tx_data);
 	pool_free(rx_data);
+	pool_free(opbuf);
 	bsp_spi_deinit(proto->dev_num);
 	return;
 }
@@ -0,0 +1,218 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hydrabus_smartcard_t1.h"
+
+static uint8_t t1_lrc(const uint8_t *data, uint32_t len)
+{
+	uint8_t lrc = 0;
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		lrc ^= data[i];
+	return lrc;
+}
+
+static uint32_t t1_build(t_smartcard_t1 *t1, uint8_t pcb, const uint8_t *inf, uint32_t len)
+{
+	t1->tx[0] = t1->nad;
+	t1->tx[1] = pcb;
+	t1->tx[2] = len;
+	if (len > 0)
+		memcpy(&t1->tx[T1_PROLOGUE_SIZE], inf, len);
+	t1->tx[T1_PROLOGUE_SIZE + len] = t1_lrc(t1->tx, T1_PROLOGUE_SIZE + len);
+	return T1_PROLOGUE_SIZE + len + 1;
+}
+
+static uint32_t t1_build_r(t_smartcard_t1 *t1, uint8_t err)
+{
+	return t1_build(t1, T1_R_BLOCK | (t1->nr ? T1_R_NR : 0) | err, NULL, 0);
+}
+
+/* Build the I-block of the APDU starting at offset, *more is set if it is chained */
+static uint32_t t1_build_i(t_smartcard_t1 *t1, const uint8_t *apdu, uint32_t len,
+			   uint32_t offset, uint32_t *chunk, bool *more)
+{
+	*chunk = len - offset;
+	if (*chunk > t1->ifsc)
+		*chunk = t1->ifsc;
+	*more = (offset + *chunk) < len;
+	return t1_build(t1, T1_I_BLOCK | (t1->ns ? T1_I_NS : 0) | (*more ? T1_I_MORE : 0),
+			&apdu[offset], *chunk);
+}
+
+/* Check received block length and LRC */
+static bool t1_check(t_smartcard_t1 *t1, int len)
+{
+	if (len < (T1_PROLOGUE_SIZE + 1))
+		return false;
+	if ((t1->rx[2] > T1_INF_SIZE_MAX) || (len != (t1->rx[2] + T1_PROLOGUE_SIZE + 1)))
+		return false;
+	return t1_lrc(t1->rx, len) == 0;
+}
+
+static bool t1_send(t_smartcard_t1 *t1, uint32_t len)
+{
+	t1->nb_blocks_tx++;
+	return t1->send(t1->user, t1->tx, len);
+}
+
+void smartcard_t1_init(t_smartcard_t1 *t1, uint8_t ifsc)
+{
+	t1->nad = 0;
+	t1->ifsc = (ifsc == 0 || ifsc == 0xFF) ? T1_IFS_DEFAULT : ifsc;
+	t1->ifsd = T1_IFS_DEFAULT;
+	t1->ns = 0;
+	t1->nr = 0;
+	t1->nb_blocks_tx = 0;
+	t1->nb_blocks_rx = 0;
+	t1->nb_retries = 0;
+}
+
+/* Send S(IFS request) so the card can send blocks up to ifsd bytes */
+bool smartcard_t1_set_ifsd(t_smartcard_t1 *t1, uint8_t ifsd)
+{
+	uint32_t retries, len;
+	int rx_len;
+
+	for (retries = 0; retries <= T1_MAX_RETRIES; retries++) {
+		len = t1_build(t1, T1_S_BLOCK | T1_S_IFS, &ifsd, 1);
+		if (!t1_send(t1, len))
+			return false;
+		rx_len = t1->recv(t1->user, t1->rx, sizeof(t1->rx), 1);
+		if (t1_check(t1, rx_len) &&
+		    (t1->rx[1] == (T1_S_BLOCK | T1_S_RESPONSE | T1_S_IFS)) &&
+		    (t1->rx[2] == 1) && (t1->rx[3] == ifsd)) {
+			t1->nb_blocks_rx++;
+			t1->ifsd = ifsd;
+			return true;
+		}
+		t1->nb_retries++;
+	}
+	return false;
+}
+
+/*
+ * Send an APDU (chained in IFSC blocks) and receive the response (chained
+ * blocks from card are acknowledged and concatenated).
+ * Return response length or T1_ERR_xxx.
+ */
+int smartcard_t1_transceive(t_smartcard_t1 *t1, const uint8_t *apdu, uint32_t len,
+			    uint8_t *resp, uint32_t resp_max)
+{
+	uint32_t offset, chunk, tx_len, resp_len, retries;
+	uint8_t pcb, wtx;
+	int rx_len;
+	bool more, i_pending;
+
+	offset = 0;
+	resp_len = 0;
+	retries = 0;
+	wtx = 1;
+	tx_len = t1_build_i(t1, apdu, len, offset, &chunk, &more);
+	/* Last I-block sent is not acknowledged yet */
+	i_pending = true;
+
+	while (1) {
+		if (!t1_send(t1, tx_len))
+			return T1_ERR_IO;
+		rx_len = t1->recv(t1->user, t1->rx, sizeof(t1->rx), wtx);
+		wtx = 1;
+
+		if (!t1_check(t1, rx_len)) {
+			if (++retries > T1_MAX_RETRIES)
+				return T1_ERR_IO;
+			t1->nb_retries++;
+			tx_len = t1_build_r(t1, (rx_len < 0) ? T1_R_ERR_OTHER : T1_R_ERR_EDC);
+			continue;
+		}
+		t1->nb_blocks_rx++;
+		pcb = t1->rx[1];
+
+		if ((pcb & T1_R_BLOCK) == 0) {
+			/* I-block: card shall not answer with data while we are chaining */
+			if ((i_pending && more) || (((pcb & T1_I_NS) != 0) != t1->nr)) {
+				if (++retries > T1_MAX_RETRIES)
+					return T1_ERR_PROTOCOL;
+				t1->nb_retries++;
+				tx_len = t1_build_r(t1, T1_R_ERR_OTHER);
+				continue;
+			}
+			if (i_pending) {
+				t1->ns ^= 1;
+				i_pending = false;
+			}
+			if ((resp_len + t1->rx[2]) > resp_max)
+				return T1_ERR_OVERFLOW;
+			memcpy(&resp[resp_len], &t1->rx[T1_PROLOGUE_SIZE], t1->rx[2]);
+			resp_len += t1->rx[2];
+			t1->nr ^= 1;
+			retries = 0;
+			if (pcb & T1_I_MORE) {
+				tx_len = t1_build_r(t1, 0);
+				continue;
+			}
+			return resp_len;
+		} else if ((pcb & T1_S_BLOCK) == T1_R_BLOCK) {
+			/* R-block */
+			if (i_pending && more && (((pcb & T1_R_NR) != 0) != t1->ns)) {
+				/* Chained block acknowledged, send next one */
+				t1->ns ^= 1;
+				offset += chunk;
+				tx_len = t1_build_i(t1, apdu, len, offset, &chunk, &more);
+				retries = 0;
+				continue;
+			}
+			/* Retransmission of last block requested */
+			if (++retries > T1_MAX_RETRIES)
+				return T1_ERR_PROTOCOL;
+			t1->nb_retries++;
+			if (i_pending)
+				tx_len = t1_build_i(t1, apdu, len, offset, &chunk, &more);
+			else
+				tx_len = t1_build_r(t1, 0);
+		} else {
+			/* S-block request */
+			switch (pcb) {
+			case (T1_S_BLOCK | T1_S_WTX):
+				wtx = (t1->rx[2] == 1 && t1->rx[3] > 0) ? t1->rx[3] : 1;
+				tx_len = t1_build(t1, T1_S_BLOCK | T1_S_RESPONSE | T1_S_WTX,
+						  &t1->rx[3], t1->rx[2]);
+				break;
+			case (T1_S_BLOCK | T1_S_IFS):
+				if (t1->rx[2] == 1 && t1->rx[3] > 0 && t1->rx[3] < 0xFF)
+					t1->ifsc = t1->rx[3];
+				tx_len = t1_build(t1, T1_S_BLOCK | T1_S_RESPONSE | T1_S_IFS,
+						  &t1->rx[3], t1->rx[2]);
+				break;
+			case (T1_S_BLOCK | T1_S_ABORT):
+				tx_len = t1_build(t1, T1_S_BLOCK | T1_S_RESPONSE | T1_S_ABORT, NULL, 0);
+				t1_send(t1, tx_len);
+				return T1_ERR_ABORT;
+			default:
+				if (++retries > T1_MAX_RETRIES)
+					return T1_ERR_PROTOCOL;
+				t1->nb_retries++;
+				tx_len = t1_build_r(t1, T1_R_ERR_OTHER);
+				break;
+			}
+		}
+	}
+}
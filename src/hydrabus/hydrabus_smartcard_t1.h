@@ -0,0 +1,84 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SMARTCARD_T1_H_
+#define _HYDRABUS_SMARTCARD_T1_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * ISO7816-3 T=1 block protocol engine (LRC EDC).
+ * Block I/O is done by callbacks so it does not depend on ChibiOS or on the
+ * hardware.
+ */
+
+#define T1_PROLOGUE_SIZE (3) /* NAD PCB LEN */
+#define T1_INF_SIZE_MAX (254)
+#define T1_BLOCK_SIZE_MAX (T1_PROLOGUE_SIZE + T1_INF_SIZE_MAX + 1)
+#define T1_IFS_DEFAULT (32)
+#define T1_MAX_RETRIES (3)
+
+/* PCB */
+#define T1_I_BLOCK (0x00)
+#define T1_I_NS (0x40)
+#define T1_I_MORE (0x20)
+#define T1_R_BLOCK (0x80)
+#define T1_R_NR (0x10)
+#define T1_R_ERR_EDC (0x01)
+#define T1_R_ERR_OTHER (0x02)
+#define T1_S_BLOCK (0xC0)
+#define T1_S_RESPONSE (0x20)
+#define T1_S_RESYNCH (0x00)
+#define T1_S_IFS (0x01)
+#define T1_S_ABORT (0x02)
+#define T1_S_WTX (0x03)
+
+/* Errors returned by smartcard_t1_transceive() */
+#define T1_ERR_IO (-1) /* Send error or no answer after retries */
+#define T1_ERR_PROTOCOL (-2) /* Unexpected block after retries */
+#define T1_ERR_ABORT (-3) /* Card aborted the chain */
+#define T1_ERR_OVERFLOW (-4) /* Response bigger than buffer */
+
+typedef struct {
+	void *user;
+	/* Send a full block, return false on error */
+	bool (*send)(void *user, const uint8_t *block, uint32_t len);
+	/*
+	 * Receive a block (prologue then LEN + 1 bytes), waiting up to
+	 * wtx * BWT for the first byte. Return block length or -1 on timeout.
+	 */
+	int (*recv)(void *user, uint8_t *block, uint32_t max, uint8_t wtx);
+	uint8_t nad;
+	uint8_t ifsc; /* Max INF size sent to card */
+	uint8_t ifsd; /* Max INF size received from card */
+	uint8_t ns; /* Send sequence number */
+	uint8_t nr; /* Expected card sequence number */
+	uint32_t nb_blocks_tx;
+	uint32_t nb_blocks_rx;
+	uint32_t nb_retries;
+	uint8_t tx[T1_BLOCK_SIZE_MAX];
+	uint8_t rx[T1_BLOCK_SIZE_MAX];
+} t_smartcard_t1;
+
+void smartcard_t1_init(t_smartcard_t1 *t1, uint8_t ifsc);
+bool smartcard_t1_set_ifsd(t_smartcard_t1 *t1, uint8_t ifsd);
+int smartcard_t1_transceive(t_smartcard_t1 *t1, const uint8_t *apdu, uint32_t len,
+			    uint8_t *resp, uint32_t resp_max);
+
+#endif /* _HYDRABUS_SMARTCARD_T1_H_ */
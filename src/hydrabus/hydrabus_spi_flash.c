@@ -0,0 +1,454 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hydrabus_spi_flash.h"
+
+#define SPI_FLASH_CMD_WREN (0x06)
+#define SPI_FLASH_CMD_RDSR (0x05)
+#define SPI_FLASH_CMD_RDID (0x9F)
+#define SPI_FLASH_CMD_RDSFDP (0x5A)
+#define SPI_FLASH_CMD_READ (0x03)
+#define SPI_FLASH_CMD_READ4 (0x13)
+#define SPI_FLASH_CMD_PP (0x02)
+#define SPI_FLASH_CMD_PP4 (0x12)
+
+#define SPI_FLASH_SR_WIP BIT(0)
+
+#define SPI_FLASH_SFDP_SIGNATURE (0x50444653) /* "SFDP" */
+#define SPI_FLASH_SFDP_DWORDS (16) /* Basic table DWORDs used */
+
+/* CRC-32 (IEEE 802.3, reflected) 4-bit table */
+static const uint32_t crc32_nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/* Same result as zlib crc32(), start with crc 0 */
+uint32_t spi_flash_crc32(uint32_t crc, const uint8_t *data, uint32_t nb_data)
+{
+	crc = ~crc;
+	while (nb_data-- > 0) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+static uint32_t get_le32(const uint8_t *data)
+{
+	return data[0] + (data[1] << 8) + (data[2] << 16) + ((uint32_t)data[3] << 24);
+}
+
+/* Opcode followed by address (3 or 4 bytes), CS is left low */
+static void spi_flash_cmd_addr(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			       uint8_t opcode, uint32_t addr)
+{
+	uint8_t hdr[5];
+	int i;
+
+	i = 0;
+	hdr[i++] = opcode;
+	if (flash->addr_bytes == 4)
+		hdr[i++] = addr >> 24;
+	hdr[i++] = addr >> 16;
+	hdr[i++] = addr >> 8;
+	hdr[i++] = addr;
+
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, hdr, i);
+}
+
+static void spi_flash_write_enable(bsp_dev_spi_t dev_num)
+{
+	uint8_t cmd = SPI_FLASH_CMD_WREN;
+
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, &cmd, 1);
+	bsp_spi_unselect(dev_num);
+}
+
+/*
+ * Poll status register until end of program/erase, sleep between polls
+ * for long operations so other threads can run.
+ */
+static bsp_status_t spi_flash_wait_ready(bsp_dev_spi_t dev_num, uint32_t timeout,
+					 bool sleep)
+{
+	uint32_t tickstart;
+	uint8_t cmd, sr;
+
+	tickstart = HAL_GetTick();
+	while (1) {
+		cmd = SPI_FLASH_CMD_RDSR;
+		bsp_spi_select(dev_num);
+		bsp_spi_write_u8(dev_num, &cmd, 1);
+		bsp_spi_read_u8(dev_num, &sr, 1);
+		bsp_spi_unselect(dev_num);
+		if (!(sr & SPI_FLASH_SR_WIP))
+			return BSP_OK;
+
+		if ((HAL_GetTick() - tickstart) >= timeout)
+			return BSP_TIMEOUT;
+		if (sleep)
+			chThdSleepMilliseconds(1);
+	}
+}
+
+/* SFDP area is always read with 3 address bytes and 8 dummy cycles */
+static void spi_flash_read_sfdp(bsp_dev_spi_t dev_num, uint32_t addr,
+				uint8_t *rx_data, uint32_t nb_data)
+{
+	uint8_t hdr[5];
+
+	hdr[0] = SPI_FLASH_CMD_RDSFDP;
+	hdr[1] = addr >> 16;
+	hdr[2] = addr >> 8;
+	hdr[3] = addr;
+	hdr[4] = 0;
+
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, hdr, sizeof(hdr));
+	bsp_spi_read_u8(dev_num, rx_data, nb_data);
+	bsp_spi_unselect(dev_num);
+}
+
+/* Geometry from JEDEC basic flash parameter table (first parameter header) */
+static bool spi_flash_parse_sfdp(bsp_dev_spi_t dev_num, t_spi_flash *flash)
+{
+	uint8_t buf[SPI_FLASH_SFDP_DWORDS * 4];
+	uint32_t dw, ptr, nb_dwords, n;
+	int i;
+
+	spi_flash_read_sfdp(dev_num, 0, buf, 16);
+	if (get_le32(&buf[0]) != SPI_FLASH_SFDP_SIGNATURE || buf[8] != 0x00)
+		return FALSE;
+
+	nb_dwords = buf[11];
+	ptr = buf[12] + (buf[13] << 8) + (buf[14] << 16);
+	if (nb_dwords < 9)
+		return FALSE;
+	if (nb_dwords > SPI_FLASH_SFDP_DWORDS)
+		nb_dwords = SPI_FLASH_SFDP_DWORDS;
+	spi_flash_read_sfdp(dev_num, ptr, buf, nb_dwords * 4);
+
+	/* DWORD 2: density in bits */
+	dw = get_le32(&buf[4]);
+	if (dw & BIT(31)) {
+		n = dw & 0x7FFFFFFF;
+		if (n < 3 || n > 34)
+			return FALSE;
+		flash->size = 1UL << (n - 3);
+	} else {
+		flash->size = (dw >> 3) + 1;
+	}
+
+	/* DWORD 8-9: erase types, size is 2^N bytes */
+	memset(flash->erase_size, 0, sizeof(flash->erase_size));
+	for (i = 0; i < SPI_FLASH_ERASE_TYPES; i++) {
+		n = buf[28 + 2 * i];
+		if (n == 0 || n > 31)
+			continue;
+		flash->erase_size[i] = 1UL << n;
+		flash->erase_opcode[i] = buf[28 + 2 * i + 1];
+	}
+
+	/* DWORD 11 (JESD216A): page size is 2^N bytes */
+	flash->page_size = 256;
+	if (nb_dwords >= 11) {
+		n = (buf[40] >> 4) & 0x0F;
+		if (n > 0)
+			flash->page_size = 1 << n;
+	}
+
+	return TRUE;
+}
+
+/* 4-byte address opcodes of 3-byte ones, 0 if unknown */
+static uint8_t spi_flash_opcode4(uint8_t opcode)
+{
+	switch (opcode) {
+	case 0x20:
+		return 0x21;
+	case 0x52:
+		return 0x5C;
+	case 0xD8:
+		return 0xDC;
+	default:
+		return 0;
+	}
+}
+
+/* Sort erase types by size, unused ones (size 0) last */
+static void spi_flash_sort_erase(t_spi_flash *flash)
+{
+	uint32_t size;
+	uint8_t opcode;
+	int i, j;
+
+	for (i = 1; i < SPI_FLASH_ERASE_TYPES; i++) {
+		size = flash->erase_size[i];
+		opcode = flash->erase_opcode[i];
+		for (j = i; j > 0; j--) {
+			if (size == 0)
+				break;
+			if (flash->erase_size[j - 1] != 0 && flash->erase_size[j - 1] <= size)
+				break;
+			flash->erase_size[j] = flash->erase_size[j - 1];
+			flash->erase_opcode[j] = flash->erase_opcode[j - 1];
+		}
+		flash->erase_size[j] = size;
+		flash->erase_opcode[j] = opcode;
+	}
+}
+
+/* Read JEDEC ID and geometry, FALSE if no memory answers */
+bool spi_flash_probe(bsp_dev_spi_t dev_num, t_spi_flash *flash)
+{
+	uint8_t cmd;
+	int i;
+
+	memset(flash, 0, sizeof(t_spi_flash));
+
+	cmd = SPI_FLASH_CMD_RDID;
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, &cmd, 1);
+	bsp_spi_read_u8(dev_num, flash->jedec_id, 3);
+	bsp_spi_unselect(dev_num);
+	if (flash->jedec_id[0] == 0x00 || flash->jedec_id[0] == 0xFF)
+		return FALSE;
+
+	flash->sfdp = spi_flash_parse_sfdp(dev_num, flash);
+	if (!flash->sfdp) {
+		/* Capacity byte is log2(size) for most manufacturers */
+		if (flash->jedec_id[2] < 0x10 || flash->jedec_id[2] > 0x1F)
+			return FALSE;
+		flash->size = 1UL << flash->jedec_id[2];
+		flash->page_size = 256;
+		flash->erase_size[0] = 4096;
+		flash->erase_opcode[0] = 0x20;
+		flash->erase_size[1] = 65536;
+		flash->erase_opcode[1] = 0xD8;
+	}
+
+	flash->addr_bytes = 3;
+	if (flash->size > (1UL << 24)) {
+		flash->addr_bytes = 4;
+		for (i = 0; i < SPI_FLASH_ERASE_TYPES; i++) {
+			flash->erase_opcode[i] = spi_flash_opcode4(flash->erase_opcode[i]);
+			if (flash->erase_opcode[i] == 0)
+				flash->erase_size[i] = 0;
+		}
+	}
+	spi_flash_sort_erase(flash);
+
+	return flash->erase_size[0] != 0;
+}
+
+/* Start a continuous read (CS stays low until spi_flash_read_close()) */
+void spi_flash_read_open(bsp_dev_spi_t dev_num, const t_spi_flash *flash, uint32_t addr)
+{
+	spi_flash_cmd_addr(dev_num, flash,
+			   flash->addr_bytes == 4 ? SPI_FLASH_CMD_READ4 : SPI_FLASH_CMD_READ,
+			   addr);
+}
+
+void spi_flash_read_close(bsp_dev_spi_t dev_num)
+{
+	bsp_spi_unselect(dev_num);
+}
+
+bsp_status_t spi_flash_read(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			    uint32_t addr, uint8_t *rx_data, uint32_t nb_data)
+{
+	bsp_status_t status;
+
+	spi_flash_read_open(dev_num, flash, addr);
+	status = bsp_spi_read_u8(dev_num, rx_data, nb_data);
+	spi_flash_read_close(dev_num);
+
+	return status;
+}
+
+/* Erase one block of erase type */
+static bsp_status_t spi_flash_erase_block(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+					  int type, uint32_t addr)
+{
+	spi_flash_write_enable(dev_num);
+	spi_flash_cmd_addr(dev_num, flash, flash->erase_opcode[type], addr);
+	bsp_spi_unselect(dev_num);
+
+	return spi_flash_wait_ready(dev_num, SPI_FLASH_ERASE_TIMEOUT, TRUE);
+}
+
+/* Largest erase type aligned on addr and not above end, -1 if none */
+static int spi_flash_erase_type(const t_spi_flash *flash, uint32_t addr, uint32_t end)
+{
+	int i;
+
+	for (i = SPI_FLASH_ERASE_TYPES - 1; i >= 0; i--) {
+		if (flash->erase_size[i] == 0)
+			continue;
+		if ((addr & (flash->erase_size[i] - 1)) == 0 &&
+		    end - addr >= flash->erase_size[i])
+			return i;
+	}
+	return -1;
+}
+
+/* addr and nb_data must be aligned on smallest erase size */
+bsp_status_t spi_flash_erase(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			     uint32_t addr, uint32_t nb_data)
+{
+	uint32_t end;
+	bsp_status_t status;
+	int type;
+
+	end = addr + nb_data;
+	while (addr < end) {
+		type = spi_flash_erase_type(flash, addr, end);
+		if (type < 0)
+			return BSP_ERROR;
+		status = spi_flash_erase_block(dev_num, flash, type, addr);
+		if (status != BSP_OK)
+			return status;
+		addr += flash->erase_size[type];
+	}
+
+	return BSP_OK;
+}
+
+static bool is_erased(const uint8_t *data, uint32_t nb_data)
+{
+	while (nb_data-- > 0) {
+		if (*data++ != 0xFF)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Page program, pages only filled with 0xFF are skipped (programming
+ * them does not change the memory).
+ */
+bsp_status_t spi_flash_program(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			       uint32_t addr, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t nb;
+	bsp_status_t status;
+
+	while (nb_data > 0) {
+		nb = flash->page_size - (addr & (flash->page_size - 1));
+		if (nb > nb_data)
+			nb = nb_data;
+
+		if (!is_erased(tx_data, nb)) {
+			spi_flash_write_enable(dev_num);
+			spi_flash_cmd_addr(dev_num, flash,
+					   flash->addr_bytes == 4 ? SPI_FLASH_CMD_PP4 : SPI_FLASH_CMD_PP,
+					   addr);
+			status = bsp_spi_write_u8(dev_num, tx_data, nb);
+			bsp_spi_unselect(dev_num);
+			if (status == BSP_OK)
+				status = spi_flash_wait_ready(dev_num, SPI_FLASH_PROGRAM_TIMEOUT,
+							      FALSE);
+			if (status != BSP_OK)
+				return status;
+		}
+
+		addr += nb;
+		tx_data += nb;
+		nb_data -= nb;
+	}
+
+	return BSP_OK;
+}
+
+/*
+ * Check image bounds, with SPI_FLASH_WRITE_ERASE addr must be aligned on
+ * smallest erase size (memory is erased up to the end of last erase block).
+ */
+bool spi_flash_write_start(const t_spi_flash *flash, t_spi_flash_write *wr,
+			   uint32_t addr, uint32_t size, uint8_t flags)
+{
+	if (size == 0 || addr >= flash->size || size > flash->size - addr)
+		return FALSE;
+	if ((flags & SPI_FLASH_WRITE_ERASE) &&
+	    (addr & (flash->erase_size[0] - 1)) != 0)
+		return FALSE;
+
+	wr->addr = addr;
+	wr->end = addr + size;
+	wr->erased = addr;
+	wr->crc = 0;
+	wr->flags = flags;
+	return TRUE;
+}
+
+/*
+ * Program next nb_data bytes of image.
+ * Blocks are erased ahead with the largest erase type fitting in the image,
+ * rx_data (nb_data bytes) is used to read back data with
+ * SPI_FLASH_WRITE_VERIFY.
+ */
+bsp_status_t spi_flash_write_chunk(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+				   t_spi_flash_write *wr, uint8_t *tx_data,
+				   uint32_t nb_data, uint8_t *rx_data)
+{
+	uint32_t erase_end;
+	bsp_status_t status;
+	int type;
+
+	if (nb_data > wr->end - wr->addr)
+		return BSP_ERROR;
+
+	if (wr->flags & SPI_FLASH_WRITE_ERASE) {
+		erase_end = (wr->end + flash->erase_size[0] - 1) & ~(flash->erase_size[0] - 1);
+		while (wr->erased < wr->addr + nb_data) {
+			type = spi_flash_erase_type(flash, wr->erased, erase_end);
+			if (type < 0)
+				return BSP_ERROR;
+			status = spi_flash_erase_block(dev_num, flash, type, wr->erased);
+			if (status != BSP_OK)
+				return status;
+			wr->erased += flash->erase_size[type];
+		}
+	}
+
+	status = spi_flash_program(dev_num, flash, wr->addr, tx_data, nb_data);
+	if (status != BSP_OK)
+		return status;
+
+	if (wr->flags & SPI_FLASH_WRITE_VERIFY) {
+		status = spi_flash_read(dev_num, flash, wr->addr, rx_data, nb_data);
+		if (status != BSP_OK)
+			return status;
+		if (memcmp(tx_data, rx_data, nb_data) != 0)
+			return BSP_ERROR;
+		wr->crc = spi_flash_crc32(wr->crc, rx_data, nb_data);
+	} else {
+		wr->crc = spi_flash_crc32(wr->crc, tx_data, nb_data);
+	}
+	wr->addr += nb_data;
+
+	return BSP_OK;
+}
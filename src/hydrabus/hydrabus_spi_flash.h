@@ -0,0 +1,80 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SPI_FLASH_H_
+#define _HYDRABUS_SPI_FLASH_H_
+
+#include "common.h"
+#include "bsp_spi.h"
+
+/*
+ * SPI NOR flash engine (25xx series).
+ * Geometry is read from SFDP (JESD216) basic parameter table, JEDEC ID
+ * capacity byte with 4KB/64KB erase and 256 bytes pages is used otherwise.
+ * Memories above 16MB are accessed with 4-byte address opcodes.
+ */
+
+#define SPI_FLASH_ERASE_TYPES (4)
+#define SPI_FLASH_CHUNK_SIZE (4096) /* Read/write buffer used by console and BBIO */
+
+/* Busy polling (see common/chconf.h/CH_CFG_ST_FREQUENCY) */
+#define SPI_FLASH_PROGRAM_TIMEOUT (100) /* About 10ms */
+#define SPI_FLASH_ERASE_TIMEOUT (40000) /* About 4s */
+
+/* t_spi_flash_write.flags */
+#define SPI_FLASH_WRITE_ERASE BIT(0) /* Erase before programming */
+#define SPI_FLASH_WRITE_VERIFY BIT(1) /* Read back and compare */
+
+typedef struct {
+	uint8_t jedec_id[3]; /* Manufacturer, type, capacity */
+	bool sfdp; /* Geometry read from SFDP */
+	uint8_t addr_bytes; /* 3 or 4 */
+	uint16_t page_size;
+	uint32_t size; /* Bytes */
+	uint32_t erase_size[SPI_FLASH_ERASE_TYPES]; /* Ascending, 0 if unused */
+	uint8_t erase_opcode[SPI_FLASH_ERASE_TYPES];
+} t_spi_flash;
+
+/* Streamed image programming state */
+typedef struct {
+	uint32_t addr; /* Next address to program */
+	uint32_t end; /* End of image */
+	uint32_t erased; /* End of erased area */
+	uint32_t crc; /* CRC-32 of data programmed (read back with verify) */
+	uint8_t flags;
+} t_spi_flash_write;
+
+bool spi_flash_probe(bsp_dev_spi_t dev_num, t_spi_flash *flash);
+void spi_flash_read_open(bsp_dev_spi_t dev_num, const t_spi_flash *flash, uint32_t addr);
+void spi_flash_read_close(bsp_dev_spi_t dev_num);
+bsp_status_t spi_flash_read(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			    uint32_t addr, uint8_t *rx_data, uint32_t nb_data);
+bsp_status_t spi_flash_erase(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			     uint32_t addr, uint32_t nb_data);
+bsp_status_t spi_flash_program(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+			       uint32_t addr, uint8_t *tx_data, uint32_t nb_data);
+
+bool spi_flash_write_start(const t_spi_flash *flash, t_spi_flash_write *wr,
+			   uint32_t addr, uint32_t size, uint8_t flags);
+bsp_status_t spi_flash_write_chunk(bsp_dev_spi_t dev_num, const t_spi_flash *flash,
+				   t_spi_flash_write *wr, uint8_t *tx_data,
+				   uint32_t nb_data, uint8_t *rx_data);
+
+uint32_t spi_flash_crc32(uint32_t crc, const uint8_t *data, uint32_t nb_data);
+
+#endif /* _HYDRABUS_SPI_FLASH_H_ */
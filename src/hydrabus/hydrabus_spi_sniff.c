@@ -0,0 +1,627 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hydrabus.h"
+#include "hydrabus_spi_sniff.h"
+#include "bsp_spi.h"
+#include "bsp_spi_conf.h"
+#include "microsd.h"
+#include "usb_tx.h"
+#include "hexdump.h"
+#include "file_fmt_pcapng.h"
+
+#define SPI_SNIFF_MOSI (0) /* SPI1 */
+#define SPI_SNIFF_MISO (1) /* SPI2 */
+
+#define SPI_SNIFF_USB_TIMEOUT TIME_MS2I(100)
+#define SPI_SNIFF_PRINT_BUF_SIZE (256)
+#define SPI_SNIFF_PCAP_BLOCK_MAX (64) /* Enhanced Packet Block without data */
+
+typedef struct {
+	const stm32_dma_stream_t *dma;
+	SPI_TypeDef *spi;
+	uint8_t *buf;
+	volatile uint32_t laps; /* DMA ring wraps */
+	volatile uint32_t errors;
+} t_spi_sniff_line;
+
+typedef struct {
+	uint32_t timestamp;
+	uint32_t pos[2]; /* Bytes received since start per line */
+	uint8_t cs;
+} t_spi_sniff_event;
+
+typedef struct {
+	t_hydra_console *con;
+	spi_sniff_out_t type;
+	uint8_t *buf;
+	uint32_t size;
+	uint32_t idx;
+	bool cont; /* Last record is continued */
+	/* SPI_SNIFF_OUT_USB */
+	uint8_t *stage; /* Record copied from rings */
+	/* SPI_SNIFF_OUT_FILE */
+	t_pcapng pcap;
+	int pcap_if[2];
+	uint64_t ts64; /* Timestamp extended to 64bits */
+	uint32_t ts_last;
+} t_spi_sniff_out;
+
+static t_spi_sniff_line sniff_lines[2];
+static t_spi_sniff_event sniff_events[SPI_SNIFF_EVENTS_NB] HOT_DATA;
+static volatile uint32_t sniff_ev_wr;
+static volatile uint32_t sniff_ev_rd;
+static volatile uint32_t sniff_ev_lost;
+static uint8_t sniff_dev_mode;
+
+static void spi_sniff_dma_cb(void *arg, uint32_t flags)
+{
+	t_spi_sniff_line *line = arg;
+
+	if (flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF))
+		line->errors++;
+	if (flags & STM32_DMA_ISR_TCIF)
+		line->laps++;
+}
+
+/*
+ * Bytes received since start (wraps at 2^32), DMA IRQ has a higher priority
+ * than callers so laps is updated when NDTR is reloaded.
+ */
+static uint32_t spi_sniff_pos(t_spi_sniff_line *line)
+{
+	uint32_t laps, ndtr;
+
+	do {
+		laps = line->laps;
+		ndtr = dmaStreamGetTransactionSize(line->dma);
+	} while (laps != line->laps);
+
+	return (laps * SPI_SNIFF_DMA_SIZE) + (SPI_SNIFF_DMA_SIZE - ndtr);
+}
+
+/* Return TRUE if DMA overwrote the ring byte at pos of a line or failed */
+static bool spi_sniff_lost(const uint32_t *pos)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if ((spi_sniff_pos(&sniff_lines[i]) - pos[i]) > SPI_SNIFF_DMA_SIZE)
+			return TRUE;
+		if (sniff_lines[i].errors)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Restart SPI so a glitch on SCK does not shift next frames */
+static inline void spi_sniff_resync(SPI_TypeDef *spi)
+{
+	spi->CR1 &= ~SPI_CR1_SPE;
+	spi->CR1 |= SPI_CR1_SPE;
+}
+
+HOT_FUNC
+static void spi_sniff_cs_cb(void *arg)
+{
+	t_spi_sniff_event *ev;
+	uint32_t wr;
+	uint8_t cs;
+
+	(void)arg;
+
+	cs = palReadPad(SPI_SNIFF_CS_PORT, SPI_SNIFF_CS_PAD);
+	wr = sniff_ev_wr;
+	if ((wr - sniff_ev_rd) >= SPI_SNIFF_EVENTS_NB) {
+		sniff_ev_lost++;
+	} else {
+		ev = &sniff_events[wr % SPI_SNIFF_EVENTS_NB];
+		ev->timestamp = bsp_get_cyclecounter();
+		ev->cs = cs;
+		ev->pos[SPI_SNIFF_MOSI] = spi_sniff_pos(&sniff_lines[SPI_SNIFF_MOSI]);
+		ev->pos[SPI_SNIFF_MISO] = spi_sniff_pos(&sniff_lines[SPI_SNIFF_MISO]);
+		sniff_ev_wr = wr + 1;
+	}
+
+	if (cs) {
+		spi_sniff_resync(sniff_lines[SPI_SNIFF_MOSI].spi);
+		spi_sniff_resync(sniff_lines[SPI_SNIFF_MISO].spi);
+	}
+}
+
+static bool spi_sniff_dma_start(t_spi_sniff_line *line, uint32_t stream, uint32_t mode)
+{
+	const stm32_dma_stream_t *dma = STM32_DMA_STREAM(stream);
+
+	line->laps = 0;
+	line->errors = 0;
+	/* Stream may be used by another driver (HydraNFC sniffer) */
+	if (dmaStreamAllocate(dma, SPI_SNIFF_DMA_IRQ_PRIORITY,
+			      spi_sniff_dma_cb, line))
+		return FALSE;
+	line->dma = dma;
+
+	dmaStreamSetPeripheral(line->dma, &line->spi->DR);
+	dmaStreamSetMemory0(line->dma, line->buf);
+	dmaStreamSetTransactionSize(line->dma, SPI_SNIFF_DMA_SIZE);
+	dmaStreamSetMode(line->dma, mode | STM32_DMA_CR_PL(3) |
+			 STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_MINC |
+			 STM32_DMA_CR_CIRC | STM32_DMA_CR_TCIE |
+			 STM32_DMA_CR_TEIE | STM32_DMA_CR_DMEIE);
+	dmaStreamEnable(line->dma);
+	line->spi->CR2 |= SPI_CR2_RXDMAEN;
+	return TRUE;
+}
+
+static void spi_sniff_dma_stop(t_spi_sniff_line *line)
+{
+	if (line->dma == NULL)
+		return;
+	line->spi->CR2 &= ~SPI_CR2_RXDMAEN;
+	dmaStreamDisable(line->dma);
+	dmaStreamRelease(line->dma);
+	line->dma = NULL;
+}
+
+/*
+ * Configure both SPI as slaves with mode parameters (polarity, phase, bit
+ * order), start DMA rings and CS events.
+ * Return FALSE on error (spi_sniff_stop() must be called anyway).
+ */
+bool spi_sniff_start(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	int i;
+
+	sniff_dev_mode = proto->config.spi.dev_mode;
+	proto->config.spi.dev_mode = DEV_SLAVE;
+	if (bsp_spi_init(BSP_DEV_SPI1, proto) != BSP_OK)
+		return FALSE;
+	if (bsp_spi_init(BSP_DEV_SPI2, proto) != BSP_OK)
+		return FALSE;
+	/* NSS pins are outputs for master mode */
+	palSetPadMode(SPI_SNIFF_CS_PORT, SPI_SNIFF_CS_PAD, PAL_MODE_INPUT);
+	palSetPadMode(GPIOC, 1, PAL_MODE_INPUT);
+
+	sniff_lines[SPI_SNIFF_MOSI].spi = BSP_SPI1;
+	sniff_lines[SPI_SNIFF_MISO].spi = BSP_SPI2;
+	for (i = 0; i < 2; i++) {
+		sniff_lines[i].dma = NULL;
+		sniff_lines[i].buf = pool_alloc_bytes(SPI_SNIFF_DMA_SIZE);
+		if (sniff_lines[i].buf == NULL)
+			return FALSE;
+	}
+
+	if (!spi_sniff_dma_start(&sniff_lines[SPI_SNIFF_MOSI],
+				 STM32_SPI_SPI1_RX_DMA_STREAM,
+				 STM32_DMA_CR_CHSEL(STM32_DMA_GETCHANNEL(STM32_SPI_SPI1_RX_DMA_STREAM,
+									 STM32_SPI1_RX_DMA_CHN))))
+		return FALSE;
+	if (!spi_sniff_dma_start(&sniff_lines[SPI_SNIFF_MISO],
+				 STM32_SPI_SPI2_RX_DMA_STREAM,
+				 STM32_DMA_CR_CHSEL(STM32_DMA_GETCHANNEL(STM32_SPI_SPI2_RX_DMA_STREAM,
+									 STM32_SPI2_RX_DMA_CHN))))
+		return FALSE;
+
+	sniff_ev_wr = 0;
+	sniff_ev_rd = 0;
+	sniff_ev_lost = 0;
+	palEnablePadEvent(SPI_SNIFF_CS_PORT, SPI_SNIFF_CS_PAD, PAL_EVENT_MODE_BOTH_EDGES);
+	palSetPadCallback(SPI_SNIFF_CS_PORT, SPI_SNIFF_CS_PAD, spi_sniff_cs_cb, NULL);
+
+	return TRUE;
+}
+
+/* Stop sniffer and restore mode SPI device */
+void spi_sniff_stop(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	int i;
+
+	palDisablePadEvent(SPI_SNIFF_CS_PORT, SPI_SNIFF_CS_PAD);
+	for (i = 0; i < 2; i++) {
+		spi_sniff_dma_stop(&sniff_lines[i]);
+		pool_free(sniff_lines[i].buf);
+		sniff_lines[i].buf = NULL;
+	}
+
+	bsp_spi_deinit(BSP_DEV_SPI1);
+	bsp_spi_deinit(BSP_DEV_SPI2);
+	proto->config.spi.dev_mode = sniff_dev_mode;
+	bsp_spi_init(proto->dev_num, proto);
+}
+
+/* Send pending USB output buffer */
+static void spi_sniff_out_flush(t_spi_sniff_out *out)
+{
+	if (out->buf != NULL)
+		usb_tx_submit(out->con, out->idx);
+	out->buf = NULL;
+	out->idx = 0;
+}
+
+static bool spi_sniff_out_write(t_spi_sniff_out *out, const uint8_t *data, uint32_t len)
+{
+	uint32_t n;
+
+	while (len > 0) {
+		if (out->buf == NULL) {
+			out->buf = usb_tx_get_buffer(out->con, &out->size,
+						     SPI_SNIFF_USB_TIMEOUT);
+			if (out->buf == NULL)
+				return FALSE;
+			out->idx = 0;
+		}
+		n = MIN(len, out->size - out->idx);
+		memcpy(out->buf + out->idx, data, n);
+		out->idx += n;
+		data += n;
+		len -= n;
+		if (out->idx == out->size)
+			spi_sniff_out_flush(out);
+	}
+	return TRUE;
+}
+
+/* Copy len ring bytes of line from pos */
+static void spi_sniff_ring_copy(uint8_t *dst, const t_spi_sniff_line *line,
+				uint32_t pos, uint32_t len)
+{
+	uint32_t idx, n;
+
+	idx = pos & (SPI_SNIFF_DMA_SIZE - 1);
+	n = MIN(len, SPI_SNIFF_DMA_SIZE - idx);
+	memcpy(dst, line->buf + idx, n);
+	memcpy(dst + n, line->buf, len - n);
+}
+
+/* Print len ring bytes of line from pos in hex, lines are not split */
+static void spi_sniff_print_line(t_hydra_console *con, const char *prefix,
+				 const t_spi_sniff_line *line, uint32_t pos,
+				 uint32_t len, const char *suffix)
+{
+	char buf[SPI_SNIFF_PRINT_BUF_SIZE];
+	uint32_t idx, n;
+
+	idx = strlen(prefix);
+	memcpy(buf, prefix, idx);
+	while (len > 0) {
+		n = (sizeof(buf) - 1 - idx) / 3;
+		if (n == 0) {
+			cprint(con, buf, idx);
+			idx = 0;
+			continue;
+		}
+		pos &= SPI_SNIFF_DMA_SIZE - 1;
+		n = MIN(n, MIN(len, SPI_SNIFF_DMA_SIZE - pos));
+		idx += hexdump_bytes(&buf[idx], line->buf + pos, n);
+		pos += n;
+		len -= n;
+	}
+	cprint(con, buf, idx);
+	cprintf(con, "%s\r\n", suffix);
+}
+
+/*
+ * "[ MOSI: XX XX..." then "  MISO: XX XX... ]", a continued frame ends
+ * with "..." and its next record starts without "[".
+ * Bytes overwritten by DMA while printed are followed by "[ overrun ]".
+ */
+static void spi_sniff_print(t_spi_sniff_out *out, t_spi_sniff_hdr *hdr,
+			    const uint32_t *pos)
+{
+	t_hydra_console *con = out->con;
+	const char *suffix;
+
+	if (hdr->flags & SPI_SNIFF_FLAG_EVENTS_LOST)
+		cprintf(con, "CS edges lost\r\n");
+	if (hdr->flags & SPI_SNIFF_FLAG_OVERRUN) {
+		cprintf(con, "[ overrun ]\r\n");
+		return;
+	}
+
+	if (hdr->flags & SPI_SNIFF_FLAG_CONTINUED)
+		suffix = " ...";
+	else if (hdr->flags & SPI_SNIFF_FLAG_MISMATCH)
+		suffix = " ] (MOSI/MISO count mismatch)";
+	else
+		suffix = " ]";
+	spi_sniff_print_line(con, out->cont ? "  MOSI:" : "[ MOSI:",
+			     &sniff_lines[SPI_SNIFF_MOSI],
+			     pos[SPI_SNIFF_MOSI], hdr->length, "");
+	spi_sniff_print_line(con, "  MISO:", &sniff_lines[SPI_SNIFF_MISO],
+			     pos[SPI_SNIFF_MISO], hdr->length, suffix);
+	if (hdr->length > 0 && spi_sniff_lost(pos)) {
+		cprintf(con, "[ overrun ]\r\n");
+		hdr->flags |= SPI_SNIFF_FLAG_OVERRUN;
+		hdr->length = 0;
+	}
+}
+
+/*
+ * Write one Enhanced Packet Block per line, ring bytes are given to
+ * pcapng_write_packet() as pseudo header and data so a wrapped frame is not
+ * copied twice.
+ */
+static void spi_sniff_pcap_write(t_spi_sniff_out *out, const t_spi_sniff_hdr *hdr,
+				 const uint32_t *pos)
+{
+	t_pcapng_pkt_opts opts;
+	uint32_t i, idx, n;
+
+	memset(&opts, 0, sizeof(opts));
+	if (hdr->flags & SPI_SNIFF_FLAG_OVERRUN)
+		opts.flags_errors = PCAPNG_FLAG_ERR_TOO_SHORT;
+	for (i = 0; i < 2; i++) {
+		opts.direction = (i == SPI_SNIFF_MOSI) ? PCAPNG_DIR_OUTBOUND :
+			PCAPNG_DIR_INBOUND;
+		idx = pos[i] & (SPI_SNIFF_DMA_SIZE - 1);
+		n = MIN(hdr->length, SPI_SNIFF_DMA_SIZE - idx);
+		pcapng_write_packet(&out->pcap, out->pcap_if[i], out->ts64,
+				    sniff_lines[i].buf + idx, n,
+				    sniff_lines[i].buf, hdr->length - n, &opts);
+	}
+}
+
+/*
+ * Block buffer is flushed first so both packets are copied without waiting
+ * for the SD card, they are replaced by empty overrun packets if DMA
+ * overwrote bytes meanwhile.
+ */
+static bool spi_sniff_pcap(t_spi_sniff_out *out, t_spi_sniff_hdr *hdr,
+			   const uint32_t *pos)
+{
+	uint32_t level, nb_packets;
+
+	/* Timestamps start at first frame */
+	if (out->pcap.nb_packets > 0)
+		out->ts64 += (uint32_t)(hdr->timestamp - out->ts_last);
+	out->ts_last = hdr->timestamp;
+
+	if ((pcapng_buffer_level(&out->pcap) +
+	     (2 * (hdr->length + SPI_SNIFF_PCAP_BLOCK_MAX))) > out->pcap.buf_size)
+		pcapng_flush(&out->pcap);
+	level = pcapng_buffer_level(&out->pcap);
+	nb_packets = out->pcap.nb_packets;
+	spi_sniff_pcap_write(out, hdr, pos);
+	if (hdr->length > 0 && spi_sniff_lost(pos)) {
+		out->pcap.buf_idx = level;
+		out->pcap.nb_packets = nb_packets;
+		hdr->flags |= SPI_SNIFF_FLAG_OVERRUN;
+		hdr->length = 0;
+		spi_sniff_pcap_write(out, hdr, pos);
+	}
+	return !out->pcap.error;
+}
+
+/*
+ * Copy record in stage buffer before sending it, bytes overwritten by DMA
+ * while waiting for USB buffers would be sent otherwise.
+ */
+static bool spi_sniff_usb(t_spi_sniff_out *out, t_spi_sniff_hdr *hdr,
+			  const uint32_t *pos)
+{
+	uint8_t *data = out->stage + sizeof(t_spi_sniff_hdr);
+
+	spi_sniff_ring_copy(data, &sniff_lines[SPI_SNIFF_MOSI],
+			    pos[SPI_SNIFF_MOSI], hdr->length);
+	spi_sniff_ring_copy(data + hdr->length, &sniff_lines[SPI_SNIFF_MISO],
+			    pos[SPI_SNIFF_MISO], hdr->length);
+	if (hdr->length > 0 && spi_sniff_lost(pos)) {
+		hdr->flags |= SPI_SNIFF_FLAG_OVERRUN;
+		hdr->length = 0;
+	}
+	memcpy(out->stage, hdr, sizeof(t_spi_sniff_hdr));
+	return spi_sniff_out_write(out, out->stage,
+				   sizeof(t_spi_sniff_hdr) + (2 * hdr->length));
+}
+
+/*
+ * Send records of frame between start and end CS edges, USB and file ones
+ * are split in SPI_SNIFF_RECORD_MAX bytes records.
+ */
+static bool spi_sniff_frame(t_spi_sniff_out *out, const t_spi_sniff_event *start,
+			    const t_spi_sniff_event *end, uint8_t flags,
+			    t_spi_sniff_stats *stats)
+{
+	t_spi_sniff_hdr hdr, rec;
+	uint32_t pos[2], len[2], left, n;
+	bool ok;
+	int i;
+
+	hdr.timestamp = start->timestamp;
+	hdr.duration = end->timestamp - start->timestamp;
+	hdr.flags = flags;
+	hdr.reserved = 0;
+
+	for (i = 0; i < 2; i++) {
+		pos[i] = start->pos[i];
+		len[i] = end->pos[i] - start->pos[i];
+	}
+	if (len[SPI_SNIFF_MOSI] != len[SPI_SNIFF_MISO])
+		hdr.flags |= SPI_SNIFF_FLAG_MISMATCH;
+	/* First byte of frame already overwritten by DMA */
+	if (spi_sniff_lost(pos))
+		hdr.flags |= SPI_SNIFF_FLAG_OVERRUN;
+	left = 0;
+	if (!(hdr.flags & SPI_SNIFF_FLAG_OVERRUN))
+		left = MIN(len[SPI_SNIFF_MOSI], len[SPI_SNIFF_MISO]);
+	if (!(hdr.flags & SPI_SNIFF_FLAG_CONTINUED))
+		stats->nb_frames++;
+
+	do {
+		n = left;
+		if (out->type != SPI_SNIFF_OUT_TEXT)
+			n = MIN(n, SPI_SNIFF_RECORD_MAX);
+		left -= n;
+		rec = hdr;
+		rec.length = n;
+		/* Events lost in first record, mismatch in last one */
+		if (left > 0)
+			rec.flags = (rec.flags & ~SPI_SNIFF_FLAG_MISMATCH) |
+				SPI_SNIFF_FLAG_CONTINUED;
+		hdr.flags &= ~SPI_SNIFF_FLAG_EVENTS_LOST;
+
+		ok = TRUE;
+		if (out->type == SPI_SNIFF_OUT_TEXT) {
+			spi_sniff_print(out, &rec, pos);
+			out->cont = !!(rec.flags & SPI_SNIFF_FLAG_CONTINUED);
+		} else if (out->type == SPI_SNIFF_OUT_FILE) {
+			ok = spi_sniff_pcap(out, &rec, pos);
+		} else {
+			ok = spi_sniff_usb(out, &rec, pos);
+		}
+
+		if (rec.flags & SPI_SNIFF_FLAG_OVERRUN)
+			stats->nb_overruns++;
+		stats->nb_bytes += rec.length;
+		for (i = 0; i < 2; i++)
+			pos[i] += n;
+	} while (ok && left > 0);
+
+	return ok;
+}
+
+/*
+ * While CS is low, send bytes received since start as a continued record
+ * once a line ring is half full so a long transfer does not overrun.
+ * Only called with no pending CS edge, start is moved after sent bytes.
+ */
+static bool spi_sniff_continue(t_spi_sniff_out *out, t_spi_sniff_event *start,
+			       t_spi_sniff_stats *stats)
+{
+	t_spi_sniff_event end;
+	uint32_t len;
+	int i;
+
+	end.timestamp = bsp_get_cyclecounter();
+	end.cs = 0;
+	for (i = 0; i < 2; i++)
+		end.pos[i] = spi_sniff_pos(&sniff_lines[i]);
+	/* CS edge during positions read, they may include next frame bytes */
+	if (sniff_ev_rd != sniff_ev_wr)
+		return TRUE;
+
+	len = MIN(end.pos[SPI_SNIFF_MOSI] - start->pos[SPI_SNIFF_MOSI],
+		  end.pos[SPI_SNIFF_MISO] - start->pos[SPI_SNIFF_MISO]);
+	if ((end.pos[SPI_SNIFF_MOSI] - start->pos[SPI_SNIFF_MOSI]) < SPI_SNIFF_CONTINUE_SIZE &&
+	    (end.pos[SPI_SNIFF_MISO] - start->pos[SPI_SNIFF_MISO]) < SPI_SNIFF_CONTINUE_SIZE)
+		return TRUE;
+
+	/* Same length on both lines, a late DMA byte goes in next record */
+	for (i = 0; i < 2; i++)
+		end.pos[i] = start->pos[i] + len;
+	if (!spi_sniff_frame(out, start, &end, SPI_SNIFF_FLAG_CONTINUED, stats))
+		return FALSE;
+	*start = end;
+	return TRUE;
+}
+
+/*
+ * Process CS edges and send frames until UBTN is pressed, a byte is received
+ * on console or output fails.
+ * USB output is flushed when no edge is pending and an end record is sent.
+ * File output is a pcapng with "mosi" and "miso" interfaces (LINKTYPE_USER0,
+ * DWT cycles timestamps), each record is one packet per interface.
+ */
+void spi_sniff_run(t_hydra_console *con, spi_sniff_out_t type, FIL *file,
+		   t_spi_sniff_stats *stats)
+{
+	t_spi_sniff_out out;
+	t_spi_sniff_event start, end;
+	t_spi_sniff_hdr hdr;
+	bool in_frame;
+	uint8_t flags, data;
+
+	memset(stats, 0, sizeof(t_spi_sniff_stats));
+	memset(&out, 0, sizeof(out));
+	out.con = con;
+	out.type = type;
+	if (type == SPI_SNIFF_OUT_USB) {
+		out.stage = pool_alloc_bytes(SPI_SNIFF_OUT_BUF_SIZE);
+		if (out.stage == NULL)
+			return;
+	}
+	if (type == SPI_SNIFF_OUT_FILE) {
+		out.buf = pool_alloc_bytes(SPI_SNIFF_OUT_BUF_SIZE);
+		if (out.buf == NULL)
+			return;
+		pcapng_init(&out.pcap, file, out.buf, SPI_SNIFF_OUT_BUF_SIZE,
+			    STM32_HCLK);
+		out.pcap_if[SPI_SNIFF_MOSI] = pcapng_add_interface(&out.pcap,
+				PCAPNG_LINKTYPE_USER0, 0, "mosi");
+		out.pcap_if[SPI_SNIFF_MISO] = pcapng_add_interface(&out.pcap,
+				PCAPNG_LINKTYPE_USER0, 0, "miso");
+		if (out.pcap.error || out.pcap_if[SPI_SNIFF_MISO] < 0) {
+			pool_free(out.buf);
+			return;
+		}
+	}
+
+	memset(&start, 0, sizeof(start));
+	in_frame = FALSE;
+	flags = 0;
+	while (!hydrabus_ubtn()) {
+		if (chnReadTimeout(con->sdu, &data, 1, TIME_IMMEDIATE) == 1)
+			break;
+
+		if (sniff_ev_lost) {
+			sniff_ev_lost = 0;
+			flags |= SPI_SNIFF_FLAG_EVENTS_LOST;
+		}
+
+		if (sniff_ev_rd == sniff_ev_wr) {
+			if (in_frame && !spi_sniff_continue(&out, &start, stats))
+				break;
+			if (type == SPI_SNIFF_OUT_USB)
+				spi_sniff_out_flush(&out);
+			chThdSleep(1);
+			continue;
+		}
+
+		end = sniff_events[sniff_ev_rd % SPI_SNIFF_EVENTS_NB];
+		sniff_ev_rd++;
+		if (end.cs == 0) {
+			start = end;
+			in_frame = TRUE;
+			continue;
+		}
+		/* Rising edge without falling one (lost) */
+		if (!in_frame)
+			continue;
+		in_frame = FALSE;
+		if (!spi_sniff_frame(&out, &start, &end, flags, stats))
+			break;
+		flags = 0;
+	}
+
+	if (type == SPI_SNIFF_OUT_USB) {
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.timestamp = bsp_get_cyclecounter();
+		hdr.flags = SPI_SNIFF_FLAG_END;
+		if (spi_sniff_out_write(&out, (uint8_t *)&hdr, sizeof(hdr)))
+			spi_sniff_out_flush(&out);
+		pool_free(out.stage);
+	}
+	if (type == SPI_SNIFF_OUT_FILE) {
+		pcapng_flush(&out.pcap);
+		pool_free(out.buf);
+	}
+}
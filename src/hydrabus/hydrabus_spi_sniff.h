@@ -0,0 +1,93 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SPI_SNIFF_H_
+#define _HYDRABUS_SPI_SNIFF_H_
+
+#include "common.h"
+#include "ff.h"
+
+/*
+ * Continuous SPI sniffer.
+ * SPI1 (MOSI on PB5) and SPI2 (MISO wired to PC3) are slaves receiving in
+ * DMA circular mode, CS (PA15) edges are timestamped by EXTI.
+ * Bytes received while CS is low are sent as one record:
+ * t_spi_sniff_hdr followed by length MOSI bytes then length MISO bytes.
+ * While CS stays low, bytes are sent in SPI_SNIFF_FLAG_CONTINUED records
+ * once SPI_SNIFF_CONTINUE_SIZE bytes are pending, the record sent at CS
+ * rising edge ends the frame.
+ * USB and file records hold at most SPI_SNIFF_RECORD_MAX bytes per line,
+ * longer ones are split in continued records. Record bytes are copied from
+ * the rings before being sent, if DMA overwrote them meanwhile the record is
+ * sent as an overrun one.
+ *
+ * SPI2 RX uses DMA1 Stream3 which is also USART3 TX DMA of 1-Wire (see
+ * bsp_onewire_conf.h), both cannot run at same time (SPI2 SCK is the 1-Wire
+ * DQ pin). The 1-Wire driver sets DMA registers directly so the sniffer
+ * stream allocation does not detect it, do not sniff while another console
+ * is in 1-Wire mode.
+ */
+
+#define SPI_SNIFF_DMA_SIZE (16384) /* Ring per line (pool), power of 2 */
+#define SPI_SNIFF_CONTINUE_SIZE (SPI_SNIFF_DMA_SIZE / 2)
+#define SPI_SNIFF_RECORD_MAX (SPI_SNIFF_CONTINUE_SIZE / 2) /* USB/file bytes per line */
+#define SPI_SNIFF_EVENTS_NB (64) /* CS edges not yet processed */
+/* Staged USB record or pcapng blocks, holds both lines of one record */
+#define SPI_SNIFF_OUT_BUF_SIZE ((2 * SPI_SNIFF_RECORD_MAX) + 512)
+
+/* CS input (SPI1 NSS) */
+#define SPI_SNIFF_CS_PORT GPIOA
+#define SPI_SNIFF_CS_PAD (15)
+
+/* Above EXTI priority so DMA wrap is counted before CS edge is read */
+#define SPI_SNIFF_DMA_IRQ_PRIORITY (STM32_EXT_EXTI10_15_IRQ_PRIORITY - 1)
+
+/* t_spi_sniff_hdr.flags */
+#define SPI_SNIFF_FLAG_OVERRUN BIT(0) /* Frame bytes overwritten (length is 0) */
+#define SPI_SNIFF_FLAG_MISMATCH BIT(1) /* MOSI/MISO counts differ, length is the lowest */
+#define SPI_SNIFF_FLAG_EVENTS_LOST BIT(2) /* CS edges lost before this frame */
+#define SPI_SNIFF_FLAG_CONTINUED BIT(3) /* CS still low, frame continues in next record */
+#define SPI_SNIFF_FLAG_END BIT(7) /* Sniffer stopped (length is 0) */
+
+/* Little endian */
+typedef struct __attribute__ ((packed)) {
+	uint32_t timestamp; /* CS falling edge (DWT cycles) */
+	uint32_t duration; /* CS low (DWT cycles) */
+	uint16_t length; /* Bytes per line */
+	uint8_t flags;
+	uint8_t reserved;
+} t_spi_sniff_hdr;
+
+typedef enum {
+	SPI_SNIFF_OUT_TEXT = 0, /* Console */
+	SPI_SNIFF_OUT_USB, /* Binary records */
+	SPI_SNIFF_OUT_FILE, /* pcapng */
+} spi_sniff_out_t;
+
+typedef struct {
+	uint32_t nb_frames; /* Continued records are not counted */
+	uint32_t nb_bytes; /* Bytes per line in frames */
+	uint32_t nb_overruns;
+} t_spi_sniff_stats;
+
+bool spi_sniff_start(t_hydra_console *con);
+void spi_sniff_run(t_hydra_console *con, spi_sniff_out_t out, FIL *file,
+		   t_spi_sniff_stats *stats);
+void spi_sniff_stop(t_hydra_console *con);
+
+#endif /* _HYDRABUS_SPI_SNIFF_H_ */
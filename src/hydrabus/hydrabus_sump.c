@@ -22,6 +22,7 @@
 #include "bsp.h"
 #include "bsp_tim.h"
 #include "hydrabus_sump.h"
+#include "usb_tx.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -70,7 +71,7 @@ static void sump_init(t_hydra_console *con)
 	tim_init(con);
 }
 
-static void get_samples(t_hydra_console *con, uint16_t * buffer) __attribute__((optimize("-O3")));
+static void get_samples(t_hydra_console *con, uint16_t * buffer) __attribute__((optimize("-O3"))) HOT_FUNC;
 static void get_samples(t_hydra_console *con, uint16_t * buffer)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -147,7 +148,54 @@ int cmd_sump(t_hydra_console *con, t_tokenline_parsed *p)
 	return TRUE;
 }
 
-void sump(t_hydra_console *con) __attribute__((optimize("-O3")));
+/*
+ * Send samples directly in USB output buffers, one byte per enabled
+ * channel group (as expected by SUMP/OLS clients)
+ */
+static void sump_upload(t_hydra_console *con, uint16_t *buffer)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *out = NULL;
+	uint32_t out_size = 0;
+	uint32_t idx = 0;
+	uint16_t sample;
+
+	while(proto->config.sump.read_count > 0) {
+		if((out_size - idx) < 2) {
+			usb_tx_submit(con, idx);
+			out = usb_tx_get_buffer(con, &out_size, TIME_INFINITE);
+			if(out == NULL) {
+				return;
+			}
+			idx = 0;
+		}
+		if (INDEX == 0) {
+			INDEX = STATES_LEN-1;
+		} else {
+			INDEX--;
+		}
+		sample = *(buffer+INDEX);
+		switch (proto->config.sump.channels) {
+		case 1:
+			out[idx++] = sample & 0xff;
+			break;
+		case 2:
+			out[idx++] = (sample & 0xff00)>>8;
+			break;
+		case 3:
+			out[idx++] = sample & 0xff;
+			out[idx++] = (sample & 0xff00)>>8;
+			break;
+		default:
+			proto->config.sump.read_count--;
+			continue;
+		}
+		proto->config.sump.read_count--;
+	}
+	usb_tx_submit(con, idx);
+}
+
+void sump(t_hydra_console *con) __attribute__((optimize("-O3"))) HOT_FUNC;
 void sump(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -177,25 +225,7 @@ void sump(t_hydra_console *con)
 				proto->config.sump.state = SUMP_STATE_ARMED;
 				get_samples(con, buffer);
 
-				while(proto->config.sump.read_count > 0) {
-					if (INDEX == 0) {
-						INDEX = STATES_LEN-1;
-					} else {
-						INDEX--;
-					}
-					switch (proto->config.sump.channels) {
-					case 1:
-						cprintf(con, "%c\x00\x00\x00", *(buffer+INDEX) & 0xff);
-						break;
-					case 2:
-						cprintf(con, "%c\x00\x00\x00", (*(buffer+INDEX) & 0xff00)>>8);
-						break;
-					case 3:
-						cprintf(con, "%c%c\x00\x00", *(buffer+INDEX) & 0xff, (*(buffer+INDEX) & 0xff00)>>8);
-						break;
-					}
-					proto->config.sump.read_count--;
-				}
+				sump_upload(con, buffer);
 				break;
 			case SUMP_DESC:
 				// device name string
@@ -0,0 +1,220 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "bsp.h"
+
+#include "hydrabus_mode_wiegand.h"
+#include "hydrabus_wiegand.h"
+
+#define WIEGAND_CYCLES_PER_US (STM32_HCLK / 1000000)
+#define WIEGAND_FRAMES_MASK (WIEGAND_FRAMES_NB - 1)
+
+/*
+ * Frames are written by EXTI interrupt (D0 and D1 at the same priority) and
+ * by capture thread with kernel locked.
+ */
+typedef struct {
+	t_wiegand_frame cur; /* Frame being received */
+	uint32_t last; /* Last bit falling edge (DWT cycles) */
+	uint32_t gap; /* Frame gap (DWT cycles) */
+	uint32_t head;
+	uint32_t tail;
+	uint32_t nb_lost; /* Frames dropped because queue was full */
+	t_wiegand_frame frames[WIEGAND_FRAMES_NB];
+} t_wiegand_capture;
+
+static t_wiegand_capture wiegand_cap HOT_DATA;
+static bool wiegand_busy = false;
+
+static const t_wiegand_format wiegand_formats[] = {
+	{ "H10301", 26, 1, 8, 9, 16, 12, 13 },
+	{ "H10306", 34, 1, 16, 17, 16, 16, 17 },
+	{ "H10304", 37, 1, 16, 17, 19, 18, 18 },
+};
+
+/* Queue current frame and start a new one */
+HOT_FUNC
+static void wiegand_frame_end(void)
+{
+	t_wiegand_capture *cap = &wiegand_cap;
+
+	if ((cap->head - cap->tail) >= WIEGAND_FRAMES_NB)
+		cap->nb_lost++;
+	else
+		cap->frames[cap->head++ & WIEGAND_FRAMES_MASK] = cap->cur;
+	memset(&cap->cur, 0, sizeof(t_wiegand_frame));
+}
+
+HOT_FUNC
+static void wiegand_cb(void *arg)
+{
+	t_wiegand_capture *cap = &wiegand_cap;
+	uint32_t now, n;
+
+	now = bsp_get_cyclecounter();
+	if (cap->cur.nb_bits > 0 && (now - cap->last) > cap->gap)
+		wiegand_frame_end();
+
+	n = cap->cur.nb_bits;
+	if (n == 0)
+		cap->cur.timestamp = now;
+	if (!palReadPad(GPIOB, WIEGAND_D0_PIN) && !palReadPad(GPIOB, WIEGAND_D1_PIN))
+		cap->cur.flags |= WIEGAND_FLAG_COLLISION;
+	if (n < WIEGAND_BITS_MAX) {
+		/* arg is 1 for D1 */
+		if (arg != NULL)
+			cap->cur.bits[n >> 3] |= 0x80 >> (n & 7);
+		cap->cur.nb_bits = n + 1;
+	} else {
+		cap->cur.flags |= WIEGAND_FLAG_OVERFLOW;
+	}
+	cap->cur.duration = now - cap->cur.timestamp;
+	cap->last = now;
+}
+
+/* D0/D1 shall be configured as inputs, gap_us is at least WIEGAND_FRAME_GAP_MIN */
+bool wiegand_capture_start(uint32_t gap_us)
+{
+	if (wiegand_busy)
+		return FALSE;
+	wiegand_busy = TRUE;
+
+	memset(&wiegand_cap, 0, sizeof(wiegand_cap));
+	if (gap_us < WIEGAND_FRAME_GAP_MIN)
+		gap_us = WIEGAND_FRAME_GAP_MIN;
+	wiegand_cap.gap = gap_us * WIEGAND_CYCLES_PER_US;
+
+	palEnablePadEvent(GPIOB, WIEGAND_D0_PIN, PAL_EVENT_MODE_FALLING_EDGE);
+	palSetPadCallback(GPIOB, WIEGAND_D0_PIN, wiegand_cb, NULL);
+	palEnablePadEvent(GPIOB, WIEGAND_D1_PIN, PAL_EVENT_MODE_FALLING_EDGE);
+	palSetPadCallback(GPIOB, WIEGAND_D1_PIN, wiegand_cb, (void *)1);
+	return TRUE;
+}
+
+/* Get next ended frame, FALSE if none */
+bool wiegand_capture_get(t_wiegand_frame *frame)
+{
+	t_wiegand_capture *cap = &wiegand_cap;
+	bool found;
+
+	chSysLock();
+	if (cap->cur.nb_bits > 0 && (bsp_get_cyclecounter() - cap->last) > cap->gap)
+		wiegand_frame_end();
+
+	found = (cap->tail != cap->head);
+	if (found)
+		*frame = cap->frames[cap->tail++ & WIEGAND_FRAMES_MASK];
+	chSysUnlock();
+
+	return found;
+}
+
+uint32_t wiegand_capture_lost(void)
+{
+	return wiegand_cap.nb_lost;
+}
+
+void wiegand_capture_stop(void)
+{
+	palDisablePadEvent(GPIOB, WIEGAND_D0_PIN);
+	palDisablePadEvent(GPIOB, WIEGAND_D1_PIN);
+	wiegand_busy = FALSE;
+}
+
+/* Format of frame length, NULL if unknown */
+const t_wiegand_format *wiegand_format_get(uint32_t nb_bits)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(wiegand_formats); i++) {
+		if (wiegand_formats[i].nb_bits == nb_bits)
+			return &wiegand_formats[i];
+	}
+	return NULL;
+}
+
+static uint32_t wiegand_get_field(const t_wiegand_frame *frame, uint32_t pos, uint32_t len)
+{
+	uint32_t value, i;
+
+	value = 0;
+	for (i = 0; i < len; i++)
+		value = (value << 1) | wiegand_frame_bit(frame, pos + i);
+	return value;
+}
+
+static void wiegand_set_field(t_wiegand_frame *frame, uint32_t pos, uint32_t len,
+			      uint32_t value)
+{
+	uint32_t i, n;
+
+	for (i = 0; i < len; i++) {
+		n = pos + i;
+		if ((value >> (len - 1 - i)) & 1)
+			frame->bits[n >> 3] |= 0x80 >> (n & 7);
+	}
+}
+
+static uint32_t wiegand_ones(const t_wiegand_frame *frame, uint32_t first, uint32_t last)
+{
+	uint32_t nb, i;
+
+	nb = 0;
+	for (i = first; i <= last; i++)
+		nb += wiegand_frame_bit(frame, i);
+	return nb;
+}
+
+/* FALSE if frame has no known format (parity is checked in card) */
+bool wiegand_decode(const t_wiegand_frame *frame, t_wiegand_card *card)
+{
+	const t_wiegand_format *format;
+
+	format = wiegand_format_get(frame->nb_bits);
+	if (format == NULL || frame->flags != 0)
+		return FALSE;
+
+	card->format = format;
+	card->facility = wiegand_get_field(frame, format->fc_pos, format->fc_len);
+	card->card = wiegand_get_field(frame, format->cn_pos, format->cn_len);
+	card->parity_ok = (wiegand_ones(frame, 0, format->even_end) & 1) == 0 &&
+			  (wiegand_ones(frame, format->odd_start, format->nb_bits - 1) & 1) == 1;
+	return TRUE;
+}
+
+/* FALSE if facility or card does not fit in format */
+bool wiegand_encode(const t_wiegand_format *format, uint32_t facility, uint32_t card,
+		    t_wiegand_frame *frame)
+{
+	if (facility >= (1UL << format->fc_len) || card >= (1UL << format->cn_len))
+		return FALSE;
+
+	memset(frame, 0, sizeof(t_wiegand_frame));
+	frame->nb_bits = format->nb_bits;
+	wiegand_set_field(frame, format->fc_pos, format->fc_len, facility);
+	wiegand_set_field(frame, format->cn_pos, format->cn_len, card);
+
+	if (wiegand_ones(frame, 1, format->even_end) & 1)
+		wiegand_set_field(frame, 0, 1, 1);
+	if ((wiegand_ones(frame, format->odd_start, format->nb_bits - 2) & 1) == 0)
+		wiegand_set_field(frame, format->nb_bits - 1, 1, 1);
+	return TRUE;
+}
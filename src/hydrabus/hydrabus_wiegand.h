@@ -0,0 +1,85 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_WIEGAND_H_
+#define _HYDRABUS_WIEGAND_H_
+
+#include "common.h"
+
+/*
+ * Wiegand capture: D0/D1 falling edges raise an EXTI interrupt which adds
+ * the bit to the current frame with DWT timestamps, a frame ends when no
+ * bit is received during the frame gap.
+ * Ended frames are queued so bits are not lost while console or USB is
+ * busy.
+ */
+
+#define WIEGAND_BITS_MAX (128)
+#define WIEGAND_FRAMES_NB (16) /* Ended frames not yet read, power of 2 */
+#define WIEGAND_FRAME_GAP_MIN (5000) /* us */
+
+/* t_wiegand_frame.flags */
+#define WIEGAND_FLAG_OVERFLOW BIT(0) /* More than WIEGAND_BITS_MAX bits */
+#define WIEGAND_FLAG_COLLISION BIT(1) /* D0 and D1 low at the same time */
+
+typedef struct {
+	uint32_t timestamp; /* First bit falling edge (DWT cycles) */
+	uint32_t duration; /* First to last bit falling edge (DWT cycles) */
+	uint8_t nb_bits;
+	uint8_t flags;
+	uint8_t bits[WIEGAND_BITS_MAX / 8]; /* First bit is MSB of bits[0] */
+} t_wiegand_frame;
+
+/*
+ * Card format with leading even parity bit over bits 1 to even_end and
+ * trailing odd parity bit over bits odd_start to nb_bits - 2.
+ */
+typedef struct {
+	const char *name;
+	uint8_t nb_bits;
+	uint8_t fc_pos; /* Facility code */
+	uint8_t fc_len;
+	uint8_t cn_pos; /* Card number */
+	uint8_t cn_len;
+	uint8_t even_end;
+	uint8_t odd_start;
+} t_wiegand_format;
+
+typedef struct {
+	const t_wiegand_format *format;
+	uint32_t facility;
+	uint32_t card;
+	bool parity_ok;
+} t_wiegand_card;
+
+static inline uint8_t wiegand_frame_bit(const t_wiegand_frame *frame, uint32_t i)
+{
+	return (frame->bits[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+bool wiegand_capture_start(uint32_t gap_us);
+bool wiegand_capture_get(t_wiegand_frame *frame);
+uint32_t wiegand_capture_lost(void);
+void wiegand_capture_stop(void);
+
+const t_wiegand_format *wiegand_format_get(uint32_t nb_bits);
+bool wiegand_decode(const t_wiegand_frame *frame, t_wiegand_card *card);
+bool wiegand_encode(const t_wiegand_format *format, uint32_t facility, uint32_t card,
+		    t_wiegand_frame *frame);
+
+#endif /* _HYDRABUS_WIEGAND_H_ */
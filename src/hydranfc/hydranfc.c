@@ -29,6 +29,7 @@
 #include "ff.h"
 #include "microsd.h"
 #include "hydrabus_sd.h"
+#include "hexdump.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
@@ -310,19 +311,11 @@ THD_FUNCTION(key_sniff, arg)
 #define MIFARE_UL_DATA (MIFARE_UL_DATA_MAX/4)
 #define MIFARE_CL1_MAX (5)
 #define MIFARE_CL2_MAX (5)
-void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data)
-{
-	uint8_t data_buf[MIFARE_DATA_MAX];
-	uint8_t CL1_buf[MIFARE_CL1_MAX];
-	uint8_t CL2_buf[MIFARE_CL2_MAX];
-
-	uint8_t CL1_buf_size = 0;
-	uint8_t CL2_buf_size = 0;
-
-	uint8_t i;
 
-	/* Clear data elements */
-	memset(data, 0, sizeof(t_hydranfc_scan_iso14443A));
+/* Configure TRF7970A as ISO14443A 106kbps reader and turn RF ON */
+void hydranfc_iso14443A_setup(void)
+{
+	uint8_t data_buf[2];
 
 	/* End Test delay */
 	irq_count = 0;
@@ -357,16 +350,46 @@ void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data)
 
 	/* Turn RF ON (Chip Status Control Register (0x00)) */
 	Trf797xTurnRfOn();
+}
+
+/*
+ * Run REQA(or WUPA)/Anticollision/Select on an already configured reader
+ * (see hydranfc_iso14443A_setup()), RF is left ON.
+ * req_cmd shall be 0x26 (REQA) or 0x52 (WUPA to also wake up HALTed tags).
+ */
+void hydranfc_iso14443A_anticoll(t_hydranfc_scan_iso14443A *data,
+				 uint8_t req_cmd, bool read_mf_ul)
+{
+	uint8_t data_buf[MIFARE_DATA_MAX];
+	uint8_t CL1_buf[MIFARE_CL1_MAX];
+	uint8_t CL2_buf[MIFARE_CL2_MAX];
+
+	uint8_t CL1_buf_size = 0;
+	uint8_t CL2_buf_size = 0;
+
+	uint8_t i;
+
+	/* Clear data elements */
+	memset(data, 0, sizeof(t_hydranfc_scan_iso14443A));
+
+	/*
+	 * Select RX without CRC_A (a previous Select could have enabled it)
+	 * Configure Mode ISO Control Register (0x01) to 0x88 (ISO14443A RX bit
+	 * rate, 106 kbps) and no RX CRC (CRC is not present in the response))
+	 */
+	data_buf[0] = ISO_CONTROL;
+	data_buf[1] = 0x88;
+	Trf797xWriteSingle(data_buf, 2);
 
 	/* Send REQA (7 bits) and receive ATQA (2 bytes) */
-	data_buf[0] = 0x26; /* REQA (7bits) */
+	data_buf[0] = req_cmd; /* REQA/WUPA (7bits) */
 	data->atqa_buf_nb_rx_data = Trf797x_transceive_bits(data_buf[0], 7, data->atqa_buf, MIFARE_ATQA_MAX,
 				    10, /* 10ms TX/RX Timeout */
 				    0); /* TX CRC disabled */
 	/* Re-send REQA */
 	if (data->atqa_buf_nb_rx_data == 0) {
 		/* Send REQA (7 bits) and receive ATQA (2 bytes) */
-		data_buf[0] = 0x26; /* REQA (7 bits) */
+		data_buf[0] = req_cmd; /* REQA/WUPA (7 bits) */
 		data->atqa_buf_nb_rx_data = Trf797x_transceive_bits(data_buf[0], 7, data->atqa_buf, MIFARE_ATQA_MAX,
 					    10, /* 10ms TX/RX Timeout */
 					    0); /* TX CRC disabled */
@@ -447,7 +470,8 @@ void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data)
 
 					if (data->sak2_buf_nb_rx_data > 0) {
 						/* Check if it is a Mifare Ultra Light */
-						if( (data->atqa_buf[0] == 0x44) && (data->atqa_buf[1] == 0x00) &&
+						if( read_mf_ul &&
+						    (data->atqa_buf[0] == 0x44) && (data->atqa_buf[1] == 0x00) &&
 						    (data->sak1_buf[0] == 0x04) && (data->sak2_buf[1] == 0x00)
 						  ) {
 							for (i = 0; i < 16; i+=4) {
@@ -512,6 +536,13 @@ void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data)
 			}
 		}
 	}
+}
+
+void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data)
+{
+	hydranfc_iso14443A_setup();
+
+	hydranfc_iso14443A_anticoll(data, 0x26, TRUE);
 
 	/* Turn RF OFF (Chip Status Control Register (0x00)) */
 	Trf797xTurnRfOff();
@@ -521,48 +552,31 @@ void hydranfc_scan_mifare(t_hydra_console *con)
 {
 	int i;
 	uint8_t bcc;
+	char uid_str[(MIFARE_UID_MAX * 3) + 1];
 	t_hydranfc_scan_iso14443A* data;
 	t_hydranfc_scan_iso14443A data_buf;
 
 	data = &data_buf;
 	hydranfc_scan_iso14443A(data);
 
-	if(data->atqa_buf_nb_rx_data > 0) {
-		cprintf(con, "ATQA:");
-		for (i = 0; i < data->atqa_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->atqa_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->atqa_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "ATQA:", data->atqa_buf, data->atqa_buf_nb_rx_data);
 
-	if(data->sak1_buf_nb_rx_data > 0) {
-		cprintf(con, "SAK1:");
-		for (i = 0; i < data->sak1_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->sak1_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->sak1_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "SAK1:", data->sak1_buf, data->sak1_buf_nb_rx_data);
 
-	if(data->sak2_buf_nb_rx_data > 0) {
-		cprintf(con, "SAK2:");
-		for (i = 0; i < data->sak2_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->sak2_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->sak2_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "SAK2:", data->sak2_buf, data->sak2_buf_nb_rx_data);
 
 	if(data->uid_buf_nb_rx_data > 0) {
 		if(data->uid_buf_nb_rx_data >= 7) {
-			cprintf(con, "UID:");
-			for (i = 0; i < data->uid_buf_nb_rx_data ; i++) {
-				cprintf(con, " %02X", data->uid_buf[i]);
-			}
-			cprintf(con, "\r\n");
+			print_hex_bytes(con, "UID:", data->uid_buf, data->uid_buf_nb_rx_data);
 		} else {
-			cprintf(con, "UID:");
 			bcc = 0;
-			for (i = 0; i < data->uid_buf_nb_rx_data - 1; i++) {
-				cprintf(con, " %02X", data->uid_buf[i]);
+			for (i = 0; i < data->uid_buf_nb_rx_data - 1; i++)
 				bcc ^= data->uid_buf[i];
-			}
-			cprintf(con, " (BCC %02X %s)\r\n", data->uid_buf[i],
+			hexdump_bytes(uid_str, data->uid_buf, i);
+			cprintf(con, "UID:%s (BCC %02X %s)\r\n", uid_str, data->uid_buf[i],
 				bcc == data->uid_buf[i] ? "ok" : "NOT OK");
 		}
 	}
@@ -574,22 +588,16 @@ void hydranfc_scan_mifare(t_hydra_console *con)
 		uint8_t expected_uid_bcc1;
 		uint8_t obtained_uid_bcc1;
 
-		cprintf(con, "DATA:");
-		for (i = 0; i < data->mf_ul_data_nb_rx_data; i++) {
-			if(i % 16 == 0)
-				cprintf(con, "\r\n");
-
-			cprintf(con, " %02X", data->mf_ul_data[i]);
+		cprintf(con, "DATA:\r\n");
+		for (i = 0; i < data->mf_ul_data_nb_rx_data; i += HEXDUMP_LINE_BYTES) {
+			print_hex_bytes(con, "", &data->mf_ul_data[i],
+					MIN(HEXDUMP_LINE_BYTES, data->mf_ul_data_nb_rx_data - i));
 		}
-		cprintf(con, "\r\n");
 
 		/* Check Data UID with BCC */
-		cprintf(con, "DATA UID:");
-		for (i = 0; i < 3; i++)
-			cprintf(con, " %02X", data->mf_ul_data[i]);
-		for (i = 4; i < 8; i++)
-			cprintf(con, " %02X", data->mf_ul_data[i]);
-		cprintf(con, "\r\n");
+		i = hexdump_bytes(uid_str, &data->mf_ul_data[0], 3);
+		hexdump_bytes(&uid_str[i], &data->mf_ul_data[4], 4);
+		cprintf(con, "DATA UID:%s\r\n", uid_str);
 
 		expected_uid_bcc0 = (ISO14443A_SEL_L1_CT ^ data->mf_ul_data[0] ^ data->mf_ul_data[1] ^ data->mf_ul_data[2]); // BCC1
 		obtained_uid_bcc0 = data->mf_ul_data[3];
@@ -614,48 +622,31 @@ int hydranfc_read_mifare_ul(t_hydra_console *con, char* filename)
 	FRESULT err;
 	FIL fp;
 	uint8_t bcc;
+	char uid_str[(MIFARE_UID_MAX * 3) + 1];
 	t_hydranfc_scan_iso14443A* data;
 	t_hydranfc_scan_iso14443A data_buf;
 
 	data = &data_buf;
 	hydranfc_scan_iso14443A(data);
 
-	if(data->atqa_buf_nb_rx_data > 0) {
-		cprintf(con, "ATQA:");
-		for (i = 0; i < data->atqa_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->atqa_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->atqa_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "ATQA:", data->atqa_buf, data->atqa_buf_nb_rx_data);
 
-	if(data->sak1_buf_nb_rx_data > 0) {
-		cprintf(con, "SAK1:");
-		for (i = 0; i < data->sak1_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->sak1_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->sak1_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "SAK1:", data->sak1_buf, data->sak1_buf_nb_rx_data);
 
-	if(data->sak2_buf_nb_rx_data > 0) {
-		cprintf(con, "SAK2:");
-		for (i = 0; i < data->sak2_buf_nb_rx_data; i++)
-			cprintf(con, " %02X", data->sak2_buf[i]);
-		cprintf(con, "\r\n");
-	}
+	if(data->sak2_buf_nb_rx_data > 0)
+		print_hex_bytes(con, "SAK2:", data->sak2_buf, data->sak2_buf_nb_rx_data);
 
 	if(data->uid_buf_nb_rx_data > 0) {
 		if(data->uid_buf_nb_rx_data >= 7) {
-			cprintf(con, "UID:");
-			for (i = 0; i < data->uid_buf_nb_rx_data ; i++) {
-				cprintf(con, " %02X", data->uid_buf[i]);
-			}
-			cprintf(con, "\r\n");
+			print_hex_bytes(con, "UID:", data->uid_buf, data->uid_buf_nb_rx_data);
 		} else {
-			cprintf(con, "UID:");
 			bcc = 0;
-			for (i = 0; i < data->uid_buf_nb_rx_data - 1; i++) {
-				cprintf(con, " %02X", data->uid_buf[i]);
+			for (i = 0; i < data->uid_buf_nb_rx_data - 1; i++)
 				bcc ^= data->uid_buf[i];
-			}
-			cprintf(con, " (BCC %02X %s)\r\n", data->uid_buf[i],
+			hexdump_bytes(uid_str, data->uid_buf, i);
+			cprintf(con, "UID:%s (BCC %02X %s)\r\n", uid_str, data->uid_buf[i],
 				bcc == data->uid_buf[i] ? "ok" : "NOT OK");
 		}
 	}
@@ -667,22 +658,16 @@ int hydranfc_read_mifare_ul(t_hydra_console *con, char* filename)
 		uint8_t expected_uid_bcc1;
 		uint8_t obtained_uid_bcc1;
 
-		cprintf(con, "DATA:");
-		for (i = 0; i < data->mf_ul_data_nb_rx_data; i++) {
-			if(i % 16 == 0)
-				cprintf(con, "\r\n");
-
-			cprintf(con, " %02X", data->mf_ul_data[i]);
+		cprintf(con, "DATA:\r\n");
+		for (i = 0; i < data->mf_ul_data_nb_rx_data; i += HEXDUMP_LINE_BYTES) {
+			print_hex_bytes(con, "", &data->mf_ul_data[i],
+					MIN(HEXDUMP_LINE_BYTES, data->mf_ul_data_nb_rx_data - i));
 		}
-		cprintf(con, "\r\n");
 
 		/* Check Data UID with BCC */
-		cprintf(con, "DATA UID:");
-		for (i = 0; i < 3; i++)
-			cprintf(con, " %02X", data->mf_ul_data[i]);
-		for (i = 4; i < 8; i++)
-			cprintf(con, " %02X", data->mf_ul_data[i]);
-		cprintf(con, "\r\n");
+		i = hexdump_bytes(uid_str, &data->mf_ul_data[0], 3);
+		hexdump_bytes(&uid_str[i], &data->mf_ul_data[4], 4);
+		cprintf(con, "DATA UID:%s\r\n", uid_str);
 
 		expected_uid_bcc0 = (ISO14443A_SEL_L1_CT ^ data->mf_ul_data[0] ^ data->mf_ul_data[1] ^ data->mf_ul_data[2]); // BCC1
 		obtained_uid_bcc0 = data->mf_ul_data[3];
@@ -735,11 +720,10 @@ int hydranfc_read_mifare_ul(t_hydra_console *con, char* filename)
 	*/
 }
 
-void hydranfc_scan_vicinity(t_hydra_console *con)
+/* Configure TRF7970A as ISO15693 reader and turn RF ON */
+void hydranfc_iso15693_setup(void)
 {
-	static uint8_t data_buf[VICINITY_UID_MAX];
-	uint8_t fifo_size;
-	int i;
+	uint8_t data_buf[2];
 
 	/* End Test delay */
 	irq_count = 0;
@@ -777,15 +761,35 @@ void hydranfc_scan_vicinity(t_hydra_console *con)
 	Trf797xTurnRfOn();
 
 	McuDelayMillisecond(10);
+}
 
+/*
+ * Send a 1 slot Inventory on an already configured reader
+ * (see hydranfc_iso15693_setup()), RF is left ON.
+ * data_buf shall be at least VICINITY_UID_MAX bytes.
+ * Return number of bytes received (Flags+DSFID+UID) or 0 if no answer.
+ */
+uint8_t hydranfc_iso15693_inventory(uint8_t *data_buf)
+{
 	/* Send Inventory(3B) and receive data + UID */
 	data_buf[0] = 0x26; /* Request Flags */
 	data_buf[1] = 0x01; /* Inventory Command */
 	data_buf[2] = 0x00; /* Mask */
 
-	fifo_size = Trf797x_transceive_bytes(data_buf, 3, data_buf, VICINITY_UID_MAX,
-					     10, /* 10ms TX/RX Timeout (shall be less than 10ms (6ms) in High Speed) */
-					     1); /* CRC enabled */
+	return Trf797x_transceive_bytes(data_buf, 3, data_buf, VICINITY_UID_MAX,
+					10, /* 10ms TX/RX Timeout (shall be less than 10ms (6ms) in High Speed) */
+					1); /* CRC enabled */
+}
+
+void hydranfc_scan_vicinity(t_hydra_console *con)
+{
+	static uint8_t data_buf[VICINITY_UID_MAX];
+	uint8_t fifo_size;
+	int i;
+
+	hydranfc_iso15693_setup();
+
+	fifo_size = hydranfc_iso15693_inventory(data_buf);
 	if (fifo_size > 0) {
 		/* fifo_size should be 10. */
 		cprintf(con, "UID:");
@@ -835,6 +839,7 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	bool sniff_frame_time;
 	bool sniff_parity;
 	bool sniff_pcap_output;
+	uint32_t nb_rounds;
 
 	if(p->tokens[token_pos] == T_SD)
 	{
@@ -854,6 +859,7 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	action = 0;
 	period = 1000;
 	continuous = FALSE;
+	nb_rounds = 0;
 	sd_file.filename[0] = 0;
 	for (t = token_pos; p->tokens[t]; t++) {
 		switch (p->tokens[t]) {
@@ -885,9 +891,15 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			break;
 
 		case T_SCAN:
+		case T_INVENTORY:
 			action = p->tokens[t];
 			break;
 
+		case T_SAMPLES:
+			t += 2;
+			memcpy(&nb_rounds, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+
 		case T_READ_MF_ULTRALIGHT:
 			action = p->tokens[t];
 			if (p->tokens[t+1] != T_ARG_STRING || p->tokens[t+3] != 0)
@@ -962,6 +974,17 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		}
 		break;
 
+	case T_INVENTORY:
+		dev_func = proto->config.hydranfc.dev_function;
+		if( (dev_func == NFC_TYPEA) || (dev_func == NFC_VICINITY) ) {
+			hydranfc_inventory(con, dev_func == NFC_VICINITY,
+					   nb_rounds, sniff_bin);
+		} else {
+			cprintf(con, "Please select MIFARE or Vicinity mode first.\r\n");
+			return 0;
+		}
+		break;
+
 	case T_READ_MF_ULTRALIGHT:
 		hydranfc_read_mifare_ul(con, sd_file.filename);
 		break;
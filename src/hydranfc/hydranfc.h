@@ -66,11 +66,20 @@ void hydranfc_cleanup(t_hydra_console *con);
 
 void hydranfc_show_registers(t_hydra_console *con);
 
+void hydranfc_iso14443A_setup(void);
+void hydranfc_iso14443A_anticoll(t_hydranfc_scan_iso14443A *data,
+				 uint8_t req_cmd, bool read_mf_ul);
 void hydranfc_scan_iso14443A(t_hydranfc_scan_iso14443A *data);
 
+void hydranfc_iso15693_setup(void);
+uint8_t hydranfc_iso15693_inventory(uint8_t *data_buf);
+
 void hydranfc_scan_mifare(t_hydra_console *con);
 void hydranfc_scan_vicinity(t_hydra_console *con);
 
+void hydranfc_inventory(t_hydra_console *con, bool vicinity,
+			uint32_t nb_rounds, bool bin_output);
+
 void hydranfc_sniff_14443A(t_hydra_console *con, bool start_of_frame, bool end_of_frame, bool sniff_trace_uart1, bool sniff_pcap_output);
 void hydranfc_sniff_14443A_bin(t_hydra_console *con, bool start_of_frame, bool end_of_frame, bool parity);
 void hydranfc_sniff_14443AB_bin_raw(t_hydra_console *con, bool start_of_frame, bool end_of_frame);
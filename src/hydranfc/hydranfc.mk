@@ -3,11 +3,12 @@ HYDRANFCSRC = hydranfc/hydranfc.c \
               hydranfc/hydranfc_cmd_sniff.c \
               hydranfc/hydranfc_cmd_sniff_downsampling.c \
               hydranfc/hydranfc_cmd_sniff_iso14443.c \
+              hydranfc/hydranfc_cmd_sniff_decoder.c \
               hydranfc/hydranfc_emul_14443a_sdd.c \
               hydranfc/hydranfc_emul_mifare.c \
-              hydranfc/file_fmt_pcap.c \
               hydranfc/hydranfc_emul_mf_ultralight.c \
-              hydranfc/hydranfc_bbio_reader.c
+              hydranfc/hydranfc_bbio_reader.c \
+              hydranfc/hydranfc_inventory.c
 
 # Required include directories
 HYDRANFCINC = ./hydranfc
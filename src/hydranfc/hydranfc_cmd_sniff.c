@@ -17,8 +17,6 @@
  * limitations under the License.
  */
 
-#include "file_fmt_pcap.h"
-
 #include <stdarg.h>
 #include <stdio.h> /* sprintf */
 #include <string.h> /* memcpy */
@@ -33,12 +31,14 @@
 #include "hydranfc.h"
 #include "hydranfc_cmd_sniff_iso14443.h"
 #include "hydranfc_cmd_sniff_downsampling.h"
+#include "hydranfc_cmd_sniff_decoder.h"
 
 #include "common.h"
 #include "microsd.h"
 #include "ff.h"
 #include "bsp.h"
 #include "bsp_uart.h"
+#include "file_fmt_pcapng.h"
 
 /* Disable D4 & TST output pin (used only for debug purpose) */
 #undef D4_OFF
@@ -121,6 +121,10 @@ uint8_t sniff_pcap_output;
 
 FIL log_file;
 
+/* pcapng capture, nfc_sniffer_buffer is used as block buffer */
+static t_pcapng sniff_pcapng;
+static uint32_t sniff_pcapng_if;
+
 #define CountLeadingZero(x) (__CLZ(x))
 #define SWAP32(x) (__REV(x))
 
@@ -373,10 +377,8 @@ void sniff_log(void)
 	tprintf("Logging...\r\n");
 
 	if (sniff_pcap_output) {
-		if (file_fmt_flush_close(&log_file, sniffer_get_buffer(),
-				sniffer_get_size())
-				< 0) {
-			// TODO implement terminal log out
+		if (pcapng_close(&sniff_pcapng) < 0) {
+			umount();
 			tprintf("Sniffed data were not saved!\r\n");
 			/* Error Red LED blink */
 			for(i=0; i<4; i++) {
@@ -387,7 +389,10 @@ void sniff_log(void)
 			}
 		}
 		else {
-			// TODO implement terminal log out
+			umount();
+			tprintf("write_file %s packets=%ld dropped=%ld size=%ld bytes\r\n",
+				&sniff_pcapng.filename.filename[2], sniff_pcapng.nb_packets,
+				sniff_pcapng.nb_dropped, sniff_pcapng.nb_bytes);
 			tprintf("Sniffed data were successfully processed and saved!\r\n");
 			/* All is OK Green LED bink */
 			for(i=0; i<4; i++) {
@@ -442,28 +447,6 @@ void sniff_log(void)
 	D5_OFF;
 }
 
-/* Save trace and return TRUE if sniff stopped by K4 or UBTN, else return FALSE/continue */
-__attribute__ ((always_inline)) static inline
-bool sniff_wait_data_change_or_exit(void)
-{
-	/* Wait until data change */
-	while (TRUE) {
-		u32_data = WaitGetDMABuffer();
-		/* Search for an edge/data */
-		if (old_u32_data != u32_data) {
-			break;
-		} else {
-			old_data_bit = (uint32_t)(u32_data&1);
-		}
-
-		if ( (K4_BUTTON) || (hydrabus_ubtn()) ) {
-			sniff_log();
-			return TRUE;
-		}
-	}
-	return FALSE;
-}
-
 /* Return TRUE/exit if sniff stopped by K4 or UBTN, else return FALSE/continue */
 __attribute__ ((always_inline)) static inline
 bool sniff_wait_data_change_or_exit_nolog(void)
@@ -657,18 +640,90 @@ void sniff_write_bin_8b(uint8_t data)
 	nfc_sniffer_index++;
 }
 
+static t_sniff_decoder_14443a sniff_decoder;
+
+__attribute__ ((always_inline)) static inline
+void sniff_write_frame_start(const t_sniff_decoder_frame *frame)
+{
+	switch(frame->detected) {
+	case MILLER_MODIFIED_106KHZ:
+		/* Miller Modified@~106Khz Start bit */
+		sniff_write_pcd();
+		break;
+
+	case MANCHESTER_106KHZ:
+		/* Manchester@~106Khz Start bit */
+		sniff_write_picc();
+		break;
+
+	default:
+		sniff_write_unknown_protocol(frame->sync_symbol);
+		break;
+	}
+}
+
+__attribute__ ((always_inline)) static inline
+void sniff_write_frame_data(const t_sniff_decoder_frame *frame)
+{
+	uint32_t i;
+	bool add_space;
+
+	for (i = 0; i < frame->nb_data; i++) {
+		/* Incomplete last byte is written without space */
+		add_space = (i + 1 < frame->nb_data) || (frame->last_nb_bit == 8);
+		/* Convert Hex to ASCII + Space */
+		sniff_write_8b_ASCII_HEX(frame->data[i], add_space);
+		/* For safety to avoid potential buffer overflow ... */
+		if (nfc_sniffer_index >= NB_SBUFFER) {
+			nfc_sniffer_index = NB_SBUFFER;
+		}
+	}
+}
+
+/* Write a decoded frame as an ISO_14443 link type packet */
+__attribute__ ((always_inline)) static inline
+void sniff_write_frame_pcapng(const t_sniff_decoder_frame *frame, uint64_t nb_cycles_start)
+{
+	uint8_t hdr[PCAPNG_ISO14443_HDR_SIZE];
+	t_pcapng_pkt_opts opts;
+
+	if (frame->nb_data == 0)
+		return;
+
+	/* Pseudo header: version, event, length (big endian) */
+	hdr[0] = 0;
+	hdr[2] = (frame->nb_data >> 8) & 0xFF;
+	hdr[3] = frame->nb_data & 0xFF;
+
+	opts.flags_errors = 0;
+	opts.rssi_valid = FALSE;
+	opts.rssi = 0;
+	opts.parity = frame->parity;
+	opts.parity_len = (frame->nb_data + 7) / 8;
+	if (frame->protocol == MANCHESTER_106KHZ) {
+		hdr[1] = PCAPNG_ISO14443_EVT_PICC_TO_PCD;
+		opts.direction = PCAPNG_DIR_INBOUND;
+	} else {
+		hdr[1] = PCAPNG_ISO14443_EVT_PCD_TO_PICC;
+		opts.direction = PCAPNG_DIR_OUTBOUND;
+	}
+	if (frame->detected == 0)
+		opts.flags_errors = PCAPNG_FLAG_ERR_SYMBOL;
+
+	pcapng_write_packet(&sniff_pcapng, sniff_pcapng_if, nb_cycles_start,
+			    hdr, sizeof(hdr), frame->data, frame->nb_data, &opts);
+}
+
 void hydranfc_sniff_14443A(t_hydra_console *con, bool start_of_frame, bool end_of_frame, bool sniff_trace_uart1, bool arg_sniff_pcap_output)
 {
 	(void)con;
-	uint8_t  ds_data, tmp_u8_data, tmp_u8_data_nb_bit;
-	uint32_t f_data, lsh_bit, rsh_bit;
-	uint32_t rsh_miller_bit, lsh_miller_bit;
-	uint32_t protocol_found, old_protocol_found; /* 0=Unknown, 1=106kb Miller Modified, 2=106kb Manchester */
-	uint32_t old_data_counter;
-	uint32_t nb_data;
+	const t_sniff_decoder_frame *frame;
+	uint32_t evt;
+	bool stop;
 	uint32_t uart_buf_pos;
 	uint32_t start_frame_cycles;
 	uint32_t total_frame_cycles;
+	uint64_t nb_cycles_start;
 #ifdef STAT_UART_WRITE
 	uint32_t uart_min;
 	uint32_t uart_max;
@@ -686,6 +741,22 @@ void hydranfc_sniff_14443A(t_hydra_console *con, bool start_of_frame, bool end_o
 	if(sniff_trace_uart1)
 		initUART1_sniff();
 
+	if (sniff_pcap_output) {
+		if (pcapng_create(&sniff_pcapng, &log_file, "nfc_sniff_",
+				  nfc_sniffer_buffer, NB_SBUFFER, STM32_HCLK) < 0) {
+			tprintf("pcapng file create error\r\n");
+			terminate_sniff_nfc();
+			pool_free(nfc_sniffer_buffer);
+			return;
+		}
+		/* SD card cannot be written with kernel locked, flush is done after frames */
+		sniff_pcapng.auto_flush = FALSE;
+		sniff_pcapng_if = pcapng_add_interface(&sniff_pcapng,
+						       PCAPNG_LINKTYPE_ISO_14443,
+						       0, "hydranfc");
+		tprintf("open_file %s\r\n", &sniff_pcapng.filename.filename[2]);
+	}
+
 	tprintf("Starting Sniffer ISO14443-A 106kbps ...\r\n");
 	/* Wait a bit in order to display all text */
 	chThdSleepMilliseconds(50);
@@ -695,337 +766,133 @@ void hydranfc_sniff_14443A(t_hydra_console *con, bool start_of_frame, bool end_o
 	uart_nb_loop = 0;
 #endif
 	uart_buf_pos = 0;
-	old_protocol_found = 0;
-	protocol_found = 0;
+	start_frame_cycles = 0;
+	total_frame_cycles = 0;
+	nb_cycles_start = 0;
 	nfc_sniffer_index = 0;
+	irq_no = 0;
+
+	sniff_decoder_14443a_init(&sniff_decoder);
+	frame = &sniff_decoder.frame;
 
 	/* Lock Kernel for sniffer */
 	chSysLock();
 
-	if (sniff_pcap_output)
-		sniff_write_pcap_global_header();
-
-	/* Main Loop */
-	while (TRUE) {
-		lsh_bit = 0;
-		rsh_bit = 0;
-		irq_no = 0;
-
-		while (TRUE) {
-			D4_OFF;
-			old_data_bit = 0;
-			f_data = 0;
-
-			uint32_t unknown = 0;
-			uint8_t pow = 0x7F;
-			uint32_t nb_cycles_start = 0;
-			uint32_t nb_cycles_end = 0;
-
-			nb_cycles_start = bsp_get_cyclecounter();
+	/* Main Loop, stopped by K4/UBTN */
+	stop = FALSE;
+	while (stop == FALSE) {
+		TST_OFF;
+		u32_data = WaitGetDMABuffer();
+		TST_ON;
 
-			u32_data = WaitGetDMABuffer();
-			old_data_bit = (uint32_t)(u32_data&1);
-			old_u32_data = u32_data;
+		if ( (K4_BUTTON) || (hydrabus_ubtn()) ) {
+			stop = TRUE;
+			evt = sniff_decoder_14443a_stop(&sniff_decoder);
+		} else {
+			evt = sniff_decoder_14443a_push(&sniff_decoder, u32_data);
+		}
 
-			/* Wait until data change or K4/UBTN is pressed to stop/exit */
-			if (sniff_wait_data_change_or_exit() == TRUE) {
-#ifdef STAT_UART_WRITE
-				tprintf("\r\nuart_nb_loop=%u uart_min=%u uart_max=%u\r\n", uart_nb_loop, uart_min, uart_max);
-#endif
-				/* Wait a bit in order to display all text */
-				chThdSleepMilliseconds(50);
-				if(sniff_trace_uart1)
-					deinitUART1_sniff();
-				pool_free(nfc_sniffer_buffer);
-				return;
-			}
+		/* 2^20 words (~10s) < 2^32 cycles (~25s) so 64bits counter does not wrap */
+		if ((sniff_decoder.nb_words & 0xFFFFF) == 0)
+			bsp_get_cyclecounter64I();
 
+		if (evt == SNIFF_DECODER_EVT_FRAME_START) {
 			/* Log All Data */
-			TST_ON;
 			D4_ON;
-			tmp_u8_data = 0;
-			tmp_u8_data_nb_bit = 0;
-
-			/* Search first edge bit position to synchronize stream */
-			/* Search an edge on each bit from MSB to LSB */
-			/* Old bit = 1 so new bit will be 0 => 11111111 10000000 => 00000000 01111111 just need to reverse it to count leading zero */
-			/* Old bit = 0 so new bit will be 1 => 00000000 01111111 no need to reverse to count leading zero */
-			lsh_bit = old_data_bit ? (~u32_data) : u32_data;
-			lsh_bit = CountLeadingZero(lsh_bit);
-			rsh_bit = 32-lsh_bit;
-
-			rsh_miller_bit = 0;
-			lsh_miller_bit = 32-rsh_miller_bit;
-
-			/* Shift data */
-			f_data = u32_data<<lsh_bit;
-			/* Next Data */
-			TST_OFF;
-			u32_data = WaitGetDMABuffer();
-			if(start_of_frame == true)
-				start_frame_cycles = bsp_get_cyclecounter();
-			TST_ON;
-			f_data |= u32_data>>rsh_bit;
-
-			/* Todo: Better algorithm to recognize frequency using table and counting number of edge ...
-			              and finaly use majority voting for frequency */
-			// DownSampling by 4 (input 32bits output 8bits filtered)
-			// In Freq of 3.39MHz => 105.9375KHz on 8bits (each bit is 848KHz so 2bits=423.75KHz)
-			ds_data  = ((downsample_4x[(f_data>>24)])<<6) |
-				   ((downsample_4x[((f_data&0x00FF0000)>>16)])<<4) |
-				   ((downsample_4x[((f_data&0x0000FF00)>>8)])<<2) |
-				   (downsample_4x[(f_data&0x000000FF)]);
-
-			/* Todo: Find frequency by counting number of consecutive "1" & "0" or the reverse.
-			 * Example0: 1x"1" then 1x"0" => 3.39MHz/2 = Freq 1695KHz
-			 * Example1: 2x"1" then 2x"0" => 3.39MHz/4 = Freq 847.5KHz
-			 * Example2: 4x"1" then 4x"0" => 3.39MHz/8 = Freq 423.75KHz
-			 * Example3: 8x"1" then 8x"0" (8+8) => 3.39MHz/16 = Freq 211.875KHz
-			 * Example4: 16x"1" then 16x"0" (16+16) => 3.39MHz/32 = Freq 105.9375KHz
-			 * Example Miller Modified '0' @~106Khz: 00000000 00111111 11111111 11111111 => 10x"0" then 22x"1" (10+22=32) => 3.39MHz/32 = Freq 105.9375KHz
-			 **/
-			protocol_found = detected_protocol[ds_data];
-			switch(protocol_found) {
-			case MILLER_MODIFIED_106KHZ:
-				/* Miller Modified@~106Khz Start bit */
-				old_protocol_found = MILLER_MODIFIED_106KHZ;
-				if (!sniff_pcap_output)
-					sniff_write_pcd();
-				break;
-
-			case MANCHESTER_106KHZ:
-				/* Manchester@~106Khz Start bit */
-				old_protocol_found = MANCHESTER_106KHZ;
-				if (!sniff_pcap_output)
-					sniff_write_picc();
-				break;
-
-			default:
-				/* If previous protocol was Manchester now it should be Miller Modified
-				  (it is a supposition and because Miller modified start after manchester)
-				*/
-				if ( MANCHESTER_106KHZ == old_protocol_found ) {
-					old_protocol_found = MILLER_MODIFIED_106KHZ;
-					protocol_found = MILLER_MODIFIED_106KHZ;
-					/* RE Synchronize bit stream to start of bit from (00000000) 11111111 to 00111111 (2 to 3 us at level 0 are not seen) */
-					/* Nota only first Miller Modified Word does not need this hack because it is well detected it start with (11111111) 00111111  */
-					// New Word
-					rsh_miller_bit = 15; /* Between 2 to 3.1us => 7 to 11bits => Average 9bits + 6bits(margin) =< 32-15 = 17 bit */
-					lsh_miller_bit = 32-rsh_miller_bit;
-					if (!sniff_pcap_output)
-						sniff_write_pcd();
-					/* Start Bit not included in data buffer */
-				} else {
-					old_protocol_found = MILLER_MODIFIED_106KHZ;
-					protocol_found = MILLER_MODIFIED_106KHZ;
-					/* RE Synchronize bit stream to start of bit from (00000000) 11111111 to 00111111 (2 to 3 us at level 0 are not seen) */
-					/* Nota only first Miller Modified Word does not need this hack because it is well detected it start with (11111111) 00111111  */
-					// New Word
-					rsh_miller_bit = 15; /* Between 2 to 3.1us => 7 to 11bits => Average 9bits + 6bits(margin) =< 32-15 = 17 bit */
-					lsh_miller_bit = 32-rsh_miller_bit;
-					if (!sniff_pcap_output)
-						sniff_write_unknown_protocol(ds_data);
-				}
-				break;
-			}
-
-			/* Decode Data until end of frame detected */
-			old_u32_data = f_data;
-			old_data_counter = 0;
-			nb_data = 0;
-			while (1) {
-				if ( (K4_BUTTON) || (hydrabus_ubtn()) ) {
-					if(end_of_frame == true)
-						total_frame_cycles = bsp_get_cyclecounter() - start_frame_cycles;
-					break;
-				}
-
-				/* New Word */
-				f_data = u32_data<<lsh_bit;
-
-				/* Next Data */
-				TST_OFF;
-				u32_data = WaitGetDMABuffer();
-				TST_ON;
-
-				f_data |= u32_data>>rsh_bit;
-
-				/* In New Data 32bits */
-				if (u32_data != old_u32_data) {
-					old_u32_data = u32_data;
-					old_data_counter = 0;
-				} else {
-					old_u32_data = u32_data;
-					/* No new data */
-					if ( (u32_data==0xFFFFFFFF) || (u32_data==0x00000000) ) {
-						old_data_counter++;
-						if (old_data_counter>1) {
-							/* No new data => End Of Frame detected => Wait new data & synchro */
-							if(end_of_frame == true)
-								total_frame_cycles = bsp_get_cyclecounter() - start_frame_cycles;
-							break;
-						}
-					} else {
-						old_data_counter = 0;
-					}
-				}
-
-				f_data = (f_data>>rsh_miller_bit)|(0xFFFFFFFF<<lsh_miller_bit);
-				// DownSampling by 4 (input 32bits output 8bits filtered)
-				// In Freq of 3.39MHz => 105.9375KHz on 8bits (each bit is 848KHz so 2bits=423.75KHz)
-				ds_data  = ((downsample_4x[(f_data>>24)])<<6) |
-					   ((downsample_4x[((f_data&0x00FF0000)>>16)])<<4) |
-					   ((downsample_4x[((f_data&0x0000FF00)>>8)])<<2) |
-					   (downsample_4x[(f_data&0x000000FF)]);
-
-				switch(protocol_found) {
-				case MILLER_MODIFIED_106KHZ:
-					if (tmp_u8_data_nb_bit < 8) {
-						tmp_u8_data |= (miller_modified_106kb[ds_data])<<tmp_u8_data_nb_bit;
-						tmp_u8_data_nb_bit++;
-					} else {
-						nb_data++;
-						tmp_u8_data_nb_bit=0;
-						/* Convert Hex to ASCII + Space */
-						if (!sniff_pcap_output)
-							sniff_write_8b_ASCII_HEX(tmp_u8_data, TRUE);
-						else
-							sniff_write_pcap_data(tmp_u8_data);
-
-						tmp_u8_data=0; /* Parity bit discarded */
-					}
-					break;
+			nb_cycles_start = bsp_get_cyclecounter64I();
+			start_frame_cycles = (uint32_t)nb_cycles_start;
+			if (!sniff_pcap_output)
+				sniff_write_frame_start(frame);
+			continue;
+		}
 
-				case MANCHESTER_106KHZ:
-					if (tmp_u8_data_nb_bit < 8) {
-						tmp_u8_data |= (manchester_106kb[ds_data])<<tmp_u8_data_nb_bit;
-						tmp_u8_data_nb_bit++;
-					} else {
-						nb_data++;
-						tmp_u8_data_nb_bit=0;
-						/* Convert Hex to ASCII + Space */
-						if (!sniff_pcap_output)
-							sniff_write_8b_ASCII_HEX(tmp_u8_data, TRUE);
-						else
-							sniff_write_pcap_data(tmp_u8_data);
-
-						tmp_u8_data=0; /* Parity bit discarded */
-					}
-					break;
+		if (evt != SNIFF_DECODER_EVT_FRAME_END)
+			continue;
 
-				default:
-					nb_data++;
-					/* Unknown protocol */
-					/* Convert Hex to ASCII */
-					if (!sniff_pcap_output)
-						sniff_write_8b_ASCII_HEX(ds_data, FALSE);
-					else {
-						unknown = 1;
-						sniff_write_pcap_data(tmp_u8_data);
-					}
-					break;
-				}
-				/* For safety to avoid potential buffer overflow ... */
-				if (nfc_sniffer_index >= NB_SBUFFER) {
-					nfc_sniffer_index = NB_SBUFFER;
-				}
-			}
+		/* End of Frame */
+		if(end_of_frame == true)
+			total_frame_cycles = bsp_get_cyclecounter() - start_frame_cycles;
 
-			/* End of Frame detected check if incomplete byte (at least 4bit) is present to write it as output */
-			if (tmp_u8_data_nb_bit>3) {
-					nb_data++;
-					/* Convert Hex to ASCII + Space */
-					if (!sniff_pcap_output)
-						sniff_write_8b_ASCII_HEX(tmp_u8_data, FALSE);
-					else
-						sniff_write_pcap_data(tmp_u8_data);
+		if (sniff_pcap_output) {
+			sniff_write_frame_pcapng(frame, nb_cycles_start);
+			/* Flush when half full (samples are lost during SD card write) */
+			if (pcapng_buffer_level(&sniff_pcapng) > (NB_SBUFFER / 2)) {
+				chSysUnlock();
+				pcapng_flush(&sniff_pcapng);
+				chSysLock();
 			}
+			D4_OFF;
+			TST_OFF;
+			continue;
+		}
 
-			nb_cycles_end = bsp_get_cyclecounter();
+		sniff_write_frame_data(frame);
 
-			if (!sniff_pcap_output)
-				if(end_of_frame == true)
-					sniff_write_frameduration(total_frame_cycles);
+		if(end_of_frame == true)
+			sniff_write_frameduration(total_frame_cycles);
 
-			if(sniff_trace_uart1)
-			{
-				uint32_t uart_buf_size;
-				uart_buf_size = (nfc_sniffer_index - uart_buf_pos);
-				if (uart_buf_size > 0) {
+		if(sniff_trace_uart1)
+		{
+			uint32_t uart_buf_size;
+			uart_buf_size = (nfc_sniffer_index - uart_buf_pos);
+			if (uart_buf_size > 0) {
 #ifdef STAT_UART_WRITE
-					uint32_t ticks;
-					ticks = bsp_get_cyclecounter();
+				uint32_t ticks;
+				ticks = bsp_get_cyclecounter();
 #endif
-					bsp_uart_write_u8(BSP_DEV_UART1, &nfc_sniffer_buffer[uart_buf_pos], uart_buf_size);
-					uart_buf_pos = nfc_sniffer_index;
+				bsp_uart_write_u8(BSP_DEV_UART1, &nfc_sniffer_buffer[uart_buf_pos], uart_buf_size);
+				uart_buf_pos = nfc_sniffer_index;
 #ifdef STAT_UART_WRITE
-					ticks = (bsp_get_cyclecounter() - ticks);
-					uart_nb_loop++;
+				ticks = (bsp_get_cyclecounter() - ticks);
+				uart_nb_loop++;
 
-					if(ticks < uart_min)
-						uart_min = ticks;
+				if(ticks < uart_min)
+					uart_min = ticks;
 
-					if(ticks > uart_max)
-						uart_max = ticks;
+				if(ticks > uart_max)
+					uart_max = ticks;
 #endif
-				}
-				/* For safety to avoid buffer overflow and restart buffer */
-				if (nfc_sniffer_index >= NB_SBUFFER) {
-					nfc_sniffer_index = 0;
-					uart_buf_pos = 0;
-				}
-			}else
-			{
-				/* For safety to avoid buffer overflow */
-				if (nfc_sniffer_index >= NB_SBUFFER) {
-					nfc_sniffer_index = NB_SBUFFER;
-				}
 			}
-
-			if (sniff_pcap_output) {
-				sniff_write_pcap_packet_header(nb_cycles_start);
-
-				if (unknown == 1)
-					sniff_write_data_header(pow, 3, 1,
-							nb_cycles_end, 0);
-				else
-					sniff_write_data_header(pow, protocol_found, 1,
-							nb_cycles_end, 0);
-
-				uint32_t y = 0;
-
-				do {
-					uint32_t i;
-					i = nfc_sniffer_index;
-
-					nfc_sniffer_buffer[i + 0] = fbuff[y];
-					nfc_sniffer_index += 1;
-					y++;
-				} while (y < tmp_sniffer_get_size());
-
-				tmp_sbuf_idx = 0;
+			/* For safety to avoid buffer overflow and restart buffer */
+			if (nfc_sniffer_index >= NB_SBUFFER) {
+				nfc_sniffer_index = 0;
+				uart_buf_pos = 0;
+			}
+		}else
+		{
+			/* For safety to avoid buffer overflow */
+			if (nfc_sniffer_index >= NB_SBUFFER) {
+				nfc_sniffer_index = NB_SBUFFER;
 			}
-
-			TST_OFF;
 		}
+		D4_OFF;
+		TST_OFF;
 	} // Main While Loop
+
+	sniff_log();
+#ifdef STAT_UART_WRITE
+	tprintf("\r\nuart_nb_loop=%u uart_min=%u uart_max=%u\r\n", uart_nb_loop, uart_min, uart_max);
+#endif
+	/* Wait a bit in order to display all text */
+	chThdSleepMilliseconds(50);
+	if(sniff_trace_uart1)
+		deinitUART1_sniff();
+	pool_free(nfc_sniffer_buffer);
 }
 
 void hydranfc_sniff_14443A_bin(t_hydra_console *con, bool start_of_frame, bool end_of_frame, bool parity)
 {
 	(void)con;
 	sniff_14443a_bin_frame_header_t bin_frame_hdr;
-	uint8_t  ds_data, tmp_u8_data, tmp_u8_data_nb_bit;
-	uint32_t f_data, lsh_bit, rsh_bit;
-	uint32_t rsh_miller_bit, lsh_miller_bit;
-	uint32_t protocol_found, old_protocol_found; /* 0=Unknown, 1=106kb Miller Modified, 2=106kb Manchester */
-	uint32_t old_data_counter;
+	const t_sniff_decoder_frame *frame;
+	uint32_t evt;
+	bool stop;
+	uint32_t i;
 #ifdef STAT_UART_WRITE
 	uint32_t uart_min;
 	uint32_t uart_max;
 	uint32_t uart_nb_loop;
 #endif
-	uint32_t nb_data;
 	uint32_t end_of_frame_cycles;
 
 	tprintf("sniff_14443A_bin start\r\n");
@@ -1042,8 +909,7 @@ void hydranfc_sniff_14443A_bin(t_hydra_console *con, bool start_of_frame, bool e
 	uart_max = 0;
 	uart_nb_loop = 0;
 #endif
-	old_protocol_found = 0;
-	protocol_found = 0;
+	irq_no = 0;
 
 	bin_frame_hdr.protocol_options = 0;
 	if(start_of_frame == true)
@@ -1053,254 +919,92 @@ void hydranfc_sniff_14443A_bin(t_hydra_console *con, bool start_of_frame, bool e
 	if(parity == true)
 		bin_frame_hdr.protocol_options |= PROTOCOL_OPTIONS_PARITY;
 
+	sniff_decoder_14443a_init(&sniff_decoder);
+	frame = &sniff_decoder.frame;
+
 	/* Lock Kernel for sniffer */
 	chSysLock();
 
-	/* Main Loop */
-	while (TRUE) {
-		lsh_bit = 0;
-		rsh_bit = 0;
-		irq_no = 0;
-
-		while (TRUE) {
-			/* Start of Frame Loop */
-			D4_OFF;
-			old_data_bit = 0;
-			f_data = 0;
-			nfc_sniffer_index = sizeof(bin_frame_hdr);
-
-			u32_data = WaitGetDMABuffer();
-			old_data_bit = (uint32_t)(u32_data&1);
-			old_u32_data = u32_data;
+	/* Main Loop, stopped by K4/UBTN */
+	stop = FALSE;
+	while (stop == FALSE) {
+		TST_OFF;
+		u32_data = WaitGetDMABuffer();
+		TST_ON;
 
-			/* Wait until data change or K4/UBTN is pressed to stop/exit */
-			if (sniff_wait_data_change_or_exit_nolog() == TRUE) {
-#ifdef STAT_UART_WRITE
-				tprintf("\r\nuart_nb_loop=%u uart_min=%u uart_max=%u\r\n", uart_nb_loop, uart_min, uart_max);
-#endif
-				/* Wait a bit in order to display all text */
-				chThdSleepMilliseconds(50);
-				deinitUART1_sniff();
-				pool_free(nfc_sniffer_buffer);
-				return;
-			}
+		if ( (K4_BUTTON) || (hydrabus_ubtn()) ) {
+			stop = TRUE;
+			evt = sniff_decoder_14443a_stop(&sniff_decoder);
+		} else {
+			evt = sniff_decoder_14443a_push(&sniff_decoder, u32_data);
+		}
 
-			/* Log All Data */
-			TST_ON;
+		if (evt == SNIFF_DECODER_EVT_FRAME_START) {
+			/* Start of Frame */
 			D4_ON;
-			tmp_u8_data = 0;
-			tmp_u8_data_nb_bit = 0;
-
-			/* Search first edge bit position to synchronize stream */
-			/* Search an edge on each bit from MSB to LSB */
-			/* Old bit = 1 so new bit will be 0 => 11111111 10000000 => 00000000 01111111 just need to reverse it to count leading zero */
-			/* Old bit = 0 so new bit will be 1 => 00000000 01111111 no need to reverse to count leading zero */
-			lsh_bit = old_data_bit ? (~u32_data) : u32_data;
-			lsh_bit = CountLeadingZero(lsh_bit);
-			rsh_bit = 32-lsh_bit;
-
-			rsh_miller_bit = 0;
-			lsh_miller_bit = 32-rsh_miller_bit;
-
-			/* Shift data */
-			f_data = u32_data<<lsh_bit;
-			/* Next Data */
-			TST_OFF;
-			u32_data = WaitGetDMABuffer();
+			nfc_sniffer_index = sizeof(bin_frame_hdr);
 			if(start_of_frame == true)
 				sniff_write_bin_timestamp(bsp_get_cyclecounter());
-			TST_ON;
-			f_data |= u32_data>>rsh_bit;
-
-			/* Todo: Better algorithm to recognize frequency using table and counting number of edge ...
-			              and finaly use majority voting for frequency */
-			// DownSampling by 4 (input 32bits output 8bits filtered)
-			// In Freq of 3.39MHz => 105.9375KHz on 8bits (each bit is 848KHz so 2bits=423.75KHz)
-			ds_data  = ((downsample_4x[(f_data>>24)])<<6) |
-				   ((downsample_4x[((f_data&0x00FF0000)>>16)])<<4) |
-				   ((downsample_4x[((f_data&0x0000FF00)>>8)])<<2) |
-				   (downsample_4x[(f_data&0x000000FF)]);
-
-			/* Todo: Find frequency by counting number of consecutive "1" & "0" or the reverse.
-			 * Example0: 1x"1" then 1x"0" => 3.39MHz/2 = Freq 1695KHz
-			 * Example1: 2x"1" then 2x"0" => 3.39MHz/4 = Freq 847.5KHz
-			 * Example2: 4x"1" then 4x"0" => 3.39MHz/8 = Freq 423.75KHz
-			 * Example3: 8x"1" then 8x"0" (8+8) => 3.39MHz/16 = Freq 211.875KHz
-			 * Example4: 16x"1" then 16x"0" (16+16) => 3.39MHz/32 = Freq 105.9375KHz
-			 * Example Miller Modified '0' @~106Khz: 00000000 00111111 11111111 11111111 => 10x"0" then 22x"1" (10+22=32) => 3.39MHz/32 = Freq 105.9375KHz
-			 */
-			protocol_found = detected_protocol[ds_data];
-			switch(protocol_found) {
-			case MILLER_MODIFIED_106KHZ:
-				/* Miller Modified@~106Khz Start bit */
-				old_protocol_found = MILLER_MODIFIED_106KHZ;
-				bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MILLER_MODIFIED_106KBPS;
-				break;
-
-			case MANCHESTER_106KHZ:
-				/* Manchester@~106Khz Start bit */
-				old_protocol_found = MANCHESTER_106KHZ;
-				bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MANCHESTER_106KBPS;
-				break;
-
-			default:
-				/* If previous protocol was Manchester now it should be Miller Modified
-				  (it is a supposition and because Miller modified start after manchester)
-				*/
-				if ( MANCHESTER_106KHZ == old_protocol_found ) {
-					old_protocol_found = MILLER_MODIFIED_106KHZ;
-					protocol_found = MILLER_MODIFIED_106KHZ;
-				  bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MILLER_MODIFIED_106KBPS;
-					/* RE Synchronize bit stream to start of bit from (00000000) 11111111 to 00111111 (2 to 3 us at level 0 are not seen) */
-					/* Nota only first Miller Modified Word does not need this hack because it is well detected it start with (11111111) 00111111  */
-					// New Word
-					rsh_miller_bit = 15; /* Between 2 to 3.1us => 7 to 11bits => Average 9bits + 6bits(margin) =< 32-15 = 17 bit */
-					lsh_miller_bit = 32-rsh_miller_bit;
-					/* Start Bit not included in data buffer */
-				} else {
-					old_protocol_found = MILLER_MODIFIED_106KHZ;
-					protocol_found = MILLER_MODIFIED_106KHZ;
-				  bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MILLER_MODIFIED_106KBPS;
-					/* RE Synchronize bit stream to start of bit from (00000000) 11111111 to 00111111 (2 to 3 us at level 0 are not seen) */
-					/* Nota only first Miller Modified Word does not need this hack because it is well detected it start with (11111111) 00111111  */
-					// New Word
-					rsh_miller_bit = 15; /* Between 2 to 3.1us => 7 to 11bits => Average 9bits + 6bits(margin) =< 32-15 = 17 bit */
-					lsh_miller_bit = 32-rsh_miller_bit;
-					//sniff_write_unknown_protocol(ds_data);
-				}
-				break;
-			}
-
-			/* Decode Data until end of frame detected */
-			old_u32_data = f_data;
-			old_data_counter = 0;
-			nb_data = 0;
-			while (1) {
-				if ( (K4_BUTTON) || (hydrabus_ubtn()) ) {
-					if(end_of_frame == true)
-						end_of_frame_cycles = bsp_get_cyclecounter();
-					break;
-				}
-
-				/* New Word */
-				f_data = u32_data<<lsh_bit;
-
-				/* Next Data */
-				TST_OFF;
-				u32_data = WaitGetDMABuffer();
-				TST_ON;
-
-				f_data |= u32_data>>rsh_bit;
-
-				/* In New Data 32bits */
-				if (u32_data != old_u32_data) {
-					old_u32_data = u32_data;
-					old_data_counter = 0;
-				} else {
-					old_u32_data = u32_data;
-					/* No new data */
-					if ( (u32_data==0xFFFFFFFF) || (u32_data==0x00000000) ) {
-						old_data_counter++;
-						if (old_data_counter>1) {
-							/* No new data => End Of Frame detected => Wait new data & synchro */
-							if(end_of_frame == true)
-								end_of_frame_cycles = bsp_get_cyclecounter();
-							break;
-						}
-					} else {
-						old_data_counter = 0;
-					}
-				}
-
-				f_data = (f_data>>rsh_miller_bit)|(0xFFFFFFFF<<lsh_miller_bit);
-				// DownSampling by 4 (input 32bits output 8bits filtered)
-				// In Freq of 3.39MHz => 105.9375KHz on 8bits (each bit is 848KHz so 2bits=423.75KHz)
-				ds_data  = ((downsample_4x[(f_data>>24)])<<6) |
-					   ((downsample_4x[((f_data&0x00FF0000)>>16)])<<4) |
-					   ((downsample_4x[((f_data&0x0000FF00)>>8)])<<2) |
-					   (downsample_4x[(f_data&0x000000FF)]);
-
-				switch(protocol_found) {
-				case MILLER_MODIFIED_106KHZ:
-					if (tmp_u8_data_nb_bit < 8) {
-						tmp_u8_data |= (miller_modified_106kb[ds_data])<<tmp_u8_data_nb_bit;
-						tmp_u8_data_nb_bit++;
-					} else {
-						bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MILLER_MODIFIED_106KBPS;
-						nb_data++;
-						tmp_u8_data_nb_bit=0;
-						/* Write 8bits Data */
-						sniff_write_bin_8b(tmp_u8_data);
-						/* Write Parity */
-						if(parity == true)
-							sniff_write_bin_8b(miller_modified_106kb[ds_data]);
-
-						tmp_u8_data=0; /* Parity bit discarded */
-					}
-					break;
-
-				case MANCHESTER_106KHZ:
-					if (tmp_u8_data_nb_bit < 8) {
-						tmp_u8_data |= (manchester_106kb[ds_data])<<tmp_u8_data_nb_bit;
-						tmp_u8_data_nb_bit++;
-					} else {
-						bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MANCHESTER_106KBPS;
-						nb_data++;
-						tmp_u8_data_nb_bit=0;
-						/* Write 8bits Data */
-						sniff_write_bin_8b(tmp_u8_data);
-						/* Write Parity */
-						if(parity == true)
-							sniff_write_bin_8b(manchester_106kb[ds_data]);
-
-						tmp_u8_data=0; /* Parity bit discarded */
-					}
-					break;
+			continue;
+		}
 
-				default:
-					bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_UNKNOWN;
-					nb_data++;
-					/* Unknown protocol */
-					/* Write 8bits Data */
-					sniff_write_bin_8b(ds_data);
-					break;
-				}
-				/* For safety to avoid potential buffer overflow ... */
-				if (nfc_sniffer_index >= NB_SBUFFER) {
-					nfc_sniffer_index = NB_SBUFFER;
-				}
-			}
-			/* End of Frame detected check if incomplete byte (at least 4bit) is present to write it as output */
-			if (tmp_u8_data_nb_bit>3) {
-					nb_data++;
-					/* Write 8bits Data */
-					sniff_write_bin_8b(tmp_u8_data);
-			}
-			if(end_of_frame == true)
-				sniff_write_bin_timestamp(end_of_frame_cycles);
+		if (evt != SNIFF_DECODER_EVT_FRAME_END)
+			continue;
+
+		/* End of Frame */
+		if(end_of_frame == true)
+			end_of_frame_cycles = bsp_get_cyclecounter();
+
+		if (frame->protocol == MANCHESTER_106KHZ)
+			bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MANCHESTER_106KBPS;
+		else
+			bin_frame_hdr.protocol_modulation = PROTOCOL_MODULATION_TYPEA_MILLER_MODIFIED_106KBPS;
+
+		for (i = 0; i < frame->nb_data; i++) {
+			/* Write 8bits Data */
+			sniff_write_bin_8b(frame->data[i]);
+			/* Write Parity (not available for incomplete last byte) */
+			if ((parity == true) &&
+			    ((i + 1 < frame->nb_data) || (frame->last_nb_bit == 8)))
+				sniff_write_bin_8b(sniff_decoder_parity(frame, i));
+		}
+		if(end_of_frame == true)
+			sniff_write_bin_timestamp(end_of_frame_cycles);
 
-			if ((nb_data > 0) && (nfc_sniffer_index >  sizeof(bin_frame_hdr))) {
+		if ((frame->nb_data > 0) && (nfc_sniffer_index >  sizeof(bin_frame_hdr))) {
 #ifdef STAT_UART_WRITE
-				uint32_t ticks;
-				ticks = bsp_get_cyclecounter();
+			uint32_t ticks;
+			ticks = bsp_get_cyclecounter();
 #endif
-				bin_frame_hdr.data_size = nfc_sniffer_index;
-				memcpy(&nfc_sniffer_buffer[0], (uint8_t*)&bin_frame_hdr, sizeof(bin_frame_hdr));
-				bsp_uart_write_u8(BSP_DEV_UART1, &nfc_sniffer_buffer[0], nfc_sniffer_index);
+			bin_frame_hdr.data_size = nfc_sniffer_index;
+			memcpy(&nfc_sniffer_buffer[0], (uint8_t*)&bin_frame_hdr, sizeof(bin_frame_hdr));
+			bsp_uart_write_u8(BSP_DEV_UART1, &nfc_sniffer_buffer[0], nfc_sniffer_index);
 #ifdef STAT_UART_WRITE
-				ticks = (bsp_get_cyclecounter() - ticks);
-				uart_nb_loop++;
+			ticks = (bsp_get_cyclecounter() - ticks);
+			uart_nb_loop++;
 
-				if(ticks < uart_min)
-					uart_min = ticks;
+			if(ticks < uart_min)
+				uart_min = ticks;
 
-				if(ticks > uart_max)
-					uart_max = ticks;
+			if(ticks > uart_max)
+				uart_max = ticks;
 #endif
-			}
-			TST_OFF;
 		}
+		D4_OFF;
+		TST_OFF;
 	} // Main While Loop
+
+	chSysUnlock();
+	terminate_sniff_nfc();
+	D4_OFF;
+	D5_OFF;
+#ifdef STAT_UART_WRITE
+	tprintf("\r\nuart_nb_loop=%u uart_min=%u uart_max=%u\r\n", uart_nb_loop, uart_min, uart_max);
+#endif
+	/* Wait a bit in order to display all text */
+	chThdSleepMilliseconds(50);
+	deinitUART1_sniff();
+	pool_free(nfc_sniffer_buffer);
 }
 
 /* Special raw data sniffer for ISO14443 TypeA or TypeB @106kbps with:
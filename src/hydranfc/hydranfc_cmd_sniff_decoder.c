@@ -0,0 +1,254 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h> /* memset */
+
+#include "hydranfc_cmd_sniff_decoder.h"
+#include "hydranfc_cmd_sniff_iso14443.h"
+#include "hydranfc_cmd_sniff_downsampling.h"
+#include "hot_path.h"
+
+/*
+ * sniff_decoder_symbol[] merges the per symbol tables in one lookup:
+ *  BIT0-1 detected_protocol[]
+ *  BIT2 miller_modified_106kb[]
+ *  BIT3 manchester_106kb[]
+ */
+#define SYMBOL_PROTOCOL_MASK (0x03)
+#define SYMBOL_MILLER_SHIFT (2)
+#define SYMBOL_MANCHESTER_SHIFT (3)
+
+static u08_t sniff_decoder_symbol[256] HOT_DATA;
+
+/* Shifts by 32 give 0 like ARM register shifts (undefined in C) */
+#define LSL32(x, n) (((n) < 32) ? ((x) << (n)) : 0)
+#define LSR32(x, n) (((n) < 32) ? ((x) >> (n)) : 0)
+
+static inline uint32_t count_leading_zero(uint32_t x)
+{
+	return x ? (uint32_t)__builtin_clz(x) : 32;
+}
+
+/*
+ * DownSampling by 4 (input 32bits output 8bits filtered)
+ * In Freq of 3.39MHz => 105.9375KHz on 8bits (each bit is 848KHz so 2bits=423.75KHz)
+ */
+static inline u08_t downsample_4x_u32(uint32_t f_data)
+{
+	return ((downsample_4x[(f_data >> 24)]) << 6) |
+	       ((downsample_4x[((f_data & 0x00FF0000) >> 16)]) << 4) |
+	       ((downsample_4x[((f_data & 0x0000FF00) >> 8)]) << 2) |
+	       (downsample_4x[(f_data & 0x000000FF)]);
+}
+
+void sniff_decoder_14443a_init(t_sniff_decoder_14443a *dec)
+{
+	uint32_t i;
+
+	for (i = 0; i < 256; i++) {
+		sniff_decoder_symbol[i] = (detected_protocol[i] & SYMBOL_PROTOCOL_MASK) |
+					  ((miller_modified_106kb[i] & 1) << SYMBOL_MILLER_SHIFT) |
+					  ((manchester_106kb[i] & 1) << SYMBOL_MANCHESTER_SHIFT);
+	}
+
+	memset(dec, 0, sizeof(t_sniff_decoder_14443a));
+	dec->state = SNIFF_DECODER_STATE_WAIT_REF;
+}
+
+static uint32_t sniff_decoder_14443a_end_frame(t_sniff_decoder_14443a *dec)
+{
+	t_sniff_decoder_frame *frame = &dec->frame;
+
+	frame->last_nb_bit = 8;
+	/* Check if incomplete byte (at least 4bit) is present */
+	if (dec->tmp_u8_data_nb_bit > 3) {
+		if (frame->nb_data < SNIFF_DECODER_FRAME_MAX) {
+			frame->data[frame->nb_data++] = dec->tmp_u8_data;
+			frame->last_nb_bit = dec->tmp_u8_data_nb_bit;
+		} else {
+			frame->nb_data_lost++;
+		}
+	}
+	frame->end_word = dec->nb_words - 1;
+	dec->state = SNIFF_DECODER_STATE_WAIT_REF;
+
+	return SNIFF_DECODER_EVT_FRAME_END;
+}
+
+static void sniff_decoder_14443a_sync(t_sniff_decoder_14443a *dec, uint32_t f_data)
+{
+	t_sniff_decoder_frame *frame = &dec->frame;
+	u08_t ds_data;
+
+	ds_data = downsample_4x_u32(f_data);
+
+	frame->sync_symbol = ds_data;
+	frame->detected = sniff_decoder_symbol[ds_data] & SYMBOL_PROTOCOL_MASK;
+	frame->nb_data = 0;
+	frame->nb_data_lost = 0;
+	frame->start_word = dec->nb_words - 2; /* Edge word */
+	memset(frame->parity, 0, sizeof(frame->parity));
+
+	dec->rsh_miller_bit = 0;
+	dec->lsh_miller_bit = 32;
+
+	switch (frame->detected) {
+	case MILLER_MODIFIED_106KHZ:
+	case MANCHESTER_106KHZ:
+		frame->protocol = frame->detected;
+		break;
+
+	default:
+		/* If previous protocol was Manchester now it should be Miller Modified
+		  (it is a supposition and because Miller modified start after manchester)
+		*/
+		if (dec->old_protocol == MANCHESTER_106KHZ)
+			frame->detected = MILLER_MODIFIED_106KHZ;
+		frame->protocol = MILLER_MODIFIED_106KHZ;
+		/* RE Synchronize bit stream to start of bit from (00000000) 11111111 to 00111111 (2 to 3 us at level 0 are not seen) */
+		/* Nota only first Miller Modified Word does not need this hack because it is well detected it start with (11111111) 00111111  */
+		dec->rsh_miller_bit = 15; /* Between 2 to 3.1us => 7 to 11bits => Average 9bits + 6bits(margin) =< 32-15 = 17 bit */
+		dec->lsh_miller_bit = 32 - dec->rsh_miller_bit;
+		break;
+	}
+	dec->old_protocol = frame->protocol;
+	dec->symbol_shift = (frame->protocol == MANCHESTER_106KHZ) ?
+			    SYMBOL_MANCHESTER_SHIFT : SYMBOL_MILLER_SHIFT;
+
+	dec->old_u32_data = f_data;
+	dec->old_data_counter = 0;
+	dec->tmp_u8_data = 0;
+	dec->tmp_u8_data_nb_bit = 0;
+}
+
+/*
+ * Push next raw word, return SNIFF_DECODER_EVT_xxx.
+ * dec->frame is valid until next push after SNIFF_DECODER_EVT_FRAME_END.
+ */
+HOT_FUNC
+uint32_t sniff_decoder_14443a_push(t_sniff_decoder_14443a *dec, uint32_t u32_data)
+{
+	t_sniff_decoder_frame *frame;
+	uint32_t f_data;
+	u08_t bit;
+
+	dec->nb_words++;
+
+	switch (dec->state) {
+	case SNIFF_DECODER_STATE_DATA:
+		f_data = LSL32(dec->prev_u32_data, dec->lsh_bit) | LSR32(u32_data, dec->rsh_bit);
+		dec->prev_u32_data = u32_data;
+
+		/* In New Data 32bits */
+		if (u32_data != dec->old_u32_data) {
+			dec->old_u32_data = u32_data;
+			dec->old_data_counter = 0;
+		} else if ((u32_data == 0xFFFFFFFF) || (u32_data == 0x00000000)) {
+			/* No new data => End Of Frame detected => Wait new data & synchro */
+			dec->old_data_counter++;
+			if (dec->old_data_counter > 1)
+				return sniff_decoder_14443a_end_frame(dec);
+		} else {
+			dec->old_data_counter = 0;
+		}
+
+		f_data = LSR32(f_data, dec->rsh_miller_bit) | LSL32(0xFFFFFFFF, dec->lsh_miller_bit);
+		bit = (sniff_decoder_symbol[downsample_4x_u32(f_data)] >> dec->symbol_shift) & 1;
+
+		if (dec->tmp_u8_data_nb_bit < 8) {
+			dec->tmp_u8_data |= bit << dec->tmp_u8_data_nb_bit;
+			dec->tmp_u8_data_nb_bit++;
+		} else {
+			/* 9th bit is the parity */
+			frame = &dec->frame;
+			if (frame->nb_data < SNIFF_DECODER_FRAME_MAX) {
+				frame->data[frame->nb_data] = dec->tmp_u8_data;
+				frame->parity[frame->nb_data >> 3] |= bit << (frame->nb_data & 7);
+				frame->nb_data++;
+			} else {
+				frame->nb_data_lost++;
+			}
+			dec->tmp_u8_data = 0;
+			dec->tmp_u8_data_nb_bit = 0;
+		}
+		return SNIFF_DECODER_EVT_NONE;
+
+	case SNIFF_DECODER_STATE_WAIT_REF:
+		dec->old_data_bit = u32_data & 1;
+		dec->old_u32_data = u32_data;
+		dec->state = SNIFF_DECODER_STATE_WAIT_EDGE;
+		return SNIFF_DECODER_EVT_NONE;
+
+	case SNIFF_DECODER_STATE_WAIT_EDGE:
+		/* Search for an edge/data */
+		if (u32_data == dec->old_u32_data) {
+			dec->old_data_bit = u32_data & 1;
+			return SNIFF_DECODER_EVT_NONE;
+		}
+		/* Search first edge bit position to synchronize stream */
+		/* Old bit = 1 so new bit will be 0 => 11111111 10000000 => 00000000 01111111 just need to reverse it to count leading zero */
+		/* Old bit = 0 so new bit will be 1 => 00000000 01111111 no need to reverse to count leading zero */
+		dec->lsh_bit = count_leading_zero(dec->old_data_bit ? ~u32_data : u32_data);
+		dec->rsh_bit = 32 - dec->lsh_bit;
+		dec->prev_u32_data = u32_data;
+		dec->state = SNIFF_DECODER_STATE_SYNC;
+		return SNIFF_DECODER_EVT_NONE;
+
+	case SNIFF_DECODER_STATE_SYNC:
+		f_data = LSL32(dec->prev_u32_data, dec->lsh_bit) | LSR32(u32_data, dec->rsh_bit);
+		dec->prev_u32_data = u32_data;
+		sniff_decoder_14443a_sync(dec, f_data);
+		dec->state = SNIFF_DECODER_STATE_DATA;
+		return SNIFF_DECODER_EVT_FRAME_START;
+	}
+
+	return SNIFF_DECODER_EVT_NONE;
+}
+
+/* Sniffer stopped: close current frame if any */
+uint32_t sniff_decoder_14443a_stop(t_sniff_decoder_14443a *dec)
+{
+	if (dec->state == SNIFF_DECODER_STATE_DATA)
+		return sniff_decoder_14443a_end_frame(dec);
+
+	dec->state = SNIFF_DECODER_STATE_WAIT_REF;
+	return SNIFF_DECODER_EVT_NONE;
+}
+
+/*
+ * Decode a buffer of raw words (replay of a capture), frame_cb is called for
+ * each complete frame. Return the number of frames.
+ */
+uint32_t sniff_decoder_14443a_decode(t_sniff_decoder_14443a *dec,
+				     const uint32_t *words, uint32_t nb_words,
+				     sniff_decoder_frame_cb frame_cb, void *user)
+{
+	uint32_t i;
+	uint32_t nb_frames;
+
+	nb_frames = 0;
+	for (i = 0; i < nb_words; i++) {
+		if (sniff_decoder_14443a_push(dec, words[i]) == SNIFF_DECODER_EVT_FRAME_END) {
+			nb_frames++;
+			if (frame_cb != NULL)
+				frame_cb(user, &dec->frame);
+		}
+	}
+
+	return nb_frames;
+}
@@ -0,0 +1,96 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRANFC_CMD_SNIFF_DECODER_H_
+#define _HYDRANFC_CMD_SNIFF_DECODER_H_
+
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * ISO14443A 106kbps sniffer decoder.
+ * It consumes the raw 32bits words sampled at 3.39MHz by the SPI1 slave
+ * (MOD pin of TRF7970A, already swapped to MSB first) and emits decoded
+ * frames (Miller Modified for PCD and Manchester for PICC).
+ * It only depends on the symbol tables (hydranfc_cmd_sniff_iso14443.c,
+ * hydranfc_cmd_sniff_downsampling.c) and common/hot_path.h, not on ChibiOS
+ * or on the hardware, so it is built on a host by tests/host to replay raw
+ * captures.
+ */
+
+/* Max data bytes stored in a frame (following bytes are dropped) */
+#define SNIFF_DECODER_FRAME_MAX (256)
+
+/* Events returned by sniff_decoder_14443a_push()/sniff_decoder_14443a_stop() */
+#define SNIFF_DECODER_EVT_NONE (0)
+#define SNIFF_DECODER_EVT_FRAME_START (1) /* frame.detected/protocol/sync_symbol are valid */
+#define SNIFF_DECODER_EVT_FRAME_END (2) /* All frame fields are valid */
+
+typedef enum {
+	SNIFF_DECODER_STATE_WAIT_REF = 0, /* Next word is the reference (idle) word */
+	SNIFF_DECODER_STATE_WAIT_EDGE, /* Wait a word different from reference */
+	SNIFF_DECODER_STATE_SYNC, /* Next word completes the first symbol */
+	SNIFF_DECODER_STATE_DATA /* Decode bits until end of frame */
+} t_sniff_decoder_state;
+
+typedef struct {
+	u08_t detected; /* detected_protocol[] value of first symbol (0=Unknown) */
+	u08_t protocol; /* MILLER_MODIFIED_106KHZ or MANCHESTER_106KHZ used to decode data */
+	u08_t sync_symbol; /* First symbol downsampled by 4 */
+	u08_t last_nb_bit; /* Number of bits of last byte (8 if complete, else 4 to 7 without parity) */
+	uint32_t nb_data; /* Number of data bytes stored in data[] */
+	uint32_t nb_data_lost; /* Number of data bytes dropped (frame too long) */
+	uint32_t start_word; /* Index of first word of the frame (1 word = 32 samples) */
+	uint32_t end_word; /* Index of last word of the frame */
+	u08_t data[SNIFF_DECODER_FRAME_MAX];
+	u08_t parity[SNIFF_DECODER_FRAME_MAX / 8]; /* Parity bit of data[i] is bit (i & 7) of parity[i / 8] */
+} t_sniff_decoder_frame;
+
+typedef struct {
+	t_sniff_decoder_state state;
+	uint32_t nb_words; /* Total number of words pushed */
+	uint32_t old_u32_data;
+	uint32_t old_data_bit;
+	uint32_t old_data_counter;
+	uint32_t prev_u32_data;
+	uint32_t lsh_bit;
+	uint32_t rsh_bit;
+	uint32_t rsh_miller_bit;
+	uint32_t lsh_miller_bit;
+	uint32_t symbol_shift; /* Bit of sniff_decoder_symbol[] used for current protocol */
+	u08_t old_protocol;
+	u08_t tmp_u8_data;
+	u08_t tmp_u8_data_nb_bit;
+	t_sniff_decoder_frame frame;
+} t_sniff_decoder_14443a;
+
+typedef void (*sniff_decoder_frame_cb)(void *user, const t_sniff_decoder_frame *frame);
+
+void sniff_decoder_14443a_init(t_sniff_decoder_14443a *dec);
+uint32_t sniff_decoder_14443a_push(t_sniff_decoder_14443a *dec, uint32_t u32_data);
+uint32_t sniff_decoder_14443a_stop(t_sniff_decoder_14443a *dec);
+uint32_t sniff_decoder_14443a_decode(t_sniff_decoder_14443a *dec,
+				     const uint32_t *words, uint32_t nb_words,
+				     sniff_decoder_frame_cb frame_cb, void *user);
+
+static inline u08_t sniff_decoder_parity(const t_sniff_decoder_frame *frame, uint32_t i)
+{
+	return (frame->parity[i >> 3] >> (i & 7)) & 1;
+}
+
+#endif /* _HYDRANFC_CMD_SNIFF_DECODER_H_ */
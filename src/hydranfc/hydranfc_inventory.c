@@ -0,0 +1,270 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ch.h"
+#include "common.h"
+#include "hydrabus.h"
+#include "hydranfc.h"
+#include "trf797x.h"
+#include "bsp.h"
+#include <string.h>
+
+/*
+ * Continuous inventory: the TRF7970A is configured and RF is turned ON only
+ * once, then WUPA/Anticollision (ISO14443A) or 1 slot Inventory (ISO15693)
+ * are sent back to back until the number of rounds is reached or UBTN is
+ * pressed.
+ * Each tag is stored once in a de-duplication table with its read count.
+ *
+ * Binary output (one record per successful read):
+ *  uint8_t  type (NFC_INVENTORY_TYPE_xxx)
+ *  uint8_t  tag index in de-duplication table (0xFF if table is full)
+ *  uint8_t  uid_len
+ *  uint8_t  uid[uid_len]
+ *  uint32_t timestamp in us since inventory start (little endian)
+ */
+
+#define NFC_INVENTORY_TAGS_MAX (32)
+#define NFC_INVENTORY_UID_MAX (10)
+#define NFC_INVENTORY_TAG_IDX_NONE (0xFF)
+
+#define NFC_INVENTORY_TYPE_ISO14443A (0x01)
+#define NFC_INVENTORY_TYPE_ISO15693 (0x02)
+
+#define ISO14443A_WUPA (0x52)
+
+/* ISO15693 Inventory answer Flags(1)+DSFID(1)+UID(8) */
+#define ISO15693_INVENTORY_ANSWER_SIZE (10)
+#define ISO15693_FLAGS_ERROR (BIT0)
+
+typedef struct {
+	uint8_t uid_len;
+	uint8_t uid[NFC_INVENTORY_UID_MAX];
+	uint32_t nb_reads;
+	uint32_t first_us;
+	uint32_t last_us;
+} t_hydranfc_inventory_tag;
+
+static t_hydranfc_inventory_tag inventory_tags[NFC_INVENTORY_TAGS_MAX];
+static uint32_t inventory_nb_tags;
+
+/* Return tag index in table, add it if not found or NFC_INVENTORY_TAG_IDX_NONE if table is full */
+static uint8_t inventory_tag_find(uint8_t *uid, uint8_t uid_len, bool *new_tag)
+{
+	t_hydranfc_inventory_tag *tag;
+	uint32_t i;
+
+	*new_tag = FALSE;
+	for (i = 0; i < inventory_nb_tags; i++) {
+		tag = &inventory_tags[i];
+		if (tag->uid_len == uid_len && memcmp(tag->uid, uid, uid_len) == 0)
+			return i;
+	}
+
+	if (inventory_nb_tags >= NFC_INVENTORY_TAGS_MAX)
+		return NFC_INVENTORY_TAG_IDX_NONE;
+
+	tag = &inventory_tags[inventory_nb_tags];
+	tag->uid_len = uid_len;
+	memcpy(tag->uid, uid, uid_len);
+	tag->nb_reads = 0;
+	*new_tag = TRUE;
+
+	return inventory_nb_tags++;
+}
+
+static void inventory_sprint_uid(char *str, uint8_t *uid, uint8_t uid_len)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	uint8_t i;
+
+	for (i = 0; i < uid_len; i++) {
+		*str++ = ' ';
+		*str++ = hex[uid[i] >> 4];
+		*str++ = hex[uid[i] & 0x0F];
+	}
+	*str = 0;
+}
+
+/* Return the UID length (0 if no tag or invalid answer) */
+static uint8_t inventory_iso14443A(uint8_t *uid)
+{
+	t_hydranfc_scan_iso14443A data;
+	uint8_t bcc;
+	uint8_t i;
+
+	hydranfc_iso14443A_anticoll(&data, ISO14443A_WUPA, FALSE);
+
+	if (data.uid_buf_nb_rx_data >= 7) {
+		/* 7 bytes UID (CL1 without CT + CL2 without BCC) */
+		memcpy(uid, data.uid_buf, 7);
+		return 7;
+	}
+
+	/* 4 bytes UID + BCC */
+	if (data.uid_buf_nb_rx_data != 5)
+		return 0;
+
+	bcc = 0;
+	for (i = 0; i < 4; i++)
+		bcc ^= data.uid_buf[i];
+	if (bcc != data.uid_buf[4])
+		return 0;
+
+	memcpy(uid, data.uid_buf, 4);
+	return 4;
+}
+
+/* Return the UID length (0 if no tag or invalid answer) */
+static uint8_t inventory_iso15693(uint8_t *uid)
+{
+	uint8_t data_buf[VICINITY_UID_MAX];
+	uint8_t fifo_size;
+
+	fifo_size = hydranfc_iso15693_inventory(data_buf);
+	if (fifo_size < ISO15693_INVENTORY_ANSWER_SIZE)
+		return 0;
+
+	if (data_buf[0] & ISO15693_FLAGS_ERROR)
+		return 0;
+
+	memcpy(uid, &data_buf[2], 8);
+	return 8;
+}
+
+static void inventory_print_summary(t_hydra_console *con, uint32_t nb_rounds,
+				    uint32_t nb_reads, uint32_t nb_lost,
+				    uint32_t elapsed_us)
+{
+	t_hydranfc_inventory_tag *tag;
+	char uid_str[(NFC_INVENTORY_UID_MAX * 3) + 1];
+	uint32_t elapsed_ms;
+	uint32_t i;
+
+	cprintf(con, "Tags: %lu\r\n", inventory_nb_tags);
+	for (i = 0; i < inventory_nb_tags; i++) {
+		tag = &inventory_tags[i];
+		inventory_sprint_uid(uid_str, tag->uid, tag->uid_len);
+		cprintf(con, "#%02lu UID:%-24s reads: %lu first: %luus last: %luus\r\n",
+			i, uid_str, tag->nb_reads, tag->first_us, tag->last_us);
+	}
+
+	elapsed_ms = elapsed_us / 1000;
+	cprintf(con, "Rounds: %lu reads: %lu not stored: %lu time: %lums\r\n",
+		nb_rounds, nb_reads, nb_lost, elapsed_ms);
+	if (elapsed_ms > 0) {
+		cprintf(con, "Rate: %lu rounds/s %lu reads/s\r\n",
+			(uint32_t)(((uint64_t)nb_rounds * 1000) / elapsed_ms),
+			(uint32_t)(((uint64_t)nb_reads * 1000) / elapsed_ms));
+	}
+}
+
+/*
+ * nb_rounds: number of inventory rounds (0 means until UBTN is pressed)
+ * bin_output: TRUE output binary records else new tags and summary in ASCII
+ */
+void hydranfc_inventory(t_hydra_console *con, bool vicinity,
+			uint32_t nb_rounds, bool bin_output)
+{
+	t_hydranfc_inventory_tag *tag;
+	uint8_t uid[NFC_INVENTORY_UID_MAX];
+	uint8_t record[3 + NFC_INVENTORY_UID_MAX + 4];
+	char uid_str[(NFC_INVENTORY_UID_MAX * 3) + 1];
+	uint8_t uid_len;
+	uint8_t tag_idx;
+	uint8_t type;
+	bool new_tag;
+	uint32_t round;
+	uint32_t nb_reads;
+	uint32_t nb_lost;
+	uint32_t timestamp_us;
+	uint64_t cycles_start;
+	uint32_t i;
+
+	inventory_nb_tags = 0;
+	nb_reads = 0;
+	nb_lost = 0;
+	timestamp_us = 0;
+
+	if (!bin_output) {
+		cprintf(con, "Inventory %s", vicinity ? "Vicinity" : "MIFARE");
+		if (nb_rounds > 0)
+			cprintf(con, " %lu rounds.\r\n", nb_rounds);
+		else
+			cprintf(con, ". Press user button to stop.\r\n");
+	}
+
+	if (vicinity) {
+		type = NFC_INVENTORY_TYPE_ISO15693;
+		hydranfc_iso15693_setup();
+	} else {
+		type = NFC_INVENTORY_TYPE_ISO14443A;
+		hydranfc_iso14443A_setup();
+	}
+
+	cycles_start = bsp_get_cyclecounter64();
+	for (round = 0; (nb_rounds == 0) || (round < nb_rounds); round++) {
+		if (hydrabus_ubtn())
+			break;
+
+		if (vicinity)
+			uid_len = inventory_iso15693(uid);
+		else
+			uid_len = inventory_iso14443A(uid);
+
+		/* bsp_get_cyclecounter64() is called at least every round (< 2^32 cycles) */
+		timestamp_us = (uint32_t)((bsp_get_cyclecounter64() - cycles_start) /
+					  (STM32_HCLK / 1000000));
+		if (uid_len == 0)
+			continue;
+
+		nb_reads++;
+		tag_idx = inventory_tag_find(uid, uid_len, &new_tag);
+		if (tag_idx != NFC_INVENTORY_TAG_IDX_NONE) {
+			tag = &inventory_tags[tag_idx];
+			if (new_tag)
+				tag->first_us = timestamp_us;
+			tag->last_us = timestamp_us;
+			tag->nb_reads++;
+		} else {
+			nb_lost++;
+		}
+
+		if (bin_output) {
+			record[0] = type;
+			record[1] = tag_idx;
+			record[2] = uid_len;
+			for (i = 0; i < uid_len; i++)
+				record[3 + i] = uid[i];
+			record[3 + i] = timestamp_us & 0xFF;
+			record[4 + i] = (timestamp_us >> 8) & 0xFF;
+			record[5 + i] = (timestamp_us >> 16) & 0xFF;
+			record[6 + i] = (timestamp_us >> 24) & 0xFF;
+			cprint(con, (char *)record, 7 + i);
+		} else if (new_tag) {
+			inventory_sprint_uid(uid_str, uid, uid_len);
+			cprintf(con, "#%02d UID:%s\r\n", tag_idx, uid_str);
+		}
+	}
+
+	/* Turn RF OFF (Chip Status Control Register (0x00)) */
+	Trf797xTurnRfOff();
+
+	if (!bin_output)
+		inventory_print_summary(con, round, nb_reads, nb_lost, timestamp_us);
+}
@@ -44,6 +44,7 @@
 #include "bsp_print_dbg.h"
 
 #include "script.h"
+#include "usb_tx.h"
 
 #define INIT_SCRIPT_NAME "initscript"
 
@@ -77,6 +78,9 @@ THD_FUNCTION(console, arg)
 
 	con = arg;
 	chRegSetThreadName(con->thread_name);
+	chMtxObjectInit(&con->mutex);
+	/* mode_con1/2 are in .ram4 which is not initialized at boot */
+	memset(con->mode->macro, 0, sizeof(con->mode->macro));
 	tl_init(con->tl, tl_tokens, tl_dict, print, con);
 	con->tl->prompt = PROMPT;
 	tl_set_callback(con->tl, execute);
@@ -87,6 +91,8 @@ THD_FUNCTION(console, arg)
 
 	while (1) {
 		input = get_char(con);
+		/* Mode periodic service runs only while console waits for input */
+		chMtxLock(&con->mutex);
 		switch(input) {
 		case 0:
 			if (++i == 20) {
@@ -113,6 +119,7 @@ THD_FUNCTION(console, arg)
 			i=0;
 			tl_input(con->tl, input);
 		}
+		chMtxUnlock(&con->mutex);
 		chThdSleepMilliseconds(1);
 	}
 }
@@ -168,9 +175,10 @@ int main(void)
 	 * Initializes a serial-over-USB CDC driver.
 	 */
 	sduObjectInit(&SDU1);
-	sduStart(&SDU1, &serusb1cfg);
-
 	sduObjectInit(&SDU2);
+	usb_tx_init(&SDU1, &SDU2);
+
+	sduStart(&SDU1, &serusb1cfg);
 	sduStart(&SDU2, &serusb2cfg);
 
 	/*
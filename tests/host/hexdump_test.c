@@ -0,0 +1,215 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test and microbenchmark of the console hex formatters
+ * (src/common/hexdump.c).
+ *
+ * The output of print_hex() and print_hex_bytes() built on hexdump_line()
+ * and hexdump_bytes() is compared with the previous one cprintf() per
+ * byte implementation for all sizes from 1 to 1000 bytes, then both are
+ * timed on a 1MiB buffer. Console writes go to a memory buffer and are
+ * counted, on target each one is a chnWrite().
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hexdump.h"
+
+#define BENCH_SIZE (1024 * 1024)
+#define OUT_MAX (BENCH_SIZE * 5)
+/* Same as PRINT_HEX_BUF_SIZE in common.c */
+#define PRINT_HEX_BUF_SIZE (512)
+
+static char out[OUT_MAX];
+static uint32_t out_len;
+static uint32_t nb_writes;
+static int nb_failed;
+
+static void cprint(const char *data, uint32_t size)
+{
+	if (out_len + size <= OUT_MAX) {
+		memcpy(&out[out_len], data, size);
+		out_len += size;
+	}
+	nb_writes++;
+}
+
+static void cprintf(const char *fmt, ...)
+{
+	va_list va_args;
+	char buf[512];
+	int len;
+
+	va_start(va_args, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, va_args);
+	va_end(va_args);
+	cprint(buf, len);
+}
+
+/* Previous print_hex(), one cprintf() per byte */
+static void print_hex_ref(uint8_t *data, uint32_t size)
+{
+	uint8_t ascii[17];
+	uint32_t i, j;
+	ascii[16] = '\0';
+	for (i = 0; i < size; ++i) {
+		cprintf("%02X ", data[i]);
+		if (data[i] >= 0x20 && data[i] <= 0x7f) {
+			ascii[i % 16] = data[i];
+		} else {
+			ascii[i % 16] = '.';
+		}
+		if ((i+1) % 8 == 0 || i+1 == size) {
+			cprintf(" ");
+			if ((i+1) % 16 == 0) {
+				cprintf("|  %s \r\n", ascii);
+			} else if (i+1 == size) {
+				ascii[(i+1) % 16] = '\0';
+				if ((i+1) % 16 <= 8) {
+					cprintf(" ");
+				}
+				for (j = (i+1) % 16; j < 16; ++j) {
+					cprintf("   ");
+				}
+				cprintf("|  %s \r\n", ascii);
+			}
+		}
+	}
+}
+
+/* Same loop as print_hex() in common.c */
+static void print_hex_new(uint8_t *data, uint32_t size)
+{
+	char buf[PRINT_HEX_BUF_SIZE];
+	uint32_t idx, i, n;
+
+	idx = 0;
+	for (i = 0; i < size; i += n) {
+		n = size - i;
+		if (n > HEXDUMP_LINE_BYTES)
+			n = HEXDUMP_LINE_BYTES;
+
+		if ((idx + HEXDUMP_LINE_MAX) > sizeof(buf)) {
+			cprint(buf, idx);
+			idx = 0;
+		}
+		idx += hexdump_line(&buf[idx], &data[i], n);
+	}
+	if (idx > 0)
+		cprint(buf, idx);
+}
+
+static char *capture(void (*print)(uint8_t *, uint32_t), uint8_t *data,
+		     uint32_t size, uint32_t *len)
+{
+	char *copy;
+
+	out_len = 0;
+	print(data, size);
+	copy = malloc(out_len);
+	memcpy(copy, out, out_len);
+	*len = out_len;
+	return copy;
+}
+
+static void test_print_hex(uint8_t *data)
+{
+	char *ref, *new;
+	uint32_t size, ref_len, new_len;
+
+	for (size = 1; size <= 1000; size++) {
+		ref = capture(print_hex_ref, data, size, &ref_len);
+		new = capture(print_hex_new, data, size, &new_len);
+		if ((ref_len != new_len) || memcmp(ref, new, ref_len)) {
+			printf("print_hex FAIL: size %u differs\n", size);
+			nb_failed++;
+			size = 1000;
+		}
+		free(ref);
+		free(new);
+	}
+	if (!nb_failed)
+		printf("print_hex  ok  : sizes 1 to 1000\n");
+}
+
+static void test_hex_bytes(uint8_t *data)
+{
+	char ref[64 * 3 + 1], new[64 * 3 + 1];
+	uint32_t size, i, len;
+
+	for (size = 0; size <= 64; size++) {
+		len = 0;
+		ref[0] = 0;
+		for (i = 0; i < size; i++)
+			len += sprintf(&ref[len], " %02X", data[i]);
+		if ((hexdump_bytes(new, data, size) != len) || strcmp(ref, new)) {
+			printf("hex_bytes FAIL: size %u differs\n", size);
+			nb_failed++;
+			return;
+		}
+	}
+	printf("hex_bytes  ok  : sizes 0 to 64\n");
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, void (*print)(uint8_t *, uint32_t), uint8_t *data)
+{
+	double start, sec;
+
+	out_len = 0;
+	nb_writes = 0;
+	start = now_sec();
+	print(data, BENCH_SIZE);
+	sec = now_sec() - start;
+
+	printf("bench %s: %u bytes, %u writes in %.3fs (%.1f MB/s)\n",
+	       name, BENCH_SIZE, nb_writes, sec, BENCH_SIZE / sec / 1e6);
+}
+
+int main(void)
+{
+	static uint8_t data[BENCH_SIZE];
+	uint32_t i;
+
+	srand(1);
+	for (i = 0; i < BENCH_SIZE; i++)
+		data[i] = rand();
+
+	test_print_hex(data);
+	test_hex_bytes(data);
+	bench("cprintf  ", print_hex_ref, data);
+	bench("hexdump.c", print_hex_new, data);
+
+	if (nb_failed) {
+		printf("%d test(s) failed\n", nb_failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test of the periodic service deadline and budget accounting
+ * (src/common/periodic_sched.c): on time calls, overruns, skipped periods
+ * and uint32_t counter wrap.
+ */
+
+#include <stdio.h>
+
+#include "periodic_sched.h"
+
+static int nb_failed;
+
+#define CHECK(name, val, expected) check(name, __LINE__, (val), (expected))
+
+static void check(const char *name, int line, uint32_t val, uint32_t expected)
+{
+	if (val == expected)
+		return;
+	printf("line %d: %s = %u, expected %u\n", line, name, val, expected);
+	nb_failed++;
+}
+
+static void test_on_time(uint32_t t0)
+{
+	t_periodic_sched s;
+	uint32_t i;
+
+	periodic_sched_init(&s, 1000, 500, t0);
+	CHECK("first delay", periodic_sched_delay(&s, t0), 0);
+
+	for (i = 0; i < 10; i++) {
+		/* Called 20us late, lasts 100us */
+		periodic_sched_done(&s, t0 + i * 1000 + 20, t0 + i * 1000 + 120);
+		CHECK("delay", periodic_sched_delay(&s, t0 + i * 1000 + 120), 880);
+		CHECK("delay due", periodic_sched_delay(&s, t0 + i * 1000 + 1000), 0);
+		CHECK("delay late", periodic_sched_delay(&s, t0 + i * 1000 + 1300), 0);
+	}
+	CHECK("nb_calls", s.nb_calls, 10);
+	CHECK("nb_overruns", s.nb_overruns, 0);
+	CHECK("nb_missed", s.nb_missed, 0);
+	CHECK("max_us", s.max_us, 100);
+	CHECK("avg_us", periodic_sched_avg_us(&s), 100);
+}
+
+static void test_overrun(uint32_t t0)
+{
+	t_periodic_sched s;
+
+	periodic_sched_init(&s, 1000, 500, t0);
+	CHECK("avg_us no call", periodic_sched_avg_us(&s), 0);
+
+	/* Over budget but ends before next deadline: not missed */
+	periodic_sched_done(&s, t0, t0 + 700);
+	CHECK("nb_overruns", s.nb_overruns, 1);
+	CHECK("nb_missed", s.nb_missed, 0);
+	CHECK("delay", periodic_sched_delay(&s, t0 + 700), 300);
+
+	/* Ends after next deadline but less than one period late: not missed */
+	periodic_sched_done(&s, t0 + 1000, t0 + 2900);
+	CHECK("nb_overruns", s.nb_overruns, 2);
+	CHECK("nb_missed", s.nb_missed, 0);
+	CHECK("deadline", s.deadline_us, t0 + 2000);
+	CHECK("delay", periodic_sched_delay(&s, t0 + 2900), 0);
+
+	/* Ends 2.5 periods after next deadline: 2 periods skipped */
+	periodic_sched_done(&s, t0 + 2900, t0 + 5500);
+	CHECK("nb_missed", s.nb_missed, 2);
+	CHECK("deadline", s.deadline_us, t0 + 5000);
+	CHECK("delay", periodic_sched_delay(&s, t0 + 5500), 0);
+
+	/* Back on time */
+	periodic_sched_done(&s, t0 + 5500, t0 + 5600);
+	CHECK("deadline", s.deadline_us, t0 + 6000);
+	CHECK("delay", periodic_sched_delay(&s, t0 + 5600), 400);
+	CHECK("nb_calls", s.nb_calls, 4);
+	CHECK("nb_overruns", s.nb_overruns, 3);
+	CHECK("max_us", s.max_us, 2600);
+	CHECK("avg_us", periodic_sched_avg_us(&s), (700 + 1900 + 2600 + 100) / 4);
+}
+
+int main(void)
+{
+	static const uint32_t t0[] = { 0, 123456, 0xFFFFF000, 0xFFFFFFFF };
+	uint32_t i;
+
+	for (i = 0; i < sizeof(t0) / sizeof(t0[0]); i++) {
+		test_on_time(t0[i]);
+		test_overrun(t0[i]);
+	}
+
+	if (nb_failed) {
+		printf("%d check(s) failed\n", nb_failed);
+		return 1;
+	}
+	printf("periodic_sched ok: on time, overrun, missed, wrap\n");
+	return 0;
+}
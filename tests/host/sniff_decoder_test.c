@@ -0,0 +1,271 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2026 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test and benchmark of the ISO14443A sniffer decoder
+ * (src/hydranfc/hydranfc_cmd_sniff_decoder.c).
+ *
+ * Frames are encoded to raw 32-bit SPI words with ISO14443-A timings
+ * (1 word = 32 samples at 3.39MHz = 1 bit at 106kbps), decoded and
+ * compared. A raw capture (little endian 32-bit words) given on the
+ * command line is replayed and its frames are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hydranfc_cmd_sniff_decoder.h"
+#include "hydranfc_cmd_sniff_iso14443.h"
+
+#define IDLE_WORDS (4)
+#define WORDS_MAX (1024 * 1024)
+#define WORDS_PER_SEC (3390000 / 32) /* Real time input rate */
+
+/* Miller modified pause (about 2.4us) */
+#define MILLER_PAUSE (0x00FFFFFF)
+
+static uint32_t words[WORDS_MAX];
+static int nb_failed;
+
+typedef struct {
+	const char *name;
+	uint8_t protocol;
+	uint32_t nb_data;
+	uint8_t data[32];
+} t_test_frame;
+
+static const t_test_frame test_frames[] = {
+	{ "SELECT CL1", MILLER_MODIFIED_106KHZ, 2, { 0x93, 0x20 } },
+	{ "ATQA", MANCHESTER_106KHZ, 2, { 0x04, 0x00 } },
+	{ "UID CL1", MANCHESTER_106KHZ, 5, { 0x04, 0xA1, 0xB2, 0xC3, 0xD4 } },
+	{ "READ 4", MILLER_MODIFIED_106KHZ, 4, { 0x30, 0x04, 0x26, 0xEE } },
+	{ "READ data", MANCHESTER_106KHZ, 18,
+	  { 0x00, 0xFF, 0x55, 0xAA, 0x01, 0x80, 0x7F, 0xFE, 0x12,
+	    0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0, 0x0F, 0xF0 } },
+};
+
+static uint8_t odd_parity(uint8_t data)
+{
+	return !__builtin_parity(data);
+}
+
+/* PCD: idle is carrier (1), pause (0) at start of a 0 or middle of a 1 */
+static uint32_t encode_miller(uint32_t *out, const uint8_t *data, uint32_t nb_data)
+{
+	uint32_t n, i, j;
+	uint8_t bit, prev;
+
+	n = 0;
+	for (i = 0; i < IDLE_WORDS; i++)
+		out[n++] = 0xFFFFFFFF;
+
+	/* Start of communication is a 0 */
+	out[n++] = MILLER_PAUSE;
+	prev = 0;
+	for (i = 0; i < nb_data; i++) {
+		for (j = 0; j < 9; j++) {
+			bit = (j < 8) ? (data[i] >> j) & 1 : odd_parity(data[i]);
+			if (bit)
+				out[n++] = 0xFFFF0000 | (MILLER_PAUSE >> 16);
+			else if (prev)
+				out[n++] = 0xFFFFFFFF;
+			else
+				out[n++] = MILLER_PAUSE;
+			prev = bit;
+		}
+	}
+	/* End of communication is a 0 followed by no modulation */
+	out[n++] = prev ? 0xFFFFFFFF : MILLER_PAUSE;
+
+	for (i = 0; i < IDLE_WORDS; i++)
+		out[n++] = 0xFFFFFFFF;
+	return n;
+}
+
+/* PICC: 847.5kHz subcarrier in first half of a 1 or second half of a 0 */
+static uint32_t encode_manchester(uint32_t *out, const uint8_t *data, uint32_t nb_data)
+{
+	uint32_t n, i, j;
+	uint8_t bit;
+
+	n = 0;
+	for (i = 0; i < IDLE_WORDS; i++)
+		out[n++] = 0x00000000;
+
+	/* Start of communication is a 1 */
+	out[n++] = 0x33330000;
+	for (i = 0; i < nb_data; i++) {
+		for (j = 0; j < 9; j++) {
+			bit = (j < 8) ? (data[i] >> j) & 1 : odd_parity(data[i]);
+			out[n++] = bit ? 0x33330000 : 0x00003333;
+		}
+	}
+
+	for (i = 0; i < IDLE_WORDS; i++)
+		out[n++] = 0x00000000;
+	return n;
+}
+
+static uint32_t encode(uint32_t *out, const t_test_frame *tf)
+{
+	if (tf->protocol == MANCHESTER_106KHZ)
+		return encode_manchester(out, tf->data, tf->nb_data);
+	return encode_miller(out, tf->data, tf->nb_data);
+}
+
+typedef struct {
+	const t_test_frame *expected;
+	uint32_t nb_frames;
+} t_check;
+
+static void check_frame(void *user, const t_sniff_decoder_frame *frame)
+{
+	t_check *chk = user;
+	const t_test_frame *tf = chk->expected;
+	uint32_t i;
+	int ok;
+
+	chk->nb_frames++;
+	ok = (frame->protocol == tf->protocol) &&
+	     (frame->nb_data == tf->nb_data) &&
+	     (frame->last_nb_bit == 8) &&
+	     (memcmp(frame->data, tf->data, tf->nb_data) == 0);
+	for (i = 0; ok && i < tf->nb_data; i++) {
+		if (sniff_decoder_parity(frame, i) != odd_parity(tf->data[i]))
+			ok = 0;
+	}
+
+	printf("%-10s %s:", tf->name, ok ? "ok  " : "FAIL");
+	for (i = 0; i < frame->nb_data; i++)
+		printf(" %02X", frame->data[i]);
+	printf(" (protocol %u, last byte %u bits)\n", frame->protocol, frame->last_nb_bit);
+	if (!ok)
+		nb_failed++;
+}
+
+static void test_frames_decode(void)
+{
+	t_sniff_decoder_14443a dec;
+	t_check chk;
+	uint32_t i, n;
+
+	for (i = 0; i < sizeof(test_frames) / sizeof(test_frames[0]); i++) {
+		chk.expected = &test_frames[i];
+		chk.nb_frames = 0;
+		n = encode(words, &test_frames[i]);
+		sniff_decoder_14443a_init(&dec);
+		sniff_decoder_14443a_decode(&dec, words, n, check_frame, &chk);
+		if (chk.nb_frames != 1) {
+			printf("%-10s FAIL: %u frames decoded\n", test_frames[i].name, chk.nb_frames);
+			nb_failed++;
+		}
+	}
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Decode a long capture of PCD frames several times */
+static void bench(void)
+{
+	t_sniff_decoder_14443a dec;
+	uint32_t n, i, nb_frames, loops;
+	double start, sec;
+
+	n = 0;
+	while (n < WORDS_MAX - 512) {
+		for (i = 0; i < sizeof(test_frames) / sizeof(test_frames[0]); i++)
+			n += encode_miller(&words[n], test_frames[i].data, test_frames[i].nb_data);
+	}
+
+	loops = 20;
+	nb_frames = 0;
+	sniff_decoder_14443a_init(&dec);
+	start = now_sec();
+	for (i = 0; i < loops; i++)
+		nb_frames += sniff_decoder_14443a_decode(&dec, words, n, NULL, NULL);
+	sec = now_sec() - start;
+
+	printf("bench: %u words %u frames in %.3fs: %.1f Mwords/s (%.0fx real time)\n",
+	       n * loops, nb_frames, sec, (n * loops) / sec / 1e6,
+	       (n * loops) / sec / WORDS_PER_SEC);
+}
+
+static void print_frame(void *user, const t_sniff_decoder_frame *frame)
+{
+	uint32_t i;
+
+	(void)user;
+	printf("%8u %s", frame->start_word,
+	       frame->protocol == MANCHESTER_106KHZ ? "PICC" : "PCD ");
+	for (i = 0; i < frame->nb_data; i++)
+		printf(" %02X", frame->data[i]);
+	if (frame->last_nb_bit != 8)
+		printf(" (%u bits)", frame->last_nb_bit);
+	printf("\n");
+}
+
+/* Replay a raw capture file */
+static int replay(const char *filename)
+{
+	t_sniff_decoder_14443a dec;
+	FILE *f;
+	uint8_t b[4];
+	uint32_t n, nb_frames;
+
+	f = fopen(filename, "rb");
+	if (f == NULL) {
+		perror(filename);
+		return 1;
+	}
+	n = 0;
+	while (n < WORDS_MAX && fread(b, 1, 4, f) == 4)
+		words[n++] = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+	fclose(f);
+
+	sniff_decoder_14443a_init(&dec);
+	nb_frames = sniff_decoder_14443a_decode(&dec, words, n, print_frame, NULL);
+	if (sniff_decoder_14443a_stop(&dec) == SNIFF_DECODER_EVT_FRAME_END) {
+		print_frame(NULL, &dec.frame);
+		nb_frames++;
+	}
+	printf("%u words, %u frames\n", n, nb_frames);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		return replay(argv[1]);
+
+	test_frames_decode();
+	bench();
+
+	if (nb_failed) {
+		printf("%d test(s) failed\n", nb_failed);
+		return 1;
+	}
+	return 0;
+}